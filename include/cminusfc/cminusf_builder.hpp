@@ -8,48 +8,75 @@
 #include "Type.hpp"
 #include "ast.hpp"
 
-#include <map>
 #include <memory>
-
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* Bindings by interned symbol: each symbol has a stack of its bindings with
+ * the innermost on top, each scope logs the symbols it bound so that exit()
+ * pops exactly those. */
 class Scope {
   public:
     // enter a new scope
-    void enter() { inner.emplace_back(); }
+    void enter() { scope_begin.push_back(bound.size()); }
 
     // exit a scope
-    void exit() { inner.pop_back(); }
+    void exit() {
+        while (bound.size() > scope_begin.back()) {
+            bindings[bound.back()].pop_back();
+            bound.pop_back();
+        }
+        scope_begin.pop_back();
+    }
 
-    bool in_global() { return inner.size() == 1; }
+    bool in_global() { return scope_begin.size() == 1; }
 
     // push a name to scope
     // return true if successful
     // return false if this name already exits
-    bool push(const std::string& name, Value *val) {
-        auto result = inner[inner.size() - 1].insert({name, val});
-        return result.second;
+    bool push(Symbol sym, Value *val) {
+        if (sym >= bindings.size())
+            bindings.resize(sym + 1);
+        auto &stack = bindings[sym];
+        unsigned depth = scope_begin.size();
+        if (not stack.empty() and stack.back().depth == depth)
+            return false;
+        stack.push_back({val, depth});
+        bound.push_back(sym);
+        return true;
     }
 
-    Value *find(const std::string& name) {
-        for (auto s = inner.rbegin(); s != inner.rend(); s++) {
-            auto iter = s->find(name);
-            if (iter != s->end()) {
-                return iter->second;
-            }
-        }
+    Value *find(Symbol sym) {
+        if (sym < bindings.size() and not bindings[sym].empty())
+            return bindings[sym].back().val;
 
-        // Name not found: handled here?
+        // CminusfChecker reports undeclared names before the build
         assert(false && "Name not found in scope");
 
         return nullptr;
     }
 
   private:
-    std::vector<std::map<std::string, Value *>> inner;
+    struct Binding {
+        Value *val;
+        // number of scopes entered when bound
+        unsigned depth;
+    };
+    std::vector<std::vector<Binding>> bindings;
+    // the symbols bound, innermost scope last
+    std::vector<Symbol> bound;
+    // where each scope starts in bound
+    std::vector<std::size_t> scope_begin;
 };
 
 class CminusfBuilder : public ASTVisitor {
   public:
-    CminusfBuilder() {
+    // direct_ssa: build scalars as ssa values, see SSAState
+    // lazy_bodies: build only the bodies main reaches, see pending_bodies
+    explicit CminusfBuilder(bool direct_ssa = false, bool lazy_bodies = false)
+        : lazy_bodies(lazy_bodies), direct_ssa(direct_ssa) {
         module = std::make_unique<Module>();
         builder = std::make_unique<IRBuilder>(nullptr, module.get());
         auto *TyVoid = module->get_void_type();
@@ -71,14 +98,14 @@ class CminusfBuilder : public ASTVisitor {
             Function::create(output_float_type, "outputFloat", module.get());
 
         auto *neg_idx_except_type = FunctionType::get(TyVoid, {});
-        auto *neg_idx_except_fun = Function::create(
+        neg_idx_except_fun = Function::create(
             neg_idx_except_type, "neg_idx_except", module.get());
 
-        scope.enter();
-        scope.push("input", input_fun);
-        scope.push("output", output_fun);
-        scope.push("outputFloat", output_float_fun);
-        scope.push("neg_idx_except", neg_idx_except_fun);
+        // bound in visit(ASTProgram &) to the symbols of the program
+        builtins = {{"input", input_fun},
+                    {"output", output_fun},
+                    {"outputFloat", output_float_fun},
+                    {"neg_idx_except", neg_idx_except_fun}};
     }
 
     std::unique_ptr<Module> getModule() { return std::move(module); }
@@ -104,6 +131,62 @@ class CminusfBuilder : public ASTVisitor {
     std::unique_ptr<IRBuilder> builder;
     Scope scope;
     std::unique_ptr<Module> module;
+    std::vector<std::pair<const char *, Function *>> builtins;
+    // called on negative array indices
+    Function *neg_idx_except_fun;
+
+    /* With lazy_bodies the functions are only declared where the program
+     * declares them. Once all names are bound, the body of main is built,
+     * and the body of every function a built call calls after it; the
+     * functions never called that way are erased without a body, as main
+     * is the only way into the program. A module without a main keeps all
+     * of its functions. */
+    bool lazy_bodies;
+    // declared and not queued yet
+    std::unordered_map<Function *, ASTFunDeclaration *> pending_bodies;
+    std::vector<std::pair<ASTFunDeclaration *, Function *>> body_queue;
+    void queue_body(Function *func);
+    Function *declare_function(ASTFunDeclaration &node);
+    // context.func becomes func
+    void build_body(ASTFunDeclaration &node, Function *func);
+
+    /* Direct SSA construction after Braun et al., "Simple and Efficient
+     * Construction of SSA Form". A scalar local or parameter keeps its
+     * alloca only to name the variable: assignments record the value as the
+     * current definition in the block, reads look it up and place phis
+     * where it is defined on several paths. A block is sealed once all its
+     * predecessors are known, phis of unsealed blocks get their operands
+     * then. The allocas are erased at the end of the function. */
+    bool direct_ssa;
+    struct SSAState {
+        // variable -> block -> definition at the end of the block
+        std::unordered_map<Value *, std::unordered_map<BasicBlock *, Value *>>
+            current_def;
+        std::unordered_set<BasicBlock *> sealed;
+        std::unordered_map<BasicBlock *, std::vector<std::pair<Value *, PhiInst *>>>
+            incomplete_phis;
+        // trivial phis taken out, and the value that replaced each
+        std::unordered_map<Value *, Value *> replaced;
+        // phis whose operands are being read
+        std::unordered_set<PhiInst *> filling;
+        std::vector<AllocaInst *> vars;
+    } ssa;
+
+    bool is_ssa_var(Value *addr) {
+        return direct_ssa and ssa.current_def.count(addr);
+    }
+    // the value of a variable, a load unless it is an ssa variable
+    Value *load_var(Value *addr);
+    void add_ssa_var(AllocaInst *var);
+    // erase the allocas and phis left over at the end of a function
+    void finish_ssa();
+    void write_variable(Value *var, BasicBlock *bb, Value *val);
+    Value *read_variable(Value *var, BasicBlock *bb);
+    Value *read_variable_recursive(Value *var, BasicBlock *bb);
+    Value *add_phi_operands(Value *var, PhiInst *phi);
+    Value *try_remove_trivial_phi(PhiInst *phi);
+    // no-op unless direct_ssa
+    void seal_block(BasicBlock *bb);
 
     struct {
         // whether require lvalue
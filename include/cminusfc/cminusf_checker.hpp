@@ -0,0 +1,78 @@
+#pragma once
+
+#include "ast.hpp"
+
+#include <deque>
+#include <string>
+#include <vector>
+
+/* The semantic errors of a program, checked on the AST before the
+ * CminusfBuilder runs: the builder takes the program as well formed and
+ * asserts on an undeclared name, a call that does not match its function or
+ * an array where a number belongs. The scopes are those of the builder, the
+ * parameters in one of their own around the body. int and float convert
+ * into each other wherever a number is expected; an array is only taken
+ * whole as the argument of an array parameter of its element type. */
+class CminusfChecker : public ASTVisitor {
+  public:
+    // the first error in the program, empty if there is none
+    const std::string &get_error() const { return error; }
+
+  private:
+    virtual Value *visit(ASTProgram &) override final;
+    virtual Value *visit(ASTNum &) override final;
+    virtual Value *visit(ASTVarDeclaration &) override final;
+    virtual Value *visit(ASTFunDeclaration &) override final;
+    virtual Value *visit(ASTParam &) override final;
+    virtual Value *visit(ASTCompoundStmt &) override final;
+    virtual Value *visit(ASTExpressionStmt &) override final;
+    virtual Value *visit(ASTSelectionStmt &) override final;
+    virtual Value *visit(ASTIterationStmt &) override final;
+    virtual Value *visit(ASTReturnStmt &) override final;
+    virtual Value *visit(ASTAssignExpression &) override final;
+    virtual Value *visit(ASTSimpleExpression &) override final;
+    virtual Value *visit(ASTAdditiveExpression &) override final;
+    virtual Value *visit(ASTVar &) override final;
+    virtual Value *visit(ASTTerm &) override final;
+    virtual Value *visit(ASTCall &) override final;
+
+    // what an expression gives or a variable holds; none after an error,
+    // it fits everywhere so that one error is reported once
+    enum Kind { k_int, k_float, k_void, k_int_array, k_float_array, k_none };
+    struct Signature {
+        Kind ret;
+        std::vector<Kind> params;
+    };
+    struct Binding {
+        // nullptr for a variable
+        const Signature *func;
+        Kind kind;
+        // number of scopes entered when bound
+        unsigned depth;
+    };
+
+    static bool is_number(Kind kind) {
+        return kind == k_int or kind == k_float or kind == k_none;
+    }
+    void enter() { scope_begin.push_back(bound.size()); }
+    void exit();
+    // false if the name is bound in the current scope already
+    bool push(Symbol sym, Binding binding);
+    // nullptr if the name is not bound
+    const Binding *find(Symbol sym) const;
+    void report(const std::string &what);
+    // the kind of expr, reported unless it is a number
+    Kind number(ASTNode *expr, const char *what);
+
+    std::string error;
+    // the function being checked, nullptr between functions
+    ASTFunDeclaration *func = nullptr;
+    const Signature *func_sig = nullptr;
+    // the kind of the last expression visited
+    Kind kind = k_none;
+    // of the builtins and the functions declared, in place
+    std::deque<Signature> signatures;
+    std::vector<std::vector<Binding>> bindings;
+    std::vector<Symbol> bound;
+    std::vector<std::size_t> scope_begin;
+};
@@ -0,0 +1,117 @@
+#pragma once
+
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+#include "LiveIntervals.hpp"
+#include "Module.hpp"
+#include "RegAlloc.hpp"
+
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* -S: x86-64 assembly for the System V ABI in GNU as syntax, linked with
+ * the io.c runtime like the code llc produces. Every instruction is
+ * selected on its own through scratch registers, a compare feeding the
+ * following branch sets the flags for it. Values live in the registers
+ * linear scan assigns or in stack slots below %rbp, an alloca is a fixed
+ * frame address. Phis become parallel moves on the edges, a conditional
+ * branch jumps to a block of its own for the moves of the taken edge. */
+class CodeGen {
+  public:
+    explicit CodeGen(Module *m) : m_(m) {}
+    void run(std::ostream &os);
+
+    // a general purpose register by its 64 and 32 bit names
+    struct Gpr {
+        const char *r64, *r32;
+    };
+
+  private:
+    using Location = LinearScan::Location;
+
+    void emit_global(GlobalVariable *global);
+    void emit_constant(Constant *init, Type *type);
+    void emit_function(Function *func);
+    void emit_prologue(Function *func);
+    void emit_epilogue();
+    void emit_instr(Instruction *instr, BasicBlock *next);
+
+    // selection
+    void emit_int_binary(Instruction *instr);
+    void emit_float_binary(Instruction *instr);
+    // flags for compare, returns the condition code
+    std::string emit_compare(Instruction *compare);
+    void emit_set(Instruction *compare);
+    void emit_load(LoadInst *load);
+    void emit_store(StoreInst *store);
+    // a gep or a bitcast, the address with no indices
+    void emit_gep(Instruction *gep);
+    void emit_call(CallInst *call);
+    void emit_br(BranchInst *br, BasicBlock *next);
+    void emit_ret(ReturnInst *ret);
+    void emit_jump(const std::string &cond, const std::string &label);
+
+    // phi elimination
+    struct Move {
+        Value *dst;
+        // nullptr: the value held in the temporary of the class
+        Value *src;
+    };
+    std::vector<Move> get_phi_moves(BasicBlock *from, BasicBlock *to);
+    void emit_moves(std::vector<Move> moves);
+    void emit_move(const Move &move);
+
+    // operands
+    bool is_float(Value *val) const {
+        return val->get_type()->is_float_type();
+    }
+    bool is_wide(Value *val) const {
+        return val->get_type()->is_pointer_type();
+    }
+    Location get_location(Value *val) const {
+        return alloc_->get_location(val);
+    }
+    std::string slot(unsigned index) const;
+    // a register, stack slot or immediate holding an integer value
+    std::string int_operand(Value *val) const;
+    // a register or stack slot holding a float value, constants are loaded
+    // into scratch
+    std::string float_operand(Value *val, const char *scratch);
+    // the address in memory val points to, through scratch if needed
+    std::string address(Value *ptr, Gpr scratch);
+    void load_int(Value *val, Gpr reg);
+    void load_float(Value *val, const char *reg);
+    // the register to compute the result of instr in: its own unless
+    // avoid is there too
+    Gpr int_target(Instruction *instr, Value *avoid = nullptr);
+    std::string float_target(Instruction *instr, Value *avoid = nullptr);
+    void write_int(Value *dst, Gpr reg);
+    void write_float(Value *dst, const std::string &reg);
+    // the name of the register holding val, empty if in memory
+    std::string reg_name(Value *val) const;
+
+    std::string get_label(BasicBlock *bb);
+    std::string new_label();
+
+    Module *m_;
+    std::ostream *os_{nullptr};
+
+    // state of the function being emitted
+    Function *func_{nullptr};
+    std::unique_ptr<LiveIntervals> intervals_;
+    std::unique_ptr<LinearScan> alloc_;
+    std::unordered_map<Value *, int> alloca_offsets_;
+    // slot i is at -(slots_base_ + 8 * (i + 1))(%rbp)
+    int slots_base_{0};
+    int frame_size_{0};
+    // callee saved registers the function uses, with their save offsets
+    std::vector<std::pair<Gpr, int>> saved_;
+    std::unordered_map<BasicBlock *, std::string> labels_;
+    unsigned next_label_{0};
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/* Live intervals of the values of a function, for linear scan allocation.
+ * The instructions are numbered from 1 in block order, instruction i reads
+ * its operands at position 2i and writes its result at 2i + 1, so a result
+ * may take the register of an operand that dies there. Arguments are
+ * written at position 1. A phi is written on the edges, that is at the end
+ * of each predecessor. An interval is the hull of all positions the value
+ * is live at, holes are not kept. */
+class LiveIntervals {
+  public:
+    struct Interval {
+        unsigned start, end;
+        // live across a call, only a callee saved register keeps it
+        bool crosses_call;
+    };
+
+    explicit LiveIntervals(Function *func);
+
+    // a compare whose only use is the conditional branch right after it is
+    // evaluated by the branch and gets no interval
+    bool is_folded(Instruction *instr) const { return folded_.count(instr); }
+
+    // arguments and instruction results, except allocas and folded
+    // compares, by start
+    const std::vector<std::pair<Value *, Interval>> &get_intervals() const {
+        return intervals_;
+    }
+    bool has_interval(Value *val) const { return ids_.count(val); }
+
+  private:
+    unsigned get_id(Value *val) const {
+        auto it = ids_.find(val);
+        return it == ids_.end() ? ~0u : it->second;
+    }
+
+    std::unordered_set<Instruction *> folded_;
+    std::unordered_map<Value *, unsigned> ids_;
+    std::vector<std::pair<Value *, Interval>> intervals_;
+};
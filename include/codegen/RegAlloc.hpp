@@ -0,0 +1,43 @@
+#pragma once
+
+#include "LiveIntervals.hpp"
+
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+/* Linear scan register allocation (Poletto and Sarkar) over LiveIntervals.
+ * The values of a class compete for the registers of that class, an
+ * interval across a call only gets a callee saved one. When none is free the
+ * interval that ends last, the new one or an active one, goes to a stack
+ * slot of its own. */
+class LinearScan {
+  public:
+    struct Location {
+        enum Kind { none, reg, slot } kind{none};
+        // register of the class of the value, or stack slot
+        unsigned index{0};
+        bool operator==(const Location &other) const {
+            return kind == other.kind and index == other.index;
+        }
+    };
+    // callee_saved[i]: register i of the class survives calls
+    using RegClass = std::vector<bool>;
+
+    LinearScan(const LiveIntervals &intervals,
+               const std::vector<RegClass> &classes,
+               const std::function<unsigned(Value *)> &get_class);
+
+    Location get_location(Value *val) const {
+        auto it = locations_.find(val);
+        return it == locations_.end() ? Location() : it->second;
+    }
+    unsigned get_num_slots() const { return num_slots_; }
+    // whether register i of class c is assigned to some value
+    bool is_used(unsigned c, unsigned i) const { return used_[c][i]; }
+
+  private:
+    std::unordered_map<Value *, Location> locations_;
+    std::vector<std::vector<bool>> used_;
+    unsigned num_slots_{0};
+};
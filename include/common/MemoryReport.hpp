@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// the peak resident set size of the process so far, in KB
+long peak_rss_kb();
+
+/* -stats: the objects and bytes every phase of a compilation allocated in
+ * the arenas of the syntax tree, the AST and the module, with the peak rss
+ * of the process after the phase. The peak only grows, so the first phase
+ * where it jumps is the one to look at when a compilation runs out of
+ * memory. */
+class MemoryReport {
+  public:
+    void add_phase(const std::string &name, std::size_t objects,
+                   std::size_t bytes);
+    void print(std::ostream &os) const;
+
+  private:
+    struct Phase {
+        std::string name;
+        std::size_t objects, bytes;
+        long peak_rss_kb;
+    };
+    std::vector<Phase> phases_;
+};
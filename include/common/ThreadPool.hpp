@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads for data parallel loops. parallel_for deals
+ * the indices out to one deque per thread (the caller takes part as thread
+ * 0); a thread works through its own deque from the front and, once it is
+ * empty, steals from the back of the others, so a few expensive indices do
+ * not leave the remaining threads idle. */
+class ThreadPool {
+  public:
+    // @num_threads: threads taking part in a loop, the calling one included;
+    // with 1 every loop simply runs on the caller
+    explicit ThreadPool(unsigned num_threads);
+    ThreadPool(const ThreadPool &) = delete;
+    ~ThreadPool();
+
+    unsigned get_num_threads() const { return queues_.size(); }
+
+    // call fn(i) for each i in [0, n) and return once all calls finished;
+    // not reentrant, fn must not start another loop on this pool
+    void parallel_for(std::size_t n,
+                      const std::function<void(std::size_t)> &fn);
+
+  private:
+    struct Queue {
+        std::mutex mutex;
+        std::deque<std::size_t> indices;
+    };
+
+    void worker(unsigned id);
+    // run indices until every queue is empty
+    void drain(unsigned id);
+    bool pop(unsigned id, std::size_t &index);
+
+    std::vector<std::unique_ptr<Queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable start_cv_, done_cv_;
+    const std::function<void(std::size_t)> *fn_{nullptr};
+    unsigned generation_{0}; // bumped for every loop
+    unsigned busy_{0};       // workers still in the current loop
+    bool stop_{false};
+};
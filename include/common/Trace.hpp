@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+/* Scoped events for -trace=<file>, written as Chrome trace JSON that
+ * chrome://tracing and Perfetto open. Every thread records into a buffer of
+ * its own, so recording takes no lock; the buffers are only read by write(),
+ * once no thread records any more. While tracing is off a Scope costs
+ * little more than one relaxed load. */
+namespace trace {
+
+namespace detail {
+extern std::atomic<bool> enabled;
+void record(std::string name, std::string detail,
+            std::chrono::steady_clock::time_point begin);
+} // namespace detail
+
+inline bool is_enabled() {
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+// start recording, the calling thread is shown as the main one
+void start();
+// the events recorded since start() as Chrome trace JSON, recording stops
+void write(std::ostream &os);
+
+// an event from the construction to the destruction, with the function it
+// works on as detail if there is one. Both are copied, and only while
+// tracing is on
+class Scope {
+  public:
+    explicit Scope(std::string_view name, std::string_view detail = {})
+        : enabled_(is_enabled()) {
+        if (enabled_) {
+            name_ = name;
+            detail_ = detail;
+            begin_ = std::chrono::steady_clock::now();
+        }
+    }
+    Scope(const Scope &) = delete;
+    ~Scope() {
+        if (enabled_)
+            detail::record(std::move(name_), std::move(detail_), begin_);
+    }
+
+  private:
+    bool enabled_;
+    std::string name_, detail_;
+    std::chrono::steady_clock::time_point begin_;
+};
+
+} // namespace trace
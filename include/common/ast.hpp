@@ -6,10 +6,18 @@ extern "C" {
 extern syntax_tree *parse(const char *input);
 }
 #include "User.hpp"
+#include <deque>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
+// parses a copy, see parse_in_place() to scan a writable buffer directly
+inline syntax_tree *parse_buffer(parse_context *ctx, std::string_view text) {
+    return parse_buffer(ctx, text.data(), text.size());
+}
+
 enum CminusType { TYPE_INT, TYPE_FLOAT, TYPE_VOID };
 
 enum RelOp {
@@ -41,6 +49,26 @@ enum MulOp {
     OP_DIV
 };
 
+// identifiers are interned while the AST is built, equal names share a
+// Symbol, numbered from 0 in order of appearance
+using Symbol = unsigned;
+
+class SymbolTable {
+  public:
+    static constexpr Symbol none = ~0u;
+
+    Symbol intern(std::string_view name);
+    // none if the name does not occur in the program
+    Symbol lookup(std::string_view name) const;
+    const std::string &get_name(Symbol sym) const { return names_[sym]; }
+    std::size_t size() const { return names_.size(); }
+
+  private:
+    // a deque keeps the strings the keys point into in place
+    std::deque<std::string> names_;
+    std::unordered_map<std::string_view, Symbol> symbols_;
+};
+
 class AST;
 
 struct ASTNode;
@@ -68,20 +96,32 @@ struct ASTCall;
 
 class ASTVisitor;
 
+/* The nodes are placed in blocks owned by the tree and destroyed with it,
+ * the pointers between them do not own anything. */
 class AST {
   public:
     AST() = delete;
     AST(syntax_tree *);
-    AST(AST &&tree) {
-        root = tree.root;
-        tree.root = nullptr;
-    };
-    ASTProgram *get_root() { return root.get(); }
+    AST(AST &&tree) = default;
+    AST(const AST &) = delete;
+    ~AST();
+    ASTProgram *get_root() { return root; }
     void run_visitor(ASTVisitor &visitor);
+    // the nodes and the bytes of their blocks, for -stats
+    std::size_t get_num_nodes() const { return nodes_.size(); }
+    std::size_t get_block_bytes() const { return block_bytes_; }
 
   private:
     ASTNode *transform_node_iter(syntax_tree_node *);
-    std::shared_ptr<ASTProgram> root = nullptr;
+    template <typename NodeType> NodeType *create();
+    void *allocate(std::size_t size);
+
+    ASTProgram *root = nullptr;
+    std::vector<std::unique_ptr<char[]>> blocks_;
+    std::size_t block_used_{0};
+    std::size_t block_bytes_{0};
+    // destructed in ~AST()
+    std::vector<ASTNode *> nodes_;
 };
 
 struct ASTNode {
@@ -92,13 +132,16 @@ struct ASTNode {
 struct ASTProgram : ASTNode {
     virtual Value* accept(ASTVisitor &) override final;
     virtual ~ASTProgram() = default;
-    std::vector<std::shared_ptr<ASTDeclaration>> declarations;
+    std::vector<ASTDeclaration *> declarations;
+    // of all identifiers in the program
+    SymbolTable symbols;
 };
 
 struct ASTDeclaration : ASTNode {
     virtual ~ASTDeclaration() = default;
     CminusType type;
     std::string id;
+    Symbol sym;
 };
 
 struct ASTFactor : ASTNode {
@@ -116,19 +159,20 @@ struct ASTNum : ASTFactor {
 
 struct ASTVarDeclaration : ASTDeclaration {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTNum> num;
+    ASTNum *num = nullptr;
 };
 
 struct ASTFunDeclaration : ASTDeclaration {
     virtual Value* accept(ASTVisitor &) override final;
-    std::vector<std::shared_ptr<ASTParam>> params;
-    std::shared_ptr<ASTCompoundStmt> compound_stmt;
+    std::vector<ASTParam *> params;
+    ASTCompoundStmt *compound_stmt = nullptr;
 };
 
 struct ASTParam : ASTNode {
     virtual Value* accept(ASTVisitor &) override final;
     CminusType type;
     std::string id;
+    Symbol sym;
     // true if it is array param
     bool isarray;
 };
@@ -139,75 +183,77 @@ struct ASTStatement : ASTNode {
 
 struct ASTCompoundStmt : ASTStatement {
     virtual Value* accept(ASTVisitor &) override final;
-    std::vector<std::shared_ptr<ASTVarDeclaration>> local_declarations;
-    std::vector<std::shared_ptr<ASTStatement>> statement_list;
+    std::vector<ASTVarDeclaration *> local_declarations;
+    std::vector<ASTStatement *> statement_list;
 };
 
 struct ASTExpressionStmt : ASTStatement {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTExpression> expression;
+    ASTExpression *expression = nullptr;
 };
 
 struct ASTSelectionStmt : ASTStatement {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTExpression> expression;
-    std::shared_ptr<ASTStatement> if_statement;
+    ASTExpression *expression = nullptr;
+    ASTStatement *if_statement = nullptr;
     // should be nullptr if no else structure exists
-    std::shared_ptr<ASTStatement> else_statement;
+    ASTStatement *else_statement = nullptr;
 };
 
 struct ASTIterationStmt : ASTStatement {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTExpression> expression;
-    std::shared_ptr<ASTStatement> statement;
+    ASTExpression *expression = nullptr;
+    ASTStatement *statement = nullptr;
 };
 
 struct ASTReturnStmt : ASTStatement {
     virtual Value* accept(ASTVisitor &) override final;
     // should be nullptr if return void
-    std::shared_ptr<ASTExpression> expression;
+    ASTExpression *expression = nullptr;
 };
 
 struct ASTExpression : ASTFactor {};
 
 struct ASTAssignExpression : ASTExpression {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTVar> var;
-    std::shared_ptr<ASTExpression> expression;
+    ASTVar *var = nullptr;
+    ASTExpression *expression = nullptr;
 };
 
 struct ASTSimpleExpression : ASTExpression {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTAdditiveExpression> additive_expression_l;
-    std::shared_ptr<ASTAdditiveExpression> additive_expression_r;
+    ASTAdditiveExpression *additive_expression_l = nullptr;
+    ASTAdditiveExpression *additive_expression_r = nullptr;
     RelOp op;
 };
 
 struct ASTVar : ASTFactor {
     virtual Value* accept(ASTVisitor &) override final;
     std::string id;
+    Symbol sym;
     // nullptr if var is of int type
-    std::shared_ptr<ASTExpression> expression;
+    ASTExpression *expression = nullptr;
 };
 
 struct ASTAdditiveExpression : ASTNode {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTAdditiveExpression> additive_expression;
+    ASTAdditiveExpression *additive_expression = nullptr;
     AddOp op;
-    std::shared_ptr<ASTTerm> term;
+    ASTTerm *term = nullptr;
 };
 
 struct ASTTerm : ASTNode {
     virtual Value* accept(ASTVisitor &) override final;
-    std::shared_ptr<ASTTerm> term;
+    ASTTerm *term = nullptr;
     MulOp op;
-    std::shared_ptr<ASTFactor> factor;
+    ASTFactor *factor = nullptr;
 };
 
 struct ASTCall : ASTFactor {
     virtual Value* accept(ASTVisitor &) override final;
     std::string id;
-    std::vector<std::shared_ptr<ASTExpression>> args;
+    Symbol sym;
+    std::vector<ASTExpression *> args;
 };
 
 class ASTVisitor {
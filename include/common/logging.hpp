@@ -7,37 +7,35 @@
 
 enum LogLevel { DEBUG = 0, INFO, WARNING, ERROR };
 struct LocationInfo {
-    LocationInfo(std::string file, int line, const char *func)
+    LocationInfo(const char *file, int line, const char *func)
         : file_(file), line_(line), func_(func) {}
     ~LocationInfo() = default;
 
-    std::string file_;
+    const char *file_;
     int line_;
     const char *func_;
 };
 class LogStream;
 class LogWriter;
 
+// messages below this level are dropped, LOGV in the environment, read once
+int read_env_log_level();
+inline int env_log_level() {
+    static const int level = read_env_log_level();
+    return level;
+}
+inline bool log_enabled(LogLevel level) { return level >= env_log_level(); }
+
 class LogWriter {
   public:
     LogWriter(LocationInfo location, LogLevel loglevel)
-        : location_(location), log_level_(loglevel) {
-        char *logv = std::getenv("LOGV");
-        if (logv) {
-            std::string string_logv = logv;
-            env_log_level = std::stoi(logv);
-        } else {
-            env_log_level = 4;
-        }
-    };
+        : location_(location), log_level_(loglevel){};
 
     void operator<(const LogStream &stream);
 
   private:
-    void output_log(const std::ostringstream &g);
     LocationInfo location_;
     LogLevel log_level_;
-    int env_log_level;
 };
 
 class LogStream {
@@ -50,18 +48,32 @@ class LogStream {
     friend class LogWriter;
 
   private:
-    std::stringstream sstream_{};
+    std::ostringstream sstream_{};
 };
 
 std::string level2string(LogLevel level);
 std::string get_short_name(const char *file_path);
 
-#define __FILESHORTNAME__ get_short_name(__FILE__)
+// the message, including its operands, is only evaluated when the level is
+// enabled; written as if/else so it stays a single statement
 #define LOG_IF(level)                                                          \
-    LogWriter(LocationInfo(__FILESHORTNAME__, __LINE__, __FUNCTION__),         \
-              level) < LogStream()
+    if (not log_enabled(level))                                                \
+        ;                                                                      \
+    else                                                                       \
+        LogWriter(LocationInfo(__FILE__, __LINE__, __FUNCTION__), level) <     \
+            LogStream()
 #define LOG(level) LOG_##level
+#ifdef LOG_STRIP_DEBUG
+// still type checked, but compiled out
+#define LOG_DEBUG                                                              \
+    if (true)                                                                  \
+        ;                                                                      \
+    else                                                                       \
+        LogWriter(LocationInfo(__FILE__, __LINE__, __FUNCTION__), DEBUG) <     \
+            LogStream()
+#else
 #define LOG_DEBUG LOG_IF(DEBUG)
+#endif
 #define LOG_INFO LOG_IF(INFO)
 #define LOG_WARNING LOG_IF(WARNING)
 #define LOG_ERROR LOG_IF(ERROR)
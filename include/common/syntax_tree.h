@@ -1,26 +1,29 @@
 #ifndef __SYNTAXTREE_H__
 #define __SYNTAXTREE_H__
 
+#include <stddef.h>
 #include <stdio.h>
 
-#define SYNTAX_TREE_NODE_NAME_MAX 30
-
+/* Nodes of the parser live in the arena of their tree, with exactly as many
+ * children as they have. `kind` is the token number (syntax_analyzer.h) of
+ * a leaf or the grammar symbol of an inner node, `name` the token text or
+ * the symbol name. */
 struct _syntax_tree_node {
-    struct _syntax_tree_node *parent;
-    struct _syntax_tree_node *children[10];
+    struct _syntax_tree_node **children;
     int children_num;
-
-    char name[SYNTAX_TREE_NODE_NAME_MAX];
+    int kind;
+    const char *name;
 };
 typedef struct _syntax_tree_node syntax_tree_node;
 
-syntax_tree_node *new_anon_syntax_tree_node();
-syntax_tree_node *new_syntax_tree_node(const char *name);
-int syntax_tree_add_child(syntax_tree_node *parent, syntax_tree_node *child);
-void del_syntax_tree_node(syntax_tree_node *node, int recursive);
+struct _syntax_tree_block;
 
 struct _syntax_tree {
     syntax_tree_node *root;
+    // the arena, NULL for trees built from new_syntax_tree_node()
+    struct _syntax_tree_block *blocks;
+    // in the arena
+    size_t num_nodes;
 };
 typedef struct _syntax_tree syntax_tree;
 
@@ -28,4 +31,43 @@ syntax_tree *new_syntax_tree();
 void del_syntax_tree(syntax_tree *tree);
 void print_syntax_tree(FILE *fout, syntax_tree *tree);
 
+// arena nodes, `name` must outlive the tree: a string literal or a copy
+// from syntax_tree_copy_text()
+syntax_tree_node *syntax_tree_new_node(syntax_tree *tree, int kind,
+                                       const char *name, int children_num);
+const char *syntax_tree_copy_text(syntax_tree *tree, const char *text,
+                                  size_t size);
+// the bytes the arena took from malloc() and the nodes in it, for -stats
+void syntax_tree_memory(const syntax_tree *tree, size_t *bytes,
+                        size_t *nodes);
+
+// single malloc()ed nodes with up to 10 children, freed one by one
+syntax_tree_node *new_anon_syntax_tree_node();
+syntax_tree_node *new_syntax_tree_node(const char *name);
+int syntax_tree_add_child(syntax_tree_node *parent, syntax_tree_node *child);
+void del_syntax_tree_node(syntax_tree_node *node, int recursive);
+
+/* The state of one run of the parser (syntax_analyzer.y), the lexer and the
+ * parser keep nothing in globals, so every thread may parse with a context
+ * of its own. */
+struct _parse_context {
+    // the current token
+    int lines;
+    int pos_start;
+    int pos_end;
+    syntax_tree *tree;
+    // the last error reported, empty if there was none
+    char error_message[256];
+    // parse_file() could not open the file, error_message names it
+    int open_failed;
+};
+typedef struct _parse_context parse_context;
+
+// all return NULL after a syntax error, see ctx->error_message
+syntax_tree *parse_file(parse_context *ctx, const char *path);
+syntax_tree *parse_stream(parse_context *ctx, FILE *input);
+syntax_tree *parse_buffer(parse_context *ctx, const char *text, size_t size);
+// text[size] and text[size + 1] must be NUL, no copy is made
+syntax_tree *parse_in_place(parse_context *ctx, char *text, size_t size);
+
 #endif /* SyntaxTree.h */
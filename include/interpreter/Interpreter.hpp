@@ -0,0 +1,123 @@
+#pragma once
+
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+#include "Module.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/* -run: execute a module in process instead of through llc and a link with
+ * io.c. Every function is decoded once into register bytecode: each value
+ * is a register of the frame, constants and global addresses are registers
+ * filled at the call, and an edge into a block with phis runs the copies
+ * through a stub of its own. Memory is real, an alloca points into a stack
+ * of the interpreter and a global into the data of it, so a load or store
+ * is a plain access. input, output, outputFloat and neg_idx_except behave
+ * like io.c; a module without main or calling other external functions is
+ * turned down with a message. */
+class Interpreter {
+  public:
+    explicit Interpreter(Module *m);
+    Interpreter(const Interpreter &) = delete;
+
+    // calls main, returns its result for the exit status, or 1 if the
+    // module cannot run
+    int run();
+
+  private:
+    union Reg {
+        int32_t i;
+        float f;
+        char *p;
+    };
+    enum class Opcode : uint8_t {
+        mov,
+        add,
+        sub,
+        mul,
+        sdiv,
+        fadd,
+        fsub,
+        fmul,
+        fdiv,
+        ge,
+        gt,
+        le,
+        lt,
+        eq,
+        ne,
+        fge,
+        fgt,
+        fle,
+        flt,
+        feq,
+        fne,
+        fptosi,
+        sitofp,
+        // alloca: dst = stack frame + imm
+        frame_addr,
+        load8,
+        load32,
+        load64,
+        store8,
+        store32,
+        store64,
+        // dst = a + imm
+        ptr_add,
+        // dst = a + b * imm
+        ptr_add_scaled,
+        // a: function, b: start in args_, c: number of arguments
+        call,
+        input,
+        output,
+        output_float,
+        neg_idx_except,
+        jmp,
+        // a: condition, b: pc if true, c: pc if false
+        br,
+        ret,
+        ret_void,
+    };
+    struct Op {
+        Opcode code;
+        uint32_t dst, a, b, c;
+        int64_t imm;
+    };
+    struct Code {
+        std::vector<Op> ops;
+        // arguments of the calls
+        std::vector<uint32_t> args;
+        // the first registers of a frame, arguments come next
+        std::vector<Reg> constants;
+        uint32_t num_regs{0};
+        // bytes of the allocas
+        uint32_t frame_size{0};
+    };
+
+    void init_global(char *data, Constant *init, Type *type);
+    // decoded on the first call
+    const Code &get_code(Function *func);
+    void decode(Function *func, Code &code);
+    // the arguments are in place at the top of regs_ already; the calls it
+    // makes run in the same loop
+    Reg execute(const Code &entry);
+
+    std::vector<Function *> functions_;
+    std::unordered_map<Function *, uint32_t> function_ids_;
+    std::vector<std::unique_ptr<Code>> codes_;
+    std::unordered_map<Value *, char *> globals_;
+    std::unique_ptr<char[]> data_;
+
+    // allocas of all active calls, registers of all active frames
+    std::unique_ptr<char[]> stack_;
+    char *stack_top_{nullptr};
+    char *stack_end_{nullptr};
+    std::unique_ptr<Reg[]> regs_;
+    std::size_t regs_top_{0};
+    // neg_idx_except ends the program
+    bool stopped_{false};
+};
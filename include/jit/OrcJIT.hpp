@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Module.hpp"
+
+/* -jit: translate a module into an llvm::Module through the C++ API,
+ * optimize it with the O2 pipeline of LLVM and call main through ORC
+ * LLJIT, in process. The external functions are bound to the io.c
+ * routines linked into cminusfc. */
+class OrcJIT {
+  public:
+    explicit OrcJIT(Module *m) : m_(m) {}
+
+    // returns the result of main for the exit status
+    int run();
+
+  private:
+    Module *m_;
+};
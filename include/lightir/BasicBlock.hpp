@@ -3,7 +3,9 @@
 #include "Instruction.hpp"
 #include "Value.hpp"
 
-#include <list>
+#include <algorithm>
+#include <cassert>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/ilist.h>
 #include <llvm/ADT/ilist_node.h>
 #include <set>
@@ -19,17 +21,34 @@ class BasicBlock : public Value, public llvm::ilist_node<BasicBlock> {
     static BasicBlock *create(Module *m, const std::string &name,
                               Function *parent) {
         auto prefix = name.empty() ? "" : "label_";
-        return new BasicBlock(m, prefix + name, parent);
+        return new (m) BasicBlock(m, prefix + name, parent);
+    }
+    static bool classof(const Value *v) {
+        return v->get_value_id() == BasicBlockVal;
     }
 
     /****************api about cfg****************/
-    std::list<BasicBlock *> &get_pre_basic_blocks() { return pre_bbs_; }
-    std::list<BasicBlock *> &get_succ_basic_blocks() { return succ_bbs_; }
+    // BranchInst keeps these up to date; one entry per edge, so a block
+    // branching to the same target twice appears twice
+    using BlockList = llvm::SmallVector<BasicBlock *, 2>;
+
+    BlockList &get_pre_basic_blocks() { return pre_bbs_; }
+    BlockList &get_succ_basic_blocks() { return succ_bbs_; }
 
     void add_pre_basic_block(BasicBlock *bb) { pre_bbs_.push_back(bb); }
     void add_succ_basic_block(BasicBlock *bb) { succ_bbs_.push_back(bb); }
-    void remove_pre_basic_block(BasicBlock *bb) { pre_bbs_.remove(bb); }
-    void remove_succ_basic_block(BasicBlock *bb) { succ_bbs_.remove(bb); }
+    // drops every edge from/to bb
+    void remove_pre_basic_block(BasicBlock *bb) {
+        pre_bbs_.erase(std::remove(pre_bbs_.begin(), pre_bbs_.end(), bb),
+                       pre_bbs_.end());
+    }
+    void remove_succ_basic_block(BasicBlock *bb) {
+        succ_bbs_.erase(std::remove(succ_bbs_.begin(), succ_bbs_.end(), bb),
+                        succ_bbs_.end());
+    }
+    // the terminator of from was moved to the end of this block: its edges
+    // leave this block now, phis of the successors included
+    void take_succ_basic_blocks(BasicBlock *from);
 
     // If the Block is terminated by ret/br
     bool is_terminated() const;
@@ -47,16 +66,24 @@ class BasicBlock : public Value, public llvm::ilist_node<BasicBlock> {
         instr_list_.insert(pos, instr);
     }
 
+    // instructions append themselves to their block on creation, which a
+    // terminated block refuses; create(this) builds one in front of pos
+    template <typename Create>
+    auto create_before(Instruction *pos, Create create) {
+        auto terminator = is_terminated() ? get_terminator() : nullptr;
+        if (terminator)
+            instr_list_.remove(terminator);
+        auto instr = create(this);
+        instr_list_.remove(instr);
+        if (terminator)
+            instr_list_.push_back(terminator);
+        instr_list_.insert(pos->getIterator(), instr);
+        return instr;
+    }
+
     void insert_before(Instruction *pos, Instruction *instr) {
-        auto it = instr_list_.begin();
-        for (; it != instr_list_.end(); ++it) {
-            if (&*it == pos) {
-                break;
-            }
-        }
-        if (it != instr_list_.end()) {
-            instr_list_.insert(it, instr);
-        }
+        assert(pos->get_parent() == this && "Inserting before another bb");
+        instr_list_.insert(pos->getIterator(), instr);
     }
     void reset(){
         pre_bbs_.clear();
@@ -67,19 +94,34 @@ class BasicBlock : public Value, public llvm::ilist_node<BasicBlock> {
     bool empty() const { return instr_list_.empty(); }
     int get_num_of_instr() const { return instr_list_.size(); }
 
+    /****************api about numbering****************/
+    // dense index in the parent function, only valid after the last
+    // Function::renumber_basic_blocks()
+    unsigned get_index() const { return index_; }
+
+    /****************api about profile****************/
+    // how often the block ran in the runs of a -fprofile-use profile, see
+    // Profile.hpp; -1 when not known
+    long get_count() const { return count_; }
+    void set_count(long count) { count_ = count; }
+
     /****************api about accessing parent****************/
     Function *get_parent() { return parent_; }
     Module *get_module();
     void erase_from_parent();
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 
   private:
+    friend class Function;
+
     BasicBlock(const BasicBlock &) = delete;
     explicit BasicBlock(Module *m, const std::string &name, Function *parent);
 
-    std::list<BasicBlock *> pre_bbs_;
-    std::list<BasicBlock *> succ_bbs_;
+    BlockList pre_bbs_;
+    BlockList succ_bbs_;
     llvm::ilist<Instruction> instr_list_;
     Function *parent_;
+    unsigned index_{0};
+    long count_{-1};
 };
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Function.hpp"
+#include "Module.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <unordered_map>
+#include <vector>
+
+/* Binary LightIR (.lir), the storage format of the compile cache and of
+ * -emit-lir. The file is a sequence of 32 bit words in host byte order:
+ *
+ *     header   magic, version, size in words, a checksum of the other
+ *              words, then count and word offset of each table
+ *     types    a type refers to the ones before it
+ *     consts   likewise, an array to its elements
+ *     globals  name, type, init
+ *     funcs    name, type, word offset of the body (0: declaration) and
+ *              the argument names
+ *     bodies   the block names, then per block its predecessors and
+ *              successors in list order and its instructions as opcode,
+ *              type, name and operands
+ *
+ * A string is its length and the bytes padded to a word. An operand is a
+ * kind in the top 3 bits and an index: a constant, global or function of
+ * the module, an argument, block or instruction (in block order) of the
+ * function. All names are stored, empty ones too, so a module prints the
+ * same after the round trip. The tables are read up front, the bodies only
+ * by materialize(), from an mmap of the file if the caller gives one.
+ *
+ * The data may come from a stale cache or another machine, so every read is
+ * bounds checked and every index and type checked as the constructors would
+ * before anything is built: broken data fails the read instead of tripping
+ * an assert, and data that changed since it was written fails the checksum. */
+void write_binary_ir(Module *m, std::ostream &os);
+// only the body of only, with the globals and functions it refers to in the
+// tables; read back with BinaryIRReader::read_into()
+void write_binary_ir(Module *m, std::ostream &os, Function *only);
+
+class BinaryIRReader {
+  public:
+    // the data is not copied and must outlive the reader
+    BinaryIRReader(const char *data, std::size_t size);
+
+    // the module with every function a declaration until materialized,
+    // nullptr if the data is no binary ir of this version or its tables are
+    // broken. The reader only materializes while the module lives
+    std::unique_ptr<Module> read_module();
+    // instead of a module of its own, bind the globals and functions of the
+    // data to those of m with the same name and type; false if one is
+    // missing or the tables are broken. The bodies materialize into the
+    // functions of m, which must be declarations by then
+    bool read_into(Module *m);
+
+    bool is_materialized(Function *func) const;
+    // false if the body is broken, func then stays a declaration
+    bool materialize(Function *func);
+    // false if a body is broken
+    bool materialize_all();
+
+  private:
+    bool read_tables(Module *m, bool bind);
+
+    const char *data_;
+    std::size_t num_words_;
+    Module *m_{nullptr};
+    std::vector<Type *> types_;
+    std::vector<Constant *> constants_;
+    std::vector<GlobalVariable *> globals_;
+    std::vector<Function *> functions_;
+    // word offset of the body of each function, 0 when there is none left
+    // to read
+    std::unordered_map<Function *, uint32_t> bodies_;
+};
@@ -8,20 +8,30 @@ class Constant : public User {
   private:
     // int value;
   public:
-    Constant(Type *ty, const std::string &name = "") : User(ty, name) {}
+    Constant(Type *ty, unsigned value_id, const std::string &name = "")
+        : User(ty, value_id, name) {}
     ~Constant() = default;
+
+    static bool classof(const Value *v) {
+        return v->get_value_id() >= ConstantIntVal and
+               v->get_value_id() <= ConstantArrayVal;
+    }
 };
 
 class ConstantInt : public Constant {
   private:
     int value_;
-    ConstantInt(Type *ty, int val) : Constant(ty, ""), value_(val) {}
+    ConstantInt(Type *ty, int val)
+        : Constant(ty, ConstantIntVal, ""), value_(val) {}
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantIntVal;
+    }
     int get_value() { return value_; }
     static ConstantInt *get(int val, Module *m);
     static ConstantInt *get(bool val, Module *m);
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 };
 
 class ConstantArray : public Constant {
@@ -33,6 +43,10 @@ class ConstantArray : public Constant {
   public:
     ~ConstantArray() = default;
 
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantArrayVal;
+    }
+
     Constant *get_element_value(int index);
 
     unsigned get_size_of_array() { return const_array.size(); }
@@ -40,25 +54,35 @@ class ConstantArray : public Constant {
     static ConstantArray *get(ArrayType *ty,
                               const std::vector<Constant *> &val);
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 };
 
 class ConstantZero : public Constant {
   private:
-    ConstantZero(Type *ty) : Constant(ty, "") {}
+    ConstantZero(Type *ty) : Constant(ty, ConstantZeroVal, "") {}
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantZeroVal;
+    }
     static ConstantZero *get(Type *ty, Module *m);
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 };
 
 class ConstantFP : public Constant {
   private:
     float val_;
-    ConstantFP(Type *ty, float val) : Constant(ty, ""), val_(val) {}
+    // what print() writes, "0x" and the bits of the value as a double in
+    // hex, made once: float constants are printed again and again
+    char text_[19];
+    unsigned char text_len_;
+    ConstantFP(Type *ty, float val);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ConstantFPVal;
+    }
     static ConstantFP *get(float val, Module *m);
     float get_value() { return val_; }
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 };
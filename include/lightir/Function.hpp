@@ -15,6 +15,7 @@
 
 class Module;
 class Argument;
+class SlotTracker;
 class Type;
 class FunctionType;
 
@@ -25,6 +26,9 @@ class Function : public Value, public llvm::ilist_node<Function> {
     ~Function() = default;
     static Function *create(FunctionType *ty, const std::string &name,
                             Module *parent);
+    static bool classof(const Value *v) {
+        return v->get_value_id() == FunctionVal;
+    }
 
     FunctionType *get_function_type() const;
     Type *get_return_type() const;
@@ -33,57 +37,42 @@ class Function : public Value, public llvm::ilist_node<Function> {
 
     unsigned get_num_of_args() const;
     unsigned get_num_basic_blocks() const;
+    // number the blocks 0..n-1 in list order so analyses can keep their
+    // per block data in vectors, returns n
+    unsigned renumber_basic_blocks();
 
     Module *get_parent() const;
 
     void remove(BasicBlock *bb);
+    // move all blocks of from to the end of this function, e.g. into a
+    // function with a changed signature; the arguments are not touched
+    void take_basic_blocks(Function *from);
+    // erase the blocks not reachable from the entry and their phi incomings
+    // in reachable blocks, returns the number of erased blocks
+    unsigned remove_unreachable_basic_blocks();
+    // erase all blocks, the function becomes a declaration
+    void drop_body();
     BasicBlock *get_entry_block() { return &*basic_blocks_.begin(); }
 
     llvm::ilist<BasicBlock> &get_basic_blocks() { return basic_blocks_; }
     std::list<Argument> &get_args() { return arguments_; }
 
     bool is_declaration() { return basic_blocks_.empty(); }
+    // of a declaration standing in for a body compiled elsewhere, see
+    // Distribute.hpp: the FuncInfo::MemEffect of that body, -1 if unknown
+    int get_effect_summary() const { return effect_summary_; }
+    void set_effect_summary(int effect) { effect_summary_ = effect; }
 
-    void set_instr_name();
-    std::string print();
-
-    void reset_bbs(){
-    for(auto &bb: basic_blocks_){
-        bb.reset();
-    }
-    for(auto &bb : basic_blocks_){
-        auto inst = &((bb.get_instructions().back()));
-            if(inst->is_br()){
-                auto br = static_cast<BranchInst*>(inst);
-                if(br->is_cond_br()){
-                    auto true_bb = static_cast<BasicBlock*>(br->get_operand(1));
-                    auto false_bb = static_cast<BasicBlock*>(br->get_operand(2));
-                    assert(true_bb->get_parent() == this);
-                    assert(false_bb->get_parent() == this);
-                    bb.add_succ_basic_block(true_bb);
-                    bb.add_succ_basic_block(false_bb);
-                    true_bb->add_pre_basic_block(&bb);
-                    false_bb->add_pre_basic_block(&bb);
-                }
-                else{
-                    auto succ_bb = static_cast<BasicBlock*>(br->get_operand(0));
-                    assert(succ_bb->get_parent() == this);
-                    bb.add_succ_basic_block(succ_bb);
-                    succ_bb->add_pre_basic_block(&bb);
-                }
-            }
-            // else{
-            //     std::cout << print();
-            // }
-        
-    }
-}
+    // the numbering of the print in progress, nullptr outside of print()
+    const SlotTracker *get_slot_tracker() const { return slot_tracker_; }
+    void print(std::ostream &os) override;
 
   private:
     llvm::ilist<BasicBlock> basic_blocks_;
     std::list<Argument> arguments_;
     Module *parent_;
-    unsigned seq_cnt_; // print use
+    const SlotTracker *slot_tracker_{nullptr};
+    int effect_summary_{-1};
 };
 
 // Argument of Function, does not contain actual value
@@ -92,8 +81,11 @@ class Argument : public Value {
     Argument(const Argument &) = delete;
     explicit Argument(Type *ty, const std::string &name = "",
                       Function *f = nullptr, unsigned arg_no = 0)
-        : Value(ty, name), parent_(f), arg_no_(arg_no) {}
+        : Value(ty, ArgumentVal, name), parent_(f), arg_no_(arg_no) {}
     virtual ~Argument() {}
+    static bool classof(const Value *v) {
+        return v->get_value_id() == ArgumentVal;
+    }
 
     inline const Function *get_parent() const { return parent_; }
     inline Function *get_parent() { return parent_; }
@@ -104,7 +96,7 @@ class Argument : public Value {
         return arg_no_;
     }
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 
   private:
     Function *parent_;
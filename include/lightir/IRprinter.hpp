@@ -10,5 +10,28 @@
 #include "User.hpp"
 #include "Value.hpp"
 
+#include <string>
+#include <unordered_map>
+
+// the numbers unnamed local values print with, computed when printing
+// instead of being stored as names: args, then every block followed by its
+// non-void instructions, counting on after the largest argN/labelN/opN an
+// explicit name already uses
+class SlotTracker {
+  public:
+    explicit SlotTracker(Function *func);
+
+    // the explicit name of v, otherwise its argN/labelN/opN
+    std::string get_name(const Value *v) const;
+
+  private:
+    std::unordered_map<const Value *, unsigned> slots_;
+};
+
+// the name a local value prints with, numbered by the SlotTracker of the
+// function being printed or by a fresh one
+std::string get_print_name(const Value *v);
+
+void print_as_op(std::ostream &os, Value *v, bool print_ty);
 std::string print_as_op(Value *v, bool print_ty);
 std::string print_instr_op_name(Instruction::OpID);
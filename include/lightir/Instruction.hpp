@@ -4,7 +4,10 @@
 #include "User.hpp"
 
 #include <cstdint>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/SmallVector.h>
 #include <llvm/ADT/ilist_node.h>
+#include <tuple>
 
 class BasicBlock;
 class Function;
@@ -49,8 +52,8 @@ class Instruction : public User, public llvm::ilist_node<Instruction> {
         getelementptr,
         zext, // zero extend
         fptosi,
-        sitofp
-        // float binary operators Logical operators
+        sitofp,
+        bitcast // pointer to pointer, for vector accesses
 
     };
     /* @parent: if parent!=nullptr, auto insert to bb
@@ -100,6 +103,7 @@ class Instruction : public User, public llvm::ilist_node<Instruction> {
     bool is_call() const { return op_id_ == call; }
     bool is_gep() const { return op_id_ == getelementptr; }
     bool is_zext() const { return op_id_ == zext; }
+    bool is_bitcast() const { return op_id_ == bitcast; }
 
     bool isBinary() const {
         return (is_add() || is_sub() || is_mul() || is_div() || is_fadd() ||
@@ -111,16 +115,32 @@ class Instruction : public User, public llvm::ilist_node<Instruction> {
 
     virtual Instruction *clone(BasicBlock *) const = 0;
 
+    static bool classof(const Value *v) {
+        return v->get_value_id() >= InstructionVal;
+    }
+
     OpID op_id_;
 
+  protected:
+    // the module whose arena holds instructions created in bb
+    static Module *get_module_of(BasicBlock *bb);
+    // v is an instruction with opcode in [first, last]
+    static bool classof_range(const Value *v, OpID first, OpID last) {
+        return v->get_value_id() >= InstructionVal + first and
+               v->get_value_id() <= InstructionVal + last;
+    }
+
   private:
     BasicBlock *parent_;
 };
 
 template <typename Inst> class BaseInst : public Instruction {
   protected:
+    // the parent bb is always the last constructor argument
     template <typename... Args> static Inst *create(Args &&...args) {
-        return new Inst(std::forward<Args>(args)...);
+        BasicBlock *bb = std::get<sizeof...(Args) - 1>(
+            std::forward_as_tuple(args...));
+        return new (get_module_of(bb)) Inst(std::forward<Args>(args)...);
     }
 
     template <typename... Args>
@@ -134,14 +154,17 @@ class IBinaryInst : public BaseInst<IBinaryInst> {
     IBinaryInst(OpID id, Value *v1, Value *v2, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return classof_range(v, add, sdiv);
+    }
     static IBinaryInst *create_add(Value *v1, Value *v2, BasicBlock *bb);
     static IBinaryInst *create_sub(Value *v1, Value *v2, BasicBlock *bb);
     static IBinaryInst *create_mul(Value *v1, Value *v2, BasicBlock *bb);
     static IBinaryInst *create_sdiv(Value *v1, Value *v2, BasicBlock *bb);
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override {
-        return new IBinaryInst(op_id_, get_operand(0), get_operand(1), prt);
+        return create(op_id_, get_operand(0), get_operand(1), prt);
     }
 };
 
@@ -152,12 +175,15 @@ class FBinaryInst : public BaseInst<FBinaryInst> {
     FBinaryInst(OpID id, Value *v1, Value *v2, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return classof_range(v, fadd, fdiv);
+    }
     static FBinaryInst *create_fadd(Value *v1, Value *v2, BasicBlock *bb);
     static FBinaryInst *create_fsub(Value *v1, Value *v2, BasicBlock *bb);
     static FBinaryInst *create_fmul(Value *v1, Value *v2, BasicBlock *bb);
     static FBinaryInst *create_fdiv(Value *v1, Value *v2, BasicBlock *bb);
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -168,6 +194,9 @@ class ICmpInst : public BaseInst<ICmpInst> {
     ICmpInst(OpID id, Value *lhs, Value *rhs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return classof_range(v, ge, ne);
+    }
     static ICmpInst *create_ge(Value *v1, Value *v2, BasicBlock *bb);
     static ICmpInst *create_gt(Value *v1, Value *v2, BasicBlock *bb);
     static ICmpInst *create_le(Value *v1, Value *v2, BasicBlock *bb);
@@ -175,7 +204,12 @@ class ICmpInst : public BaseInst<ICmpInst> {
     static ICmpInst *create_eq(Value *v1, Value *v2, BasicBlock *bb);
     static ICmpInst *create_ne(Value *v1, Value *v2, BasicBlock *bb);
 
-    virtual std::string print() override;
+    // the operator comparing the operands the other way round, a < b is b > a
+    static OpID get_swapped_op(OpID op);
+    // the operator of the negated compare, not a < b is a >= b
+    static OpID get_inverse_op(OpID op);
+
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -186,6 +220,9 @@ class FCmpInst : public BaseInst<FCmpInst> {
     FCmpInst(OpID id, Value *lhs, Value *rhs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return classof_range(v, fge, fne);
+    }
     static FCmpInst *create_fge(Value *v1, Value *v2, BasicBlock *bb);
     static FCmpInst *create_fgt(Value *v1, Value *v2, BasicBlock *bb);
     static FCmpInst *create_fle(Value *v1, Value *v2, BasicBlock *bb);
@@ -193,7 +230,7 @@ class FCmpInst : public BaseInst<FCmpInst> {
     static FCmpInst *create_feq(Value *v1, Value *v2, BasicBlock *bb);
     static FCmpInst *create_fne(Value *v1, Value *v2, BasicBlock *bb);
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 
     Instruction *clone(BasicBlock *prt) const override;
 };
@@ -207,16 +244,17 @@ public:
 
     static CallInst *create_call(Function *func, std::vector<Value *> args,
                                  BasicBlock *bb);
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + call;
+    }
     FunctionType *get_function_type() const;
 
-    virtual std::string print() override;
-    Function *func_;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override {
-            if(get_operands().size() == 1){
-                return new CallInst(func_, {}, prt);
-            }
-        return new CallInst(
-            func_, {get_operands().begin() + 1, get_operands().end()}, prt);
+        return create(get_operand(0)->as<Function>(),
+                      std::vector<Value *>{get_operands().begin() + 1,
+                                           get_operands().end()},
+                      prt);
     }
 };
 
@@ -229,6 +267,9 @@ class BranchInst : public BaseInst<BranchInst> {
     ~BranchInst();
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + br;
+    }
     static BranchInst *create_cond_br(Value *cond, BasicBlock *if_true,
                                       BasicBlock *if_false, BasicBlock *bb);
     static BranchInst *create_br(BasicBlock *if_true, BasicBlock *bb);
@@ -236,15 +277,16 @@ class BranchInst : public BaseInst<BranchInst> {
     bool is_cond_br() const { return get_num_operand() == 3; }
 
     Value *get_condition() const { return get_operand(0); }
+    // branch to to wherever this branched to from, the CFG edges follow
+    void replace_successor(BasicBlock *from, BasicBlock *to);
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override {
         if (is_cond_br())
-            return new BranchInst(this->get_operand(0),
-                                  (BasicBlock *)(get_operand(1)),
-                                  (BasicBlock *)(get_operand(2)), prt);
-        return new BranchInst(nullptr, (BasicBlock *)(get_operand(0)), nullptr,
-                              prt);
+            return create(this->get_operand(0),
+                          (BasicBlock *)(get_operand(1)),
+                          (BasicBlock *)(get_operand(2)), prt);
+        return create(nullptr, (BasicBlock *)(get_operand(0)), nullptr, prt);
     }
 };
 
@@ -255,11 +297,14 @@ class ReturnInst : public BaseInst<ReturnInst> {
     ReturnInst(Value *val, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + ret;
+    }
     static ReturnInst *create_ret(Value *val, BasicBlock *bb);
     static ReturnInst *create_void_ret(BasicBlock *bb);
     bool is_void_ret() const;
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -270,14 +315,17 @@ class GetElementPtrInst : public BaseInst<GetElementPtrInst> {
     GetElementPtrInst(Value *ptr, std::vector<Value *> idxs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + getelementptr;
+    }
     static Type *get_element_type(Value *ptr, std::vector<Value *> idxs);
     static GetElementPtrInst *create_gep(Value *ptr, std::vector<Value *> idxs,
                                          BasicBlock *bb);
     Type *get_element_type() const;
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override{
-  return new GetElementPtrInst(get_operand(0), {get_operands().begin() + 1, get_operands().end()}, prt);
+  return create(get_operand(0), std::vector<Value *>{get_operands().begin() + 1, get_operands().end()}, prt);
 }
 };
 
@@ -288,12 +336,15 @@ class StoreInst : public BaseInst<StoreInst> {
     StoreInst(Value *val, Value *ptr, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + store;
+    }
     static StoreInst *create_store(Value *val, Value *ptr, BasicBlock *bb);
 
     Value *get_rval() { return this->get_operand(0); }
     Value *get_lval() { return this->get_operand(1); }
     Instruction *clone(BasicBlock *prt) const override;
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 };
 
 class LoadInst : public BaseInst<LoadInst> {
@@ -303,12 +354,15 @@ class LoadInst : public BaseInst<LoadInst> {
     LoadInst(Value *ptr, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + load;
+    }
     static LoadInst *create_load(Value *ptr, BasicBlock *bb);
 
     Value *get_lval() const { return this->get_operand(0); }
     Type *get_load_type() const { return get_type(); };
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -319,13 +373,16 @@ class AllocaInst : public BaseInst<AllocaInst> {
     AllocaInst(Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + alloca;
+    }
     static AllocaInst *create_alloca(Type *ty, BasicBlock *bb);
 
     Type *get_alloca_type() const {
         return get_type()->get_pointer_element_type();
     };
     Instruction *clone(BasicBlock *prt) const override;
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
 };
 
 class ZextInst : public BaseInst<ZextInst> {
@@ -335,12 +392,15 @@ class ZextInst : public BaseInst<ZextInst> {
     ZextInst(Value *val, Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + zext;
+    }
     static ZextInst *create_zext(Value *val, Type *ty, BasicBlock *bb);
     static ZextInst *create_zext_to_i32(Value *val, BasicBlock *bb);
 
     Type *get_dest_type() const { return get_type(); };
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -351,12 +411,15 @@ class FpToSiInst : public BaseInst<FpToSiInst> {
     FpToSiInst(Value *val, Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + fptosi;
+    }
     static FpToSiInst *create_fptosi(Value *val, Type *ty, BasicBlock *bb);
     static FpToSiInst *create_fptosi_to_i32(Value *val, BasicBlock *bb);
 
     Type *get_dest_type() const { return get_type(); };
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -367,11 +430,34 @@ class SiToFpInst : public BaseInst<SiToFpInst> {
     SiToFpInst(Value *val, Type *ty, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + sitofp;
+    }
     static SiToFpInst *create_sitofp(Value *val, BasicBlock *bb);
 
     Type *get_dest_type() const { return get_type(); };
 
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
+    Instruction *clone(BasicBlock *prt) const override;
+};
+
+class BitCastInst : public BaseInst<BitCastInst> {
+    friend BaseInst<BitCastInst>;
+
+  private:
+    BitCastInst(Value *val, Type *ty, BasicBlock *bb);
+
+  public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + bitcast;
+    }
+    // the same address seen as a pointer to another type, e.g. float* to
+    // <4 x float>*
+    static BitCastInst *create_bitcast(Value *val, Type *ty, BasicBlock *bb);
+
+    Type *get_dest_type() const { return get_type(); };
+
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
 };
 
@@ -383,33 +469,58 @@ class PhiInst : public BaseInst<PhiInst> {
             std::vector<BasicBlock *> val_bbs, BasicBlock *bb);
 
   public:
+    static bool classof(const Value *v) {
+        return v->get_value_id() == InstructionVal + phi;
+    }
     static PhiInst *create_phi(Type *ty, BasicBlock *bb,
                                std::vector<Value *> vals = {},
                                std::vector<BasicBlock *> val_bbs = {});
 
-    void add_phi_pair_operand(Value *val, Value *pre_bb) {
-        this->add_operand(val);
-        this->add_operand(pre_bb);
+    // operand i is the value incoming from get_incoming_block(i), the
+    // blocks are kept beside the operands and are not uses
+    unsigned get_num_incoming() const { return get_num_operand(); }
+    Value *get_incoming_value(unsigned i) const { return get_operand(i); }
+    BasicBlock *get_incoming_block(unsigned i) const {
+        return incoming_bbs_[i];
     }
-
-    void remove_phi_operand(Value *pre_bb) {
-        for (unsigned i = 0; i < this->get_num_operand(); i += 2) {
-            if (this->get_operand(i + 1) == pre_bb) {
-                this->remove_operand(i);
-                this->remove_operand(i);
-                return;
-            }
-        }
+    void set_incoming_value(unsigned i, Value *val) { set_operand(i, val); }
+    void set_incoming_block(unsigned i, BasicBlock *pre_bb);
+
+    // the first pair from pre_bb, -1 / nullptr if there is none
+    int get_incoming_index(const BasicBlock *pre_bb) const;
+    Value *get_incoming_value_for(const BasicBlock *pre_bb) const {
+        auto i = get_incoming_index(pre_bb);
+        return i < 0 ? nullptr : get_incoming_value(i);
     }
 
-    std::vector<std::pair<Value *, BasicBlock *>> get_phi_pairs() {
+    void add_phi_pair_operand(Value *val, BasicBlock *pre_bb);
+    // O(1) on wide phis, the last pair takes the place of the removed one
+    void remove_incoming(const BasicBlock *pre_bb);
+    // every pair from old_bb comes from new_bb instead
+    void replace_incoming_block(const BasicBlock *old_bb, BasicBlock *new_bb);
+
+    std::vector<std::pair<Value *, BasicBlock *>> get_phi_pairs() const {
         std::vector<std::pair<Value *, BasicBlock *>> res;
-        for (size_t i = 0; i < get_num_operand(); i += 2) {
-            res.push_back({this->get_operand(i),
-                           this->get_operand(i + 1)->as<BasicBlock>()});
-        }
+        res.reserve(get_num_incoming());
+        for (unsigned i = 0; i < get_num_incoming(); i++)
+            res.emplace_back(get_incoming_value(i), get_incoming_block(i));
         return res;
     }
-    virtual std::string print() override;
+    virtual void print(std::ostream &os) override;
     Instruction *clone(BasicBlock *prt) const override;
+
+  private:
+    // phis with this many pairs find a block through the index, narrower
+    // ones scan incoming_bbs_
+    static constexpr unsigned index_threshold = 16;
+
+    void build_index() const;
+
+    llvm::SmallVector<BasicBlock *, 2> incoming_bbs_;
+    // block -> its first pair, built on the first lookup in a wide phi and
+    // kept up to date after that. A block that repeats makes the removal
+    // of a pair ambiguous, such phis scan instead
+    mutable llvm::DenseMap<const BasicBlock *, unsigned> index_;
+    mutable bool index_valid_{false};
+    mutable bool index_has_repeats_{false};
 };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Module.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+/* Reads LLVM IR text back into a module: the subset Module::print() writes,
+ * so everything cminusfc emits and hand written .ll in that style. Besides
+ * that the parser skips what clang puts around such code, linkage words,
+ * nsw, inbounds, align, attribute groups and top level metadata, and it
+ * numbers unnamed arguments and an unnamed entry block like llvm does.
+ *
+ * Values may be used before they are defined anywhere in a function, a use
+ * holds a placeholder of the type it names until the definition replaces
+ * it, and calls may go to functions defined further down. Types are checked
+ * before an instruction is built, so bad input gives an error instead of an
+ * assert. The preds comments are not read, the edges of the blocks come
+ * from the branches. Returns nullptr and "<line>:<column>: <message>" in
+ * error for text that is not taken. */
+std::unique_ptr<Module> parse_ll(const char *data, std::size_t size,
+                                 std::string &error);
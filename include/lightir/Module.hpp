@@ -6,20 +6,89 @@
 #include "Type.hpp"
 #include "Value.hpp"
 
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
 #include <list>
+#include <llvm/ADT/DenseMap.h>
+#include <llvm/ADT/DenseSet.h>
 #include <llvm/ADT/ilist.h>
 #include <llvm/ADT/ilist_node.h>
+#include <llvm/Support/Allocator.h>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_set>
 
 class GlobalVariable;
 class Function;
+class ConstantInt;
+class ConstantFP;
+class ConstantZero;
+class ConstantArray;
+// the parts of a derived type, made on the stack to look the type up
+struct TypeKey {
+    Type::TypeID tid;
+    // the pointee, element or return type
+    Type *contained;
+    // elements of an array or vector
+    unsigned num_elements;
+    llvm::ArrayRef<Type *> params;
+    std::size_t hash;
+
+    TypeKey(Type::TypeID tid, Type *contained, unsigned num_elements,
+            llvm::ArrayRef<Type *> params = {})
+        : tid(tid), contained(contained), num_elements(num_elements),
+          params(params),
+          hash(Type::hash_of(tid, contained, num_elements, params)) {}
+};
+
+struct TypeKeyInfo {
+    static Type *getEmptyKey() {
+        return llvm::DenseMapInfo<Type *>::getEmptyKey();
+    }
+    static Type *getTombstoneKey() {
+        return llvm::DenseMapInfo<Type *>::getTombstoneKey();
+    }
+    static unsigned getHashValue(const Type *ty) {
+        return static_cast<unsigned>(ty->get_hash());
+    }
+    static unsigned getHashValue(const TypeKey &key) {
+        return static_cast<unsigned>(key.hash);
+    }
+    static bool isEqual(const Type *lhs, const Type *rhs) { return lhs == rhs; }
+    static bool isEqual(const TypeKey &key, const Type *ty);
+};
+
 class Module {
   public:
-    Module();
-    ~Module() = default;
+    // @use_arena: place the values of the module in a bump allocator
+    // owned by the module, their memory is released in bulk with the module
+    explicit Module(bool use_arena = true);
+    Module(const Module &) = delete;
+    // cuts every use-def link at once rather than use by use, then frees
+    // the values; no value of the module may be used afterwards. This was
+    // the opt-in fast teardown before the constants moved into the module
+    ~Module();
 
+    bool uses_arena() const { return use_arena_; }
+    void *allocate(std::size_t size, std::size_t alignment) {
+        std::lock_guard<std::mutex> lock(arena_mutex_);
+        return arena_.Allocate(size, llvm::Align(alignment));
+    }
+    // the values ever created in the module and the bytes they took, in the
+    // arena or not; for -stats
+    void count_value(std::size_t size) {
+        num_values_.fetch_add(1, std::memory_order_relaxed);
+        value_bytes_.fetch_add(size, std::memory_order_relaxed);
+    }
+    std::size_t get_num_values() const {
+        return num_values_.load(std::memory_order_relaxed);
+    }
+    std::size_t get_value_bytes() const {
+        return value_bytes_.load(std::memory_order_relaxed);
+    }
     Type *get_void_type();
     Type *get_label_type();
     IntegerType *get_int1_type();
@@ -30,17 +99,60 @@ class Module {
 
     PointerType *get_pointer_type(Type *contained);
     ArrayType *get_array_type(Type *contained, unsigned num_elements);
-    FunctionType *get_function_type(Type *retty, std::vector<Type *> &args);
+    VectorType *get_vector_type(Type *contained, unsigned num_elements);
+    FunctionType *get_function_type(Type *retty, llvm::ArrayRef<Type *> args);
 
     void add_function(Function *f);
     llvm::ilist<Function> &get_functions();
     void add_global_variable(GlobalVariable *g);
     llvm::ilist<GlobalVariable> &get_global_variable();
 
-    void set_print_name();
+    // the one copy of name that values with this name point to
+    const std::string *intern_name(const std::string &name) {
+        std::lock_guard<std::mutex> lock(names_mutex_);
+        return &*names_.insert(name).first;
+    }
+
+    void print(std::ostream &os);
     std::string print();
 
   private:
+    friend class ConstantInt;
+    friend class ConstantFP;
+    friend class ConstantZero;
+    friend class ConstantArray;
+
+    // drop every use-def link inside the module without fixing up use lists
+    void drop_all_references();
+    // the type with the parts of key, made by create() the first time
+    template <typename T, typename Create>
+    T *intern_type(const TypeKey &key, std::vector<std::unique_ptr<T>> &owned,
+                   Create create);
+
+    bool use_arena_;
+    // must outlive the constants and the function and global lists below
+    llvm::BumpPtrAllocator arena_;
+
+    // function passes may run on several threads at once (-j), these guard
+    // what all functions share: the arena, the constant and the type tables
+    std::mutex arena_mutex_;
+    std::mutex constants_mutex_;
+    std::mutex types_mutex_;
+    std::mutex names_mutex_;
+    std::atomic<std::size_t> num_values_{0}, value_bytes_{0};
+
+    // value names, nodes never move; outlives the values as well
+    std::unordered_set<std::string> names_;
+
+    // uniqued constants, keyed by the value widened to 64 bits so that no
+    // int32 value or float bit pattern hits the DenseMap empty/tombstone keys
+    llvm::DenseMap<int64_t, std::unique_ptr<ConstantInt>> int_constants_;
+    std::unique_ptr<ConstantInt> bool_constants_[2];
+    llvm::DenseMap<uint64_t, std::unique_ptr<ConstantFP>> float_constants_;
+    llvm::DenseMap<Type *, std::unique_ptr<ConstantZero>> zero_constants_;
+    // not uniqued, only owned here
+    std::vector<std::unique_ptr<ConstantArray>> array_constants_;
+
     // The global variables in the module
     llvm::ilist<GlobalVariable> global_list_;
     // The functions in the module
@@ -51,9 +163,14 @@ class Module {
     std::unique_ptr<Type> label_ty_;
     std::unique_ptr<Type> void_ty_;
     std::unique_ptr<FloatType> float32_ty_;
-    std::map<Type *, std::unique_ptr<PointerType>> pointer_map_;
-    std::map<std::pair<Type *, int>, std::unique_ptr<ArrayType>> array_map_;
-    std::map<std::pair<Type *, std::vector<Type *>>,
-             std::unique_ptr<FunctionType>>
-        function_map_;
+    // asked for all the time, made up front
+    PointerType *int32_ptr_ty_;
+    PointerType *float32_ptr_ty_;
+    // the derived types, one of each structure; equal parts are the same
+    // pointers, so the structure is compared without going deeper
+    llvm::DenseSet<Type *, TypeKeyInfo> types_;
+    std::vector<std::unique_ptr<PointerType>> pointer_types_;
+    std::vector<std::unique_ptr<ArrayType>> array_types_;
+    std::vector<std::unique_ptr<VectorType>> vector_types_;
+    std::vector<std::unique_ptr<FunctionType>> function_types_;
 };
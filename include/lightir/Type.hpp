@@ -1,6 +1,8 @@
 #pragma once
 
+#include <cstddef>
 #include <iostream>
+#include <llvm/ADT/ArrayRef.h>
 #include <vector>
 
 class Module;
@@ -9,6 +11,7 @@ class FunctionType;
 class ArrayType;
 class PointerType;
 class FloatType;
+class VectorType;
 
 class Type {
   public:
@@ -19,7 +22,8 @@ class Type {
         FunctionTyID, // Functions
         ArrayTyID,    // Arrays
         PointerTyID,  // Pointer
-        FloatTyID     // float
+        FloatTyID,    // float
+        VectorTyID    // Fixed vectors of i32 or float
     };
 
     explicit Type(TypeID tid, Module *m);
@@ -34,18 +38,32 @@ class Type {
     bool is_array_type() const { return get_type_id() == ArrayTyID; }
     bool is_pointer_type() const { return get_type_id() == PointerTyID; }
     bool is_float_type() const { return get_type_id() == FloatTyID; }
+    bool is_vector_type() const { return get_type_id() == VectorTyID; }
     bool is_int32_type() const;
     bool is_int1_type() const;
 
     // Return related data member if is the required type, else throw error
     Type *get_pointer_element_type() const;
     Type *get_array_element_type() const;
+    // the element type of a vector, the type itself for the others
+    Type *get_scalar_type() const;
 
     Module *get_module() const { return m_; }
     unsigned get_size() const;
 
+    // of the structure, taken once: types are uniqued by it in Module
+    std::size_t get_hash() const { return hash_; }
+    // the hash of a type of tid with these parts: the pointee, element or
+    // return type, the number of elements or bits, the parameters
+    static std::size_t hash_of(TypeID tid, const Type *contained,
+                               unsigned num, llvm::ArrayRef<Type *> params = {});
+
+    void print(std::ostream &os) const;
     std::string print() const;
 
+  protected:
+    std::size_t hash_;
+
   private:
     TypeID tid_;
     Module *m_;
@@ -68,9 +86,10 @@ class FunctionType : public Type {
     static bool is_valid_return_type(Type *ty);
     static bool is_valid_argument_type(Type *ty);
 
-    static FunctionType *get(Type *result, std::vector<Type *> params);
+    static FunctionType *get(Type *result, const std::vector<Type *> &params);
 
     unsigned get_num_of_args() const;
+    const std::vector<Type *> &get_params() const { return args_; }
 
     Type *get_param_type(unsigned i) const;
     std::vector<Type *>::iterator param_begin() { return args_.begin(); }
@@ -116,3 +135,19 @@ class FloatType : public Type {
 
   private:
 };
+
+class VectorType : public Type {
+  public:
+    VectorType(Type *contained, unsigned num_elements);
+
+    static bool is_valid_element_type(Type *ty);
+
+    static VectorType *get(Type *contained, unsigned num_elements);
+
+    Type *get_element_type() const { return contained_; }
+    unsigned get_num_of_elements() const { return num_elements_; }
+
+  private:
+    Type *contained_;       // i32 or float
+    unsigned num_elements_; // Number of lanes
+};
@@ -2,40 +2,54 @@
 
 #include "Value.hpp"
 
-#include <vector>
+#include <llvm/ADT/STLExtras.h>
+#include <llvm/ADT/SmallVector.h>
+#include <llvm/ADT/iterator_range.h>
 
 class User : public Value {
   public:
-    User(Type *ty, const std::string &name = "") : Value(ty, name){};
+    User(Type *ty, unsigned value_id, const std::string &name = "")
+        : Value(ty, value_id, name){};
     virtual ~User() { remove_all_operands(); }
 
-    const std::vector<Value *> &get_operands() const { return operands_; }
+    static bool classof(const Value *v) {
+        return v->get_value_id() >= GlobalVariableVal;
+    }
+
+    // the operand values, a random access view over the use nodes
+    using op_iterator =
+        llvm::mapped_iterator<const Use *, Value *(*)(const Use &)>;
+    llvm::iterator_range<op_iterator> get_operands() const {
+        return {op_iterator(operands_.begin(), &get_use_value),
+                op_iterator(operands_.end(), &get_use_value)};
+    }
     unsigned get_num_operand() const { return operands_.size(); }
 
     // start from 0
-    Value *get_operand(unsigned i) const { return operands_.at(i); };
+    Value *get_operand(unsigned i) const {
+        assert(i < operands_.size() && "get_operand out of index");
+        return operands_[i].get_used();
+    };
     // start from 0
     void set_operand(unsigned i, Value *v);
     void add_operand(Value *v);
 
     void remove_all_operands();
     void remove_operand(unsigned i);
+    // O(1) but not order preserving, the last operand takes slot i
+    void remove_operand_unordered(unsigned i);
 
-  private:
-    std::vector<Value *> operands_; // operands of this value
-};
+    // Drop all operands for module teardown: the uses are forgotten without
+    // touching the used values, which are about to be destroyed as well.
+    void drop_operands_for_teardown();
 
-/* For example: op = func(a, b)
- *  for a: Use(op, 0)
- *  for b: Use(op, 1)
- */
-struct Use {
-    User *val_;       // used by whom
-    unsigned arg_no_; // the no. of operand
+  private:
+    friend class Value;
 
-    Use(User *val, unsigned no) : val_(val), arg_no_(no) {}
+    static Value *get_use_value(const Use &use) { return use.get_used(); }
 
-    bool operator==(const Use &other) const {
-        return val_ == other.val_ and arg_no_ == other.arg_no_;
-    }
+    // the use node of each operand holds the operand. Fixed arity
+    // instructions have at most 3 operands, which stay inline; phis, calls
+    // and constant arrays move theirs to the heap when they grow beyond
+    llvm::SmallVector<Use, 3> operands_;
 };
@@ -2,26 +2,160 @@
 
 #include <functional>
 #include <iostream>
-#include <list>
+#include <iterator>
 #include <string>
 #include <cassert>
 
+class Module;
 class Type;
 class Value;
 class User;
-struct Use;
+
+/* For example: op = func(a, b)
+ *  for a: Use(op, 0)
+ *  for b: Use(op, 1)
+ *
+ * Use nodes are the operand storage of their User, each holds the used
+ * Value and is linked into an intrusive list headed by it, so adding or
+ * removing a use never allocates and unlinking is O(1). Constants, globals and
+ * functions are used by all functions at once, (un)linking a use of those
+ * takes a lock so that functions can be changed on different threads.
+ */
+struct Use {
+    User *val_;       // used by whom
+    unsigned arg_no_; // the no. of operand
+
+    Use(User *val, unsigned no, Value *used)
+        : val_(val), arg_no_(no), used_(used) {}
+    Use(const Use &) = delete;
+    Use &operator=(const Use &) = delete;
+    // moving a node (e.g. when the operand storage grows) relinks it in place
+    Use(Use &&other) noexcept
+        : val_(other.val_), arg_no_(other.arg_no_), used_(other.used_) {
+        take_links(other);
+    }
+    Use &operator=(Use &&other) noexcept {
+        if (this != &other) {
+            unlink();
+            val_ = other.val_;
+            arg_no_ = other.arg_no_;
+            used_ = other.used_;
+            take_links(other);
+        }
+        return *this;
+    }
+    ~Use() { unlink(); }
+
+    bool operator==(const Use &other) const {
+        return val_ == other.val_ and arg_no_ == other.arg_no_;
+    }
+
+    bool is_linked() const { return prev_ != nullptr; }
+    Use *get_next() const { return next_; }
+
+  private:
+    friend class Value;
+    friend class User;
+
+    // mark as unlinked without touching the neighbours or the used value,
+    // see Module teardown
+    void forget_links() {
+        used_ = nullptr;
+        next_ = nullptr;
+        prev_ = nullptr;
+    }
+    void link(Use *&head) {
+        next_ = head;
+        if (next_)
+            next_->prev_ = &next_;
+        prev_ = &head;
+        head = this;
+    }
+    // the operand, nullptr once it was dropped
+    Value *get_used() const { return used_; }
+    // both lock the use list of the used value if it is shared
+    void unlink();
+    void take_links(Use &other);
+
+    Value *used_;
+    Use *next_{nullptr};
+    Use **prev_{nullptr}; // the next_ field pointing at us, or the list head
+};
+
+// iterable view over the intrusive use list of a Value
+class UseList {
+  public:
+    class iterator {
+      public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Use;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Use *;
+        using reference = const Use &;
+
+        explicit iterator(const Use *use = nullptr) : use_(use) {}
+        reference operator*() const { return *use_; }
+        pointer operator->() const { return use_; }
+        iterator &operator++() {
+            use_ = use_->get_next();
+            return *this;
+        }
+        iterator operator++(int) {
+            auto old = *this;
+            ++*this;
+            return old;
+        }
+        bool operator==(const iterator &other) const {
+            return use_ == other.use_;
+        }
+        bool operator!=(const iterator &other) const {
+            return use_ != other.use_;
+        }
+
+      private:
+        const Use *use_;
+    };
+
+    explicit UseList(const Use *head) : head_(head) {}
+
+    iterator begin() const { return iterator(head_); }
+    iterator end() const { return iterator(); }
+    const Use &front() const { return *head_; }
+    bool empty() const { return head_ == nullptr; }
+    // walks the list, prefer empty() when only emptiness matters
+    std::size_t size() const { return std::distance(begin(), end()); }
+
+  private:
+    const Use *head_;
+};
 
 class Value {
   public:
-    explicit Value(Type *ty, const std::string &name = "")
-        : type_(ty), name_(name){};
+    // discriminator of the concrete class, is/as/dyn_cast only compare it;
+    // an instruction stores InstructionVal + its Instruction::OpID
+    enum ValueID : unsigned {
+        ArgumentVal,
+        BasicBlockVal,
+        FunctionVal,
+        // Users from here on
+        GlobalVariableVal,
+        ConstantIntVal,
+        ConstantFPVal,
+        ConstantZeroVal,
+        ConstantArrayVal,
+        InstructionVal,
+    };
+
+    explicit Value(Type *ty, unsigned value_id, const std::string &name = "");
     virtual ~Value() { replace_all_use_with(nullptr); }
 
-    std::string get_name() const { return name_; };
+    // empty for values that print with a number, see SlotTracker
+    const std::string &get_name() const { return *name_; };
     Type *get_type() const { return type_; }
-    const std::list<Use> &get_use_list() const { return use_list_; }
+    unsigned get_value_id() const { return value_id_; }
+    UseList get_use_list() const { return UseList(use_head_); }
 
-    bool set_name(std::string name);
+    bool set_name(const std::string &name);
 
     void add_use(User *user, unsigned arg_no);
     void remove_use(User *user, unsigned arg_no);
@@ -29,32 +163,52 @@ class Value {
     void replace_all_use_with(Value *new_val);
     void replace_use_with_if(Value *new_val, std::function<bool(Use *)> pred);
 
-    virtual std::string print() = 0;
+    // print the textual IR of this value into os
+    virtual void print(std::ostream &os) = 0;
+    // string wrapper around print(std::ostream &)
+    std::string print();
 
     template<typename T>
     T *as()
     {
-      static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
-      const auto ptr = dynamic_cast<T*>(this);
-      assert(ptr && "dynamic_cast failed");
-      return ptr;
+      assert(is<T>() && "as<T>() on a value of another kind");
+      return static_cast<T*>(this);
     }
     template<typename T>
     [[nodiscard]] const T* as() const {
-        static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
-        const auto ptr = dynamic_cast<const T*>(this);
-        assert(ptr);
-        return ptr;
+        assert(is<T>() && "as<T>() on a value of another kind");
+        return static_cast<const T*>(this);
+    }
+    // as<T>() that yields nullptr instead of asserting
+    template <typename T> T *dyn_cast() {
+        return is<T>() ? static_cast<T *>(this) : nullptr;
     }
-    // is 接口
+    template <typename T> [[nodiscard]] const T *dyn_cast() const {
+        return is<T>() ? static_cast<const T *>(this) : nullptr;
+    }
+    // IR nodes can be placed in the arena of their module (see
+    // Module::allocate), such memory is reclaimed in bulk when the module is
+    // destroyed and delete only runs the destructor.
+    static void *operator new(std::size_t size);
+    static void *operator new(std::size_t size, Module *m);
+    static void operator delete(void *ptr);
+    static void operator delete(void *ptr, Module *m);
+
+    // forget all uses without unlinking them one by one, only valid when all
+    // users are being torn down together with this value
+    void clear_use_list_unchecked() { use_head_ = nullptr; }
+
+    // is 接口, T::classof decides by the value id
     template <typename T>
     [[nodiscard]] bool is() const {
         static_assert(std::is_base_of<Value, T>::value, "T must be a subclass of Value");
-        return dynamic_cast<const T*>(this);
+        return T::classof(this);
     }
 
   private:
     Type *type_;
-    std::list<Use> use_list_; // who use this value
-    std::string name_;        // should we put name field here ?
+    Use *use_head_{nullptr}; // who use this value
+    // interned by the module of the type, see Module::intern_name()
+    const std::string *name_;
+    const unsigned value_id_;
 };
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "Value.hpp"
+
+/**
+ * 简单的别名分析：地址分解为基址（FuncInfo::get_first_addr）加上以标量
+ * 元素计的偏移。不同的全局变量、不同的 alloca 互不别名；alloca 也不会与
+ * 参数传入的指针别名。同一基址下常量偏移相同则必然别名，不同则不别名。
+ **/
+class AliasAnalysis {
+  public:
+    enum AliasResult { NoAlias, MayAlias, MustAlias };
+
+    static AliasResult alias(Value *ptr1, Value *ptr2);
+
+  private:
+    struct Location {
+        Value *base;
+        bool const_offset; // offset known at compile time
+        long offset;
+    };
+    static Location decompose(Value *ptr);
+};
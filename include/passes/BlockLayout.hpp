@@ -0,0 +1,27 @@
+#pragma once
+
+#include "CallGraph.hpp"
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 按 -fprofile-use 的执行次数（见 Profile.hpp）重排函数的基本块，让热路径
+ * 顺序落下而不必跳转：从入口块开始，每次把当前块执行次数最多的未放置后继
+ * 接在后面；没有这样的后继时，从剩下执行次数最多的块重新开始。次数相同的
+ * 块保持原来的先后，从未执行的块因此移到函数末尾。
+ * 传递中新建、没有次数的块取有次数的前驱中最大的次数，仍然没有的按 0 计。
+ * 没有任何次数的函数保持原样。只改变块的顺序，控制流图不变。
+ **/
+class BlockLayout : public FunctionPass {
+  public:
+    BlockLayout(Module *m) : FunctionPass(m) {}
+
+    void run_on_func(Function *func) override;
+    // the blocks only change places
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        pa.preserve<CallGraph>();
+        return pa;
+    }
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+/**
+ * 数组下标检查消除。对函数内每个 i32 值求一个取值区间 [lo, hi]：
+ * 常量、加减乘、除以正负数、zext 按区间运算（可能溢出时为全集），
+ * phi 取各入边值的并集，按支配树先序迭代到不动点，多次增长的区间放宽为全集。
+ * 求某块中的值时沿支配树向上，经过的块若只有唯一前驱（不计调用
+ * neg_idx_except 的块，它不会返回）且前驱以比较结果条件跳转，
+ * 就用该比较收紧区间，因此通过一次下标检查后下标也已知非负。
+ * 能证明非负的 `icmp sge idx, 0` 检查改为直接跳到访问块，报错块随之删除。
+ **/
+class BoundsCheckElim : public FunctionPass {
+  public:
+    BoundsCheckElim(Module *m) : FunctionPass(m) {}
+
+    void run_on_func(Function *func) override;
+    // the guards only exit, removing them keeps every function as pure
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    // lo > hi is the empty range of a value not computed yet
+    struct Range {
+        std::int64_t lo, hi;
+        bool empty() const { return lo > hi; }
+    };
+
+    // ranges of one function, functions may be solved concurrently
+    struct FuncState {
+        std::unordered_map<Value *, Range> ranges;
+        // how often each range grew, to widen those that keep growing
+        std::unordered_map<Value *, unsigned> updates;
+        // blocks calling neg_idx_except, they never reach their successors
+        std::unordered_set<BasicBlock *> abort_bbs;
+    };
+
+    void prepare() override;
+
+    Range get_range(FuncState &state, Value *val);
+    // the range of val inside bb, narrowed by the branches leading to bb
+    Range get_range_at(FuncState &state, Value *val, BasicBlock *bb);
+    // val as constrained by `cond` being taken, cond an i1 value
+    Range refine(FuncState &state, Range range, Value *val, Value *cond,
+                 bool taken);
+    Range compute(FuncState &state, Instruction *instr);
+    void solve(FuncState &state, Function *func);
+    bool remove_guards(FuncState &state, Function *func);
+
+    Dominators *dominators_;
+};
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Function.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 调用图：记录每个函数的调用者、被调用者和调用点，
+ * 并用 Tarjan 算法求强连通分量，按自底向上（被调用者在前）的顺序给出。
+ **/
+class CallGraph : public Pass {
+  public:
+    using SCC = std::vector<Function *>;
+
+    CallGraph(Module *m) : Pass(m) {}
+
+    void run() override;
+
+    // distinct functions, in order of first call
+    const std::vector<Function *> &get_callees(Function *func) {
+        return nodes_[func].callees;
+    }
+    const std::vector<Function *> &get_callers(Function *func) {
+        return nodes_[func].callers;
+    }
+    // the call instructions inside func
+    const std::vector<CallInst *> &get_call_sites(Function *func) {
+        return nodes_[func].call_sites;
+    }
+
+    // every SCC comes after all SCCs it calls into
+    const std::vector<SCC> &get_sccs() const { return sccs_; }
+    const SCC &get_scc(Function *func) { return sccs_[nodes_[func].scc]; }
+    // calls itself directly or through other functions
+    bool is_recursive(Function *func) { return nodes_[func].recursive; }
+
+  private:
+    struct Node {
+        std::vector<Function *> callees;
+        std::vector<Function *> callers;
+        std::vector<CallInst *> call_sites;
+        unsigned scc{0};
+        bool recursive{false};
+    };
+
+    void compute_sccs();
+
+    std::unordered_map<Function *, Node> nodes_;
+    std::vector<SCC> sccs_;
+};
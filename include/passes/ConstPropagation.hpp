@@ -1,26 +1,29 @@
 #ifndef CONSTPROPAGATION_HPP
 #define CONSTPROPAGATION_HPP
 #include "Constant.hpp"
-#include "IRBuilder.hpp"
 #include "Instruction.hpp"
 #include "Module.hpp"
 #include "PassManager.hpp"
 #include "Value.hpp"
 
-#include <stack>
+#include <set>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 ConstantFP *cast_constantfp(Value *value);
 ConstantInt *cast_constantint(Value *value);
 
+// all compute() return nullptr if the result is no compile time constant,
+// e.g. a division by zero that has to trap at runtime
 class ConstFolder {
 public:
     ConstFolder(Module *m) : module_(m) {}
-    // cminus only support binary operations
+    // int binary operations and int compare
     ConstantInt *compute(Instruction::OpID op, ConstantInt *value1, ConstantInt *value2);
-    ConstantFP *compute(Instruction::OpID op, ConstantFP *value1, ConstantFP *value2);
-    // int -> float
-    ConstantFP *compute(Instruction::OpID op, ConstantInt *value1);
+    // float binary operations (ConstantFP) and float compare (ConstantInt)
+    Constant *compute(Instruction::OpID op, ConstantFP *value1, ConstantFP *value2);
+    // int -> float, i1 -> i32
+    Constant *compute(Instruction::OpID op, ConstantInt *value1);
     // float -> int
     ConstantInt *compute(Instruction::OpID op, ConstantFP *value1);
 
@@ -28,24 +31,51 @@ private:
     Module *module_;
 };
 
-class ConstPropagation : public Pass {
+/* Sparse conditional constant propagation (Wegman & Zadeck) over SSA, run
+ * after Mem2Reg. Every value gets a lattice value undef > constant >
+ * overdefined and only instructions in blocks reached through executable
+ * edges are evaluated, so constants flow through phis and conditional
+ * branches in a single pass. Afterwards constant instructions are replaced,
+ * branches on constants become unconditional and blocks that were never
+ * executable are removed. */
+class ConstPropagation : public FunctionPass {
 public:
-    ConstPropagation(Module *m) : Pass(m) {}
-    void run();
+    ConstPropagation(Module *m) : FunctionPass(m), folder_(m) {}
+    void run_on_func(Function *func) override;
 
 private:
-    // clear blocks recursively from the start_bb
-    void clear_blocks_recs(BasicBlock *start_bb);
-
-    // check if the bb is the entry block in func
-    bool is_entry(BasicBlock *bb);
-    IRBuilder *builder = new IRBuilder(nullptr, m_);
-    std::vector<Instruction *> wait_delete;
-    ConstFolder *folder = new ConstFolder(m_);
-    // std::stack<GlobalVariable*>
-    std::unordered_map<GlobalVariable *, Constant *> globalvar_def;
-    // basic blocks that need to be removed
-    std::vector<BasicBlock *> delete_bb;
+    struct LatticeValue {
+        enum State { undef, constant, overdefined } state{undef};
+        Constant *value{nullptr};
+    };
+
+    // solver state of one function, functions may be solved concurrently
+    struct FuncState {
+        std::unordered_map<Value *, LatticeValue> lattice;
+        std::set<std::pair<BasicBlock *, BasicBlock *>> executable_edges;
+        std::unordered_set<BasicBlock *> executable_bbs;
+        // blocks that just became executable, visited as a whole
+        std::vector<BasicBlock *> bb_work_list;
+        // instructions whose operands lowered
+        std::vector<Instruction *> instr_work_list;
+    };
+
+    // propagation
+    LatticeValue get_lattice(FuncState &state, Value *val);
+    void update(FuncState &state, Instruction *instr, LatticeValue val);
+    void mark_edge_executable(FuncState &state, BasicBlock *from,
+                              BasicBlock *to);
+    void visit(FuncState &state, Instruction *instr);
+    void visit_phi(FuncState &state, PhiInst *phi);
+    void visit_br(FuncState &state, BranchInst *br);
+    Constant *fold(Instruction *instr, const std::vector<Constant *> &ops);
+
+    // rewriting
+    void replace_constants(FuncState &state, Function *func);
+    void fold_branch(BranchInst *br, ConstantInt *cond);
+    void remove_dead_blocks(FuncState &state, Function *func);
+
+    ConstFolder folder_;
 };
 
 #endif
@@ -1,30 +1,47 @@
 #pragma once
 
+#include "Dominators.hpp"
 #include "FuncInfo.hpp"
 #include "PassManager.hpp"
 
+#include <atomic>
 #include <unordered_set>
+#include <vector>
 
 /**
  * 死代码消除：参见
  *https://www.clear.rice.edu/comp512/Lectures/10Dead-Clean-SCCP.pdf
  **/
-class DeadCode : public Pass {
+class DeadCode : public FunctionPass {
   public:
-    DeadCode(Module *m) : Pass(m), func_info(std::make_shared<FuncInfo>(m)) {}
+    DeadCode(Module *m) : FunctionPass(m) {}
 
-    void run();
+    void run_on_func(Function *func) override;
+    // removed instructions are side effect free; erased blocks invalidate
+    // the dominator trees
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        if (not erased_blocks_)
+            pa.preserve<Dominators>();
+        return pa;
+    }
 
   private:
-    std::shared_ptr<FuncInfo> func_info;
-    int ins_count{0}; // 用以衡量死代码消除的性能
-    std::deque<Instruction *> work_list{};
-    std::unordered_map<Instruction *, bool> marked{};
-
-    void mark(Function *func);
-    void mark(Instruction *ins);
-    bool sweep(Function *func);
+    using Marked = std::unordered_set<Instruction *>;
+
+    void prepare() override;
+    void finish() override;
+
+    FuncInfo *func_info;
+    // 各函数可能在不同线程上处理
+    std::atomic<bool> erased_blocks_{false};
+    std::atomic<int> ins_count{0}; // 用以衡量死代码消除的性能
+
+    // 删除从入口不可达的基本块
     bool clear_basic_blocks(Function *func);
+    void mark(Function *func, Marked &marked);
+    bool sweep(Function *func, const Marked &marked);
     bool is_critical(Instruction *ins);
     void sweep_globally();
 };
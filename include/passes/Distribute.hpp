@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Module.hpp"
+
+#include <string>
+#include <sys/types.h>
+#include <vector>
+
+/* -distribute N: the function passes of the pipeline on N worker processes.
+ * The pipeline is cut in three, see split_pipeline(): the coordinator runs
+ * the part up to the last interprocedural pass before ipcp on the whole
+ * module, ships every definition to the workers, puts the optimized bodies
+ * back in module order and runs the rest itself.
+ *
+ * A job is the body in binary LightIR, written with the globals and
+ * functions it refers to as in the function cache, together with the
+ * FuncInfo effects of the functions it calls, which stay declarations in
+ * the module of the job. Each job gets a module of its own and the
+ * effects are those of the callees before the function part, so a body
+ * comes back the same whichever worker compiles it and with however many
+ * workers; it may differ from the body compiled without -distribute, where
+ * the effects of optimized callees are seen.
+ *
+ * A worker is this compiler started as "cminusfc --worker", or the shell
+ * command in $CMINUSF_WORKER, e.g. "ssh host cminusfc --worker", talking on
+ * its stdin and stdout. Both ways a message is its length as a 32 bit word
+ * in host byte order and as many bytes: first the pipeline, then jobs
+ *     <number of callees> (<effect> <name length> <name>)... <binary ir>
+ * each answered with "o" and the body in binary ir, or "e" and an error.
+ * The jobs of a worker that failed, could not be started or sent a body that
+ * does not read back are compiled in the coordinator the same way, so the
+ * output does not depend on the workers either. */
+class Distributor {
+  public:
+    explicit Distributor(unsigned num_workers);
+    Distributor(const Distributor &) = delete;
+    // ends the workers
+    ~Distributor();
+
+    struct Pipeline {
+        // up to the last inline or globalopt before the first ipcp
+        std::string module;
+        // the passes of the workers, from there up to the first ipcp
+        std::string functions;
+        // from the first ipcp on
+        std::string rest;
+    };
+    static Pipeline split_pipeline(const std::string &text);
+
+    // replace every definition of m by its body after the passes of
+    // pipeline, as compiled by the workers
+    void run(Module *m, const std::string &pipeline);
+
+    unsigned get_num_functions() const { return num_functions_; }
+    // of those, compiled by a worker rather than the coordinator
+    unsigned get_num_remote() const { return num_remote_; }
+    unsigned get_num_workers() const { return workers_.size(); }
+
+    // --worker: answer the jobs on stdin until it is closed
+    static int serve_worker();
+
+  private:
+    struct Worker {
+        pid_t pid;
+        // the coordinator's end of the socket, -1 once the worker failed
+        int fd;
+    };
+
+    void start_workers(unsigned num_workers, const std::string &pipeline);
+    // the reply to a job, as a worker would give it
+    static std::string compile_job(const std::string &pipeline,
+                                   const std::string &job);
+
+    unsigned num_workers_;
+    std::vector<Worker> workers_;
+    unsigned num_functions_{0}, num_remote_{0};
+};
@@ -3,25 +3,40 @@
 #include "BasicBlock.hpp"
 #include "PassManager.hpp"
 
+#include <cassert>
 #include <map>
-#include <set>
+#include <unordered_map>
+#include <vector>
 
-class Dominators : public Pass {
+class Dominators : public FunctionPass {
   public:
-    using BBSet = std::set<BasicBlock *>;
-
-    explicit Dominators(Module *m) : Pass(m) {}
+    // sorted by block index
+    using BBList = std::vector<BasicBlock *>;
+
+    // how the idom of each block is computed, both give the same results;
+    // cminusf_bench -micro times the two and checks that they agree
+    enum class Algorithm {
+        Iterative, // Cooper-Harvey-Kennedy fixpoint over the reverse post order
+        SemiNCA,   // near linear, one pass regardless of the loop structure
+    };
+
+    explicit Dominators(Module *m, Algorithm algo = Algorithm::SemiNCA)
+        : FunctionPass(m), algo_(algo) {}
     ~Dominators() = default;
-    void run() override;
-    void run_on_func(Function *f);
+    // (re)compute the trees of a single function
+    void run_on_func(Function *f) override;
 
     // functions for getting information
-    BasicBlock *get_idom(BasicBlock *bb) { return idom_.at(bb); }
-    const BBSet &get_dominance_frontier(BasicBlock *bb) {
-        return dom_frontier_.at(bb);
+    BasicBlock *get_idom(BasicBlock *bb) {
+        auto &tree = get_tree(bb);
+        auto idom = tree.idom_[bb->get_index()];
+        return idom == NONE ? nullptr : tree.blocks_[idom];
+    }
+    const BBList &get_dominance_frontier(BasicBlock *bb) {
+        return get_tree(bb).dom_frontier_[bb->get_index()];
     }
-    const BBSet &get_dom_tree_succ_blocks(BasicBlock *bb) {
-        return dom_tree_succ_blocks_.at(bb);
+    const BBList &get_dom_tree_succ_blocks(BasicBlock *bb) {
+        return get_tree(bb).dom_tree_succ_blocks_[bb->get_index()];
     }
 
     // print cfg or dominance tree
@@ -30,59 +45,65 @@ class Dominators : public Pass {
 
     // functions for dominance tree
     const bool is_dominate(BasicBlock *bb1, BasicBlock *bb2) {
-        return dom_tree_L_.at(bb1) <= dom_tree_L_.at(bb2) &&
-               dom_tree_R_.at(bb1) >= dom_tree_L_.at(bb2);
+        auto &tree = get_tree(bb1);
+        auto i1 = bb1->get_index(), i2 = bb2->get_index();
+        return tree.dom_tree_L_[i1] <= tree.dom_tree_L_[i2] &&
+               tree.dom_tree_R_[i1] >= tree.dom_tree_L_[i2];
     }
 
-    const std::vector<BasicBlock *> &get_dom_dfs_order() {
-        return dom_dfs_order_;
+    const std::vector<BasicBlock *> &get_dom_dfs_order(Function *f) {
+        return trees_.at(f).dom_dfs_order_;
     }
 
-    const std::vector<BasicBlock *> &get_dom_post_order() {
-        return dom_post_order_;
+    const std::vector<BasicBlock *> &get_dom_post_order(Function *f) {
+        return trees_.at(f).dom_post_order_;
     }
 
   private:
+    static constexpr unsigned NONE = ~0u; // no idom / not visited
+
+    void prepare() override;
+
+    // everything is indexed by BasicBlock::get_index()
+    struct DomTree {
+        std::vector<BasicBlock *> blocks_;
+        std::vector<unsigned> post_order_;   // 后序编号, root is the highest
+        std::vector<unsigned> post_order_vec_; // 后序遍历的块
+        std::vector<unsigned> pre_order_vec_;  // 先序遍历的块
+        std::vector<unsigned> dfs_parent_;     // dfs 树上的父节点
+        std::vector<unsigned> idom_;         // 直接支配
+        std::vector<BBList> dom_frontier_;   // 支配边界集合
+        std::vector<BBList> dom_tree_succ_blocks_; // 支配树中的后继节点
+
+        // 支配树上的dfs序L,R
+        std::vector<unsigned> dom_tree_L_;
+        std::vector<unsigned> dom_tree_R_;
+
+        std::vector<BasicBlock *> dom_dfs_order_;
+        std::vector<BasicBlock *> dom_post_order_;
+    };
+
+    DomTree &get_tree(BasicBlock *bb) {
+        auto &tree = trees_.at(bb->get_parent());
+        assert(bb->get_index() < tree.blocks_.size() &&
+               tree.blocks_[bb->get_index()] == bb &&
+               "block numbering changed since the analysis ran");
+        return tree;
+    }
 
-    void dfs(BasicBlock *bb, std::set<BasicBlock *> &visited);
-    void create_idom(Function *f);
-    void create_dominance_frontier(Function *f);
-    void create_dom_tree_succ(Function *f);
-    void create_dom_dfs_order(Function *f);
+    void dfs(DomTree &tree);
+    void create_idom(DomTree &tree);
+    void create_idom_semi_nca(DomTree &tree);
+    void create_dominance_frontier(DomTree &tree);
+    void create_dom_tree_succ(DomTree &tree);
+    void create_dom_dfs_order(DomTree &tree);
 
-    BasicBlock * intersect(BasicBlock *b1, BasicBlock *b2);
+    unsigned intersect(const DomTree &tree, unsigned b1, unsigned b2);
 
-    void create_reverse_post_order(Function *f);
-    void set_idom(BasicBlock *bb, BasicBlock *idom) { idom_[bb] = idom; }
-    void set_dominance_frontier(BasicBlock *bb, BBSet &df) {
-        dom_frontier_[bb].clear();
-        dom_frontier_[bb].insert(df.begin(), df.end());
-    }
-    void add_dom_tree_succ_block(BasicBlock *bb, BasicBlock *dom_tree_succ_bb) {
-        dom_tree_succ_blocks_[bb].insert(dom_tree_succ_bb);
-    }
-    unsigned int get_post_order(BasicBlock *bb) {
-        return post_order_.at(bb);
-    }
     // for debug
     void print_idom(Function *f);
     void print_dominance_frontier(Function *f);
 
-    // TODO 补充需要的函数
-    std::list<BasicBlock *> reverse_post_order_{};
-    std::map<BasicBlock *, int> post_order_id_{}; // the root has highest ID
-
-    std::vector<BasicBlock *> post_order_vec_{}; // 逆后序
-    std::map<BasicBlock *, unsigned int> post_order_{}; // 逆后序
-    std::map<BasicBlock *, BasicBlock *> idom_{};  // 直接支配
-    std::map<BasicBlock *, BBSet> dom_frontier_{}; // 支配边界集合
-    std::map<BasicBlock *, BBSet> dom_tree_succ_blocks_{}; // 支配树中的后继节点
-
-    // 支配树上的dfs序L,R
-    std::map<BasicBlock *, unsigned int> dom_tree_L_;
-    std::map<BasicBlock *, unsigned int> dom_tree_R_;
-
-    std::vector<BasicBlock *> dom_dfs_order_;
-    std::vector<BasicBlock *> dom_post_order_;
-
+    Algorithm algo_;
+    std::unordered_map<Function *, DomTree> trees_;
 };
@@ -3,33 +3,47 @@
 #include "PassManager.hpp"
 #include "logging.hpp"
 
-#include <deque>
 #include <unordered_map>
 
 /**
- * 计算哪些函数是纯函数
- * WARN:
- * 假定所有函数都是纯函数，除非他写入了全局变量、修改了传入的数组、或者直接间接调用了非纯函数
+ * 计算每个函数对内存的影响，从轻到重依次为：
+ * 1. ReadNone：不读写任何非局部内存，即纯函数
+ * 2. ReadOnly：只读全局变量或传入的数组，不写任何非局部内存
+ * 3. ArgMemOnly：只写传入的数组（可以读任何内存）
+ * 4. Any：写全局变量、进行输入输出，或者情况不明
+ * 对局部变量（alloca）的读写不算在内；调用的影响取被调用者的影响，
+ * 被调用者只写实参时按实参的基址重新判断（传入局部数组则只算读）
+ * 通过 CallGraph 的强连通分量自底向上传播，分量内部迭代到不动点；
+ * 声明的函数与 main 一律视为 Any，带有效果摘要的声明（-distribute 中
+ * 代表在别处编译的函数）取其摘要
  */
 class FuncInfo : public Pass {
   public:
+    enum MemEffect { ReadNone, ReadOnly, ArgMemOnly, Any };
+
     FuncInfo(Module *m) : Pass(m) {}
 
     void run();
 
-    bool is_pure_function(Function *func) const { return is_pure.at(func); }
+    MemEffect get_effect(Function *func) const { return effects_.at(func); }
+    bool is_pure_function(Function *func) const {
+        return get_effect(func) == ReadNone;
+    }
+    // writes no memory of the caller, may read it
+    bool is_readonly_function(Function *func) const {
+        return get_effect(func) <= ReadOnly;
+    }
 
-  private:
-    std::deque<Function *> worklist;
-    std::unordered_map<Function *, bool> is_pure;
+    // the alloca, global, argument or loaded pointer an address is based on
+    static Value *get_first_addr(Value *val);
 
-    void trivial_mark(Function *func);
-    void process(Function *func);
-    Value *get_first_addr(Value *val);
+  private:
+    std::unordered_map<Function *, MemEffect> effects_;
 
-    bool is_side_effect_inst(Instruction *inst);
-    bool is_local_load(LoadInst *inst);
-    bool is_local_store(StoreInst *inst);
+    MemEffect get_local_effect(Function *func);
+    MemEffect get_inst_effect(Instruction *inst);
+    // the effect of a write through ptr
+    static MemEffect get_store_effect(Value *ptr);
 
     void log();
 };
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Module.hpp"
+
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+
+class PassManager;
+
+/* -incremental: a database of optimized function bodies in the -cache-dir,
+ * one binary LightIR file fn-<fingerprint>.lir per function. The
+ * fingerprint of a function is taken on the ir as built and hashes
+ *     - the context: the compiler and the options
+ *     - the function itself, as printed
+ *     - every function it calls directly or not, as printed, for their
+ *       bodies are inlined and their FuncInfo summaries used
+ *     - if it or one of those refers to a global: the globals and every
+ *       function that refers to one, and their callees, for GlobalOpt and
+ *       FuncInfo look at all uses of a global
+ * so a changed function changes the fingerprints of its callers, and of all
+ * functions sharing globals with it, but not those of its callees.
+ *
+ * Only passes that depend on a function and what it calls are cached: the
+ * pipeline is cut before the first step running ipcp, which changes
+ * functions for their callers. load() puts the cached bodies in place and
+ * freezes them, the passes up to the cut skip them, store() saves the
+ * other bodies, and the rest of the pipeline runs on all functions. A
+ * function optimized again sees the callees taken from the cache in their
+ * optimized form, so its calls may be inlined or folded differently than
+ * without the cache, correct all the same. */
+class FunctionCache {
+  public:
+    // context: what besides the ir the optimized bodies depend on
+    FunctionCache(std::filesystem::path dir, std::string context);
+
+    // fingerprint every definition of m, then replace those found in the
+    // cache by the optimized bodies and freeze them in pm
+    void load(Module *m, PassManager &pm);
+    // write the definitions of m that load() did not find
+    void store(Module *m);
+
+    unsigned get_num_functions() const { return num_functions_; }
+    unsigned get_num_hits() const { return num_hits_; }
+
+    // 128 bit FNV-1a of text in hex
+    static std::string hash(const std::string &text);
+    // write data to <dir>/<key>.lir through a file of its own that is
+    // renamed into place, so that concurrent compilers see either no entry
+    // or a complete one
+    static void write_entry(const std::filesystem::path &dir,
+                            const std::string &key, const std::string &data);
+
+  private:
+    std::filesystem::path entry_path(const std::string &fingerprint) const;
+
+    std::filesystem::path dir_;
+    std::string context_;
+    // of the definitions not taken from the cache
+    std::unordered_map<Function *, std::string> fingerprints_;
+    unsigned num_functions_{0}, num_hits_{0};
+};
@@ -2,7 +2,20 @@
 
 #include "PassManager.hpp"
 
+#include <set>
+#include <string>
+#include <unordered_map>
 
+/**
+ * 自底向上的内联：按 CallGraph 给出的强连通分量顺序处理函数，被调函数在
+ * 调用者之前处理完毕，因此每个函数的调用点只需收集一次。
+ * 代价为被调函数的指令数，常量实参有奖励；调用者的增长受预算限制。
+ * 递归（含相互递归）的函数不会被内联。
+ * 有 -fprofile-use 的执行次数时（见 Profile.hpp），执行次数不少于全模块最热
+ * 基本块 1/hot_call_divisor 的调用点为热调用点，按更宽的 hot_inline_threshold
+ * 与 hot_caller_growth_budget 内联；内联出的基本块按调用点的次数缩放被调函数
+ * 的次数，被调函数相应减去。
+ **/
 class FunctionInline : public Pass{
 public:
     FunctionInline(Module *m) : Pass(m) {}
@@ -18,4 +31,25 @@ public:
                                         "outputFloat",
                                         "input",
                                         "neg_idx_except"};
-};
\ No newline at end of file
+
+    // callees up to this many instructions are inlined
+    static constexpr int inline_threshold = 50;
+    // cost reduction per constant argument, later folding pays for it
+    static constexpr int const_arg_bonus = 10;
+    // instructions a caller may gain from inlining in total
+    static constexpr unsigned caller_growth_budget = 400;
+    // the limits of hot call sites, those running at least 1/hot_call_divisor
+    // as often as the hottest block of the module
+    static constexpr long hot_call_divisor = 100;
+    static constexpr int hot_inline_threshold = 300;
+    static constexpr unsigned hot_caller_growth_budget = 1600;
+
+private:
+    int get_inline_cost(CallInst *call, Function *callee);
+    unsigned count_instructions(Function *func);
+    bool is_hot(CallInst *call) const;
+
+    std::unordered_map<Function *, unsigned> func_size_;
+    // no call site is hot without block counts
+    long hot_count_{0};
+};
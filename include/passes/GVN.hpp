@@ -0,0 +1,52 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+/**
+ * 全局值编号：在支配树上做作用域化的哈希表，若一条指令与支配它的某条指令
+ * 的操作码、类型和操作数都相同，则用后者替换它。
+ * 覆盖算术、比较、gep、类型转换以及纯函数调用（参见 FuncInfo，纯函数只依赖
+ * 标量参数，不读写非局部内存）。
+ **/
+class GVN : public Pass {
+  public:
+    GVN(Module *m) : Pass(m) {}
+
+    void run() override;
+    // only redundant instructions are removed
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<Dominators>();
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    struct Expression {
+        unsigned op;
+        Type *type;
+        std::vector<Value *> operands;
+
+        bool operator==(const Expression &other) const {
+            return op == other.op and type == other.type and
+                   operands == other.operands;
+        }
+    };
+    struct ExpressionHash {
+        std::size_t operator()(const Expression &expr) const;
+    };
+
+    void run_on_func(Function *func);
+    // whether instr can be numbered, *expr is filled in if so
+    bool get_expression(Instruction *instr, Expression *expr);
+
+    Dominators *dominators_;
+    FuncInfo *func_info_;
+    // leaders of the expressions available in the current dom tree scope
+    std::unordered_map<Expression, Instruction *, ExpressionHash> leaders_;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "FuncInfo.hpp"
+#include "GlobalVariable.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_set>
+#include <vector>
+
+/**
+ * 全局变量优化，沿 GEP 收集每个全局变量的 load、store 和作为实参的调用：
+ * 1. 从未被写过的全局变量标记为常量，load 换成初值中对应的常量
+ *    （ConstantZero 的任何元素都是 0）；传给会写内存的函数（见 FuncInfo）的
+ *    可能被写，不算
+ * 2. 只被写、从不被读也不传给函数的全局变量，删除其 store
+ * 3. 只在 main 中使用（main 不会被调用）的标量和小数组降为 main 入口的
+ *    alloca 并写入初值，之后可由 Mem2Reg/SROA 提升
+ * 传给声明的函数（如 -fprofile-generate 的 profile_init）的全局变量地址
+ * 可能被保存下来，视为逃逸，不做处理。
+ * 不再使用的全局变量随之删除；在被冻结的函数（见 AnalysisManager::freeze）
+ * 中使用的全局变量不处理
+ **/
+class GlobalOpt : public Pass {
+  public:
+    // arrays with more elements keep their global storage
+    static constexpr unsigned max_local_elements = 16;
+
+    GlobalOpt(Module *m) : Pass(m) {}
+
+    void run() override;
+
+  private:
+    struct GlobalUses {
+        std::vector<LoadInst *> loads;
+        std::vector<StoreInst *> stores;
+        // in use order, a gep on another gep comes after it
+        std::vector<GetElementPtrInst *> geps;
+        std::vector<CallInst *> calls;
+        std::unordered_set<Function *> funcs;
+        // used other than by loads, stores to it, geps and calls of
+        // definitions
+        bool escapes{false};
+    };
+
+    void collect_uses(Value *ptr, GlobalUses &uses);
+    // the value a load from the never written global reads, nullptr if
+    // the initializer does not tell
+    Constant *get_loaded_value(GlobalVariable *global, LoadInst *load);
+    bool constify(GlobalVariable *global, GlobalUses &uses);
+    bool remove_stores(GlobalVariable *global, GlobalUses &uses);
+    bool localize(GlobalVariable *global, Function *main);
+
+    FuncInfo *func_info_;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "PassManager.hpp"
+
+#include <vector>
+
+/**
+ * 过程间常量传播与无用参数删除，处理除 main 外只被直接调用的函数，
+ * 反复执行直到不再变化：
+ * 1. 所有调用点对某个参数都传入同一个常量时，函数内该参数换成这个常量；
+ *    递归调用原样传入该参数本身不影响判断
+ * 2. 所有 ret 都返回同一个常量（或自身递归调用的结果）时，
+ *    调用的结果换成这个常量，调用本身保留
+ * 3. 删除没有使用的参数，所有调用的结果都没用（或只被自身的 ret 返回）时
+ *    改为返回 void；签名改变时新建函数，移入原函数的基本块并替换所有调用
+ * 之后由 sccp 在函数内继续传播这些常量
+ **/
+class IPConstProp : public Pass {
+  public:
+    IPConstProp(Module *m) : Pass(m) {}
+
+    void run() override;
+
+  private:
+    // false if func is used other than as the callee of a call
+    bool get_calls(Function *func, std::vector<CallInst *> &calls);
+    bool propagate_args(Function *func, const std::vector<CallInst *> &calls);
+    bool propagate_return(Function *func,
+                          const std::vector<CallInst *> &calls);
+    bool remove_dead_args(Function *func,
+                          const std::vector<CallInst *> &calls);
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "Instruction.hpp"
+#include "LoopInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+// a basic induction variable: phi = [init, preheader], [phi + step, latch]
+struct InductionVar {
+    PhiInst *phi;
+    Value *init;
+    // the add (or sub) computing the value of the next iteration
+    Instruction *next;
+    int step;
+};
+
+/**
+ * 归纳变量分析：找出只有一个 latch 的循环中，循环头里每次迭代加一个常数的
+ * phi（Mem2Reg 为 while 循环的计数变量生成的形式）。
+ * 循环只从循环头退出，且退出条件是归纳变量与常数的比较、初值也是常数时，
+ * 算出循环体执行的次数；计算中归纳变量会溢出的循环次数未知。
+ **/
+class InductionVars : public Pass {
+  public:
+    InductionVars(Module *m) : Pass(m) {}
+
+    void run() override;
+
+    // empty for loops without a single latch
+    const std::vector<InductionVar> &get_induction_vars(Loop *loop) const {
+        static const std::vector<InductionVar> none;
+        auto it = loops_.find(loop);
+        return it == loops_.end() ? none : it->second.ivs;
+    }
+    // how often the body runs, -1 if unknown
+    long get_trip_count(Loop *loop) const {
+        auto it = loops_.find(loop);
+        return it == loops_.end() ? -1 : it->second.trip_count;
+    }
+    // the induction variable the exit test compares, nullptr if none
+    const InductionVar *get_exit_var(Loop *loop) const {
+        auto it = loops_.find(loop);
+        if (it == loops_.end() or it->second.exit_var < 0)
+            return nullptr;
+        return &it->second.ivs[it->second.exit_var];
+    }
+    // the exit test as `exit var op bound`, true while the body runs;
+    // nullptr if there is no exit var
+    Value *get_exit_bound(Loop *loop, Instruction::OpID &op) const {
+        auto it = loops_.find(loop);
+        if (it == loops_.end() or it->second.exit_var < 0)
+            return nullptr;
+        op = it->second.exit_op;
+        return it->second.exit_bound;
+    }
+
+    // how often the body of `while (iv op bound)` runs for iv = init,
+    // init + step, ...; -1 if never ending or iv would wrap around
+    static long compute_trip_count(Instruction::OpID op, long init, long step,
+                                   long bound);
+
+  private:
+    struct LoopIVs {
+        std::vector<InductionVar> ivs;
+        int exit_var{-1};
+        Instruction::OpID exit_op;
+        Value *exit_bound{nullptr};
+        long trip_count{-1};
+    };
+
+    void analyze(Loop *loop);
+    void find_trip_count(Loop *loop, LoopIVs &result);
+
+    std::unordered_map<Loop *, LoopIVs> loops_;
+};
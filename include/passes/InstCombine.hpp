@@ -0,0 +1,49 @@
+#pragma once
+
+#include "ConstPropagation.hpp"
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "LoopInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_set>
+#include <vector>
+
+/**
+ * 窥孔化简，用 worklist 迭代到不动点：
+ * - 常量操作数折叠（ConstFolder），可交换运算把常量放到右侧
+ * - 代数恒等式：x+0, x-0, x-x, x*0, x*1, x/1, x op= x 的比较等
+ * - 强度削弱（IR 没有移位）：x*2 -> x+x, x*-1 与 x/-1 -> 0-x
+ * - zext(i1 c) 与 0 比较还原为 c 或其反（仅整数比较）
+ * 被替换指令的使用者重新入队；fptosi/sitofp 的往返不等价，不做化简
+ **/
+class InstCombine : public Pass {
+  public:
+    InstCombine(Module *m) : Pass(m), folder_(m) {}
+
+    void run() override;
+    // the CFG stays and only pure arithmetic is rewritten
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<Dominators>();
+        pa.preserve<LoopInfo>();
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    void run_on_func(Function *func);
+    void push(Instruction *instr);
+
+    // nullptr if nothing applies, else the value replacing instr; new
+    // instructions are created right before instr
+    Value *simplify(Instruction *instr);
+    Value *simplify_ibinary(Instruction *instr);
+    Value *simplify_fbinary(Instruction *instr);
+    Value *simplify_icmp(Instruction *instr);
+    Value *simplify_zext(Instruction *instr);
+
+    ConstFolder folder_;
+    std::vector<Instruction *> work_list_;
+    std::unordered_set<Instruction *> in_work_list_;
+};
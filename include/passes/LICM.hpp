@@ -0,0 +1,42 @@
+#pragma once
+
+#include "FuncInfo.hpp"
+#include "LoopInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_set>
+
+/**
+ * 循环不变量外提：把操作数都定义在循环外的指令移到循环的 preheader。
+ * 由内向外处理循环，外提到内层 preheader 的指令还能继续外提。
+ * 只移动不会出错的指令（不含 sdiv），以及对循环内未被写过的全局变量的 load。
+ **/
+class LICM : public Pass {
+  public:
+    LICM(Module *m) : Pass(m) {}
+
+    void run() override;
+    // instructions only move between existing blocks
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<Dominators>();
+        pa.preserve<LoopInfo>();
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    void run_on_loop(Loop *loop);
+    // collect the globals written in loop into stored_globals_
+    void collect_stores(Loop *loop);
+    bool is_invariant(Loop *loop, Instruction *instr);
+    bool can_hoist(Instruction *instr);
+
+    FuncInfo *func_info_;
+    LoopInfo *loop_info_;
+
+    std::unordered_set<Value *> stored_globals_;
+    // the loop stores through a pointer of unknown base or calls an impure
+    // function, no global load can be hoisted
+    bool clobbers_all_{false};
+};
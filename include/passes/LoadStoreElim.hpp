@@ -0,0 +1,51 @@
+#pragma once
+
+#include "AliasAnalysis.hpp"
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "LoopInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+/**
+ * 冗余 load/store 消除。按逆后序遍历基本块，维护每个地址当前已知的值：
+ * store 的值转发给之后的 load，重复的 load 复用前一次的结果，写回相同值的
+ * store 被删除；块内被覆盖且之间没有读取的 store 也被删除。
+ * 所有前驱都处理过的块从前驱出口状态的交集开始（循环头从空状态开始），
+ * 调用 neg_idx_except 的块不会返回，不参与交集。
+ **/
+class LoadStoreElim : public Pass {
+  public:
+    LoadStoreElim(Module *m) : Pass(m) {}
+
+    void run() override;
+    // the CFG stays, removed memory accesses never make a function impure
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<Dominators>();
+        pa.preserve<LoopInfo>();
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    // (address, value known to be in memory there)
+    using MemoryState = std::vector<std::pair<Value *, Value *>>;
+
+    void run_on_func(Function *func);
+    MemoryState get_entry_state(BasicBlock *bb);
+    void run_on_block(BasicBlock *bb, MemoryState &state);
+    // forget whatever ptr may overwrite
+    static void clobber(MemoryState &state, Value *ptr);
+    // forget the objects a call that only writes its arguments may change
+    static void clobber_args(MemoryState &state, CallInst *call);
+
+    FuncInfo *func_info_;
+    std::unordered_map<BasicBlock *, MemoryState> out_states_;
+    // blocks ending the program, their out state is never observed
+    std::unordered_set<BasicBlock *> no_return_;
+};
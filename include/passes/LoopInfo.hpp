@@ -0,0 +1,106 @@
+#pragma once
+
+#include "BasicBlock.hpp"
+#include "Dominators.hpp"
+#include "PassManager.hpp"
+
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// a natural loop: the header and every block that reaches a back edge to it
+// without passing through the header
+class Loop {
+  public:
+    explicit Loop(BasicBlock *header) : header_(header) {}
+
+    BasicBlock *get_header() const { return header_; }
+    // the only block outside the loop branching to the header, its only
+    // successor is the header. nullptr if the header is the entry block
+    BasicBlock *get_preheader() const { return preheader_; }
+    // blocks inside the loop branching to the header
+    const std::vector<BasicBlock *> &get_latches() const { return latches_; }
+    // all blocks including those of the sub loops, in dom tree pre order so
+    // the header comes first
+    const std::vector<BasicBlock *> &get_blocks() const { return blocks_; }
+    // blocks outside the loop with a predecessor inside
+    std::vector<BasicBlock *> get_exit_blocks() const;
+
+    Loop *get_parent_loop() const { return parent_; }
+    const std::vector<Loop *> &get_sub_loops() const { return sub_loops_; }
+    // 1 for outermost loops
+    unsigned get_depth() const {
+        unsigned depth = 1;
+        for (auto loop = parent_; loop; loop = loop->parent_)
+            ++depth;
+        return depth;
+    }
+
+    bool contains(BasicBlock *bb) const { return block_set_.count(bb); }
+    bool contains(const Loop *loop) const {
+        for (; loop; loop = loop->parent_)
+            if (loop == this)
+                return true;
+        return false;
+    }
+
+  private:
+    friend class LoopInfo;
+
+    BasicBlock *header_;
+    BasicBlock *preheader_{nullptr};
+    std::vector<BasicBlock *> latches_;
+    std::vector<BasicBlock *> blocks_;
+    std::unordered_set<BasicBlock *> block_set_;
+    Loop *parent_{nullptr};
+    std::vector<Loop *> sub_loops_;
+};
+
+/**
+ * 自然循环分析：用支配关系找回边，建立循环嵌套森林。
+ * 构建时会把循环规范化：没有唯一前置块（preheader）的循环会插入一个新块，
+ * 并重新计算该函数的 Dominators，因此两者始终一致。插入了新块时报告改动，
+ * 请求 LoopInfo 的 pass 随之算作改动了 IR，其余缓存的分析结果因此失效。
+ **/
+class LoopInfo : public Pass {
+  public:
+    LoopInfo(Module *m) : Pass(m) {}
+
+    void run() override;
+
+    // the innermost loop containing bb, nullptr if none
+    Loop *get_loop_for(BasicBlock *bb) const {
+        auto it = bb_loop_.find(bb);
+        return it == bb_loop_.end() ? nullptr : it->second;
+    }
+    // 0 for blocks outside of any loop
+    unsigned get_loop_depth(BasicBlock *bb) const {
+        auto loop = get_loop_for(bb);
+        return loop ? loop->get_depth() : 0;
+    }
+    bool is_loop_header(BasicBlock *bb) const {
+        auto loop = get_loop_for(bb);
+        return loop and loop->get_header() == bb;
+    }
+
+    const std::vector<Loop *> &get_top_level_loops(Function *f) {
+        return loops_[f].top_level;
+    }
+    // inner loops come before the loops containing them
+    std::vector<Loop *> get_loops_in_post_order(Function *f);
+
+  private:
+    struct FuncLoops {
+        std::vector<std::unique_ptr<Loop>> loops;
+        std::vector<Loop *> top_level;
+    };
+
+    void run_on_func(Function *f);
+    void discover_loops(Function *f);
+    void create_preheader(Loop *loop);
+
+    Dominators *dominators_;
+    std::unordered_map<Function *, FuncLoops> loops_;
+    std::unordered_map<BasicBlock *, Loop *> bb_loop_;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "FuncInfo.hpp"
+#include "InductionVars.hpp"
+#include "LoopInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+
+/**
+ * 循环展开，处理迭代次数 T 为常数、只从循环头退出的最内层循环。
+ * 1. 完全展开：T 份循环体之和不超过 size_budget 条指令时，把循环体复制 T 份
+ *    依次相接，每份中循环头的退出判断必为真而被去掉；原循环头最后一次求值时
+ *    条件必为假，直接跳到出口，原循环体随之删除
+ * 2. 部分展开：先在循环前剥离 T % factor 次迭代，再在回边上接 factor - 1 份
+ *    循环体，副本中的退出判断同样必为真；增加的指令超过 size_budget 时减小 factor
+ * 复制出的循环头不含 phi，phi 的值直接换成上一份中回边上的值。
+ **/
+class LoopUnroll : public Pass {
+  public:
+    static constexpr unsigned default_factor = 4;
+    static constexpr unsigned default_size_budget = 256;
+
+    // factor 1 only unrolls fully, size_budget bounds the instructions the
+    // copies add to each loop
+    LoopUnroll(Module *m, unsigned factor = default_factor,
+               unsigned size_budget = default_size_budget)
+        : Pass(m), factor_(factor), size_budget_(size_budget) {}
+
+    void run() override;
+    // unrolled copies never make a function less pure
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    using ValueMap = std::unordered_map<Value *, Value *>;
+
+    // whether the loop has the shape the copies rely on
+    bool can_unroll(Loop *loop);
+    bool run_on_loop(Loop *loop, long trip_count);
+    // one iteration in new blocks, the header phis taking phi_values and
+    // its back edges going to the original header; phi_values becomes what
+    // the phis get next, latch_copy is the copy of the latch
+    BasicBlock *clone_iteration(Loop *loop, ValueMap &phi_values,
+                                BasicBlock *&latch_copy);
+    // runs the first count iterations in front of the loop
+    void peel(Loop *loop, unsigned count);
+    // factor iterations in each round of the loop
+    void unroll_partial(Loop *loop, unsigned factor);
+    void unroll_full(Loop *loop, unsigned trip_count);
+
+    unsigned factor_;
+    unsigned size_budget_;
+};
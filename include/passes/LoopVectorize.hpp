@@ -0,0 +1,55 @@
+#pragma once
+
+#include "FuncInfo.hpp"
+#include "InductionVars.hpp"
+#include "LoopInfo.hpp"
+#include "PassManager.hpp"
+
+#include <unordered_map>
+
+/**
+ * 循环向量化：把 `while (i < n)` 形式、步长为 1 的最内层计数循环每 width 次
+ * 迭代合成一次向量迭代。循环只能有循环头和一个循环体块，循环头只含归纳变量
+ * 的 phi 与退出判断，循环体只含：
+ *   - 最后一个下标为归纳变量、其余操作数循环不变的 gep，元素为 i32 或 float
+ *   - 经这些 gep 的 load 与 store
+ *   - 操作数为上述值或循环不变量的整数/浮点二元运算
+ *   - 归纳变量的自增与回边
+ * 任意两次访存中有 store 时，地址须在同一次迭代中完全相同，或经别名分析
+ * 互不别名，因此迭代之间没有依赖。
+ * 在 preheader 与循环头之间插入向量循环：剩余迭代不少于 width 次时执行
+ * 一次向量迭代，gep 经 bitcast 成向量指针后按向量 load/store，循环不变量
+ * 经入口块中的 [width x T] 数组展开成向量。原循环从向量循环停下处继续，
+ * 作为标量尾循环处理剩下的迭代。
+ * 生成的 ir 只有 -emit-llvm、-emit-lir 与 -jit 支持，不在 -O 流水线中。
+ **/
+class LoopVectorize : public Pass {
+  public:
+    static constexpr unsigned width = 4;
+
+    LoopVectorize(Module *m) : Pass(m) {}
+
+    void run() override;
+    // the new allocas are written only, no function gets less pure
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    // what vectorize() needs of a loop can_vectorize() accepted
+    struct Plan {
+        const InductionVar *iv;
+        Value *bound;
+        BasicBlock *body;
+    };
+
+    bool can_vectorize(Loop *loop, InductionVars *induction_vars, Plan &plan);
+    void vectorize(Loop *loop, const Plan &plan);
+    // the loop invariant val in every lane, made in the preheader
+    Value *get_splat(Value *val, BasicBlock *preheader);
+
+    // of the loop being vectorized
+    std::unordered_map<Value *, Value *> splats_;
+};
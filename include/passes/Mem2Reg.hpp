@@ -1,38 +1,60 @@
 #pragma once
 
 #include "Dominators.hpp"
+#include "FuncInfo.hpp"
 #include "Instruction.hpp"
 #include "Value.hpp"
 
-#include <map>
 #include <memory>
+#include <unordered_map>
+#include <vector>
 
-class Mem2Reg : public Pass {
+class Mem2Reg : public FunctionPass {
   private:
-    Function *func_;
-    std::unique_ptr<Dominators> dominators_;
-    std::map<Value *, Value *> phi_map;
-    // TODO 添加需要的变量
-
-    // 变量定值栈
-    std::map<Value *, std::vector<Value *>> var_val_stack;
-    // phi指令对应的左值(地址)
-    std::map<PhiInst *, Value *> phi_lval;
+    Dominators *dominators_;
+
+    // 一个函数的提升状态，各函数可以在不同线程上并行处理
+    struct FuncState {
+        Function *func;
+        // 被提升的局部变量(alloca)及其稠密编号，即下面各表的下标
+        std::vector<Value *> vars;
+        std::unordered_map<Value *, unsigned> var_index;
+        // 变量定值栈
+        std::vector<std::vector<Value *>> var_val_stack;
+        // phi指令对应的左值编号
+        std::unordered_map<PhiInst *, unsigned> phi_lval;
+
+        // index of a promoted variable, -1 for any other address
+        int get_var_index(Value *l_val) const {
+            auto it = var_index.find(l_val);
+            return it == var_index.end() ? -1 : static_cast<int>(it->second);
+        }
+    };
+
+    void prepare() override;
 
   public:
-    Mem2Reg(Module *m) : Pass(m) {}
+    Mem2Reg(Module *m) : FunctionPass(m) {}
     ~Mem2Reg() = default;
 
-    void run() override;
+    void run_on_func(Function *func) override;
+    // only loads/stores of allocas are rewritten, the CFG is untouched and
+    // those are no side effects for FuncInfo
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<Dominators>();
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
 
-    void generate_phi();
-    void rename(BasicBlock *bb);
+    void generate_phi(FuncState &state);
+    void rename(FuncState &state, BasicBlock *entry);
 
     static inline bool is_global_variable(Value *l_val) {
-        return dynamic_cast<GlobalVariable *>(l_val) != nullptr;
+        return l_val->is<GlobalVariable>();
     }
     static inline bool is_gep_instr(Value *l_val) {
-        return dynamic_cast<GetElementPtrInst *>(l_val) != nullptr;
+        return l_val->is<GetElementPtrInst>();
     }
 
     static inline bool is_valid_ptr(Value *l_val) {
@@ -2,35 +2,319 @@
 
 #include "Module.hpp"
 
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <iosfwd>
 #include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <typeindex>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 #include <vector>
 
+class AnalysisManager;
+class MemoryReport;
+class ThreadPool;
+
+// the set of analyses whose cached results are still valid after a pass
+class PreservedAnalyses {
+  public:
+    static PreservedAnalyses none() { return PreservedAnalyses(); }
+    static PreservedAnalyses all() {
+        PreservedAnalyses pa;
+        pa.all_ = true;
+        return pa;
+    }
+
+    template <typename AnalysisType> void preserve() {
+        preserved_.insert(std::type_index(typeid(AnalysisType)));
+    }
+    bool is_preserved(std::type_index id) const {
+        return all_ or preserved_.count(id);
+    }
+
+  private:
+    bool all_{false};
+    std::set<std::type_index> preserved_;
+};
+
 class Pass {
   public:
     Pass(Module *m) : m_(m) {}
     virtual ~Pass() = default;
     virtual void run() = 0;
 
+    // the class name unless overridden, used in reports
+    virtual std::string get_name() const;
+
+    // analyses still valid after the last run(), nothing by default
+    virtual PreservedAnalyses get_preserved() const {
+        return PreservedAnalyses::none();
+    }
+
+    void set_analysis_manager(AnalysisManager *am) { am_ = am; }
+
+    // named counters of the last run(), shown by -stats; a FunctionPass on
+    // threads adds them up in the order it would without
+    using Stats = std::vector<std::pair<std::string, long>>;
+    const Stats &get_stats() const { return stats_; }
+    void clear_stats() { stats_.clear(); }
+
+    // whether the last run() changed the ir
+    bool changed() const { return changed_; }
+    void clear_changed() { changed_ = false; }
+
   protected:
+    // may be called from the worker threads of a FunctionPass; the counters
+    // count changes to the ir, a positive delta also means set_changed()
+    void add_stat(const std::string &name, long delta = 1);
+    // for changes no counter is kept for
+    void set_changed() {
+        changed_ = true;
+        // without a PassManager there are no worker threads
+        if (not am_)
+            own_am_stale_ = true;
+    }
+
+    // the functions a transforming pass leaves alone: declarations and
+    // those frozen in the AnalysisManager
+    bool skips(Function *func) const;
+
+    // cached analysis result; a pass run outside any PassManager keeps its
+    // own, which a change it reports invalidates for later requests. The
+    // results of earlier calls stay alive as long as the pass
+    template <typename AnalysisType> AnalysisType *get_analysis();
+
+    // the pool of the PassManager (-j N), nullptr when running serially
+    ThreadPool *get_thread_pool() const;
+
     Module *m_;
+
+  private:
+    AnalysisManager *am_{nullptr};
+    std::unique_ptr<AnalysisManager> own_am_;
+    // a change was reported since the last request to own_am_
+    bool own_am_stale_{false};
+    // results of own_am_ invalidated while the pass may still hold them
+    std::vector<std::unique_ptr<Pass>> retired_;
+    Stats stats_;
+    std::mutex stats_mutex_;
+    std::atomic<bool> changed_{false};
 };
 
+/* A pass that handles every function definition on its own. With a thread
+ * pool the functions are spread over the workers: run_on_func may then only
+ * change the function it is given and must neither request analyses nor
+ * touch other pass members without a lock. prepare() and finish() run on
+ * the calling thread before and after all functions, module passes in
+ * between function passes act as barriers. */
+class FunctionPass : public Pass {
+  public:
+    using Pass::Pass;
+
+    void run() override;
+    virtual void run_on_func(Function *func) = 0;
+
+  protected:
+    // e.g. fetch the analyses run_on_func needs
+    virtual void prepare() {}
+    virtual void finish() {}
+};
+
+/* Analyses are Passes whose run() fills in results about the whole module.
+ * They are constructed and run on the first request, then served from the
+ * cache until a pass that does not preserve them has run. One that changes
+ * the ir on the way reports it with set_changed() like a transformation,
+ * the pass requesting it then counts as changing the ir. */
+class AnalysisManager {
+  public:
+    explicit AnalysisManager(Module *m) : m_(m) {}
+
+    template <typename AnalysisType> AnalysisType *get() {
+        auto &result = results_[std::type_index(typeid(AnalysisType))];
+        if (not result) {
+            result = std::make_unique<AnalysisType>(m_);
+            // analyses built on other analyses share this cache
+            result->set_analysis_manager(this);
+            result->run();
+        }
+        return static_cast<AnalysisType *>(result.get());
+    }
+
+    void set_thread_pool(ThreadPool *pool) { pool_ = pool; }
+    ThreadPool *get_thread_pool() const { return pool_; }
+
+    // -incremental: functions whose optimized body came from the cache, the
+    // transforming passes skip them while the analyses still cover them
+    void freeze(Function *func) { frozen_.insert(func); }
+    void thaw() { frozen_.clear(); }
+    bool is_frozen(Function *func) const { return frozen_.count(func); }
+
+    // the results not in pa go, into retired if given
+    void invalidate(const PreservedAnalyses &pa,
+                    std::vector<std::unique_ptr<Pass>> *retired = nullptr) {
+        for (auto it = results_.begin(); it != results_.end();) {
+            if (pa.is_preserved(it->first)) {
+                ++it;
+                continue;
+            }
+            if (retired)
+                retired->push_back(std::move(it->second));
+            it = results_.erase(it);
+        }
+    }
+
+  private:
+    Module *m_;
+    ThreadPool *pool_{nullptr};
+    std::unordered_set<Function *> frozen_;
+    std::unordered_map<std::type_index, std::unique_ptr<Pass>> results_;
+};
+
+template <typename AnalysisType> AnalysisType *Pass::get_analysis() {
+    AnalysisType *result;
+    if (am_) {
+        result = am_->get<AnalysisType>();
+    } else {
+        if (not own_am_)
+            own_am_ = std::make_unique<AnalysisManager>(m_);
+        else if (own_am_stale_)
+            own_am_->invalidate(get_preserved(), &retired_);
+        own_am_stale_ = false;
+        result = own_am_->get<AnalysisType>();
+    }
+    // the change an analysis made to the ir when it ran, see LoopInfo, is
+    // the first requester's to report
+    if (result->changed()) {
+        result->clear_changed();
+        set_changed();
+    }
+    return result;
+}
+
 class PassManager {
   public:
-    PassManager(Module *m) : m_(m) {}
+    PassManager(Module *m);
+    ~PassManager();
 
     template <typename PassType, typename... Args>
     void add_pass(Args &&...args) {
-        passes_.emplace_back(new PassType(m_, std::forward<Args>(args)...));
+        add_pass(std::make_unique<PassType>(m_, std::forward<Args>(args)...));
     }
+    void add_pass(std::unique_ptr<Pass> pass);
 
-    void run() {
-        for (auto &pass : passes_) {
-            pass->run();
-        }
+    // the passes added in between run again until none of them changes the
+    // ir, at most max_repeat times; groups may nest
+    void begin_repeat();
+    void end_repeat();
+    static constexpr unsigned max_repeat = 8;
+    // call fn at this point of the pipeline, outside of any group
+    void add_callback(std::function<void()> fn);
+
+    /* -passes: pass names separated by commas, repeat(<passes>) is a group
+     * as above, e.g. "mem2reg,dce,repeat(sccp,instcombine,dce)". A pass
+     * named twice in a row is added once. Returns the error, empty on
+     * success, in which case nothing is added. */
+    std::string add_pipeline(const std::string &text);
+    // the error add_pipeline() would return
+    static std::string check_pipeline(const std::string &text);
+    // whether a checked pipeline runs the pass named name
+    static bool pipeline_has(const std::string &text, const std::string &name);
+    // a checked pipeline cut before the first top level step, a pass or a
+    // group, that runs the pass named name; the second part is empty if
+    // none does
+    static std::pair<std::string, std::string>
+    split_pipeline(const std::string &text, const std::string &name);
+    // a checked pipeline cut after the last top level step that runs one of
+    // the passes named names; the first part is empty if none does
+    static std::pair<std::string, std::string>
+    split_pipeline_after(const std::string &text,
+                         const std::vector<std::string> &names);
+    // the pipeline of -O<level>, 0 to 2
+    static std::string level_pipeline(unsigned level);
+
+    // -j N: run function passes on N threads
+    void set_num_threads(unsigned num_threads);
+
+    // -time-passes: wall/cpu time and peak rss after each pass
+    void enable_timing(bool enable) { timing_ = enable; }
+    // -stats: IR size around each pass and the counters of the pass
+    void enable_stats(bool enable) { stats_ = enable; }
+    // -verify-each: run the Verifier before the first pass and after every
+    // pass that changed the ir
+    void enable_verify_each(bool enable) { verify_each_ = enable; }
+    // -stats: what each pass allocated in the module becomes a phase of
+    // report
+    void set_memory_report(MemoryReport *report) { memory_ = report; }
+    // see AnalysisManager::freeze(); after thaw() the passes run again even
+    // if they changed nothing before, when they skipped the frozen functions
+    void freeze(Function *func) { am_.freeze(func); }
+    void thaw() {
+        am_.thaw();
+        unchanged_at_.clear();
+    }
+    // for a callback that changed the ir behind the passes: drop the cached
+    // analyses, and the passes run again even if they changed nothing before
+    void invalidate() {
+        am_.invalidate(PreservedAnalyses::none());
+        unchanged_at_.clear();
     }
 
+    // a pass is skipped if it changed nothing when it ran last and no pass
+    // changed the ir since
+    void run();
+    // what the Verifier found wrong and at which point, empty if the ir
+    // passed every check; run() stops at the first failure
+    const std::string &get_verify_failure() const { return verify_failure_; }
+
+    void print_timing_report(std::ostream &os) const;
+    void print_stats_report(std::ostream &os) const;
+    // both reports of all passes as one JSON document
+    void print_json_report(std::ostream &os) const;
+
   private:
-    std::vector<std::unique_ptr<Pass>> passes_;
+    struct PassRecord {
+        std::string name;
+        double wall_ms{0}, cpu_ms{0};
+        long peak_rss_kb{0};
+        unsigned instrs_before{0}, instrs_after{0};
+        unsigned blocks_before{0}, blocks_after{0};
+        Pass::Stats stats;
+    };
+
+    struct Step {
+        // nullptr for the begin and the end of a repeat group and for a
+        // callback
+        std::unique_ptr<Pass> pass;
+        std::function<void()> callback;
+        // index of the end of the group it begins
+        std::size_t group_end{0};
+    };
+    // whether some pass in [begin, end) changed the ir
+    bool run_steps(std::size_t begin, std::size_t end);
+    bool run_pass(Pass *pass);
+    // sets verify_failure_ if the ir is broken, where says at which point
+    void verify(const std::string &where);
+
+    std::vector<Step> steps_;
+    // begins of the groups not yet ended
+    std::vector<std::size_t> open_groups_;
+    // counts the runs that changed the ir
+    unsigned long generation_{0};
+    // pass type -> generation_ after its last run if that changed nothing
+    std::unordered_map<std::type_index, unsigned long> unchanged_at_;
     Module *m_;
+    // declared before am_, which points to it
+    std::unique_ptr<ThreadPool> pool_;
+    AnalysisManager am_;
+    bool timing_{false};
+    bool stats_{false};
+    bool verify_each_{false};
+    MemoryReport *memory_{nullptr};
+    std::string verify_failure_;
+    std::vector<PassRecord> records_;
 };
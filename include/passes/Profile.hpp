@@ -0,0 +1,50 @@
+#pragma once
+
+#include "Module.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* -fprofile-generate and -fprofile-use, both on the ir as built, before the
+ * passes. instrument() gives every block of every definition a counter in
+ * the global array profile_counters, which holds a record
+ *     <name hash> <checksum> <number of blocks> <count>...
+ * per function, and makes main hand the array to profile_init() of the
+ * runtime, see src/io/profile.c, which writes the records at exit. The
+ * checksum hashes the cfg and the calls of each block, so a profile taken
+ * with other options still applies to the functions built alike.
+ *
+ * annotate() sets the counts of BasicBlock where name and checksum agree.
+ * Passes copying blocks pass the counts on, blocks made otherwise have
+ * none. A call runs as often as its block, so the block counts are the
+ * call counts FunctionInline weighs the call sites by, and BlockLayout
+ * orders the blocks with them. */
+class Profile {
+  public:
+    // the counters, and the call of profile_init() at the start of main
+    static void instrument(Module *m);
+
+    // false with error set if there is no profile at path
+    bool read(const std::filesystem::path &path, std::string &error);
+    // set the block counts of the functions of m found in the profile,
+    // returns their number
+    unsigned annotate(Module *m) const;
+    // of the file read, the cache keys take it
+    const std::string &get_hash() const { return hash_; }
+
+  private:
+    struct Record {
+        std::uint32_t checksum;
+        std::vector<long> counts;
+    };
+
+    // 32 bit FNV-1a
+    static std::uint32_t hash_name(const std::string &name);
+    static std::uint32_t get_checksum(Function *func);
+
+    std::unordered_map<std::uint32_t, Record> records_;
+    std::string hash_;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "FuncInfo.hpp"
+#include "Instruction.hpp"
+#include "PassManager.hpp"
+
+#include <map>
+
+/**
+ * 标量替换：局部数组的每次访问都是常量下标的 gep，且 gep 只被 load/store
+ * 用作地址时，把数组拆成每个元素一个 alloca，之后由 Mem2Reg 提升为寄存器。
+ **/
+class SROA : public Pass {
+  public:
+    SROA(Module *m) : Pass(m) {}
+
+    void run() override;
+    // only allocas and geps in the entry block change
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<Dominators>();
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    // element index accessed through gep, -1 if gep is not such an access
+    static int get_const_index(AllocaInst *alloca, GetElementPtrInst *gep);
+    bool can_split(AllocaInst *alloca);
+    void split(AllocaInst *alloca);
+};
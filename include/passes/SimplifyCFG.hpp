@@ -0,0 +1,35 @@
+#pragma once
+
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+/**
+ * 控制流图化简，对每个函数反复执行直到不再变化：
+ * 1. 条件为常量（或两个目标相同）的条件跳转改为无条件跳转
+ * 2. 删除不可达基本块
+ * 3. 合并只有唯一后继、且该后继只有唯一前驱的基本块
+ * 4. 删除只含一条无条件跳转的空块，前驱直接跳到其后继并修正 phi
+ * 前驱/后继关系由 BranchInst 的创建、修改与删除同步更新
+ **/
+class SimplifyCFG : public Pass {
+  public:
+    SimplifyCFG(Module *m) : Pass(m) {}
+
+    void run() override;
+    // removing code never makes a function less pure
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    void run_on_func(Function *func);
+    bool fold_branches(Function *func);
+    bool merge_blocks(Function *func);
+    bool remove_forwarders(Function *func);
+
+    // point the terminator of bb at to instead of from
+    bool try_merge(BasicBlock *bb);
+    bool try_remove_forwarder(BasicBlock *bb);
+};
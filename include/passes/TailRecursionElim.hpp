@@ -0,0 +1,35 @@
+#pragma once
+
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+
+#include <utility>
+#include <vector>
+
+/**
+ * 尾递归消除：函数中紧跟 `ret` 且返回其结果（或 void 调用后 `ret void`）的
+ * 自身调用改为跳回函数开头。入口块拆成两块，alloca 留在入口块，其余指令移到
+ * 新的循环头，循环头为每个参数建一个 phi，参数的使用都换成 phi；每个尾调用
+ * 块向 phi 传入调用的实参并跳到循环头。
+ * 局部数组在各次迭代间复用，所以指针实参须来自参数或全局变量，
+ * 指向本函数 alloca（或来源不明）的调用不处理。
+ **/
+class TailRecursionElim : public FunctionPass {
+  public:
+    TailRecursionElim(Module *m) : FunctionPass(m) {}
+
+    void run_on_func(Function *func) override;
+    // the calls only become jumps, no function gets less pure
+    PreservedAnalyses get_preserved() const override {
+        PreservedAnalyses pa;
+        pa.preserve<FuncInfo>();
+        return pa;
+    }
+
+  private:
+    // the self calls of func in tail position, each with its ret
+    std::vector<std::pair<CallInst *, ReturnInst *>>
+    find_tail_calls(Function *func);
+    // the entry keeps the allocas, the new header the rest of it
+    BasicBlock *split_entry(Function *func);
+};
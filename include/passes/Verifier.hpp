@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Dominators.hpp"
+#include "PassManager.hpp"
+
+#include <llvm/ADT/DenseMap.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+class SlotTracker;
+
+/**
+ * 检查 IR 的不变量，不修改 IR，发现的问题记在 get_errors() 中：
+ * 1. 操作数与 use 链一致：每个 use 都在其 user 对应的操作数上，
+ *    函数内的值的 use 都来自本函数中仍在基本块里的指令
+ * 2. 每个基本块恰好以一条终结指令结尾，后继与终结指令的目标一致，
+ *    前驱与后继互相对应，入口块没有前驱
+ * 3. phi 只出现在块首，其来源块与块的前驱一一对应（按重数）
+ * 4. 操作数的定义支配其使用，phi 的来源值支配对应的前驱块；
+ *    不可达块中的使用不检查
+ * 5. 各类指令的操作数与结果类型
+ * 支配关系每次重新计算，不依赖可能已经过期的缓存；
+ * 总的代价与 IR 的大小成线性，可以在每个 pass 之后运行（-verify-each）
+ **/
+class Verifier : public Pass {
+  public:
+    // more errors than this are counted but not described
+    static constexpr unsigned max_errors = 20;
+
+    // out of line for the unique_ptr to the incomplete SlotTracker
+    Verifier(Module *m);
+    ~Verifier() override;
+
+    void run() override;
+    PreservedAnalyses get_preserved() const override {
+        return PreservedAnalyses::all();
+    }
+
+    bool is_valid() const { return num_errors_ == 0; }
+    const std::vector<std::string> &get_errors() const { return errors_; }
+    // one error per line, with a note about the errors left out
+    std::string get_report() const;
+
+  private:
+    void verify_function(Function *func);
+    void verify_cfg(Function *func);
+    void verify_phis(BasicBlock *bb);
+    void verify_instruction(Instruction *instr);
+    void verify_types(Instruction *instr);
+    void verify_dominance(Instruction *instr);
+    // the uses of a value defined in func, or of a global when func is null
+    void verify_uses(Value *val, Function *func, unsigned &num_uses);
+
+    void error(const Value *where, const std::string &msg);
+    std::string name_of(const Value *v);
+
+    std::unique_ptr<Dominators> dominators_;
+    Function *func_{nullptr};
+    // names for the messages, built for the first error in a function
+    std::unique_ptr<SlotTracker> tracker_;
+    // by BasicBlock::get_index() of func_
+    std::vector<char> reachable_;
+    std::vector<unsigned> pred_count_, pred_used_, pred_stamp_;
+    // the phi pred_used_ counts for where pred_stamp_ equals it
+    unsigned stamp_{0};
+    // position of each instruction in its block
+    llvm::DenseMap<const Instruction *, unsigned> positions_;
+    // edges counted up from the successor lists, down from the predecessors
+    llvm::DenseMap<std::pair<const BasicBlock *, const BasicBlock *>, int>
+        edges_;
+
+    std::vector<std::string> errors_;
+    unsigned num_errors_{0};
+};
@@ -1,15 +1,16 @@
 #include "cminusf_builder.hpp"
+#include "Trace.hpp"
 
 #define CONST_FP(num) ConstantFP::get((float)num, module.get())
 #define CONST_INT(num) ConstantInt::get(num, module.get())
 
-// types
-Type *VOID_T;
-Type *INT1_T;
-Type *INT32_T;
-Type *INT32PTR_T;
-Type *FLOAT_T;
-Type *FLOATPTR_T;
+// types of the module being built, per thread for batch compilation
+thread_local Type *VOID_T;
+thread_local Type *INT1_T;
+thread_local Type *INT32_T;
+thread_local Type *INT32PTR_T;
+thread_local Type *FLOAT_T;
+thread_local Type *FLOATPTR_T;
 
 bool promote(IRBuilder *builder, Value **l_val_p, Value **r_val_p) {
     bool is_int = false;
@@ -27,6 +28,15 @@ bool promote(IRBuilder *builder, Value **l_val_p, Value **r_val_p) {
     return is_int;
 }
 
+// what reading a variable before any assignment gives
+Value *zero_value(Type *type, Module *m) {
+    if (type->is_integer_type())
+        return ConstantInt::get(0, m);
+    if (type->is_float_type())
+        return ConstantFP::get(0., m);
+    return ConstantZero::get(type, m);
+}
+
 /*
  * use CMinusfBuilder::Scope to construct scopes
  * scope.enter: enter a new scope
@@ -43,13 +53,53 @@ Value* CminusfBuilder::visit(ASTProgram &node) {
     FLOAT_T = module->get_float_type();
     FLOATPTR_T = module->get_float_ptr_type();
 
+    scope.enter();
+    for (auto &[name, func] : builtins) {
+        auto sym = node.symbols.lookup(name);
+        if (sym != SymbolTable::none)
+            scope.push(sym, func);
+    }
+
     Value *ret_val = nullptr;
     for (auto &decl : node.declarations) {
         ret_val = decl->accept(*this);
     }
+
+    if (lazy_bodies) {
+        // every name is bound now, the bodies main reaches are built
+        // one after another as their calls are built. Without a main the
+        // module is a library, every function of it may be called
+        Function *main_func = nullptr;
+        for (auto &[func, decl] : pending_bodies)
+            if (decl->id == "main")
+                main_func = func;
+        if (main_func) {
+            queue_body(main_func);
+        } else {
+            for (auto &func : module->get_functions())
+                queue_body(&func);
+        }
+        while (not body_queue.empty()) {
+            auto [decl, func] = body_queue.back();
+            body_queue.pop_back();
+            build_body(*decl, func);
+        }
+        // no built body calls the rest
+        for (auto &[func, decl] : pending_bodies)
+            module->get_functions().erase(func);
+        pending_bodies.clear();
+    }
     return ret_val;
 }
 
+void CminusfBuilder::queue_body(Function *func) {
+    auto it = pending_bodies.find(func);
+    if (it == pending_bodies.end())
+        return;
+    body_queue.emplace_back(it->second, func);
+    pending_bodies.erase(it);
+}
+
 Value* CminusfBuilder::visit(ASTNum &node) {
     if (node.type == TYPE_INT) {
         return CONST_INT(node.i_val);
@@ -73,30 +123,41 @@ Value* CminusfBuilder::visit(ASTVarDeclaration &node) {
         if (node.num == nullptr) {
             // 普通全局变量，初始化为零
             auto *global_var = GlobalVariable::create(node.id, module.get(), var_type, false, ConstantZero::get(var_type, module.get()));
-            scope.push(node.id, global_var);
+            scope.push(node.sym, global_var);
         } else {
             // 全局数组，初始化为零
             auto *array_type = ArrayType::get(var_type, node.num->i_val);
             auto *global_var = GlobalVariable::create(node.id, module.get(), array_type, false, ConstantZero::get(array_type, module.get()));
-            scope.push(node.id, global_var);
+            scope.push(node.sym, global_var);
         }
     } else {
         // 局部变量声明
         if (node.num == nullptr) {
             // 普通局部变量，使用 alloca 分配栈空间
             auto *alloca = builder->create_alloca(var_type);
-            scope.push(node.id, alloca);
+            if (direct_ssa)
+                add_ssa_var(alloca);
+            scope.push(node.sym, alloca);
         } else {
             // 局部数组，使用 alloca 分配栈空间
             auto *array_type = ArrayType::get(var_type, node.num->i_val);
             auto *alloca = builder->create_alloca(array_type);
-            scope.push(node.id, alloca);
+            scope.push(node.sym, alloca);
         }
     }
     return nullptr;
 }
 
 Value* CminusfBuilder::visit(ASTFunDeclaration &node) {
+    auto *func = declare_function(node);
+    if (lazy_bodies)
+        pending_bodies.emplace(func, &node);
+    else
+        build_body(node, func);
+    return nullptr;
+}
+
+Function *CminusfBuilder::declare_function(ASTFunDeclaration &node) {
     FunctionType *fun_type;
     Type *ret_type;
     std::vector<Type *> param_types;
@@ -125,10 +186,16 @@ Value* CminusfBuilder::visit(ASTFunDeclaration &node) {
 
     fun_type = FunctionType::get(ret_type, param_types);
     auto func = Function::create(fun_type, node.id, module.get());
-    scope.push(node.id, func);
+    scope.push(node.sym, func);
+    return func;
+}
+
+void CminusfBuilder::build_body(ASTFunDeclaration &node, Function *func) {
+    trace::Scope trace_scope("build", node.id);
     context.func = func;
     auto funBB = BasicBlock::create(module.get(), "entry", func);
     builder->set_insert_point(funBB);
+    seal_block(funBB);
     scope.enter();
     context.pre_enter_scope = true;
     std::vector<Value *> args;
@@ -138,11 +205,14 @@ Value* CminusfBuilder::visit(ASTFunDeclaration &node) {
     for (unsigned int i = 0; i < node.params.size(); ++i) {
         auto* param_i = node.params[i]->accept(*this);
         args[i]->set_name(node.params[i]->id);
-        builder->create_store(args[i], param_i);
-        scope.push(args[i]->get_name(), param_i);
+        if (is_ssa_var(param_i))
+            write_variable(param_i, funBB, args[i]);
+        else
+            builder->create_store(args[i], param_i);
+        scope.push(node.params[i]->sym, param_i);
     }
     node.compound_stmt->accept(*this);
-    if (builder->get_insert_block()->get_terminator() == nullptr) 
+    if (not builder->get_insert_block()->is_terminated())
     {
         if (context.func->get_return_type()->is_void_type())
             builder->create_void_ret();
@@ -152,11 +222,23 @@ Value* CminusfBuilder::visit(ASTFunDeclaration &node) {
             builder->create_ret(CONST_INT(0));
     }
     scope.exit();
-    return nullptr;
+    if (direct_ssa)
+        finish_ssa();
+    // declarations after the function are global again
+    context.func = nullptr;
 }
 
 Value* CminusfBuilder::visit(ASTParam &node) {
-    return nullptr;
+    // 形参的栈空间，数组形参存放的是指针
+    Type *param_type = nullptr;
+    if (node.type == TYPE_INT)
+        param_type = node.isarray ? INT32PTR_T : INT32_T;
+    else
+        param_type = node.isarray ? FLOATPTR_T : FLOAT_T;
+    auto *alloca = builder->create_alloca(param_type);
+    if (direct_ssa)
+        add_ssa_var(alloca);
+    return alloca;
 }
 
 Value* CminusfBuilder::visit(ASTCompoundStmt &node) {
@@ -209,7 +291,9 @@ Value* CminusfBuilder::visit(ASTSelectionStmt &node) {
     } else {
         falseBB = BasicBlock::create(module.get(), "", context.func);
         builder->create_cond_br(cond_val, trueBB, falseBB);
+        seal_block(falseBB);
     }
+    seal_block(trueBB);
     builder->set_insert_point(trueBB);
     node.if_statement->accept(*this);
 
@@ -227,6 +311,8 @@ Value* CminusfBuilder::visit(ASTSelectionStmt &node) {
         }
     }
 
+    // both branches are done
+    seal_block(contBB);
     builder->set_insert_point(contBB);
     return nullptr;
 }
@@ -253,6 +339,8 @@ Value* CminusfBuilder::visit(ASTIterationStmt &node) {
         bool_cond = builder->create_fcmp_ne(cond_val, CONST_FP(0.));
     }
     builder->create_cond_br(bool_cond, bodyBB, contBB);
+    seal_block(bodyBB);
+    seal_block(contBB);
     
     // 循环体基本块
     builder->set_insert_point(bodyBB);
@@ -260,6 +348,8 @@ Value* CminusfBuilder::visit(ASTIterationStmt &node) {
     if (not builder->get_insert_block()->is_terminated()) {
         builder->create_br(condBB);  // 跳回条件检查
     }
+    // 回边已知
+    seal_block(condBB);
     
     // 继续基本块
     builder->set_insert_point(contBB);
@@ -289,7 +379,7 @@ Value* CminusfBuilder::visit(ASTReturnStmt &node) {
 }
 
 Value* CminusfBuilder::visit(ASTVar &node) {
-    Value* baseAddr = this->scope.find(node.id);
+    Value* baseAddr = this->scope.find(node.sym);
     Type* alloctype = nullptr;
     
     if(baseAddr->is<AllocaInst>()) {
@@ -314,16 +404,18 @@ Value* CminusfBuilder::visit(ASTVar &node) {
         
         auto cond_neg = builder->create_icmp_ge(idx, CONST_INT(0));
         builder->create_cond_br(cond_neg,right_bb, wrong_bb);
+        seal_block(wrong_bb);
 
-        auto wrong = scope.find("neg_idx_except");
+        auto wrong = neg_idx_except_fun;
         builder->set_insert_point(wrong_bb);
         builder->create_call(wrong, {});
         builder->create_br(right_bb);
+        seal_block(right_bb);
         builder->set_insert_point(right_bb);
         
         if(context.require_lvalue) {
             if(alloctype->is_pointer_type()) {
-                baseAddr = builder->create_load(baseAddr);
+                baseAddr = load_var(baseAddr);
                 baseAddr = builder->create_gep(baseAddr,{idx});
             } else if(alloctype->is_array_type()){ 
                 baseAddr = builder->create_gep(baseAddr,{CONST_INT(0),idx});
@@ -332,7 +424,7 @@ Value* CminusfBuilder::visit(ASTVar &node) {
             return baseAddr;
         } else {
             if(alloctype->is_pointer_type()){
-                baseAddr = builder->create_load(baseAddr);
+                baseAddr = load_var(baseAddr);
                 baseAddr = builder->create_gep(baseAddr,{idx});
             } else if(alloctype->is_array_type()){ 
                 baseAddr = builder->create_gep(baseAddr,{CONST_INT(0),idx});
@@ -349,7 +441,7 @@ Value* CminusfBuilder::visit(ASTVar &node) {
             if(alloctype->is_array_type()){
                 return builder->create_gep(baseAddr, {CONST_INT(0),CONST_INT(0)});
             } else {
-                return builder->create_load(baseAddr);
+                return load_var(baseAddr);
             }
             
         }
@@ -369,7 +461,10 @@ Value* CminusfBuilder::visit(ASTAssignExpression &node) {
             expr_result = builder->create_fptosi(expr_result, INT32_T);
         }
     }
-    builder->create_store(expr_result, var_addr);
+    if (is_ssa_var(var_addr))
+        write_variable(var_addr, builder->get_insert_block(), expr_result);
+    else
+        builder->create_store(expr_result, var_addr);
     return expr_result;
 }
 
@@ -499,7 +594,9 @@ Value* CminusfBuilder::visit(ASTTerm &node) {
 }
 
 Value* CminusfBuilder::visit(ASTCall &node) {
-    auto *func = dynamic_cast<Function *>(scope.find(node.id));
+    auto *func = scope.find(node.sym)->as<Function>();
+    if (lazy_bodies)
+        queue_body(func);
     std::vector<Value *> args;
     auto param_type = func->get_function_type()->param_begin();
     for (auto &arg : node.args) {
@@ -518,3 +615,118 @@ Value* CminusfBuilder::visit(ASTCall &node) {
 
     return builder->create_call(static_cast<Function *>(func), args);
 }
+
+void CminusfBuilder::add_ssa_var(AllocaInst *var) {
+    ssa.current_def[var];
+    ssa.vars.push_back(var);
+}
+
+Value *CminusfBuilder::load_var(Value *addr) {
+    if (is_ssa_var(addr))
+        return read_variable(addr, builder->get_insert_block());
+    return builder->create_load(addr);
+}
+
+void CminusfBuilder::write_variable(Value *var, BasicBlock *bb, Value *val) {
+    ssa.current_def[var][bb] = val;
+}
+
+Value *CminusfBuilder::read_variable(Value *var, BasicBlock *bb) {
+    auto &defs = ssa.current_def[var];
+    auto it = defs.find(bb);
+    if (it == defs.end())
+        return read_variable_recursive(var, bb);
+    // trivial phis are replaced in their uses only, not in current_def
+    auto *val = it->second;
+    for (auto r = ssa.replaced.find(val); r != ssa.replaced.end();
+         r = ssa.replaced.find(val))
+        val = r->second;
+    it->second = val;
+    return val;
+}
+
+Value *CminusfBuilder::read_variable_recursive(Value *var, BasicBlock *bb) {
+    auto *type = var->as<AllocaInst>()->get_alloca_type();
+    auto &preds = bb->get_pre_basic_blocks();
+    Value *val;
+    if (not ssa.sealed.count(bb)) {
+        // 前驱未知，操作数在 seal_block 时补上
+        auto *phi = PhiInst::create_phi(type, bb);
+        bb->add_instr_begin(phi);
+        ssa.incomplete_phis[bb].push_back({var, phi});
+        val = phi;
+    } else if (preds.empty()) {
+        val = zero_value(type, module.get());
+    } else if (preds.size() == 1) {
+        val = read_variable(var, preds.front());
+    } else {
+        // 先记下 phi，经过回边的读取会找到它
+        auto *phi = PhiInst::create_phi(type, bb);
+        bb->add_instr_begin(phi);
+        write_variable(var, bb, phi);
+        val = add_phi_operands(var, phi);
+    }
+    write_variable(var, bb, val);
+    return val;
+}
+
+Value *CminusfBuilder::add_phi_operands(Value *var, PhiInst *phi) {
+    ssa.filling.insert(phi);
+    for (auto *pred : phi->get_parent()->get_pre_basic_blocks())
+        phi->add_phi_pair_operand(read_variable(var, pred), pred);
+    ssa.filling.erase(phi);
+    return try_remove_trivial_phi(phi);
+}
+
+Value *CminusfBuilder::try_remove_trivial_phi(PhiInst *phi) {
+    if (ssa.filling.count(phi) or ssa.replaced.count(phi))
+        return phi;
+    Value *same = nullptr;
+    for (auto &[val, bb] : phi->get_phi_pairs()) {
+        if (val == same or val == phi)
+            continue;
+        // merges at least two values
+        if (same != nullptr)
+            return phi;
+        same = val;
+    }
+    // only reachable through itself
+    if (same == nullptr)
+        same = zero_value(phi->get_type(), module.get());
+
+    std::vector<PhiInst *> phi_users;
+    for (auto &use : phi->get_use_list()) {
+        if (use.val_ != phi and use.val_->is<PhiInst>())
+            phi_users.push_back(use.val_->as<PhiInst>());
+    }
+    phi->replace_all_use_with(same);
+    phi->remove_all_operands();
+    phi->get_parent()->remove_instr(phi);
+    ssa.replaced[phi] = same;
+    // users that merged phi with one other value are trivial now
+    for (auto *user : phi_users)
+        try_remove_trivial_phi(user);
+    return same;
+}
+
+void CminusfBuilder::seal_block(BasicBlock *bb) {
+    if (not direct_ssa)
+        return;
+    auto it = ssa.incomplete_phis.find(bb);
+    if (it != ssa.incomplete_phis.end()) {
+        auto phis = std::move(it->second);
+        ssa.incomplete_phis.erase(it);
+        for (auto &[var, phi] : phis)
+            add_phi_operands(var, phi);
+    }
+    ssa.sealed.insert(bb);
+}
+
+void CminusfBuilder::finish_ssa() {
+    assert(ssa.incomplete_phis.empty() && "Block left unsealed");
+    for (auto *var : ssa.vars)
+        var->get_parent()->erase_instr(var);
+    for (auto &[phi, val] : ssa.replaced)
+        delete phi;
+    ssa = SSAState();
+}
@@ -0,0 +1,259 @@
+#include "cminusf_checker.hpp"
+
+void CminusfChecker::exit() {
+    while (bound.size() > scope_begin.back()) {
+        bindings[bound.back()].pop_back();
+        bound.pop_back();
+    }
+    scope_begin.pop_back();
+}
+
+bool CminusfChecker::push(Symbol sym, Binding binding) {
+    if (sym >= bindings.size())
+        bindings.resize(sym + 1);
+    auto &stack = bindings[sym];
+    binding.depth = scope_begin.size();
+    if (not stack.empty() and stack.back().depth == binding.depth)
+        return false;
+    stack.push_back(binding);
+    bound.push_back(sym);
+    return true;
+}
+
+const CminusfChecker::Binding *CminusfChecker::find(Symbol sym) const {
+    if (sym < bindings.size() and not bindings[sym].empty())
+        return &bindings[sym].back();
+    return nullptr;
+}
+
+void CminusfChecker::report(const std::string &what) {
+    if (not error.empty())
+        return;
+    if (func)
+        error = "error in function " + func->id + ": " + what;
+    else
+        error = "error: " + what;
+}
+
+CminusfChecker::Kind CminusfChecker::number(ASTNode *expr, const char *what) {
+    expr->accept(*this);
+    if (not is_number(kind))
+        report(std::string(kind == k_void ? "void value" : "array") +
+               " used as " + what);
+    return kind;
+}
+
+Value *CminusfChecker::visit(ASTProgram &node) {
+    enter();
+    // as the builder declares them
+    signatures.push_back({k_int, {}});
+    signatures.push_back({k_void, {k_int}});
+    signatures.push_back({k_void, {k_float}});
+    signatures.push_back({k_void, {}});
+    const char *names[] = {"input", "output", "outputFloat", "neg_idx_except"};
+    for (std::size_t i = 0; i < signatures.size(); i++) {
+        auto sym = node.symbols.lookup(names[i]);
+        if (sym != SymbolTable::none)
+            push(sym, {&signatures[i], k_none, 0});
+    }
+    for (auto decl : node.declarations)
+        decl->accept(*this);
+    exit();
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTNum &node) {
+    kind = node.type == TYPE_INT ? k_int : k_float;
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTVarDeclaration &node) {
+    Kind var_kind;
+    if (node.num == nullptr)
+        var_kind = node.type == TYPE_INT ? k_int : k_float;
+    else
+        var_kind = node.type == TYPE_INT ? k_int_array : k_float_array;
+    if (not push(node.sym, {nullptr, var_kind, 0}))
+        report("'" + node.id + "' is declared twice");
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTFunDeclaration &node) {
+    Signature sig;
+    if (node.type == TYPE_INT)
+        sig.ret = k_int;
+    else if (node.type == TYPE_FLOAT)
+        sig.ret = k_float;
+    else
+        sig.ret = k_void;
+    for (auto param : node.params) {
+        if (param->type == TYPE_INT)
+            sig.params.push_back(param->isarray ? k_int_array : k_int);
+        else
+            sig.params.push_back(param->isarray ? k_float_array : k_float);
+    }
+    signatures.push_back(std::move(sig));
+    if (not push(node.sym, {&signatures.back(), k_none, 0}))
+        report("'" + node.id + "' is declared twice");
+
+    func = &node;
+    func_sig = &signatures.back();
+    enter();
+    for (auto param : node.params)
+        param->accept(*this);
+    node.compound_stmt->accept(*this);
+    exit();
+    func = nullptr;
+    func_sig = nullptr;
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTParam &node) {
+    Kind param_kind;
+    if (node.type == TYPE_INT)
+        param_kind = node.isarray ? k_int_array : k_int;
+    else
+        param_kind = node.isarray ? k_float_array : k_float;
+    if (not push(node.sym, {nullptr, param_kind, 0}))
+        report("parameter '" + node.id + "' is declared twice");
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTCompoundStmt &node) {
+    enter();
+    for (auto decl : node.local_declarations)
+        decl->accept(*this);
+    for (auto stmt : node.statement_list)
+        stmt->accept(*this);
+    exit();
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTExpressionStmt &node) {
+    if (node.expression)
+        node.expression->accept(*this);
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTSelectionStmt &node) {
+    number(node.expression, "condition");
+    node.if_statement->accept(*this);
+    if (node.else_statement)
+        node.else_statement->accept(*this);
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTIterationStmt &node) {
+    number(node.expression, "condition");
+    node.statement->accept(*this);
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTReturnStmt &node) {
+    if (node.expression == nullptr) {
+        if (func_sig->ret != k_void)
+            report("return without a value");
+    } else if (func_sig->ret == k_void) {
+        report("return with a value in a void function");
+    } else {
+        number(node.expression, "return value");
+    }
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTAssignExpression &node) {
+    number(node.expression, "assigned value");
+    node.var->accept(*this);
+    if (not is_number(kind))
+        report("assignment to array '" + node.var->id + "'");
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTSimpleExpression &node) {
+    if (node.additive_expression_r == nullptr) {
+        node.additive_expression_l->accept(*this);
+        return nullptr;
+    }
+    number(node.additive_expression_l, "operand");
+    number(node.additive_expression_r, "operand");
+    // a comparison gives 0 or 1
+    kind = k_int;
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTAdditiveExpression &node) {
+    if (node.additive_expression == nullptr) {
+        node.term->accept(*this);
+        return nullptr;
+    }
+    auto l = number(node.additive_expression, "operand");
+    auto r = number(node.term, "operand");
+    kind = l == k_int and r == k_int ? k_int : k_float;
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTTerm &node) {
+    if (node.term == nullptr) {
+        node.factor->accept(*this);
+        return nullptr;
+    }
+    auto l = number(node.term, "operand");
+    auto r = number(node.factor, "operand");
+    kind = l == k_int and r == k_int ? k_int : k_float;
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTVar &node) {
+    auto binding = find(node.sym);
+    if (binding == nullptr or binding->func) {
+        report("'" + node.id + "' is " +
+               (binding ? "a function, not a variable" : "not declared"));
+        kind = k_none;
+        return nullptr;
+    }
+    auto var_kind = binding->kind;
+    if (node.expression == nullptr) {
+        kind = var_kind;
+        return nullptr;
+    }
+    number(node.expression, "index");
+    if (var_kind == k_int_array)
+        kind = k_int;
+    else if (var_kind == k_float_array)
+        kind = k_float;
+    else {
+        report("'" + node.id + "' is no array");
+        kind = k_none;
+    }
+    return nullptr;
+}
+
+Value *CminusfChecker::visit(ASTCall &node) {
+    auto binding = find(node.sym);
+    if (binding == nullptr or binding->func == nullptr) {
+        report("'" + node.id + "' is " +
+               (binding ? "a variable, not a function" : "not declared"));
+        kind = k_none;
+        return nullptr;
+    }
+    auto &sig = *binding->func;
+    if (node.args.size() != sig.params.size()) {
+        report("'" + node.id + "' takes " + std::to_string(sig.params.size()) +
+               " arguments, " + std::to_string(node.args.size()) + " given");
+    } else {
+        for (std::size_t i = 0; i < node.args.size(); i++) {
+            auto param = sig.params[i];
+            if (is_number(param)) {
+                number(node.args[i], "argument");
+                continue;
+            }
+            node.args[i]->accept(*this);
+            if (kind != param and kind != k_none)
+                report("argument " + std::to_string(i + 1) + " of '" +
+                       node.id + "' is no " +
+                       (param == k_int_array ? "int" : "float") + " array");
+        }
+    }
+    kind = sig.ret;
+    return nullptr;
+}
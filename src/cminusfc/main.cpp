@@ -1,137 +1,969 @@
 
+#include "BinaryIR.hpp"
+#include "CodeGen.hpp"
+#include "Distribute.hpp"
+#include "FunctionCache.hpp"
+#include "Interpreter.hpp"
+#include "LLParser.hpp"
+#include "MemoryReport.hpp"
 #include "Module.hpp"
 #include "PassManager.hpp"
+#include "Profile.hpp"
 #include "ast.hpp"
 #include "cminusf_builder.hpp"
-#include "PassManager.hpp"
-#include "DeadCode.hpp"
-#include "Mem2Reg.hpp"
-#include "ConstPropagation.hpp"
-#include "FunctionInline.hpp"
+#include "cminusf_checker.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#ifdef CMINUSF_JIT
+#include "OrcJIT.hpp"
+#endif
 
+#include <cassert>
+#include <cstdlib>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <llvm/Support/MemoryBuffer.h>
+#include <memory>
+#include <optional>
+#include <set>
+#include <sstream>
 #include <string>
+#include <vector>
 
 using std::string;
 using std::operator""s;
 
 struct Config {
     string exe_name; // compiler exe name
-    std::filesystem::path input_file;
-    std::filesystem::path output_file;
+    // several inputs are compiled one after another in a single process,
+    // each into its own output as if cminusfc ran on it alone
+    std::vector<std::filesystem::path> input_files;
+    std::vector<std::filesystem::path> output_files; // same index
+    std::filesystem::path output_file;               // -o, one input only
+    // --serve: read compile requests from stdin instead of files
+    bool serve{false};
+    // --worker: compile the functions a -distribute coordinator sends
+    bool worker{false};
 
     bool emitast{false};
     bool emitllvm{false};
+    // -emit-lir: binary LightIR, see BinaryIR.hpp
+    bool emitlir{false};
+    // -S: x86-64 assembly
+    bool emitasm{false};
+    // -run: interpret the module instead of writing it
+    bool run{false};
+    // -jit: the same through LLVM ORC
+    bool jit{false};
     // optization config
     bool const_prop{false};
     bool dce{false};
     bool func_inline{false};
+    bool tre{false};
+    bool ipcp{false};
+    bool globalopt{false};
+    bool gvn{false};
+    bool licm{false};
+    bool simplify_cfg{false};
+    bool sroa{false};
+    bool lse{false};
+    bool instcombine{false};
+    bool unroll{false};
+    bool bce{false};
+    // vector ir, which -S and -run do not take
+    bool vectorize{false};
+    // the builder emits ssa for scalars, no mem2reg needed before dce
+    bool ssa_builder{false};
+    // -O<level>, instead of the single pass options
+    int opt_level{-1};
+    // -passes=<pipeline>, instead of both
+    string passes;
+    // threads for function passes, or for the files of a batch
+    unsigned jobs{1};
+    // reports
+    bool time_passes{false};
+    bool stats{false};
+    std::filesystem::path report_json_file;
+    // -trace=<file>: Chrome trace JSON of the phases, see Trace.hpp
+    std::filesystem::path trace_file;
+    // check the ir after every pass that changed it
+    bool verify_each{false};
+    // llvm ir compiled before is taken from here, see cache_key()
+    std::filesystem::path cache_dir;
+    // -incremental: the optimized functions as well, see FunctionCache
+    bool incremental{false};
+    // -distribute <workers>: the function passes in worker processes, see
+    // Distribute.hpp
+    unsigned workers{0};
+    // -fprofile-generate: count the runs of the blocks, see Profile.hpp
+    bool profile_generate{false};
+    // -fprofile-use[=<file>]: the counts of such runs, read by check()
+    std::filesystem::path profile_file;
+    std::shared_ptr<const Profile> profile;
 
-    Config(int argc, char **argv) : argc(argc), argv(argv) {
+    Config(int argc, char **argv) {
+        read_args(argc, argv);
         parse_cmd_line();
         check();
     }
+    // the options of one --serve request after those the server was started
+    // with, a bad option is recorded in error instead of exiting
+    Config(const Config &server, const std::vector<string> &words);
+    string error;
+
+    // the passes to run, see PassManager::add_pipeline
+    string pipeline() const;
+    // the options that change the generated ir
+    string pipeline_options() const;
 
   private:
-    int argc{-1};
-    char **argv{nullptr};
+    std::vector<string> args;
+    bool in_request{false};
 
+    // argv with every @<file> replaced by the whitespace separated words
+    // in that file
+    void read_args(int argc, char **argv);
     void parse_cmd_line();
     void check();
+    // the pipeline without the passes of the profile
+    string base_pipeline() const;
+    void check_request();
     // print helper infomation and exit
     void print_help() const;
-    void print_err(const string &msg) const;
+    void print_err(const string &msg);
 };
 
-int main(int argc, char **argv) {
-    Config config(argc, argv);
+// the pipeline on m, the reports of the passes go to report_os and with
+// -stats every pass to memory as well. With cache the functions found there
+// skip the passes it covers. Broken ir found by -verify-each is a compiler
+// bug, reported before exiting
+void run_passes(const Config &config, Module *m, unsigned pass_threads,
+                std::ostream &report_os, MemoryReport &memory,
+                FunctionCache *cache = nullptr) {
+    if (config.profile_generate)
+        Profile::instrument(m);
+    unsigned num_annotated = config.profile ? config.profile->annotate(m) : 0;
+    PassManager PM(m);
+    PM.set_num_threads(pass_threads);
+    PM.enable_timing(config.time_passes or not config.report_json_file.empty());
+    PM.enable_stats(config.stats or not config.report_json_file.empty());
+    PM.enable_verify_each(config.verify_each);
+    if (config.stats)
+        PM.set_memory_report(&memory);
+    std::unique_ptr<Distributor> distributor;
+    if (cache) {
+        auto [cached, rest] =
+            PassManager::split_pipeline(config.pipeline(), "ipcp");
+        cache->load(m, PM);
+        PM.add_pipeline(cached);
+        PM.add_callback([&] {
+            cache->store(m);
+            PM.thaw();
+        });
+        PM.add_pipeline(rest);
+    } else if (config.workers > 0) {
+        auto parts = Distributor::split_pipeline(config.pipeline());
+        distributor = std::make_unique<Distributor>(config.workers);
+        PM.add_pipeline(parts.module);
+        PM.add_callback([&, functions = parts.functions] {
+            distributor->run(m, functions);
+            PM.invalidate();
+        });
+        PM.add_pipeline(parts.rest);
+    } else {
+        auto error = PM.add_pipeline(config.pipeline());
+        assert(error.empty() && "Pipeline not checked");
+    }
+    PM.run();
+    if (not PM.get_verify_failure().empty()) {
+        std::cerr << "[ERR] " << PM.get_verify_failure();
+        std::exit(1);
+    }
+    if (config.time_passes)
+        PM.print_timing_report(report_os);
+    if (config.stats)
+        PM.print_stats_report(report_os);
+    if (config.stats and cache)
+        report_os << "===--- Function cache ---===\n"
+                  << cache->get_num_hits() << " of "
+                  << cache->get_num_functions()
+                  << " functions taken from the cache\n";
+    if (config.stats and distributor)
+        report_os << "===--- Distribution ---===\n"
+                  << distributor->get_num_remote() << " of "
+                  << distributor->get_num_functions()
+                  << " functions compiled by "
+                  << distributor->get_num_workers() << " workers\n";
+    if (config.stats and config.profile) {
+        unsigned num_functions = 0;
+        for (auto &func : m->get_functions())
+            num_functions += not func.is_declaration();
+        report_os << "===--- Profile ---===\n"
+                  << num_annotated << " of " << num_functions
+                  << " functions have counts\n";
+    }
+    if (not config.report_json_file.empty()) {
+        std::ofstream report(config.report_json_file);
+        PM.print_json_report(report);
+    }
+}
 
-    auto syntax_tree = parse(config.input_file.c_str());
-    auto ast = AST(syntax_tree);
+// write m to output_os or execute it. Returns the exit status of the program
+// with -run, 0 otherwise
+int emit_module(const Config &config, Module *m, std::ostream &output_os) {
+    if (config.emitllvm) {
+        trace::Scope scope("print");
+        m->print(output_os);
+    }
+    if (config.emitlir) {
+        trace::Scope scope("write-lir");
+        write_binary_ir(m, output_os);
+    }
+    if (config.emitasm) {
+        trace::Scope scope("codegen");
+        CodeGen codegen(m);
+        codegen.run(output_os);
+    }
+    if (config.run) {
+        Interpreter interpreter(m);
+        return interpreter.run();
+    }
+#ifdef CMINUSF_JIT
+    if (config.jit) {
+        OrcJIT jit(m);
+        return jit.run();
+    }
+#endif
+    return 0;
+}
+
+// emit_module(), then with -stats the output as the last phase of memory
+// and the memory report to report_os
+int emit_module(const Config &config, Module *m, std::ostream &output_os,
+                MemoryReport &memory, std::ostream &report_os) {
+    auto values = m->get_num_values(), bytes = m->get_value_bytes();
+    auto status = emit_module(config, m, output_os);
+    if (config.stats) {
+        memory.add_phase("output", m->get_num_values() - values,
+                         m->get_value_bytes() - bytes);
+        memory.print(report_os);
+    }
+    return status;
+}
+
+// the ast (-emit-ast) or the module of one parsed input goes to output_os,
+// the reports of the passes to report_os, and with binary_ir the module
+// after the passes in binary LightIR there. Returns what emit_module() does,
+// nothing after a semantic error, which goes to report_os
+std::optional<int> compile_tree(const Config &config, syntax_tree *tree,
+                 unsigned pass_threads, std::ostream &output_os,
+                 std::ostream &report_os, string *binary_ir = nullptr,
+                 FunctionCache *cache = nullptr) {
+    // the tree is gone with the AST built
+    MemoryReport memory;
+    if (config.stats) {
+        std::size_t bytes, nodes;
+        syntax_tree_memory(tree, &bytes, &nodes);
+        memory.add_phase("syntax tree", nodes, bytes);
+    }
+    auto ast = [&] {
+        trace::Scope scope("ast");
+        return AST(tree);
+    }();
+    if (config.stats)
+        memory.add_phase("ast", ast.get_num_nodes(), ast.get_block_bytes());
 
     if (config.emitast) { // if emit ast (lab1), print ast and return
+        // the printer writes to stdout
+        auto *stdout_buf = std::cout.rdbuf(output_os.rdbuf());
         ASTPrinter printer;
         ast.run_visitor(printer);
-    } else {
-        std::unique_ptr<Module> m;
-        CminusfBuilder builder;
-        ast.run_visitor(builder);
-        m = builder.getModule();
+        std::cout.rdbuf(stdout_buf);
+        return 0;
+    }
+    CminusfChecker checker;
+    ast.run_visitor(checker);
+    if (not checker.get_error().empty()) {
+        report_os << checker.get_error() << "\n";
+        return std::nullopt;
+    }
+    // with dce in the pipeline the functions main does not reach are left
+    // out, -O0 output keeps them
+    CminusfBuilder builder(config.ssa_builder,
+                           PassManager::pipeline_has(config.pipeline(), "dce"));
+    ast.run_visitor(builder);
+    auto m = builder.getModule();
+    if (config.stats)
+        memory.add_phase("ir build", m->get_num_values(), m->get_value_bytes());
+    run_passes(config, m.get(), pass_threads, report_os, memory, cache);
+    if (binary_ir) {
+        std::ostringstream binary;
+        write_binary_ir(m.get(), binary);
+        *binary_ir = binary.str();
+    }
+    return emit_module(config, m.get(), output_os, memory, report_os);
+}
+
+// .lir and .ll inputs skip the front end, the passes still run on them
+bool is_ir_file(const std::filesystem::path &file) {
+    return file.extension() == ".lir" or file.extension() == ".ll";
+}
+
+// a module in binary LightIR, nullptr if the file is missing, no such
+// module or broken. The file is mapped rather than read where the system
+// allows
+std::unique_ptr<Module> read_lir_file(const std::filesystem::path &file) {
+    auto buffer = llvm::MemoryBuffer::getFile(file.string(), false, false);
+    if (not buffer)
+        return nullptr;
+    BinaryIRReader reader((*buffer)->getBufferStart(),
+                          (*buffer)->getBufferSize());
+    auto m = reader.read_module();
+    if (m == nullptr or not reader.materialize_all())
+        return nullptr;
+    return m;
+}
+
+// the module in a .lir or .ll input, nullptr after telling report_os why
+// there is none
+std::unique_ptr<Module> read_ir_file(const std::filesystem::path &file,
+                                     std::ostream &report_os) {
+    trace::Scope scope("read-ir");
+    if (file.extension() == ".lir") {
+        auto m = read_lir_file(file);
+        if (m == nullptr)
+            report_os << "[ERR] " << file.string()
+                      << " is no binary LightIR of this compiler or broken.\n";
+        return m;
+    }
+    auto buffer = llvm::MemoryBuffer::getFile(file.string(), false, false);
+    if (not buffer) {
+        report_os << "[ERR] Open input file " << file.string() << " failed.\n";
+        return nullptr;
+    }
+    string error;
+    auto m = parse_ll((*buffer)->getBufferStart(), (*buffer)->getBufferSize(),
+                      error);
+    if (m == nullptr)
+        report_os << "[ERR] " << file.string() << ":" << error << "\n";
+    return m;
+}
+
+// why the parser gave no tree for file: a syntax error goes after the name
+// of the file like the errors in .ll input, an open failure names it
+void report_parse_error(std::ostream &report_os,
+                        const std::filesystem::path &file,
+                        const parse_context &ctx) {
+    if (ctx.open_failed)
+        report_os << ctx.error_message << "\n";
+    else
+        report_os << "[ERR] " << file.string() << ": " << ctx.error_message
+                  << "\n";
+}
 
-        PassManager PM(m.get());
-        // optimization 
-        if(config.dce) {
-            PM.add_pass<Mem2Reg>();
-            PM.add_pass<DeadCode>();
+void print_llvm_header(std::ostream &os,
+                       const std::filesystem::path &source_file) {
+    os << "; ModuleID = 'cminus'\n";
+    os << "source_filename = " << source_file << "\n\n";
+}
+
+// the pipeline options and the size and time of the compiler binary, so
+// that a rebuilt compiler starts over
+string compile_context(const Config &config) {
+    std::error_code ec;
+    auto exe_size = std::filesystem::file_size("/proc/self/exe", ec);
+    auto exe_time = std::filesystem::last_write_time("/proc/self/exe", ec);
+    std::ostringstream context;
+    context << exe_size << ' ' << exe_time.time_since_epoch().count() << ' '
+            << config.pipeline_options();
+    return context.str();
+}
+
+/* -cache-dir: the module after the passes is stored as <dir>/<key>.lir in
+ * binary LightIR and mapped back on a hit, so one entry serves -emit-llvm,
+ * -emit-lir and -S alike. The key hashes the source and the compile
+ * context, see FunctionCache::write_entry() for how entries are written. */
+string cache_key(const Config &config, const string &source) {
+    return FunctionCache::hash(compile_context(config) + '\n' + source);
+}
+
+// compile a single input file, false after an error in the source or bad ir
+bool compile(const Config &config, const std::filesystem::path &input_file,
+             const std::filesystem::path &output_file, unsigned pass_threads,
+             std::ostream &report_os) {
+    if (is_ir_file(input_file)) {
+        auto m = read_ir_file(input_file, report_os);
+        if (m == nullptr)
+            return false;
+        MemoryReport memory;
+        if (config.stats)
+            memory.add_phase("read ir", m->get_num_values(),
+                             m->get_value_bytes());
+        run_passes(config, m.get(), pass_threads, report_os, memory);
+        std::ofstream output_stream(output_file, std::ios::binary);
+        if (config.emitllvm)
+            print_llvm_header(output_stream,
+                              std::filesystem::canonical(input_file));
+        emit_module(config, m.get(), output_stream, memory, report_os);
+        return true;
+    }
+
+    bool use_cache = not config.cache_dir.empty() and not config.emitast;
+    string source, key;
+    if (use_cache) {
+        std::ifstream input(input_file, std::ios::binary);
+        if (not input) {
+            report_os << "[ERR] Open input file " << input_file.string()
+                      << " failed.\n";
+            return false;
+        }
+        source.assign(std::istreambuf_iterator<char>(input),
+                      std::istreambuf_iterator<char>());
+        key = cache_key(config, source);
+        // the reports need the passes to run
+        if (not config.time_passes and not config.stats and
+            config.report_json_file.empty()) {
+            if (auto m = read_lir_file(config.cache_dir / (key + ".lir"))) {
+                std::ofstream output_stream(output_file, std::ios::binary);
+                if (config.emitllvm)
+                    print_llvm_header(output_stream,
+                                      std::filesystem::canonical(input_file));
+                emit_module(config, m.get(), output_stream);
+                return true;
+            }
         }
+    }
+
+    parse_context ctx;
+    syntax_tree *tree = [&] {
+        trace::Scope scope("parse");
+        if (not use_cache)
+            return parse_file(&ctx, input_file.c_str());
+        auto size = source.size();
+        source.append(2, '\0');
+        return parse_in_place(&ctx, source.data(), size);
+    }();
+    if (tree == nullptr) {
+        report_parse_error(report_os, input_file, ctx);
+        return false;
+    }
 
-        if(config.func_inline) {
-            PM.add_pass<FunctionInline>();
-            PM.add_pass<DeadCode>();
+    if (config.emitast) {
+        compile_tree(config, tree, pass_threads, std::cout, report_os);
+        return true;
+    }
+    std::ofstream output_stream(output_file, std::ios::binary);
+    if (config.emitllvm)
+        print_llvm_header(output_stream,
+                          std::filesystem::canonical(input_file));
+    string binary_ir;
+    std::unique_ptr<FunctionCache> cache;
+    if (use_cache and config.incremental)
+        cache = std::make_unique<FunctionCache>(config.cache_dir,
+                                                compile_context(config));
+    if (not compile_tree(config, tree, pass_threads, output_stream, report_os,
+                         use_cache ? &binary_ir : nullptr, cache.get())) {
+        output_stream.close();
+        std::error_code ec;
+        std::filesystem::remove(output_file, ec);
+        return false;
+    }
+    if (use_cache)
+        FunctionCache::write_entry(config.cache_dir, key, binary_ir);
+    return true;
+}
+
+// -run, -jit: compile the single input and execute it, the exit status is
+// that of the program, or 1 after an error in the source or bad ir
+int run(const Config &config) {
+    auto &input_file = config.input_files[0];
+    if (is_ir_file(input_file)) {
+        auto m = read_ir_file(input_file, std::cerr);
+        if (m == nullptr)
+            return 1;
+        MemoryReport memory;
+        if (config.stats)
+            memory.add_phase("read ir", m->get_num_values(),
+                             m->get_value_bytes());
+        run_passes(config, m.get(), config.jobs, std::cerr, memory);
+        return emit_module(config, m.get(), std::cout, memory, std::cerr);
+    }
+    parse_context ctx;
+    syntax_tree *tree = [&] {
+        trace::Scope scope("parse");
+        return parse_file(&ctx, input_file.c_str());
+    }();
+    if (tree == nullptr) {
+        report_parse_error(std::cerr, input_file, ctx);
+        return 1;
+    }
+    return compile_tree(config, tree, config.jobs, std::cout, std::cerr)
+        .value_or(1);
+}
+
+/* --serve: answer compile requests from stdin one after another, so that
+ * editors and judges need not start a compiler per source. A request is
+ *     compile <name> [<option>...]\n<length>\n<length bytes of source>
+ * with the options of the command line after those the server was started
+ * with, but no files, -o or -report-json. The reply on stdout is
+ *     ok <output length> <report length>\n<output><report>
+ * holding the ast, llvm ir or assembly and the -time-passes/-stats reports, or
+ *     error <length>\n<message>
+ * for a bad request or a syntax or semantic error in the source.
+ * The requests end with stdin or a line "quit". Each gets a module of its
+ * own, so no ir nor constants are kept from one request to the next. */
+int serve(const Config &config) {
+    auto reply_error = [](const string &msg) {
+        std::cout << "error " << msg.size() << "\n" << msg << std::flush;
+    };
+    string line;
+    while (std::getline(std::cin, line)) {
+        std::istringstream header(line);
+        string command, name, word;
+        std::vector<string> words;
+        header >> command >> name;
+        while (header >> word)
+            words.push_back(word);
+        if (command.empty())
+            continue;
+        if (command == "quit")
+            break;
+        if (command != "compile" or name.empty()) {
+            reply_error("bad request '" + line + "'");
+            continue;
         }
 
-        if(config.const_prop) {
-            PM.add_pass<Mem2Reg>();
-            PM.add_pass<DeadCode>();
-            PM.add_pass<ConstPropagation>();
-            PM.add_pass<DeadCode>();
+        string length_line;
+        if (not std::getline(std::cin, length_line))
+            break;
+        char *end;
+        auto length = std::strtoul(length_line.c_str(), &end, 10);
+        if (length_line.empty() or *end != '\0') {
+            reply_error("bad source length '" + length_line + "'");
+            continue;
+        }
+        // with the two NULs parse_in_place() needs
+        string source(length + 2, '\0');
+        if (not std::cin.read(source.data(), length))
+            break;
+
+        Config request(config, words);
+        if (not request.error.empty()) {
+            reply_error(request.error);
+            continue;
+        }
+        parse_context ctx;
+        syntax_tree *tree = [&] {
+            trace::Scope scope("parse");
+            return parse_in_place(&ctx, source.data(), length);
+        }();
+        if (tree == nullptr) {
+            string msg = ctx.error_message;
+            reply_error(msg.empty() ? "syntax error" : msg);
+            continue;
         }
-        PM.run();
 
-        std::ofstream output_stream(config.output_file);
-        if (config.emitllvm) {
-            auto abs_path = std::filesystem::canonical(config.input_file);
-            output_stream << "; ModuleID = 'cminus'\n";
-            output_stream << "source_filename = " << abs_path << "\n\n";
-            output_stream << m->print();
-        } 
+        std::ostringstream output, report;
+        if (request.emitllvm and not request.emitast)
+            print_llvm_header(output, name);
+        if (not compile_tree(request, tree, request.jobs, output, report)) {
+            // the message and its newline are all of the report then
+            auto msg = report.str();
+            msg.pop_back();
+            reply_error(msg);
+            continue;
+        }
+        auto output_str = output.str(), report_str = report.str();
+        std::cout << "ok " << output_str.size() << " " << report_str.size()
+                  << "\n"
+                  << output_str << report_str << std::flush;
+    }
+    return 0;
+}
+
+// what main() does for config, apart from the trace
+int run_config(const Config &config) {
+    if (config.worker)
+        return Distributor::serve_worker();
+    if (config.serve)
+        return serve(config);
+    if (config.run or config.jit)
+        return run(config);
+
+    auto num_files = config.input_files.size();
+    if (num_files == 1) {
+        return compile(config, config.input_files[0], config.output_files[0],
+                       config.jobs, std::cerr)
+                   ? 0
+                   : 1;
     }
 
+    // a batch: with -j the files are spread over the threads, one module
+    // per thread, and the reports are printed in input order afterwards.
+    // The ast printer writes to stdout directly, so it stays serial.
+    std::vector<std::ostringstream> reports(num_files);
+    std::vector<char> compiled(num_files);
+    ThreadPool pool(config.emitast ? 1 : config.jobs);
+    pool.parallel_for(num_files, [&](std::size_t i) {
+        compiled[i] = compile(config, config.input_files[i],
+                              config.output_files[i], 1, reports[i]);
+    });
+    for (std::size_t i = 0; i < num_files; i++) {
+        if (reports[i].tellp() > 0)
+            std::cerr << "===--- " << config.input_files[i].string()
+                      << " ---===\n"
+                      << reports[i].str();
+    }
+    for (auto ok : compiled) {
+        if (not ok)
+            return 1;
+    }
     return 0;
 }
 
-void Config::parse_cmd_line() {
+int main(int argc, char **argv) {
+    Config config(argc, argv);
+    if (config.trace_file.empty())
+        return run_config(config);
+    trace::start();
+    int status = run_config(config);
+    std::ofstream trace_os(config.trace_file);
+    trace::write(trace_os);
+    return status;
+}
+
+Config::Config(const Config &server, const std::vector<string> &words)
+    : exe_name(server.exe_name), in_request(true) {
+    for (auto &arg : server.args) {
+        if (arg != "--serve"s)
+            args.push_back(arg);
+    }
+    args.insert(args.end(), words.begin(), words.end());
+    parse_cmd_line();
+    check_request();
+}
+
+void Config::read_args(int argc, char **argv) {
     exe_name = argv[0];
     for (int i = 1; i < argc; ++i) {
-        if (argv[i] == "-h"s || argv[i] == "--help"s) {
+        if (argv[i][0] != '@') {
+            args.emplace_back(argv[i]);
+            continue;
+        }
+        std::ifstream response_file(argv[i] + 1);
+        if (not response_file)
+            print_err("cannot open response file '"s + (argv[i] + 1) + "'");
+        string word;
+        while (response_file >> word)
+            args.push_back(word);
+    }
+}
+
+void Config::parse_cmd_line() {
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        if (in_request and args[i][0] != '-') {
+            print_err("no input files in a request");
+        } else if (in_request and
+                   (args[i] == "-h"s || args[i] == "--help"s ||
+                    args[i] == "-o"s || args[i] == "-report-json"s ||
+                    args[i] == "-cache-dir"s || args[i] == "-incremental"s ||
+                    args[i] == "-distribute"s || args[i] == "--serve"s ||
+                    args[i] == "--worker"s ||
+                    args[i] == "-run"s || args[i] == "-jit"s ||
+                    args[i].rfind("-trace="s, 0) == 0)) {
+            print_err("\'"s + args[i] + "\' is not allowed in a request");
+        } else if (args[i] == "-h"s || args[i] == "--help"s) {
             print_help();
-        } else if (argv[i] == "-o"s) {
-            if (output_file.empty() && i + 1 < argc) {
-                output_file = argv[i + 1];
+        } else if (args[i] == "-o"s) {
+            if (output_file.empty() && i + 1 < args.size()) {
+                output_file = args[i + 1];
                 i += 1;
             } else {
                 print_err("bad output file");
             }
-        } else if (argv[i] == "-emit-ast"s) {
+        } else if (args[i] == "--serve"s) {
+            serve = true;
+        } else if (args[i] == "--worker"s) {
+            worker = true;
+        } else if (args[i] == "-emit-ast"s) {
             emitast = true;
-        } else if (argv[i] == "-emit-llvm"s) {
+        } else if (args[i] == "-emit-llvm"s) {
             emitllvm = true;
-        } else if (argv[i] == "-dce"s) {
+        } else if (args[i] == "-emit-lir"s) {
+            emitlir = true;
+        } else if (args[i] == "-S"s) {
+            emitasm = true;
+        } else if (args[i] == "-run"s) {
+            run = true;
+        } else if (args[i] == "-jit"s) {
+#ifdef CMINUSF_JIT
+            jit = true;
+#else
+            print_err("-jit is not built in, configure with -DCMINUSF_JIT=ON");
+#endif
+        } else if (args[i] == "-dce"s) {
             dce = true;
-        } else if (argv[i] == "-const-prop"s) {
+        } else if (args[i] == "-const-prop"s) {
             const_prop = true;
-        } else if (argv[i] == "-func-inline"s) {
+        } else if (args[i] == "-func-inline"s) {
             func_inline = true;
-        } else {
-            if (input_file.empty()) {
-                input_file = argv[i];
+        } else if (args[i] == "-gvn"s) {
+            gvn = true;
+        } else if (args[i] == "-licm"s) {
+            licm = true;
+        } else if (args[i] == "-simplify-cfg"s) {
+            simplify_cfg = true;
+        } else if (args[i] == "-sroa"s) {
+            sroa = true;
+        } else if (args[i] == "-lse"s) {
+            lse = true;
+        } else if (args[i] == "-instcombine"s) {
+            instcombine = true;
+        } else if (args[i] == "-unroll"s) {
+            unroll = true;
+        } else if (args[i] == "-vectorize"s) {
+            vectorize = true;
+        } else if (args[i] == "-globalopt"s) {
+            globalopt = true;
+        } else if (args[i] == "-ipcp"s) {
+            ipcp = true;
+        } else if (args[i] == "-tre"s) {
+            tre = true;
+        } else if (args[i] == "-bce"s) {
+            bce = true;
+        } else if (args[i] == "-ssa-builder"s) {
+            ssa_builder = true;
+        } else if (args[i] == "-O0"s || args[i] == "-O1"s || args[i] == "-O2"s) {
+            opt_level = args[i][2] - '0';
+            // the optimizing levels get ssa from the builder
+            if (opt_level > 0)
+                ssa_builder = true;
+        } else if (args[i].rfind("-passes="s, 0) == 0) {
+            passes = args[i].substr(8);
+        } else if (args[i] == "-j"s) {
+            if (i + 1 < args.size() && std::atoi(args[i + 1].c_str()) > 0) {
+                jobs = std::atoi(args[i + 1].c_str());
+                i += 1;
+            } else {
+                print_err("bad number of jobs");
+            }
+        } else if (args[i] == "-cache-dir"s) {
+            if (cache_dir.empty() && i + 1 < args.size()) {
+                cache_dir = args[i + 1];
+                i += 1;
+            } else {
+                print_err("bad cache directory");
+            }
+        } else if (args[i] == "-incremental"s) {
+            incremental = true;
+        } else if (args[i] == "-distribute"s) {
+            if (i + 1 < args.size() && std::atoi(args[i + 1].c_str()) > 0) {
+                workers = std::atoi(args[i + 1].c_str());
+                i += 1;
+            } else {
+                print_err("bad number of workers");
+            }
+        } else if (args[i] == "-fprofile-generate"s) {
+            profile_generate = true;
+        } else if (args[i] == "-fprofile-use"s) {
+            profile_file = "cminusf.profile";
+        } else if (args[i].rfind("-fprofile-use="s, 0) == 0) {
+            profile_file = args[i].substr(14);
+            if (profile_file.empty())
+                print_err("bad profile file");
+        } else if (args[i] == "-time-passes"s) {
+            time_passes = true;
+        } else if (args[i] == "-stats"s) {
+            stats = true;
+        } else if (args[i].rfind("-trace="s, 0) == 0) {
+            trace_file = args[i].substr(7);
+            if (trace_file.empty())
+                print_err("bad trace file");
+        } else if (args[i] == "-verify-each"s) {
+            verify_each = true;
+        } else if (args[i] == "-report-json"s) {
+            if (report_json_file.empty() && i + 1 < args.size()) {
+                report_json_file = args[i + 1];
+                i += 1;
             } else {
-                string err =
-                    "unrecognized command-line option \'"s + argv[i] + "\'"s;
-                print_err(err);
+                print_err("bad report file");
             }
+        } else if (args[i][0] == '-') {
+            string err =
+                "unrecognized command-line option \'"s + args[i] + "\'"s;
+            print_err(err);
+        } else {
+            input_files.emplace_back(args[i]);
         }
     }
 }
 
 void Config::check() {
-    if (input_file.empty()) {
+    if (worker) {
+        // the coordinator sends everything else
+        if (args.size() != 1)
+            print_err("--worker takes no other options");
+        return;
+    }
+    if (incremental and cache_dir.empty()) {
+        print_err("-incremental needs -cache-dir");
+    }
+    // the function cache keeps no block counts
+    if (incremental and (profile_generate or not profile_file.empty())) {
+        print_err("-incremental does not mix with -fprofile-generate or "
+                  "-fprofile-use");
+    }
+    // both put other bodies in place of those the passes made
+    if (incremental and workers > 0) {
+        print_err("-incremental does not mix with -distribute");
+    }
+    // the workers get no block counts
+    if (workers > 0 and not profile_file.empty()) {
+        print_err("-distribute does not mix with -fprofile-use");
+    }
+    if (serve) {
+        if (not input_files.empty() or not output_file.empty() or
+            not report_json_file.empty() or not cache_dir.empty() or run or
+            jit) {
+            print_err("--serve reads its sources from the requests");
+        }
+        if (workers > 0) {
+            print_err("--serve does not mix with -distribute");
+        }
+        check_request();
+        return;
+    }
+    if (input_files.empty()) {
         print_err("no input file");
     }
-    if (input_file.extension() != ".cminus") {
-        print_err("file format not recognized");
+    for (auto &input_file : input_files) {
+        if (input_file.extension() != ".cminus" and
+            not is_ir_file(input_file)) {
+            print_err("file format not recognized");
+        }
+        if (emitast and is_ir_file(input_file)) {
+            print_err("-emit-ast needs .cminus inputs");
+        }
+    }
+    if (input_files.size() > 1 && not output_file.empty()) {
+        print_err("-o needs a single input file");
+    }
+    if (input_files.size() > 1 && not report_json_file.empty()) {
+        print_err("-report-json needs a single input file");
+    }
+    if ((run || jit) && (input_files.size() > 1 || not output_file.empty())) {
+        print_err("-run and -jit need a single input file and no -o");
+    }
+    check_request();
+    if (not output_file.empty()) {
+        output_files.push_back(output_file);
+        return;
+    }
+    std::set<std::filesystem::path> seen;
+    for (auto &input_file : input_files) {
+        auto output = input_file.stem();
+        if (emitllvm) {
+            output.replace_extension(".ll");
+        } else if (emitlir) {
+            output.replace_extension(".lir");
+        } else if (emitasm) {
+            output.replace_extension(".s");
+        }
+        if (output == input_file) {
+            print_err("the output would overwrite " + input_file.string());
+        }
+        if (not seen.insert(output).second) {
+            print_err("several inputs would be written to " +
+                      output.string());
+        }
+        output_files.push_back(output);
+    }
+}
+
+string Config::pipeline() const {
+    auto result = base_pipeline();
+    // the counts order the blocks once the other passes are done with them
+    if (profile_file.empty() or
+        PassManager::pipeline_has(result, "block-layout"))
+        return result;
+    return result.empty() ? "block-layout" : result + ",block-layout";
+}
+
+string Config::base_pipeline() const {
+    if (not passes.empty())
+        return passes;
+    if (opt_level >= 0)
+        return PassManager::level_pipeline(opt_level);
+    // the single pass options in their fixed order
+    std::pair<bool, const char *> options[] = {
+        {dce, ssa_builder ? "dce" : "mem2reg,dce"},
+        // before inline so that former self calls can be inlined
+        {tre, "tre,dce"},
+        {func_inline, "inline,dce"},
+        // before mem2reg so that the globals made local are promoted
+        {globalopt, "globalopt,mem2reg,dce"},
+        {const_prop, "mem2reg,dce,sccp,dce"},
+        {ipcp, "mem2reg,dce,ipcp,sccp,dce"},
+        // after const-prop so that computed indices are folded already
+        {sroa, "sroa,mem2reg,dce"},
+        {lse, "lse,dce"},
+        {instcombine, "instcombine,dce"},
+        {simplify_cfg, "simplify-cfg,dce"},
+        {gvn, "gvn,dce"},
+        {licm, "licm,dce"},
+        {unroll, "unroll,sccp,simplify-cfg,dce"},
+        {bce, "bce,simplify-cfg,dce"},
+        // last, the other passes leave vector instructions alone; the loops
+        // as built have their bounds checks and exit tests to clear first
+        {vectorize, "bce,instcombine,simplify-cfg,dce,vectorize,dce"},
+    };
+    string result;
+    for (auto &[enabled, steps] : options) {
+        if (enabled)
+            result += result.empty() ? steps : ","s + steps;
+    }
+    return result;
+}
+
+string Config::pipeline_options() const {
+    auto options =
+        (ssa_builder ? "-ssa-builder -passes="s : "-passes="s) + pipeline();
+    if (profile_generate)
+        options += " -fprofile-generate";
+    if (profile)
+        options += " -fprofile-use=" + profile->get_hash();
+    // the same output with any number of workers
+    if (workers > 0)
+        options += " -distribute";
+    return options;
+}
+
+// the options every compilation checks, with or without input files
+void Config::check_request() {
+    bool pass_options = dce or const_prop or func_inline or gvn or licm or
+                        simplify_cfg or sroa or lse or instcombine or unroll or
+                        bce or tre or ipcp or globalopt or vectorize;
+    if (emitasm and (emitllvm or emitast)) {
+        print_err("-S does not mix with -emit-llvm or -emit-ast");
+    }
+    if (run and jit) {
+        print_err("-run and -jit do not mix");
+    }
+    if (emitlir and (emitllvm or emitasm or emitast)) {
+        print_err("-emit-lir does not mix with -emit-llvm, -S or -emit-ast");
+    }
+    if ((run or jit) and (emitllvm or emitlir or emitasm or emitast)) {
+        print_err("-run and -jit do not mix with -emit-llvm, -emit-lir, -S or "
+                  "-emit-ast");
+    }
+    if ((opt_level >= 0) + not passes.empty() + pass_options > 1) {
+        print_err("-O, -passes and the single pass options do not mix");
+    }
+    auto pipeline_error = PassManager::check_pipeline(passes);
+    if (not pipeline_error.empty()) {
+        print_err("bad pipeline: " + pipeline_error);
     }
     if (const_prop && not dce) {
         print_err("const-prop pass need dce pass");
@@ -139,24 +971,86 @@ void Config::check() {
     if (func_inline && not dce) {
         print_err("function inline pass need dce pass");
     }
-    if (output_file.empty()) {
-        output_file = input_file.stem();
-        if (emitllvm) {
-            output_file.replace_extension(".ll");
-        }
+    if (gvn && not dce) {
+        print_err("gvn pass need dce pass");
+    }
+    if (licm && not dce) {
+        print_err("licm pass need dce pass");
+    }
+    if (simplify_cfg && not dce) {
+        print_err("simplify cfg pass need dce pass");
+    }
+    if (sroa && not dce) {
+        print_err("sroa pass need dce pass");
+    }
+    if (lse && not dce) {
+        print_err("load store elimination pass need dce pass");
+    }
+    if (instcombine && not dce) {
+        print_err("instcombine pass need dce pass");
+    }
+    if (unroll && not dce) {
+        print_err("loop unroll pass need dce pass");
+    }
+    if (bce && not dce) {
+        print_err("bounds check elimination pass need dce pass");
+    }
+    if (globalopt && not dce) {
+        print_err("global variable optimization pass need dce pass");
+    }
+    if (ipcp && not dce) {
+        print_err("interprocedural constant propagation pass need dce pass");
+    }
+    if (tre && not dce) {
+        print_err("tail recursion elimination pass need dce pass");
+    }
+    if (vectorize && not dce) {
+        print_err("loop vectorization pass need dce pass");
+    }
+    if ((emitasm or run) and pipeline_error.empty() and
+        PassManager::pipeline_has(pipeline(), "vectorize")) {
+        print_err("vector ir needs -emit-llvm, -emit-lir or -jit");
+    }
+    if (profile_generate and not profile_file.empty()) {
+        print_err("-fprofile-generate and -fprofile-use do not mix");
+    }
+    // the interpreter has no runtime to write the counts
+    if (profile_generate and run) {
+        print_err("-fprofile-generate needs -jit or a linked program, not "
+                  "-run");
+    }
+    profile.reset();
+    if (not profile_file.empty()) {
+        auto read = std::make_shared<Profile>();
+        string profile_error;
+        if (read->read(profile_file, profile_error))
+            profile = read;
+        else
+            print_err(profile_error);
     }
 }
 
 void Config::print_help() const {
     std::cout << "Usage: " << exe_name
-              << " [-h|--help] [-o <target-file>] [-emit-llvm] [-S] [-dump-json]"
-                 "[-const-prop] [-dce]"
-                 "<input-file>"
+              << " [-h|--help] [-o <target-file>] [-emit-llvm] [-emit-lir] [-S] [-run] [-jit] [-dump-json]"
+                 "[-const-prop] [-ipcp] [-dce] [-func-inline] [-globalopt] [-gvn] [-licm] [-simplify-cfg] [-sroa] [-lse] [-instcombine] [-unroll] [-bce] [-vectorize] [-tre] [-ssa-builder]"
+                 " [-O0|-O1|-O2] [-passes=<pipeline>]"
+                 " [-j <threads>] [-cache-dir <dir> [-incremental]] [-distribute <workers>] [-fprofile-generate|-fprofile-use[=<profile>]] [-time-passes] [-stats] [-report-json <report-file>] [-trace=<trace-file>] [-verify-each]"
+                 "<input-file>... (or @<file> listing arguments)\n"
+                 "       " << exe_name << " --serve [<option>...]\n"
+                 "       " << exe_name << " --worker"
               << std::endl;
     exit(0);
 }
 
-void Config::print_err(const string &msg) const {
+void Config::print_err(const string &msg) {
+    if (in_request) {
+        // the server goes on with the next request
+        if (error.empty())
+            error = msg;
+        return;
+    }
     std::cout << exe_name << ": " << msg << std::endl;
     exit(-1);
-}
\ No newline at end of file
+}
+
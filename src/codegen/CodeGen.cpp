@@ -0,0 +1,765 @@
+#include "CodeGen.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+using Gpr = CodeGen::Gpr;
+
+// allocatable, %rbx and %r12-%r15 are callee saved
+const Gpr gprs[] = {{"%rbx", "%ebx"},   {"%r12", "%r12d"}, {"%r13", "%r13d"},
+                    {"%r14", "%r14d"},  {"%r15", "%r15d"}, {"%r10", "%r10d"}};
+const LinearScan::RegClass gpr_class = {true, true, true, true, true, false};
+// no xmm register survives a call
+const char *const xmms[] = {"%xmm8",  "%xmm9",  "%xmm10",
+                            "%xmm11", "%xmm12", "%xmm13"};
+const LinearScan::RegClass xmm_class(6, false);
+
+// scratch, never allocated: %rax %rcx %rdx %r11 %xmm14 %xmm15. The argument
+// registers are not allocated either, calls and the prologue use them freely
+const Gpr rax{"%rax", "%eax"}, rcx{"%rcx", "%ecx"}, r11{"%r11", "%r11d"};
+const Gpr int_args[] = {{"%rdi", "%edi"}, {"%rsi", "%esi"}, {"%rdx", "%edx"},
+                        {"%rcx", "%ecx"}, {"%r8", "%r8d"},  {"%r9", "%r9d"}};
+const unsigned num_float_args = 8;
+
+std::string xmm_arg(unsigned i) { return "%xmm" + std::to_string(i); }
+
+uint32_t float_bits(float val) {
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return bits;
+}
+
+int align(int size, int to) { return (size + to - 1) / to * to; }
+
+} // namespace
+
+void CodeGen::run(std::ostream &os) {
+    os_ = &os;
+    for (auto &global : m_->get_global_variable())
+        emit_global(&global);
+    for (auto &func : m_->get_functions()) {
+        if (not func.is_declaration())
+            emit_function(&func);
+    }
+    os << "\t.section\t.note.GNU-stack,\"\",@progbits\n";
+}
+
+void CodeGen::emit_global(GlobalVariable *global) {
+    auto &os = *os_;
+    auto type = global->get_type()->get_pointer_element_type();
+    auto init = global->get_init();
+    auto name = global->get_name();
+    bool zero = init == nullptr or init->is<ConstantZero>();
+    os << (zero ? "\t.bss\n" : "\t.data\n");
+    os << "\t.globl\t" << name << "\n\t.p2align\t3\n\t.type\t" << name
+       << ", @object\n\t.size\t" << name << ", " << type->get_size() << "\n"
+       << name << ":\n";
+    if (zero)
+        os << "\t.zero\t" << type->get_size() << "\n";
+    else
+        emit_constant(init, type);
+}
+
+void CodeGen::emit_constant(Constant *init, Type *type) {
+    auto &os = *os_;
+    if (auto c = init->dyn_cast<ConstantInt>())
+        os << (type->is_int1_type() ? "\t.byte\t" : "\t.long\t")
+           << c->get_value() << "\n";
+    else if (auto f = init->dyn_cast<ConstantFP>())
+        os << "\t.long\t" << float_bits(f->get_value()) << "\n";
+    else if (auto array = init->dyn_cast<ConstantArray>()) {
+        auto elem_type = static_cast<ArrayType *>(type)->get_element_type();
+        for (unsigned i = 0; i < array->get_size_of_array(); i++)
+            emit_constant(array->get_element_value(i), elem_type);
+    } else
+        os << "\t.zero\t" << type->get_size() << "\n";
+}
+
+void CodeGen::emit_function(Function *func) {
+    auto &os = *os_;
+    func_ = func;
+    labels_.clear();
+    next_label_ = 0;
+    intervals_ = std::make_unique<LiveIntervals>(func);
+    alloc_ = std::make_unique<LinearScan>(
+        *intervals_, std::vector<LinearScan::RegClass>{gpr_class, xmm_class},
+        [](Value *val) { return val->get_type()->is_float_type() ? 1u : 0u; });
+
+    // frame below %rbp: saved registers, spill slots, allocas
+    int offset = 0;
+    saved_.clear();
+    for (unsigned i = 0; i < gpr_class.size(); i++) {
+        if (gpr_class[i] and alloc_->is_used(0, i)) {
+            offset += 8;
+            saved_.emplace_back(gprs[i], -offset);
+        }
+    }
+    slots_base_ = offset;
+    offset += 8 * alloc_->get_num_slots();
+    alloca_offsets_.clear();
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &instr : bb.get_instructions()) {
+            if (auto alloca = instr.dyn_cast<AllocaInst>()) {
+                offset += align(alloca->get_alloca_type()->get_size(), 8);
+                alloca_offsets_[alloca] = -offset;
+            }
+        }
+    }
+    frame_size_ = align(offset, 16);
+
+    auto name = func->get_name();
+    os << "\t.text\n\t.globl\t" << name << "\n\t.p2align\t4\n\t.type\t" << name
+       << ", @function\n"
+       << name << ":\n";
+    emit_prologue(func);
+    std::vector<BasicBlock *> blocks;
+    for (auto &bb : func->get_basic_blocks())
+        blocks.push_back(&bb);
+    for (unsigned i = 0; i < blocks.size(); i++) {
+        auto next = i + 1 < blocks.size() ? blocks[i + 1] : nullptr;
+        os << get_label(blocks[i]) << ":\n";
+        for (auto &instr : blocks[i]->get_instructions())
+            emit_instr(&instr, next);
+    }
+    os << "\t.size\t" << name << ", .-" << name << "\n";
+}
+
+void CodeGen::emit_prologue(Function *func) {
+    auto &os = *os_;
+    os << "\tpushq\t%rbp\n\tmovq\t%rsp, %rbp\n";
+    if (frame_size_)
+        os << "\tsubq\t$" << frame_size_ << ", %rsp\n";
+    for (auto &[reg, offset] : saved_)
+        os << "\tmovq\t" << reg.r64 << ", " << offset << "(%rbp)\n";
+    // arguments to their locations, the rest of the ABI registers are free
+    unsigned ints = 0, floats = 0, stack = 0;
+    for (auto &arg : func->get_args()) {
+        if (is_float(&arg)) {
+            if (floats < num_float_args) {
+                write_float(&arg, xmm_arg(floats++));
+                continue;
+            }
+            os << "\tmovss\t" << 16 + 8 * stack++ << "(%rbp), %xmm15\n";
+            write_float(&arg, "%xmm15");
+        } else {
+            if (ints < std::size(int_args)) {
+                write_int(&arg, int_args[ints++]);
+                continue;
+            }
+            os << "\tmovq\t" << 16 + 8 * stack++ << "(%rbp), %rax\n";
+            write_int(&arg, rax);
+        }
+    }
+}
+
+void CodeGen::emit_epilogue() {
+    auto &os = *os_;
+    for (auto &[reg, offset] : saved_)
+        os << "\tmovq\t" << offset << "(%rbp), " << reg.r64 << "\n";
+    os << "\tleave\n\tret\n";
+}
+
+void CodeGen::emit_instr(Instruction *instr, BasicBlock *next) {
+    auto &os = *os_;
+    switch (instr->get_instr_type()) {
+    case Instruction::ret:
+        emit_ret(instr->as<ReturnInst>());
+        break;
+    case Instruction::br:
+        emit_br(instr->as<BranchInst>(), next);
+        break;
+    case Instruction::add:
+    case Instruction::sub:
+    case Instruction::mul:
+    case Instruction::sdiv:
+        emit_int_binary(instr);
+        break;
+    case Instruction::fadd:
+    case Instruction::fsub:
+    case Instruction::fmul:
+    case Instruction::fdiv:
+        emit_float_binary(instr);
+        break;
+    case Instruction::alloca:
+    case Instruction::phi:
+        // the frame and the edges take care of them
+        break;
+    case Instruction::load:
+        emit_load(instr->as<LoadInst>());
+        break;
+    case Instruction::store:
+        emit_store(instr->as<StoreInst>());
+        break;
+    case Instruction::ge:
+    case Instruction::gt:
+    case Instruction::le:
+    case Instruction::lt:
+    case Instruction::eq:
+    case Instruction::ne:
+    case Instruction::fge:
+    case Instruction::fgt:
+    case Instruction::fle:
+    case Instruction::flt:
+    case Instruction::feq:
+    case Instruction::fne:
+        if (not intervals_->is_folded(instr))
+            emit_set(instr);
+        break;
+    case Instruction::call:
+        emit_call(instr->as<CallInst>());
+        break;
+    case Instruction::getelementptr:
+    case Instruction::bitcast:
+        emit_gep(instr);
+        break;
+    case Instruction::zext: {
+        // i1 is kept as 0 or 1 in 32 bits
+        auto target = int_target(instr);
+        load_int(instr->get_operand(0), target);
+        write_int(instr, target);
+        break;
+    }
+    case Instruction::fptosi: {
+        auto target = int_target(instr);
+        auto src = float_operand(instr->get_operand(0), "%xmm14");
+        os << "\tcvttss2si\t" << src << ", " << target.r32 << "\n";
+        write_int(instr, target);
+        break;
+    }
+    case Instruction::sitofp: {
+        auto val = instr->get_operand(0);
+        auto target = float_target(instr);
+        auto src = int_operand(val);
+        if (src[0] == '$') {
+            load_int(val, rax);
+            src = rax.r32;
+        }
+        os << "\tcvtsi2ssl\t" << src << ", " << target << "\n";
+        write_float(instr, target);
+        break;
+    }
+    }
+}
+
+void CodeGen::emit_int_binary(Instruction *instr) {
+    auto &os = *os_;
+    auto lhs = instr->get_operand(0), rhs = instr->get_operand(1);
+    if (instr->is_div()) {
+        load_int(lhs, rax);
+        os << "\tcltd\n";
+        if (get_location(rhs).kind == Location::none) {
+            // idiv takes no immediate
+            load_int(rhs, rcx);
+            os << "\tidivl\t%ecx\n";
+        } else
+            os << "\tidivl\t" << int_operand(rhs) << "\n";
+        write_int(instr, rax);
+        return;
+    }
+    auto target = int_target(instr, rhs);
+    load_int(lhs, target);
+    const char *op = instr->is_add() ? "addl" : instr->is_sub() ? "subl" : "imull";
+    os << "\t" << op << "\t" << int_operand(rhs) << ", " << target.r32 << "\n";
+    write_int(instr, target);
+}
+
+void CodeGen::emit_float_binary(Instruction *instr) {
+    auto &os = *os_;
+    auto lhs = instr->get_operand(0), rhs = instr->get_operand(1);
+    auto target = float_target(instr, rhs);
+    load_float(lhs, target.c_str());
+    auto src = float_operand(rhs, "%xmm14");
+    const char *op = instr->is_fadd()   ? "addss"
+                     : instr->is_fsub() ? "subss"
+                     : instr->is_fmul() ? "mulss"
+                                        : "divss";
+    os << "\t" << op << "\t" << src << ", " << target << "\n";
+    write_float(instr, target);
+}
+
+std::string CodeGen::emit_compare(Instruction *compare) {
+    auto &os = *os_;
+    auto lhs = compare->get_operand(0), rhs = compare->get_operand(1);
+    auto type = compare->get_instr_type();
+    if (compare->is_cmp()) {
+        auto reg = reg_name(lhs);
+        if (reg.empty()) {
+            load_int(lhs, rax);
+            reg = rax.r32;
+        }
+        os << "\tcmpl\t" << int_operand(rhs) << ", " << reg << "\n";
+        switch (type) {
+        case Instruction::ge:
+            return "ge";
+        case Instruction::gt:
+            return "g";
+        case Instruction::le:
+            return "le";
+        case Instruction::lt:
+            return "l";
+        case Instruction::eq:
+            return "e";
+        default:
+            return "ne";
+        }
+    }
+    // ucomiss sets cf for less and zf for equal, unordered sets both and pf
+    bool swap = type == Instruction::fgt or type == Instruction::fge;
+    auto x = swap ? rhs : lhs, y = swap ? lhs : rhs;
+    auto reg = reg_name(x);
+    if (reg.empty()) {
+        load_float(x, "%xmm15");
+        reg = "%xmm15";
+    }
+    auto src = float_operand(y, "%xmm14");
+    os << "\tucomiss\t" << src << ", " << reg << "\n";
+    switch (type) {
+    case Instruction::flt:
+    case Instruction::fgt:
+        return "b";
+    case Instruction::fle:
+    case Instruction::fge:
+        return "be";
+    case Instruction::feq:
+        return "e";
+    default:
+        // jne or jp
+        return "une";
+    }
+}
+
+void CodeGen::emit_set(Instruction *compare) {
+    auto &os = *os_;
+    auto cond = emit_compare(compare);
+    if (cond == "une")
+        os << "\tsetne\t%al\n\tsetp\t%cl\n\torb\t%cl, %al\n";
+    else
+        os << "\tset" << cond << "\t%al\n";
+    auto target = int_target(compare);
+    os << "\tmovzbl\t%al, " << target.r32 << "\n";
+    write_int(compare, target);
+}
+
+void CodeGen::emit_jump(const std::string &cond, const std::string &label) {
+    auto &os = *os_;
+    if (cond == "une")
+        os << "\tjne\t" << label << "\n\tjp\t" << label << "\n";
+    else
+        os << "\tj" << cond << "\t" << label << "\n";
+}
+
+void CodeGen::emit_load(LoadInst *load) {
+    auto &os = *os_;
+    auto mem = address(load->get_lval(), rcx);
+    if (is_float(load)) {
+        auto target = float_target(load);
+        os << "\tmovss\t" << mem << ", " << target << "\n";
+        write_float(load, target);
+    } else {
+        auto target = int_target(load);
+        bool wide = is_wide(load);
+        os << (wide ? "\tmovq\t" : "\tmovl\t") << mem << ", "
+           << (wide ? target.r64 : target.r32) << "\n";
+        write_int(load, target);
+    }
+}
+
+void CodeGen::emit_store(StoreInst *store) {
+    auto &os = *os_;
+    auto val = store->get_rval();
+    auto mem = address(store->get_lval(), rcx);
+    bool in_memory = get_location(val).kind == Location::slot;
+    if (is_float(val)) {
+        auto src = float_operand(val, "%xmm14");
+        if (in_memory) {
+            os << "\tmovss\t" << src << ", %xmm14\n";
+            src = "%xmm14";
+        }
+        os << "\tmovss\t" << src << ", " << mem << "\n";
+        return;
+    }
+    bool wide = is_wide(val);
+    std::string src;
+    if (in_memory or val->is<AllocaInst>() or val->is<GlobalVariable>()) {
+        load_int(val, rax);
+        src = wide ? rax.r64 : rax.r32;
+    } else
+        src = int_operand(val);
+    os << (wide ? "\tmovq\t" : "\tmovl\t") << src << ", " << mem << "\n";
+}
+
+void CodeGen::emit_gep(Instruction *gep) {
+    auto &os = *os_;
+    auto base = gep->get_operand(0);
+    auto type = base->get_type()->get_pointer_element_type();
+    // constant indices fold into one offset
+    long offset = 0;
+    std::vector<std::pair<Value *, unsigned>> scaled;
+    for (unsigned i = 1; i < gep->get_num_operand(); i++) {
+        if (i > 1)
+            type = static_cast<ArrayType *>(type)->get_element_type();
+        auto idx = gep->get_operand(i);
+        if (auto c = idx->dyn_cast<ConstantInt>())
+            offset += static_cast<long>(c->get_value()) * type->get_size();
+        else if (not idx->is<ConstantZero>())
+            scaled.emplace_back(idx, type->get_size());
+    }
+    // the indices are read after the base is in target
+    auto target = scaled.empty() ? int_target(gep) : rax;
+    if (auto it = alloca_offsets_.find(base); it != alloca_offsets_.end())
+        os << "\tleaq\t" << it->second + offset << "(%rbp), " << target.r64
+           << "\n";
+    else if (base->is<GlobalVariable>())
+        os << "\tleaq\t" << base->get_name() << (offset ? "+" : "")
+           << (offset ? std::to_string(offset) : "") << "(%rip), "
+           << target.r64 << "\n";
+    else {
+        load_int(base, target);
+        if (offset)
+            os << "\tleaq\t" << offset << "(" << target.r64 << "), "
+               << target.r64 << "\n";
+    }
+    for (auto &[idx, size] : scaled) {
+        os << "\tmovslq\t" << int_operand(idx) << ", %rcx\n";
+        if (size == 1 or size == 2 or size == 4 or size == 8)
+            os << "\tleaq\t(" << target.r64 << ",%rcx," << size << "), "
+               << target.r64 << "\n";
+        else
+            os << "\timulq\t$" << size << ", %rcx\n\taddq\t%rcx, "
+               << target.r64 << "\n";
+    }
+    write_int(gep, target);
+}
+
+void CodeGen::emit_call(CallInst *call) {
+    auto &os = *os_;
+    auto callee = call->get_operand(0)->as<Function>();
+    std::vector<Value *> stack_args;
+    std::vector<Value *> int_regs, float_regs;
+    for (unsigned i = 1; i < call->get_num_operand(); i++) {
+        auto arg = call->get_operand(i);
+        if (is_float(arg) and float_regs.size() < num_float_args)
+            float_regs.push_back(arg);
+        else if (not is_float(arg) and int_regs.size() < std::size(int_args))
+            int_regs.push_back(arg);
+        else
+            stack_args.push_back(arg);
+    }
+    // %rsp stays 16 byte aligned at the call
+    auto pushed = stack_args.size() + stack_args.size() % 2;
+    if (stack_args.size() % 2)
+        os << "\tsubq\t$8, %rsp\n";
+    for (auto it = stack_args.rbegin(); it != stack_args.rend(); ++it) {
+        if (is_float(*it)) {
+            load_float(*it, "%xmm14");
+            os << "\tsubq\t$8, %rsp\n\tmovss\t%xmm14, (%rsp)\n";
+        } else {
+            load_int(*it, rax);
+            os << "\tpushq\t%rax\n";
+        }
+    }
+    for (unsigned i = 0; i < int_regs.size(); i++)
+        load_int(int_regs[i], int_args[i]);
+    for (unsigned i = 0; i < float_regs.size(); i++)
+        load_float(float_regs[i], xmm_arg(i).c_str());
+    os << "\tcall\t" << callee->get_name()
+       << (callee->is_declaration() ? "@PLT" : "") << "\n";
+    if (pushed)
+        os << "\taddq\t$" << 8 * pushed << ", %rsp\n";
+    if (call->is_void())
+        return;
+    if (is_float(call))
+        write_float(call, "%xmm0");
+    else
+        write_int(call, rax);
+}
+
+void CodeGen::emit_br(BranchInst *br, BasicBlock *next) {
+    auto &os = *os_;
+    auto bb = br->get_parent();
+    if (not br->is_cond_br()) {
+        auto target = br->get_operand(0)->as<BasicBlock>();
+        emit_moves(get_phi_moves(bb, target));
+        if (target != next)
+            os << "\tjmp\t" << get_label(target) << "\n";
+        return;
+    }
+    auto cond = br->get_condition();
+    auto if_true = br->get_operand(1)->as<BasicBlock>();
+    auto if_false = br->get_operand(2)->as<BasicBlock>();
+    auto true_moves = get_phi_moves(bb, if_true);
+    auto false_moves = get_phi_moves(bb, if_false);
+    if (auto c = cond->dyn_cast<ConstantInt>()) {
+        auto taken = c->get_value() ? if_true : if_false;
+        emit_moves(c->get_value() ? true_moves : false_moves);
+        if (taken != next)
+            os << "\tjmp\t" << get_label(taken) << "\n";
+        return;
+    }
+    // the flags first, the moves leave them alone
+    std::string code;
+    auto compare = cond->dyn_cast<Instruction>();
+    if (compare and intervals_->is_folded(compare))
+        code = emit_compare(compare);
+    else {
+        os << "\tcmpl\t$0, " << int_operand(cond) << "\n";
+        code = "ne";
+    }
+    auto true_label = true_moves.empty() ? get_label(if_true) : new_label();
+    emit_jump(code, true_label);
+    emit_moves(false_moves);
+    if (if_false != next or not true_moves.empty())
+        os << "\tjmp\t" << get_label(if_false) << "\n";
+    if (not true_moves.empty()) {
+        os << true_label << ":\n";
+        emit_moves(true_moves);
+        if (if_true != next)
+            os << "\tjmp\t" << get_label(if_true) << "\n";
+    }
+}
+
+void CodeGen::emit_ret(ReturnInst *ret) {
+    if (not ret->is_void_ret()) {
+        auto val = ret->get_operand(0);
+        if (is_float(val))
+            load_float(val, "%xmm0");
+        else
+            load_int(val, rax);
+    } else if (func_->get_name() == "main")
+        // the exit status, as for a main that returns int
+        *os_ << "\txorl\t%eax, %eax\n";
+    emit_epilogue();
+}
+
+std::vector<CodeGen::Move> CodeGen::get_phi_moves(BasicBlock *from,
+                                                  BasicBlock *to) {
+    std::vector<Move> moves;
+    for (auto &instr : to->get_instructions()) {
+        if (not instr.is_phi())
+            break;
+        for (auto &[val, pred] : instr.as<PhiInst>()->get_phi_pairs()) {
+            if (pred == from) {
+                moves.push_back({&instr, val});
+                break;
+            }
+        }
+    }
+    return moves;
+}
+
+void CodeGen::emit_moves(std::vector<Move> moves) {
+    // nothing to do where the value already is
+    moves.erase(std::remove_if(moves.begin(), moves.end(),
+                               [&](Move &move) {
+                                   auto loc = get_location(move.dst);
+                                   return loc.kind == Location::none or
+                                          get_location(move.src) == loc;
+                               }),
+                moves.end());
+    // the location a move reads, none for constants
+    auto source = [&](const Move &move) {
+        return move.src ? get_location(move.src) : Location();
+    };
+    auto same_class = [&](const Move &a, const Move &b) {
+        return is_float(a.dst) == is_float(b.dst);
+    };
+    while (not moves.empty()) {
+        bool done = false;
+        for (unsigned k = 0; k < moves.size() and not done; k++) {
+            auto dst = get_location(moves[k].dst);
+            bool blocked = false;
+            for (unsigned j = 0; j < moves.size(); j++) {
+                if (j != k and same_class(moves[j], moves[k]) and
+                    source(moves[j]) == dst)
+                    blocked = true;
+            }
+            if (not blocked) {
+                emit_move(moves[k]);
+                moves.erase(moves.begin() + k);
+                done = true;
+            }
+        }
+        if (done)
+            continue;
+        // only cycles are left, break one through the temporary
+        auto &first = moves.front();
+        auto dst = get_location(first.dst);
+        if (is_float(first.dst))
+            load_float(first.dst, "%xmm15");
+        else
+            load_int(first.dst, r11);
+        for (auto &move : moves) {
+            if (same_class(move, first) and source(move) == dst)
+                move.src = nullptr;
+        }
+    }
+}
+
+void CodeGen::emit_move(const Move &move) {
+    auto &os = *os_;
+    auto dst = move.dst;
+    auto loc = get_location(dst);
+    if (is_float(dst)) {
+        if (not move.src)
+            write_float(dst, "%xmm15");
+        else if (loc.kind == Location::reg)
+            load_float(move.src, xmms[loc.index]);
+        else if (auto reg = reg_name(move.src); not reg.empty())
+            write_float(dst, reg);
+        else {
+            load_float(move.src, "%xmm14");
+            write_float(dst, "%xmm14");
+        }
+        return;
+    }
+    if (not move.src)
+        write_int(dst, r11);
+    else if (loc.kind == Location::reg)
+        load_int(move.src, gprs[loc.index]);
+    else if (get_location(move.src).kind == Location::reg)
+        write_int(dst, gprs[get_location(move.src).index]);
+    else if (move.src->is<ConstantInt>() or move.src->is<ConstantZero>())
+        os << (is_wide(dst) ? "\tmovq\t" : "\tmovl\t") << int_operand(move.src)
+           << ", " << slot(loc.index) << "\n";
+    else {
+        load_int(move.src, rax);
+        write_int(dst, rax);
+    }
+}
+
+std::string CodeGen::slot(unsigned index) const {
+    return std::to_string(-(slots_base_ + 8 * static_cast<int>(index + 1))) +
+           "(%rbp)";
+}
+
+std::string CodeGen::int_operand(Value *val) const {
+    if (auto c = val->dyn_cast<ConstantInt>())
+        return "$" + std::to_string(c->get_value());
+    if (val->is<ConstantZero>())
+        return "$0";
+    auto loc = get_location(val);
+    assert(loc.kind != Location::none && "no location for the operand");
+    if (loc.kind == Location::slot)
+        return slot(loc.index);
+    return reg_name(val);
+}
+
+std::string CodeGen::float_operand(Value *val, const char *scratch) {
+    if (val->is<ConstantFP>() or val->is<ConstantZero>()) {
+        load_float(val, scratch);
+        return scratch;
+    }
+    auto loc = get_location(val);
+    assert(loc.kind != Location::none && "no location for the operand");
+    if (loc.kind == Location::slot)
+        return slot(loc.index);
+    return reg_name(val);
+}
+
+std::string CodeGen::address(Value *ptr, Gpr scratch) {
+    if (auto it = alloca_offsets_.find(ptr); it != alloca_offsets_.end())
+        return std::to_string(it->second) + "(%rbp)";
+    if (ptr->is<GlobalVariable>())
+        return ptr->get_name() + "(%rip)";
+    if (get_location(ptr).kind == Location::reg)
+        return "(" + reg_name(ptr) + ")";
+    load_int(ptr, scratch);
+    return std::string("(") + scratch.r64 + ")";
+}
+
+void CodeGen::load_int(Value *val, Gpr reg) {
+    auto &os = *os_;
+    if (auto it = alloca_offsets_.find(val); it != alloca_offsets_.end()) {
+        os << "\tleaq\t" << it->second << "(%rbp), " << reg.r64 << "\n";
+        return;
+    }
+    if (val->is<GlobalVariable>()) {
+        os << "\tleaq\t" << val->get_name() << "(%rip), " << reg.r64 << "\n";
+        return;
+    }
+    bool wide = is_wide(val);
+    auto src = int_operand(val);
+    auto dst = wide ? reg.r64 : reg.r32;
+    if (src != dst)
+        os << (wide ? "\tmovq\t" : "\tmovl\t") << src << ", " << dst << "\n";
+}
+
+void CodeGen::load_float(Value *val, const char *reg) {
+    auto &os = *os_;
+    if (auto c = val->dyn_cast<ConstantFP>()) {
+        os << "\tmovl\t$" << float_bits(c->get_value()) << ", %eax\n\tmovd\t%eax, "
+           << reg << "\n";
+        return;
+    }
+    if (val->is<ConstantZero>()) {
+        os << "\txorps\t" << reg << ", " << reg << "\n";
+        return;
+    }
+    auto src = float_operand(val, reg);
+    if (src != reg)
+        os << (src[0] == '%' ? "\tmovaps\t" : "\tmovss\t") << src << ", " << reg
+           << "\n";
+}
+
+CodeGen::Gpr CodeGen::int_target(Instruction *instr, Value *avoid) {
+    auto loc = get_location(instr);
+    if (loc.kind != Location::reg or (avoid and get_location(avoid) == loc and
+                                      not is_float(avoid)))
+        return rax;
+    return gprs[loc.index];
+}
+
+std::string CodeGen::float_target(Instruction *instr, Value *avoid) {
+    auto loc = get_location(instr);
+    if (loc.kind != Location::reg or (avoid and get_location(avoid) == loc and
+                                      is_float(avoid)))
+        return "%xmm15";
+    return xmms[loc.index];
+}
+
+void CodeGen::write_int(Value *dst, Gpr reg) {
+    auto loc = get_location(dst);
+    if (loc.kind == Location::none)
+        return;
+    bool wide = is_wide(dst);
+    auto src = wide ? reg.r64 : reg.r32;
+    auto target = loc.kind == Location::slot ? slot(loc.index) : reg_name(dst);
+    if (target != src)
+        *os_ << (wide ? "\tmovq\t" : "\tmovl\t") << src << ", " << target
+             << "\n";
+}
+
+void CodeGen::write_float(Value *dst, const std::string &reg) {
+    auto loc = get_location(dst);
+    if (loc.kind == Location::none)
+        return;
+    if (loc.kind == Location::slot)
+        *os_ << "\tmovss\t" << reg << ", " << slot(loc.index) << "\n";
+    else if (reg != xmms[loc.index])
+        *os_ << "\tmovaps\t" << reg << ", " << xmms[loc.index] << "\n";
+}
+
+std::string CodeGen::reg_name(Value *val) const {
+    auto loc = get_location(val);
+    if (loc.kind != Location::reg)
+        return "";
+    if (is_float(val))
+        return xmms[loc.index];
+    return is_wide(val) ? gprs[loc.index].r64 : gprs[loc.index].r32;
+}
+
+std::string CodeGen::get_label(BasicBlock *bb) {
+    auto it = labels_.find(bb);
+    if (it == labels_.end())
+        it = labels_.emplace(bb, new_label()).first;
+    return it->second;
+}
+
+std::string CodeGen::new_label() {
+    return ".L" + func_->get_name() + "_" + std::to_string(next_label_++);
+}
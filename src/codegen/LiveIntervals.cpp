@@ -0,0 +1,167 @@
+#include "LiveIntervals.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+
+// a set of value ids
+class Bits {
+  public:
+    explicit Bits(unsigned size = 0) : words_((size + 63) / 64) {}
+    void set(unsigned i) { words_[i / 64] |= 1ul << (i % 64); }
+    bool test(unsigned i) const { return words_[i / 64] >> (i % 64) & 1; }
+    // this |= other & ~mask, whether this changed
+    bool merge(const Bits &other, const Bits *mask = nullptr) {
+        bool changed = false;
+        for (unsigned i = 0; i < words_.size(); i++) {
+            auto word = other.words_[i] & (mask ? ~mask->words_[i] : ~0ul);
+            changed |= (words_[i] | word) != words_[i];
+            words_[i] |= word;
+        }
+        return changed;
+    }
+    template <typename F> void for_each(F f) const {
+        for (unsigned i = 0; i < words_.size(); i++) {
+            for (auto word = words_[i]; word; word &= word - 1)
+                f(i * 64 + __builtin_ctzl(word));
+        }
+    }
+
+  private:
+    std::vector<unsigned long> words_;
+};
+
+bool is_compare(Instruction *instr) {
+    return instr->is_cmp() or instr->is_fcmp();
+}
+
+} // namespace
+
+LiveIntervals::LiveIntervals(Function *func) {
+    std::vector<Value *> values;
+    auto add_value = [&](Value *val) {
+        ids_.emplace(val, values.size());
+        values.push_back(val);
+    };
+    for (auto &arg : func->get_args())
+        add_value(&arg);
+
+    // numbering
+    std::vector<BasicBlock *> blocks;
+    std::unordered_map<BasicBlock *, unsigned> block_ids;
+    std::unordered_map<Instruction *, unsigned> index;
+    std::vector<unsigned> calls;
+    unsigned next_index = 1;
+    for (auto &bb : func->get_basic_blocks()) {
+        block_ids[&bb] = blocks.size();
+        blocks.push_back(&bb);
+        Instruction *prev = nullptr;
+        for (auto &instr : bb.get_instructions()) {
+            index[&instr] = next_index++;
+            if (instr.is_call())
+                calls.push_back(index[&instr]);
+            if (instr.is_br() and instr.get_num_operand() == 3 and prev and
+                is_compare(prev) and instr.get_operand(0) == prev and
+                prev->get_use_list().size() == 1)
+                folded_.insert(prev);
+            prev = &instr;
+        }
+    }
+    for (auto bb : blocks) {
+        for (auto &instr : bb->get_instructions()) {
+            if (not instr.is_void() and not instr.is_alloca() and
+                not folded_.count(&instr))
+                add_value(&instr);
+        }
+    }
+
+    // liveness per block, phi operands are live out of their predecessor
+    auto num_blocks = blocks.size();
+    auto num_values = values.size();
+    std::vector<Bits> gen(num_blocks, Bits(num_values)),
+        kill(num_blocks, Bits(num_values)),
+        live_in(num_blocks, Bits(num_values)),
+        live_out(num_blocks, Bits(num_values));
+    for (unsigned b = 0; b < num_blocks; b++) {
+        for (auto &instr : blocks[b]->get_instructions()) {
+            if (instr.is_phi()) {
+                for (auto &[val, pred] : instr.as<PhiInst>()->get_phi_pairs()) {
+                    auto id = get_id(val);
+                    if (id != ~0u)
+                        live_out[block_ids.at(pred)].set(id);
+                }
+            } else {
+                for (auto op : instr.get_operands()) {
+                    auto id = get_id(op);
+                    if (id != ~0u and not kill[b].test(id))
+                        gen[b].set(id);
+                }
+            }
+            auto id = get_id(&instr);
+            if (id != ~0u)
+                kill[b].set(id);
+        }
+    }
+    for (unsigned b = 0; b < num_blocks; b++)
+        live_in[b].merge(gen[b]);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (auto b = num_blocks; b-- > 0;) {
+            for (auto succ : blocks[b]->get_succ_basic_blocks())
+                live_out[b].merge(live_in[block_ids.at(succ)]);
+            changed |= live_in[b].merge(live_out[b], &kill[b]);
+        }
+    }
+
+    // the hull of the positions
+    std::vector<Interval> hull(num_values, {UINT_MAX, 0, false});
+    auto extend = [&](unsigned id, unsigned pos) {
+        hull[id].start = std::min(hull[id].start, pos);
+        hull[id].end = std::max(hull[id].end, pos);
+    };
+    for (auto &arg : func->get_args())
+        extend(get_id(&arg), 1);
+    for (unsigned b = 0; b < num_blocks; b++) {
+        auto bb = blocks[b];
+        auto from = 2 * index[&bb->get_instructions().front()];
+        auto to = 2 * index[&bb->get_instructions().back()] + 1;
+        live_in[b].for_each([&](unsigned id) { extend(id, from); });
+        live_out[b].for_each([&](unsigned id) { extend(id, to); });
+        for (auto &instr : bb->get_instructions()) {
+            auto id = get_id(&instr);
+            if (instr.is_phi()) {
+                extend(id, from);
+                for (auto &[val, pred] : instr.as<PhiInst>()->get_phi_pairs())
+                    extend(id, 2 * index[&pred->get_instructions().back()] + 1);
+                continue;
+            }
+            auto use = 2 * index[&instr];
+            // read by the branch
+            if (folded_.count(&instr))
+                use += 2;
+            for (auto op : instr.get_operands()) {
+                auto op_id = get_id(op);
+                if (op_id != ~0u)
+                    extend(op_id, use);
+            }
+            if (id != ~0u)
+                extend(id, 2 * index[&instr] + 1);
+        }
+    }
+
+    for (unsigned id = 0; id < num_values; id++) {
+        auto &interval = hull[id];
+        // the first call reading its operands no earlier than the start
+        auto call = std::lower_bound(calls.begin(), calls.end(),
+                                     (interval.start + 1) / 2);
+        interval.crosses_call =
+            call != calls.end() and 2 * *call + 1 < interval.end;
+        intervals_.emplace_back(values[id], interval);
+    }
+    std::stable_sort(intervals_.begin(), intervals_.end(),
+                     [](auto &a, auto &b) {
+                         return a.second.start < b.second.start;
+                     });
+}
@@ -0,0 +1,69 @@
+#include "RegAlloc.hpp"
+
+#include <algorithm>
+
+LinearScan::LinearScan(const LiveIntervals &intervals,
+                       const std::vector<RegClass> &classes,
+                       const std::function<unsigned(Value *)> &get_class) {
+    struct Active {
+        Value *val;
+        unsigned end;
+        unsigned reg;
+    };
+    std::vector<std::vector<Active>> active(classes.size());
+    std::vector<std::vector<bool>> free(classes.size());
+    for (unsigned c = 0; c < classes.size(); c++) {
+        free[c].assign(classes[c].size(), true);
+        used_.emplace_back(classes[c].size(), false);
+    }
+
+    auto spill = [&](Value *val) {
+        locations_[val] = {Location::slot, num_slots_++};
+    };
+    // intervals come by start
+    for (auto &[val, interval] : intervals.get_intervals()) {
+        auto c = get_class(val);
+        auto &regs = classes[c];
+        auto &act = active[c];
+        // expire the intervals that ended
+        act.erase(std::remove_if(act.begin(), act.end(),
+                                 [&, start = interval.start](Active &a) {
+                                     if (a.end >= start)
+                                         return false;
+                                     free[c][a.reg] = true;
+                                     return true;
+                                 }),
+                  act.end());
+
+        auto allowed = [&](unsigned reg) {
+            return regs[reg] or not interval.crosses_call;
+        };
+        // caller saved registers first, they cost no save in the prologue
+        int reg = -1;
+        for (unsigned i = 0; i < regs.size(); i++) {
+            if (free[c][i] and allowed(i) and
+                (reg < 0 or (regs[reg] and not regs[i])))
+                reg = i;
+        }
+        if (reg < 0) {
+            // the active interval ending last whose register fits
+            Active *victim = nullptr;
+            for (auto &a : act) {
+                if (allowed(a.reg) and (not victim or a.end > victim->end))
+                    victim = &a;
+            }
+            if (not victim or victim->end <= interval.end) {
+                spill(val);
+                continue;
+            }
+            reg = victim->reg;
+            spill(victim->val);
+            *victim = act.back();
+            act.pop_back();
+        }
+        free[c][reg] = false;
+        used_[c][reg] = true;
+        locations_[val] = {Location::reg, static_cast<unsigned>(reg)};
+        act.push_back({val, interval.end, static_cast<unsigned>(reg)});
+    }
+}
@@ -0,0 +1,35 @@
+#include "MemoryReport.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sys/resource.h>
+
+long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss; // KB on Linux
+}
+
+void MemoryReport::add_phase(const std::string &name, std::size_t objects,
+                             std::size_t bytes) {
+    phases_.push_back({name, objects, bytes, peak_rss_kb()});
+}
+
+void MemoryReport::print(std::ostream &os) const {
+    std::size_t total_objects = 0, total_bytes = 0;
+    long peak = 0;
+    os << "===--- Memory report ---===\n"
+       << std::setw(10) << "Objects" << std::setw(14) << "Bytes"
+       << std::setw(14) << "PeakRSS(KB)"
+       << "  Phase\n";
+    for (auto &phase : phases_) {
+        os << std::setw(10) << phase.objects << std::setw(14) << phase.bytes
+           << std::setw(14) << phase.peak_rss_kb << "  " << phase.name
+           << "\n";
+        total_objects += phase.objects;
+        total_bytes += phase.bytes;
+        peak = std::max(peak, phase.peak_rss_kb);
+    }
+    os << std::setw(10) << total_objects << std::setw(14) << total_bytes
+       << std::setw(14) << peak << "  Total\n";
+}
@@ -0,0 +1,94 @@
+#include "ThreadPool.hpp"
+
+#include <cassert>
+
+ThreadPool::ThreadPool(unsigned num_threads) {
+    assert(num_threads > 0 && "a pool needs at least the calling thread");
+    for (unsigned i = 0; i < num_threads; i++)
+        queues_.push_back(std::make_unique<Queue>());
+    for (unsigned i = 1; i < num_threads; i++)
+        threads_.emplace_back(&ThreadPool::worker, this, i);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    start_cv_.notify_all();
+    for (auto &thread : threads_)
+        thread.join();
+}
+
+void ThreadPool::parallel_for(std::size_t n,
+                              const std::function<void(std::size_t)> &fn) {
+    if (threads_.empty() or n <= 1) {
+        for (std::size_t i = 0; i < n; i++)
+            fn(i);
+        return;
+    }
+    // contiguous blocks keep neighbouring indices on one thread
+    auto num = queues_.size();
+    for (std::size_t t = 0; t < num; t++) {
+        std::lock_guard<std::mutex> lock(queues_[t]->mutex);
+        for (auto i = n * t / num; i < n * (t + 1) / num; i++)
+            queues_[t]->indices.push_back(i);
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        fn_ = &fn;
+        busy_ = threads_.size();
+        generation_++;
+    }
+    start_cv_.notify_all();
+    drain(0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    done_cv_.wait(lock, [&] { return busy_ == 0; });
+    fn_ = nullptr;
+}
+
+void ThreadPool::worker(unsigned id) {
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            start_cv_.wait(lock, [&] { return stop_ or generation_ != seen; });
+            if (stop_)
+                return;
+            seen = generation_;
+        }
+        drain(id);
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (--busy_ == 0)
+            done_cv_.notify_one();
+    }
+}
+
+void ThreadPool::drain(unsigned id) {
+    std::size_t index;
+    while (pop(id, index))
+        (*fn_)(index);
+}
+
+bool ThreadPool::pop(unsigned id, std::size_t &index) {
+    {
+        auto &own = *queues_[id];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (not own.indices.empty()) {
+            index = own.indices.front();
+            own.indices.pop_front();
+            return true;
+        }
+    }
+    // indices are never added during a loop, so one empty round means done
+    for (unsigned k = 1; k < queues_.size(); k++) {
+        auto &victim = *queues_[(id + k) % queues_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (not victim.indices.empty()) {
+            index = victim.indices.back();
+            victim.indices.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,112 @@
+#include "Trace.hpp"
+
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Event {
+    std::string name, detail;
+    Clock::time_point begin, end;
+};
+
+struct Buffer {
+    unsigned tid;
+    std::vector<Event> events;
+};
+
+// taken once by every thread that records and by write(); the buffers live
+// until the exit, a thread keeps a pointer to its own
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<Buffer>> buffers;
+Clock::time_point start_time;
+
+Buffer &thread_buffer() {
+    thread_local Buffer *buffer = nullptr;
+    if (buffer == nullptr) {
+        std::lock_guard<std::mutex> lock(buffers_mutex);
+        buffers.push_back(std::make_unique<Buffer>());
+        buffer = buffers.back().get();
+        buffer->tid = buffers.size() - 1;
+    }
+    return *buffer;
+}
+
+void print_string(std::ostream &os, const std::string &str) {
+    os << '"';
+    for (char c : str) {
+        if (c == '"' or c == '\\')
+            os << '\\' << c;
+        else if (static_cast<unsigned char>(c) >= 0x20)
+            os << c;
+    }
+    os << '"';
+}
+
+// microseconds since start(), the unit of the trace
+double micros(Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+
+} // namespace
+
+namespace trace {
+
+std::atomic<bool> detail::enabled{false};
+
+void detail::record(std::string name, std::string detail,
+                    Clock::time_point begin) {
+    auto end = Clock::now();
+    thread_buffer().events.push_back(
+        {std::move(name), std::move(detail), begin, end});
+}
+
+void start() {
+    start_time = Clock::now();
+    thread_buffer();
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+void write(std::ostream &os) {
+    detail::enabled.store(false, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    os << "{\"traceEvents\":[";
+    bool first = true;
+    auto separate = [&]() {
+        os << (first ? "\n" : ",\n");
+        first = false;
+    };
+    os << std::fixed << std::setprecision(3);
+    for (auto &buffer : buffers) {
+        separate();
+        os << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+           << buffer->tid << ",\"args\":{\"name\":";
+        print_string(os, buffer->tid == 0
+                             ? "main"
+                             : "worker " + std::to_string(buffer->tid));
+        os << "}}";
+        for (auto &event : buffer->events) {
+            separate();
+            os << "{\"name\":";
+            print_string(os, event.name);
+            os << ",\"ph\":\"X\",\"ts\":" << micros(event.begin - start_time)
+               << ",\"dur\":" << micros(event.end - event.begin)
+               << ",\"pid\":1,\"tid\":" << buffer->tid;
+            if (not event.detail.empty()) {
+                os << ",\"args\":{\"function\":";
+                print_string(os, event.detail);
+                os << "}";
+            }
+            os << "}";
+        }
+        buffer->events.clear();
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+    os << std::defaultfloat;
+}
+
+} // namespace trace
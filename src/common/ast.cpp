@@ -1,7 +1,13 @@
 #include "ast.hpp"
+extern "C" {
+// the token numbers and syntax_node_kind
+#include "syntax_analyzer.h"
+}
 
-#include <cstring>
+#include <algorithm>
+#include <cstddef>
 #include <iostream>
+#include <new>
 #include <stack>
 
 #define _AST_NODE_ERROR_                                                       \
@@ -9,9 +15,6 @@
                "Contact with TAs to solve your problem."                       \
             << std::endl;                                                      \
   std::abort();
-// NOTE: use std::string instead of strcmp to compare strings,
-// 注意使用这里的接口
-#define _STR_EQ(a, b) (strcmp((a), (b)) == 0)
 
 void AST::run_visitor(ASTVisitor &visitor) { root->accept(visitor); }
 
@@ -22,7 +25,47 @@ AST::AST(syntax_tree *s) {
   }
   auto node = transform_node_iter(s->root);
   del_syntax_tree(s);
-  root = std::shared_ptr<ASTProgram>(static_cast<ASTProgram *>(node));
+  root = static_cast<ASTProgram *>(node);
+}
+
+AST::~AST() {
+  for (auto *node : nodes_)
+    node->~ASTNode();
+}
+
+void *AST::allocate(std::size_t size) {
+  constexpr std::size_t block_size = 64 * 1024;
+  constexpr std::size_t align = alignof(std::max_align_t);
+  size = (size + align - 1) / align * align;
+  if (blocks_.empty() or block_size - block_used_ < size) {
+    blocks_.emplace_back(new char[std::max(size, block_size)]);
+    block_used_ = 0;
+    block_bytes_ += std::max(size, block_size);
+  }
+  void *p = blocks_.back().get() + block_used_;
+  block_used_ += size;
+  return p;
+}
+
+Symbol SymbolTable::intern(std::string_view name) {
+  auto it = symbols_.find(name);
+  if (it != symbols_.end())
+    return it->second;
+  Symbol sym = names_.size();
+  names_.emplace_back(name);
+  symbols_.emplace(names_.back(), sym);
+  return sym;
+}
+
+Symbol SymbolTable::lookup(std::string_view name) const {
+  auto it = symbols_.find(name);
+  return it == symbols_.end() ? none : it->second;
+}
+
+template <typename NodeType> NodeType *AST::create() {
+  auto *node = new (allocate(sizeof(NodeType))) NodeType();
+  nodes_.push_back(node);
+  return node;
 }
 
 ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
@@ -32,8 +75,11 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
   declaration-list -> declaration-list declaration | declaration
   将其转化成AST中ASTProgram的结构
   */
-  if (_STR_EQ(n->name, "program")) {
-    auto node = new ASTProgram();
+  switch (n->kind) {
+  case NODE_PROGRAM: {
+    auto node = create<ASTProgram>();
+    // for the symbols of the declarations below
+    root = node;
 
     // flatten declaration list
     std::stack<syntax_tree_node *>
@@ -48,20 +94,20 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
     while (!s.empty()) {
       auto child_node =
           static_cast<ASTDeclaration *>(transform_node_iter(s.top()));
-
-      auto child_node_shared = std::shared_ptr<ASTDeclaration>(child_node);
-      node->declarations.push_back(child_node_shared);
+      node->declarations.push_back(child_node);
       s.pop();
     }
     return node;
-  } else if (_STR_EQ(n->name, "declaration")) {
+  }
+  case NODE_DECLARATION: {
     return transform_node_iter(n->children[0]);
-  } else if (_STR_EQ(n->name, "var-declaration")) {
-    auto node = new ASTVarDeclaration();
+  }
+  case NODE_VAR_DECLARATION: {
+    auto node = create<ASTVarDeclaration>();
     // NOTE: 思考 ASTVarDeclaration的结构，需要填充的字段有哪些
     // type
     // 为什么不会有 TYPE_VOID?
-    if (_STR_EQ(n->children[0]->children[0]->name, "int"))
+    if (n->children[0]->children[0]->kind == INT)
       node->type = TYPE_INT;
     else
       node->type = TYPE_FLOAT;
@@ -69,10 +115,12 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
     // 由不同的表达式填充
     if (n->children_num == 3) {
       node->id = n->children[1]->name;
+      node->sym = root->symbols.intern(node->id);
     } else if (n->children_num == 6) {
       node->id = n->children[1]->name;
+      node->sym = root->symbols.intern(node->id);
       int num = std::stoi(n->children[3]->name);
-      auto num_node = std::make_shared<ASTNum>();
+      auto num_node = create<ASTNum>();
       num_node->i_val = num;
       num_node->type = TYPE_INT;
       node->num = num_node;
@@ -81,21 +129,23 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
       std::abort();
     }
     return node;
-  } else if (_STR_EQ(n->name, "fun-declaration")) {
+  }
+  case NODE_FUN_DECLARATION: {
     // fun-declaration -> type-specifier ID ( params ) compound-stmt
     // 由表达式和 ASTFunDeclaration的结构，我们需要填充
     // type, id, params, compound_stmt 这四个字段
-    auto node = new ASTFunDeclaration();
+    auto node = create<ASTFunDeclaration>();
     // type 字段填充
-    if (_STR_EQ(n->children[0]->children[0]->name, "int")) {
+    if (n->children[0]->children[0]->kind == INT) {
       node->type = TYPE_INT;
-    } else if (_STR_EQ(n->children[0]->children[0]->name, "float")) {
+    } else if (n->children[0]->children[0]->kind == FLOAT) {
       node->type = TYPE_FLOAT;
     } else {
       node->type = TYPE_VOID;
     }
     // id 字段填充
     node->id = n->children[1]->name;
+    node->sym = root->symbols.intern(node->id);
 
     // flatten params
     std::stack<syntax_tree_node *> s;
@@ -111,30 +161,32 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
 
       while (!s.empty()) {
         auto child_node = static_cast<ASTParam *>(transform_node_iter(s.top()));
-        auto child_node_shared = std::shared_ptr<ASTParam>(child_node);
-        node->params.push_back(child_node_shared);
+        node->params.push_back(child_node);
         s.pop();
       }
     }
 
     auto stmt_node =
         static_cast<ASTCompoundStmt *>(transform_node_iter(n->children[5]));
-    node->compound_stmt = std::shared_ptr<ASTCompoundStmt>(stmt_node);
+    node->compound_stmt = stmt_node;
     return node;
-  } else if (_STR_EQ(n->name, "param")) {
+  }
+  case NODE_PARAM: {
     // param -> type-specifier ID | type-specifier ID [ ]
     // ASTParam的结构 主要需要填充的属性有 type, id, isarray
-    auto node = new ASTParam();
-    if (_STR_EQ(n->children[0]->children[0]->name, "int"))
+    auto node = create<ASTParam>();
+    if (n->children[0]->children[0]->kind == INT)
       node->type = TYPE_INT;
     else
       node->type = TYPE_FLOAT;
     node->id = n->children[1]->name;
+    node->sym = root->symbols.intern(node->id);
     if (n->children_num > 2)
       node->isarray = true;
     return node;
-  } else if (_STR_EQ(n->name, "compound-stmt")) {
-    auto node = new ASTCompoundStmt();
+  }
+  case NODE_COMPOUND_STMT: {
+    auto node = create<ASTCompoundStmt>();
     if (n->children[1]->children_num == 2) {
       // flatten local declarations
       auto list_ptr = n->children[1];
@@ -147,8 +199,7 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
       while (!s.empty()) {
         auto decl_node =
             static_cast<ASTVarDeclaration *>(transform_node_iter(s.top()));
-        auto decl_node_ptr = std::shared_ptr<ASTVarDeclaration>(decl_node);
-        node->local_declarations.push_back(decl_node_ptr);
+        node->local_declarations.push_back(decl_node);
         s.pop();
       }
     }
@@ -165,180 +216,180 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
       while (!s.empty()) {
         auto stmt_node =
             static_cast<ASTStatement *>(transform_node_iter(s.top()));
-        auto stmt_node_ptr = std::shared_ptr<ASTStatement>(stmt_node);
-        node->statement_list.push_back(stmt_node_ptr);
+        node->statement_list.push_back(stmt_node);
         s.pop();
       }
     }
     return node;
-  } else if (_STR_EQ(n->name, "statement")) {
+  }
+  case NODE_STATEMENT: {
     return transform_node_iter(n->children[0]);
-  } else if (_STR_EQ(n->name, "expression-stmt")) {
-    auto node = new ASTExpressionStmt();
+  }
+  case NODE_EXPRESSION_STMT: {
+    auto node = create<ASTExpressionStmt>();
     if (n->children_num == 2) {
       auto expr_node =
           static_cast<ASTExpression *>(transform_node_iter(n->children[0]));
-
-      auto expr_node_ptr = std::shared_ptr<ASTExpression>(expr_node);
-      node->expression = expr_node_ptr;
+      node->expression = expr_node;
     }
     return node;
-  } else if (_STR_EQ(n->name, "selection-stmt")) {
-    auto node = new ASTSelectionStmt();
+  }
+  case NODE_SELECTION_STMT: {
+    auto node = create<ASTSelectionStmt>();
 
     auto expr_node =
         static_cast<ASTExpression *>(transform_node_iter(n->children[2]));
-    auto expr_node_ptr = std::shared_ptr<ASTExpression>(expr_node);
-    node->expression = expr_node_ptr;
+    node->expression = expr_node;
 
     auto if_stmt_node =
         static_cast<ASTStatement *>(transform_node_iter(n->children[4]));
-    auto if_stmt_node_ptr = std::shared_ptr<ASTStatement>(if_stmt_node);
-    node->if_statement = if_stmt_node_ptr;
+    node->if_statement = if_stmt_node;
 
     // check whether this selection statement contains
     // else structure
     if (n->children_num == 7) {
       auto else_stmt_node =
           static_cast<ASTStatement *>(transform_node_iter(n->children[6]));
-      auto else_stmt_node_ptr = std::shared_ptr<ASTStatement>(else_stmt_node);
-      node->else_statement = else_stmt_node_ptr;
+      node->else_statement = else_stmt_node;
     }
 
     return node;
-  } else if (_STR_EQ(n->name, "iteration-stmt")) {
-    auto node = new ASTIterationStmt();
+  }
+  case NODE_ITERATION_STMT: {
+    auto node = create<ASTIterationStmt>();
 
     auto expr_node =
         static_cast<ASTExpression *>(transform_node_iter(n->children[2]));
-    auto expr_node_ptr = std::shared_ptr<ASTExpression>(expr_node);
-    node->expression = expr_node_ptr;
+    node->expression = expr_node;
 
     auto stmt_node =
         static_cast<ASTStatement *>(transform_node_iter(n->children[4]));
-    auto stmt_node_ptr = std::shared_ptr<ASTStatement>(stmt_node);
-    node->statement = stmt_node_ptr;
+    node->statement = stmt_node;
 
     return node;
-  } else if (_STR_EQ(n->name, "return-stmt")) {
-    auto node = new ASTReturnStmt();
+  }
+  case NODE_RETURN_STMT: {
+    auto node = create<ASTReturnStmt>();
     if (n->children_num == 3) {
       auto expr_node =
           static_cast<ASTExpression *>(transform_node_iter(n->children[1]));
-      node->expression = std::shared_ptr<ASTExpression>(expr_node);
+      node->expression = expr_node;
     }
     return node;
-  } else if (_STR_EQ(n->name, "expression")) {
+  }
+  case NODE_EXPRESSION: {
     // simple-expression
     if (n->children_num == 1) {
       return transform_node_iter(n->children[0]);
     }
-    auto node = new ASTAssignExpression();
+    auto node = create<ASTAssignExpression>();
 
     auto var_node = static_cast<ASTVar *>(transform_node_iter(n->children[0]));
-    node->var = std::shared_ptr<ASTVar>(var_node);
+    node->var = var_node;
 
     auto expr_node =
         static_cast<ASTExpression *>(transform_node_iter(n->children[2]));
-    node->expression = std::shared_ptr<ASTExpression>(expr_node);
+    node->expression = expr_node;
 
     return node;
-  } else if (_STR_EQ(n->name, "var")) {
-    auto node = new ASTVar();
+  }
+  case NODE_VAR: {
+    auto node = create<ASTVar>();
     node->id = n->children[0]->name;
+    node->sym = root->symbols.intern(node->id);
     if (n->children_num == 4) {
       auto expr_node =
           static_cast<ASTExpression *>(transform_node_iter(n->children[2]));
-      node->expression = std::shared_ptr<ASTExpression>(expr_node);
+      node->expression = expr_node;
     }
     return node;
-  } else if (_STR_EQ(n->name, "simple-expression")) {
-    auto node = new ASTSimpleExpression();
+  }
+  case NODE_SIMPLE_EXPRESSION: {
+    auto node = create<ASTSimpleExpression>();
     auto expr_node_1 = static_cast<ASTAdditiveExpression *>(
         transform_node_iter(n->children[0]));
-    node->additive_expression_l =
-        std::shared_ptr<ASTAdditiveExpression>(expr_node_1);
+    node->additive_expression_l = expr_node_1;
 
     if (n->children_num == 3) {
-      auto op_name = n->children[1]->children[0]->name;
-      if (_STR_EQ(op_name, "<="))
+      auto op = n->children[1]->children[0]->kind;
+      if (op == LTE)
         node->op = OP_LE;
-      else if (_STR_EQ(op_name, "<"))
+      else if (op == LT)
         node->op = OP_LT;
-      else if (_STR_EQ(op_name, ">"))
+      else if (op == GT)
         node->op = OP_GT;
-      else if (_STR_EQ(op_name, ">="))
+      else if (op == GTE)
         node->op = OP_GE;
-      else if (_STR_EQ(op_name, "=="))
+      else if (op == EQ)
         node->op = OP_EQ;
-      else if (_STR_EQ(op_name, "!="))
+      else if (op == NEQ)
         node->op = OP_NEQ;
 
       auto expr_node_2 = static_cast<ASTAdditiveExpression *>(
           transform_node_iter(n->children[2]));
-      node->additive_expression_r =
-          std::shared_ptr<ASTAdditiveExpression>(expr_node_2);
+      node->additive_expression_r = expr_node_2;
     }
     return node;
-  } else if (_STR_EQ(n->name, "additive-expression")) {
-    auto node = new ASTAdditiveExpression();
+  }
+  case NODE_ADDITIVE_EXPRESSION: {
+    auto node = create<ASTAdditiveExpression>();
     if (n->children_num == 3) {
       auto add_expr_node = static_cast<ASTAdditiveExpression *>(
           transform_node_iter(n->children[0]));
-      node->additive_expression =
-          std::shared_ptr<ASTAdditiveExpression>(add_expr_node);
+      node->additive_expression = add_expr_node;
 
-      auto op_name = n->children[1]->children[0]->name;
-      if (_STR_EQ(op_name, "+"))
+      auto op = n->children[1]->children[0]->kind;
+      if (op == ADD)
         node->op = OP_PLUS;
-      else if (_STR_EQ(op_name, "-"))
+      else if (op == SUB)
         node->op = OP_MINUS;
 
       auto term_node =
           static_cast<ASTTerm *>(transform_node_iter(n->children[2]));
-      node->term = std::shared_ptr<ASTTerm>(term_node);
+      node->term = term_node;
     } else {
       auto term_node =
           static_cast<ASTTerm *>(transform_node_iter(n->children[0]));
-      node->term = std::shared_ptr<ASTTerm>(term_node);
+      node->term = term_node;
     }
     return node;
-  } else if (_STR_EQ(n->name, "term")) {
-    auto node = new ASTTerm();
+  }
+  case NODE_TERM: {
+    auto node = create<ASTTerm>();
     if (n->children_num == 3) {
       auto term_node =
           static_cast<ASTTerm *>(transform_node_iter(n->children[0]));
-      node->term = std::shared_ptr<ASTTerm>(term_node);
+      node->term = term_node;
 
-      auto op_name = n->children[1]->children[0]->name;
-      if (_STR_EQ(op_name, "*"))
+      auto op = n->children[1]->children[0]->kind;
+      if (op == MUL)
         node->op = OP_MUL;
-      else if (_STR_EQ(op_name, "/"))
+      else if (op == DIV)
         node->op = OP_DIV;
 
       auto factor_node =
           static_cast<ASTFactor *>(transform_node_iter(n->children[2]));
-      node->factor = std::shared_ptr<ASTFactor>(factor_node);
+      node->factor = factor_node;
     } else {
       auto factor_node =
           static_cast<ASTFactor *>(transform_node_iter(n->children[0]));
-      node->factor = std::shared_ptr<ASTFactor>(factor_node);
+      node->factor = factor_node;
     }
     return node;
-  } else if (_STR_EQ(n->name, "factor")) {
+  }
+  case NODE_FACTOR: {
     int i = 0;
     if (n->children_num == 3)
       i = 1;
-    auto name = n->children[i]->name;
-    if (_STR_EQ(name, "expression") || _STR_EQ(name, "var") ||
-        _STR_EQ(name, "call"))
+    auto kind = n->children[i]->kind;
+    if (kind == NODE_EXPRESSION || kind == NODE_VAR || kind == NODE_CALL)
       return transform_node_iter(n->children[i]);
     else {
-      auto num_node = new ASTNum();
-      if (_STR_EQ(name, "integer")) {
+      auto num_node = create<ASTNum>();
+      if (kind == NODE_INTEGER) {
         num_node->type = TYPE_INT;
         num_node->i_val = std::stoi(n->children[i]->children[0]->name);
-      } else if (_STR_EQ(name, "float")) {
+      } else if (kind == NODE_FLOAT) {
         num_node->type = TYPE_FLOAT;
         num_node->f_val = std::stof(n->children[i]->children[0]->name);
       } else {
@@ -346,11 +397,13 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
       }
       return num_node;
     }
-  } else if (_STR_EQ(n->name, "call")) {
-    auto node = new ASTCall();
+  }
+  case NODE_CALL: {
+    auto node = create<ASTCall>();
     node->id = n->children[0]->name;
+    node->sym = root->symbols.intern(node->id);
     // flatten args
-    if (_STR_EQ(n->children[2]->children[0]->name, "arg-list")) {
+    if (n->children[2]->children[0]->kind == NODE_ARG_LIST) {
       auto list_ptr = n->children[2]->children[0];
       auto s = std::stack<syntax_tree_node *>();
       while (list_ptr->children_num == 3) {
@@ -362,13 +415,13 @@ ASTNode *AST::transform_node_iter(syntax_tree_node *n) {
       while (!s.empty()) {
         auto expr_node =
             static_cast<ASTExpression *>(transform_node_iter(s.top()));
-        auto expr_node_ptr = std::shared_ptr<ASTExpression>(expr_node);
-        node->args.push_back(expr_node_ptr);
+        node->args.push_back(expr_node);
         s.pop();
       }
     }
     return node;
-  } else {
+  }
+  default:
     std::cerr << "[ast]: transform failure!" << std::endl;
     std::abort();
   }
@@ -1,16 +1,17 @@
 #include "logging.hpp"
 
-void LogWriter::operator<(const LogStream &stream) {
-    std::ostringstream msg;
-    msg << stream.sstream_.rdbuf();
-    output_log(msg);
+int read_env_log_level() {
+    char *logv = std::getenv("LOGV");
+    if (not logv)
+        return 4;
+    return std::atoi(logv);
 }
 
-void LogWriter::output_log(const std::ostringstream &msg) {
-    if (log_level_ >= env_log_level)
-        std::cout << "[" << level2string(log_level_) << "] "
-                  << "(" << location_.file_ << ":" << location_.line_ << "L  "
-                  << location_.func_ << ")" << msg.str() << std::endl;
+void LogWriter::operator<(const LogStream &stream) {
+    std::cout << "[" << level2string(log_level_) << "] "
+              << "(" << get_short_name(location_.file_) << ":"
+              << location_.line_ << "L  " << location_.func_ << ")"
+              << stream.sstream_.str() << std::endl;
 }
 std::string level2string(LogLevel level) {
     switch (level) {
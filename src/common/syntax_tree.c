@@ -3,19 +3,82 @@
 
 #include "syntax_tree.h"
 
+#define MAX_LEGACY_CHILDREN 10
+#define BLOCK_SIZE (64 * 1024)
+
+struct _syntax_tree_block {
+    struct _syntax_tree_block *next;
+    size_t used;
+    size_t size;
+    // the nodes, aligned as the block itself
+    void *data[];
+};
+
+static void *tree_alloc(syntax_tree *tree, size_t size) {
+    size = (size + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    struct _syntax_tree_block *block = tree->blocks;
+    if (!block || block->size - block->used < size) {
+        size_t block_size = size > BLOCK_SIZE ? size : BLOCK_SIZE;
+        block = (struct _syntax_tree_block *)malloc(
+            sizeof(struct _syntax_tree_block) + block_size);
+        block->next = tree->blocks;
+        block->used = 0;
+        block->size = block_size;
+        tree->blocks = block;
+    }
+    void *p = (char *)block->data + block->used;
+    block->used += size;
+    return p;
+}
+
+syntax_tree_node *syntax_tree_new_node(syntax_tree *tree, int kind,
+                                       const char *name, int children_num) {
+    syntax_tree_node *new_node =
+        (syntax_tree_node *)tree_alloc(tree, sizeof(syntax_tree_node));
+    new_node->children =
+        children_num ? (syntax_tree_node **)tree_alloc(
+                           tree, children_num * sizeof(syntax_tree_node *))
+                     : NULL;
+    new_node->children_num = children_num;
+    new_node->kind = kind;
+    new_node->name = name;
+    tree->num_nodes++;
+    return new_node;
+}
+
+const char *syntax_tree_copy_text(syntax_tree *tree, const char *text,
+                                  size_t size) {
+    char *copy = (char *)tree_alloc(tree, size + 1);
+    memcpy(copy, text, size);
+    copy[size] = '\0';
+    return copy;
+}
+
+void syntax_tree_memory(const syntax_tree *tree, size_t *bytes,
+                        size_t *nodes) {
+    *bytes = 0;
+    for (struct _syntax_tree_block *block = tree->blocks; block;
+         block = block->next)
+        *bytes += sizeof(struct _syntax_tree_block) + block->size;
+    *nodes = tree->num_nodes;
+}
+
 syntax_tree_node *new_syntax_tree_node(const char *name) {
     syntax_tree_node *new_node =
         (syntax_tree_node *)malloc(sizeof(syntax_tree_node));
-    if (name)
-        strncpy(new_node->name, name, SYNTAX_TREE_NODE_NAME_MAX);
-    else
-        new_node->name[0] = '\0';
+    new_node->children = (syntax_tree_node **)malloc(
+        MAX_LEGACY_CHILDREN * sizeof(syntax_tree_node *));
     new_node->children_num = 0;
+    new_node->kind = 0;
+    if (!name)
+        name = "";
+    size_t size = strlen(name) + 1;
+    new_node->name = (const char *)memcpy(malloc(size), name, size);
     return new_node;
 }
 
 int syntax_tree_add_child(syntax_tree_node *parent, syntax_tree_node *child) {
-    if (!parent || !child)
+    if (!parent || !child || parent->children_num == MAX_LEGACY_CHILDREN)
         return -1;
     parent->children[parent->children_num++] = child;
     return parent->children_num;
@@ -31,18 +94,30 @@ void del_syntax_tree_node(syntax_tree_node *node, int recursive) {
             del_syntax_tree_node(node->children[i], 1);
         }
     }
+    free(node->children);
+    free((char *)node->name);
     free(node);
 }
 
 syntax_tree *new_syntax_tree() {
-    return (syntax_tree *)malloc(sizeof(syntax_tree));
+    syntax_tree *tree = (syntax_tree *)malloc(sizeof(syntax_tree));
+    tree->root = NULL;
+    tree->blocks = NULL;
+    tree->num_nodes = 0;
+    return tree;
 }
 
 void del_syntax_tree(syntax_tree *tree) {
     if (!tree)
         return;
 
-    if (tree->root) {
+    if (tree->blocks) {
+        while (tree->blocks) {
+            struct _syntax_tree_block *next = tree->blocks->next;
+            free(tree->blocks);
+            tree->blocks = next;
+        }
+    } else if (tree->root) {
         del_syntax_tree_node(tree->root, 1);
     }
     free(tree);
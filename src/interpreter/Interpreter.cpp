@@ -0,0 +1,578 @@
+#include "Interpreter.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+
+namespace {
+
+// reserved up front, only the touched pages are backed
+constexpr std::size_t stack_size = std::size_t(64) << 20;
+constexpr std::size_t max_regs = std::size_t(1) << 24;
+
+uint32_t align8(uint32_t size) { return (size + 7) / 8 * 8; }
+
+// two's complement like the machine, without the undefined behaviour
+int32_t wrap(int64_t val) { return static_cast<int32_t>(static_cast<uint32_t>(val)); }
+
+// what the interpreter provides in place of io.c
+bool is_runtime(const std::string &name) {
+    return name == "input" or name == "output" or name == "outputFloat" or
+           name == "neg_idx_except";
+}
+
+void overflow() {
+    std::fprintf(stderr, "stack overflow\n");
+    std::abort();
+}
+
+} // namespace
+
+Interpreter::Interpreter(Module *m) {
+    for (auto &func : m->get_functions()) {
+        function_ids_.emplace(&func, functions_.size());
+        functions_.push_back(&func);
+    }
+    codes_.resize(functions_.size());
+
+    uint32_t size = 0;
+    std::vector<std::pair<GlobalVariable *, uint32_t>> offsets;
+    for (auto &global : m->get_global_variable()) {
+        offsets.emplace_back(&global, size);
+        size += align8(global.get_type()->get_pointer_element_type()->get_size());
+    }
+    data_.reset(new char[size + 1]());
+    for (auto &[global, offset] : offsets) {
+        globals_[global] = data_.get() + offset;
+        if (global->get_init())
+            init_global(data_.get() + offset, global->get_init(),
+                        global->get_type()->get_pointer_element_type());
+    }
+
+    stack_.reset(new char[stack_size]);
+    stack_top_ = stack_.get();
+    stack_end_ = stack_top_ + stack_size;
+    regs_.reset(new Reg[max_regs]);
+}
+
+void Interpreter::init_global(char *data, Constant *init, Type *type) {
+    if (auto c = init->dyn_cast<ConstantInt>()) {
+        int32_t val = c->get_value();
+        if (type->is_int1_type())
+            *data = static_cast<char>(val);
+        else
+            std::memcpy(data, &val, 4);
+    } else if (auto f = init->dyn_cast<ConstantFP>()) {
+        float val = f->get_value();
+        std::memcpy(data, &val, 4);
+    } else if (auto array = init->dyn_cast<ConstantArray>()) {
+        auto elem_type = static_cast<ArrayType *>(type)->get_element_type();
+        for (unsigned i = 0; i < array->get_size_of_array(); i++)
+            init_global(data + i * elem_type->get_size(),
+                        array->get_element_value(i), elem_type);
+    }
+    // ConstantZero: the data starts zeroed
+}
+
+int Interpreter::run() {
+    Function *main = nullptr;
+    for (auto func : functions_) {
+        if (func->get_name() == "main")
+            main = func;
+    }
+    if (main == nullptr or main->is_declaration()) {
+        std::fprintf(stderr, "run: no main to run\n");
+        return 1;
+    }
+    // the functions are decoded as they are called, check the calls of
+    // external functions up front like a link would
+    for (auto func : functions_) {
+        if (func->is_declaration() and not func->get_use_list().empty() and
+            not is_runtime(func->get_name())) {
+            std::fprintf(stderr, "run: call of unknown external function %s\n",
+                         func->get_name().c_str());
+            return 1;
+        }
+    }
+    auto result = execute(get_code(main));
+    std::fflush(stdout);
+    if (stopped_ or main->get_return_type()->is_void_type())
+        return 0;
+    return result.i;
+}
+
+const Interpreter::Code &Interpreter::get_code(Function *func) {
+    auto &code = codes_[function_ids_.at(func)];
+    if (not code) {
+        code = std::make_unique<Code>();
+        decode(func, *code);
+    }
+    return *code;
+}
+
+void Interpreter::decode(Function *func, Code &code) {
+    // registers: constants, arguments, instructions, phi temporaries and
+    // the result of void calls
+    std::unordered_map<Value *, uint32_t> regs;
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &instr : bb.get_instructions()) {
+            for (auto op : instr.get_operands()) {
+                if (regs.count(op))
+                    continue;
+                Reg val;
+                val.p = nullptr;
+                if (auto c = op->dyn_cast<ConstantInt>())
+                    val.i = c->get_value();
+                else if (auto f = op->dyn_cast<ConstantFP>())
+                    val.f = f->get_value();
+                else if (op->is<GlobalVariable>())
+                    val.p = globals_.at(op);
+                else if (not op->is<ConstantZero>())
+                    continue;
+                regs.emplace(op, code.constants.size());
+                code.constants.push_back(val);
+            }
+        }
+    }
+    auto num_regs = static_cast<uint32_t>(code.constants.size());
+    for (auto &arg : func->get_args())
+        regs.emplace(&arg, num_regs++);
+    std::size_t max_phis = 0;
+    for (auto &bb : func->get_basic_blocks()) {
+        std::size_t phis = 0;
+        for (auto &instr : bb.get_instructions()) {
+            if (not instr.is_void())
+                regs.emplace(&instr, num_regs++);
+            phis += instr.is_phi();
+        }
+        max_phis = std::max(max_phis, phis);
+    }
+    auto temps = num_regs;
+    auto sink = static_cast<uint32_t>(temps + max_phis);
+    code.num_regs = sink + 1;
+    auto reg = [&](Value *val) { return regs.at(val); };
+
+    auto &ops = code.ops;
+    auto emit = [&](Opcode opcode, uint32_t dst, uint32_t a = 0, uint32_t b = 0,
+                    uint32_t c = 0, int64_t imm = 0) {
+        ops.push_back({opcode, dst, a, b, c, imm});
+    };
+    // branch targets are patched once the blocks and stubs are placed
+    struct Fixup {
+        std::size_t op;
+        uint32_t Op::*field;
+        BasicBlock *from, *to;
+    };
+    std::vector<Fixup> fixups;
+    std::unordered_map<BasicBlock *, uint32_t> block_pcs;
+    for (auto &bb : func->get_basic_blocks()) {
+        block_pcs[&bb] = ops.size();
+        for (auto &instr : bb.get_instructions()) {
+            auto dst = instr.is_void() ? sink : reg(&instr);
+            auto op0 = instr.get_num_operand() > 0 ? instr.get_operand(0) : nullptr;
+            auto binary = [&](Opcode opcode) {
+                emit(opcode, dst, reg(op0), reg(instr.get_operand(1)));
+            };
+            switch (instr.get_instr_type()) {
+            case Instruction::add:
+                binary(Opcode::add);
+                break;
+            case Instruction::sub:
+                binary(Opcode::sub);
+                break;
+            case Instruction::mul:
+                binary(Opcode::mul);
+                break;
+            case Instruction::sdiv:
+                binary(Opcode::sdiv);
+                break;
+            case Instruction::fadd:
+                binary(Opcode::fadd);
+                break;
+            case Instruction::fsub:
+                binary(Opcode::fsub);
+                break;
+            case Instruction::fmul:
+                binary(Opcode::fmul);
+                break;
+            case Instruction::fdiv:
+                binary(Opcode::fdiv);
+                break;
+            case Instruction::ge:
+                binary(Opcode::ge);
+                break;
+            case Instruction::gt:
+                binary(Opcode::gt);
+                break;
+            case Instruction::le:
+                binary(Opcode::le);
+                break;
+            case Instruction::lt:
+                binary(Opcode::lt);
+                break;
+            case Instruction::eq:
+                binary(Opcode::eq);
+                break;
+            case Instruction::ne:
+                binary(Opcode::ne);
+                break;
+            case Instruction::fge:
+                binary(Opcode::fge);
+                break;
+            case Instruction::fgt:
+                binary(Opcode::fgt);
+                break;
+            case Instruction::fle:
+                binary(Opcode::fle);
+                break;
+            case Instruction::flt:
+                binary(Opcode::flt);
+                break;
+            case Instruction::feq:
+                binary(Opcode::feq);
+                break;
+            case Instruction::fne:
+                binary(Opcode::fne);
+                break;
+            case Instruction::zext:
+            case Instruction::bitcast:
+                // i1 is 0 or 1 in the 32 bits, a pointer stays the same
+                emit(Opcode::mov, dst, reg(op0));
+                break;
+            case Instruction::fptosi:
+                emit(Opcode::fptosi, dst, reg(op0));
+                break;
+            case Instruction::sitofp:
+                emit(Opcode::sitofp, dst, reg(op0));
+                break;
+            case Instruction::alloca: {
+                auto type = instr.as<AllocaInst>()->get_alloca_type();
+                emit(Opcode::frame_addr, dst, 0, 0, 0, code.frame_size);
+                code.frame_size += align8(type->get_size());
+                break;
+            }
+            case Instruction::load: {
+                auto type = instr.get_type();
+                auto opcode = type->is_int1_type()      ? Opcode::load8
+                              : type->is_pointer_type() ? Opcode::load64
+                                                        : Opcode::load32;
+                emit(opcode, dst, reg(op0));
+                break;
+            }
+            case Instruction::store: {
+                auto type = op0->get_type();
+                auto opcode = type->is_int1_type()      ? Opcode::store8
+                              : type->is_pointer_type() ? Opcode::store64
+                                                        : Opcode::store32;
+                emit(opcode, 0, reg(op0), reg(instr.get_operand(1)));
+                break;
+            }
+            case Instruction::getelementptr: {
+                auto type = op0->get_type()->get_pointer_element_type();
+                int64_t offset = 0;
+                auto base = reg(op0);
+                for (unsigned i = 1; i < instr.get_num_operand(); i++) {
+                    if (i > 1)
+                        type = static_cast<ArrayType *>(type)->get_element_type();
+                    auto idx = instr.get_operand(i);
+                    int64_t size = type->get_size();
+                    if (auto c = idx->dyn_cast<ConstantInt>())
+                        offset += c->get_value() * size;
+                    else if (not idx->is<ConstantZero>()) {
+                        emit(Opcode::ptr_add_scaled, dst, base, reg(idx), 0, size);
+                        base = dst;
+                    }
+                }
+                if (offset or base != dst)
+                    emit(Opcode::ptr_add, dst, base, 0, 0, offset);
+                break;
+            }
+            case Instruction::call: {
+                auto callee = op0->as<Function>();
+                auto num_args = instr.get_num_operand() - 1;
+                if (callee->is_declaration()) {
+                    auto name = callee->get_name();
+                    if (name == "input")
+                        emit(Opcode::input, dst);
+                    else if (name == "output")
+                        emit(Opcode::output, 0, reg(instr.get_operand(1)));
+                    else if (name == "outputFloat")
+                        emit(Opcode::output_float, 0, reg(instr.get_operand(1)));
+                    else if (name == "neg_idx_except")
+                        emit(Opcode::neg_idx_except, 0);
+                    // run() turned down the calls of any other declaration
+                    break;
+                }
+                emit(Opcode::call, dst, function_ids_.at(callee),
+                     code.args.size(), num_args);
+                for (unsigned i = 1; i <= num_args; i++)
+                    code.args.push_back(reg(instr.get_operand(i)));
+                break;
+            }
+            case Instruction::br: {
+                auto br = instr.as<BranchInst>();
+                if (not br->is_cond_br()) {
+                    fixups.push_back({ops.size(), &Op::a, &bb,
+                                      op0->as<BasicBlock>()});
+                    emit(Opcode::jmp, 0);
+                    break;
+                }
+                fixups.push_back({ops.size(), &Op::b, &bb,
+                                  instr.get_operand(1)->as<BasicBlock>()});
+                fixups.push_back({ops.size(), &Op::c, &bb,
+                                  instr.get_operand(2)->as<BasicBlock>()});
+                emit(Opcode::br, 0, reg(op0));
+                break;
+            }
+            case Instruction::ret:
+                if (instr.get_num_operand())
+                    emit(Opcode::ret, 0, reg(op0));
+                else
+                    emit(Opcode::ret_void, 0);
+                break;
+            case Instruction::phi:
+                // set on the edges
+                break;
+            }
+        }
+    }
+
+    // an edge into phis goes through a stub with the copies, all sources
+    // are read before a phi is written
+    std::map<std::pair<BasicBlock *, BasicBlock *>, uint32_t> stubs;
+    for (auto &fixup : fixups) {
+        std::vector<std::pair<uint32_t, uint32_t>> copies;
+        for (auto &instr : fixup.to->get_instructions()) {
+            if (not instr.is_phi())
+                break;
+            for (auto &[val, pred] : instr.as<PhiInst>()->get_phi_pairs()) {
+                if (pred == fixup.from) {
+                    copies.emplace_back(reg(&instr), reg(val));
+                    break;
+                }
+            }
+        }
+        auto target = block_pcs.at(fixup.to);
+        if (not copies.empty()) {
+            auto [it, inserted] =
+                stubs.emplace(std::make_pair(fixup.from, fixup.to), ops.size());
+            if (inserted) {
+                bool overlap = false;
+                for (auto &[dst, src] : copies) {
+                    for (auto &other : copies)
+                        overlap |= src == other.first;
+                }
+                if (overlap) {
+                    for (unsigned k = 0; k < copies.size(); k++)
+                        emit(Opcode::mov, temps + k, copies[k].second);
+                    for (unsigned k = 0; k < copies.size(); k++)
+                        emit(Opcode::mov, copies[k].first, temps + k);
+                } else {
+                    for (auto &[dst, src] : copies)
+                        emit(Opcode::mov, dst, src);
+                }
+                emit(Opcode::jmp, 0, target);
+            }
+            target = it->second;
+        }
+        ops[fixup.op].*fixup.field = target;
+    }
+}
+
+Interpreter::Reg Interpreter::execute(const Code &entry) {
+    // the calls run in this loop on a stack of their own rather than the
+    // C++ one, so deep recursion ends in the stack overflow message
+    struct Frame {
+        const Code *code;
+        const Op *pc;
+        Reg *r;
+        char *frame;
+        // of the caller, where the result goes
+        uint32_t dst;
+    };
+    std::vector<Frame> calls;
+    const Code *code;
+    const Op *pc;
+    Reg *r;
+    char *frame;
+    auto enter = [&](const Code &callee) {
+        code = &callee;
+        pc = callee.ops.data();
+        r = regs_.get() + regs_top_;
+        std::memcpy(r, callee.constants.data(),
+                    callee.constants.size() * sizeof(Reg));
+        regs_top_ += callee.num_regs;
+        frame = stack_top_;
+        if (static_cast<std::size_t>(stack_end_ - stack_top_) <
+            callee.frame_size)
+            overflow();
+        stack_top_ += callee.frame_size;
+    };
+    // back to the caller, false if there is none
+    auto leave = [&](Reg result) {
+        regs_top_ -= code->num_regs;
+        stack_top_ = frame;
+        if (calls.empty())
+            return false;
+        auto &caller = calls.back();
+        code = caller.code;
+        pc = caller.pc;
+        r = caller.r;
+        frame = caller.frame;
+        r[caller.dst] = result;
+        calls.pop_back();
+        return true;
+    };
+    enter(entry);
+
+    for (;;) {
+        auto &op = *pc++;
+        switch (op.code) {
+        case Opcode::mov:
+            r[op.dst] = r[op.a];
+            break;
+        case Opcode::add:
+            r[op.dst].i = wrap(int64_t(r[op.a].i) + r[op.b].i);
+            break;
+        case Opcode::sub:
+            r[op.dst].i = wrap(int64_t(r[op.a].i) - r[op.b].i);
+            break;
+        case Opcode::mul:
+            r[op.dst].i = wrap(int64_t(r[op.a].i) * r[op.b].i);
+            break;
+        case Opcode::sdiv:
+            r[op.dst].i = wrap(int64_t(r[op.a].i) / r[op.b].i);
+            break;
+        case Opcode::fadd:
+            r[op.dst].f = r[op.a].f + r[op.b].f;
+            break;
+        case Opcode::fsub:
+            r[op.dst].f = r[op.a].f - r[op.b].f;
+            break;
+        case Opcode::fmul:
+            r[op.dst].f = r[op.a].f * r[op.b].f;
+            break;
+        case Opcode::fdiv:
+            r[op.dst].f = r[op.a].f / r[op.b].f;
+            break;
+        case Opcode::ge:
+            r[op.dst].i = r[op.a].i >= r[op.b].i;
+            break;
+        case Opcode::gt:
+            r[op.dst].i = r[op.a].i > r[op.b].i;
+            break;
+        case Opcode::le:
+            r[op.dst].i = r[op.a].i <= r[op.b].i;
+            break;
+        case Opcode::lt:
+            r[op.dst].i = r[op.a].i < r[op.b].i;
+            break;
+        case Opcode::eq:
+            r[op.dst].i = r[op.a].i == r[op.b].i;
+            break;
+        case Opcode::ne:
+            r[op.dst].i = r[op.a].i != r[op.b].i;
+            break;
+        // the unordered compares of the builder: true on a nan
+        case Opcode::fge:
+            r[op.dst].i = not(r[op.a].f < r[op.b].f);
+            break;
+        case Opcode::fgt:
+            r[op.dst].i = not(r[op.a].f <= r[op.b].f);
+            break;
+        case Opcode::fle:
+            r[op.dst].i = not(r[op.a].f > r[op.b].f);
+            break;
+        case Opcode::flt:
+            r[op.dst].i = not(r[op.a].f >= r[op.b].f);
+            break;
+        case Opcode::feq:
+            r[op.dst].i = not(r[op.a].f < r[op.b].f or r[op.a].f > r[op.b].f);
+            break;
+        case Opcode::fne:
+            r[op.dst].i = r[op.a].f != r[op.b].f;
+            break;
+        case Opcode::fptosi:
+            r[op.dst].i = static_cast<int32_t>(r[op.a].f);
+            break;
+        case Opcode::sitofp:
+            r[op.dst].f = static_cast<float>(r[op.a].i);
+            break;
+        case Opcode::frame_addr:
+            r[op.dst].p = frame + op.imm;
+            break;
+        case Opcode::load8:
+            r[op.dst].i = static_cast<unsigned char>(*r[op.a].p);
+            break;
+        case Opcode::load32:
+            std::memcpy(&r[op.dst], r[op.a].p, 4);
+            break;
+        case Opcode::load64:
+            std::memcpy(&r[op.dst], r[op.a].p, 8);
+            break;
+        case Opcode::store8:
+            *r[op.b].p = static_cast<char>(r[op.a].i);
+            break;
+        case Opcode::store32:
+            std::memcpy(r[op.b].p, &r[op.a], 4);
+            break;
+        case Opcode::store64:
+            std::memcpy(r[op.b].p, &r[op.a], 8);
+            break;
+        case Opcode::ptr_add:
+            r[op.dst].p = r[op.a].p + op.imm;
+            break;
+        case Opcode::ptr_add_scaled:
+            r[op.dst].p = r[op.a].p + int64_t(r[op.b].i) * op.imm;
+            break;
+        case Opcode::call: {
+            auto &callee = get_code(functions_[op.a]);
+            if (max_regs - regs_top_ < callee.num_regs)
+                overflow();
+            auto args = regs_.get() + regs_top_ + callee.constants.size();
+            for (uint32_t k = 0; k < op.c; k++)
+                args[k] = r[code->args[op.b + k]];
+            calls.push_back({code, pc, r, frame, op.dst});
+            enter(callee);
+            break;
+        }
+        case Opcode::input: {
+            int val = 0;
+            if (std::scanf("%d", &val) != 1)
+                val = 0;
+            r[op.dst].i = val;
+            break;
+        }
+        case Opcode::output:
+            std::printf("%d\n", r[op.a].i);
+            break;
+        case Opcode::output_float:
+            std::printf("%f\n", r[op.a].f);
+            break;
+        case Opcode::neg_idx_except:
+            // ends the program like exit(0) in io.c
+            std::printf("negative index exception\n");
+            stopped_ = true;
+            return Reg{};
+        case Opcode::jmp:
+            pc = code->ops.data() + op.a;
+            break;
+        case Opcode::br:
+            pc = code->ops.data() + (r[op.a].i ? op.b : op.c);
+            break;
+        case Opcode::ret: {
+            auto result = r[op.a];
+            if (not leave(result))
+                return result;
+            break;
+        }
+        case Opcode::ret_void:
+            if (not leave(Reg{}))
+                return Reg{};
+            break;
+        }
+    }
+}
@@ -5,3 +5,9 @@ void output(int a);
 void outputFloat(float a);
 
 void neg_idx_except();
+
+// -fprofile-generate, see profile.c: main starts with profile_init(), the
+// counts are written at exit or by profile_flush()
+void profile_init(int *records, int size);
+
+void profile_flush(void);
@@ -0,0 +1,161 @@
+/* The runtime of io.c for programs that print or read a lot: output goes to
+ * a large buffer written when full and at exit, numbers are formatted and
+ * parsed by hand, and input() takes its characters from big read()s of
+ * stdin. What is printed is byte for byte what io.c prints. Link with
+ * -lcminus_io_fast instead of -lcminus_io. */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "io.h"
+
+#define OUT_SIZE (1 << 16)
+#define IN_SIZE (1 << 16)
+
+static char out_buf[OUT_SIZE];
+static size_t out_len;
+static int registered;
+// output is written before input() waits on a terminal, as stdio does
+static int stdout_tty = -1;
+
+static char in_buf[IN_SIZE];
+static size_t in_pos, in_len;
+static int in_eof;
+
+static void flush_output(void) {
+    size_t done = 0;
+    while (done < out_len) {
+        ssize_t n = write(STDOUT_FILENO, out_buf + done, out_len - done);
+        if (n <= 0)
+            break;
+        done += n;
+    }
+    out_len = 0;
+}
+
+// room for at least `size` more bytes
+static char *reserve(size_t size) {
+    if (!registered) {
+        registered = 1;
+        atexit(flush_output);
+    }
+    if (out_len + size > OUT_SIZE)
+        flush_output();
+    return out_buf + out_len;
+}
+
+// the digits of v backwards from end, returns the first
+static char *format_unsigned(char *end, uint64_t v) {
+    do {
+        *--end = '0' + v % 10;
+        v /= 10;
+    } while (v);
+    return end;
+}
+
+void output(int a) {
+    char digits[24], *end = digits + sizeof(digits);
+    char *p = format_unsigned(end, a < 0 ? -(int64_t)a : a);
+    if (a < 0)
+        *--p = '-';
+    size_t len = end - p;
+    char *out = reserve(len + 1);
+    memcpy(out, p, len);
+    out[len] = '\n';
+    out_len += len + 1;
+}
+
+/* printf("%f\n", a): a is m * 2^e exactly, so a * 10^6 is rounded to an
+ * integer half to even like glibc does, in 128 bit arithmetic. Values of
+ * 2^64 and beyond, inf and nan go through snprintf. */
+void outputFloat(float a) {
+    int exp;
+    float frac = frexpf(fabsf(a), &exp);
+    if (!isfinite(a) || exp > 64) {
+        char *out = reserve(64);
+        out_len += snprintf(out, 64, "%f\n", a);
+        return;
+    }
+    // a = mant * 2^(exp - 24), fixed = a * 10^6 below 2^64 * 10^6 < 2^84
+    unsigned __int128 fixed = (uint64_t)ldexpf(frac, 24) * 1000000ull;
+    int shift = exp - 24;
+    if (shift >= 0) {
+        fixed <<= shift;
+    } else if (-shift >= 100) {
+        // fixed is below 2^44, far less than half of 2^-shift
+        fixed = 0;
+    } else {
+        unsigned __int128 one = (unsigned __int128)1 << -shift;
+        unsigned __int128 rest = fixed & (one - 1), half = one >> 1;
+        fixed >>= -shift;
+        if (rest > half || (rest == half && (fixed & 1)))
+            fixed++;
+    }
+    char digits[48], *end = digits + sizeof(digits);
+    char *p = end;
+    *--p = '\n';
+    // the six decimals with their zeros, the leading 1 is dropped
+    p = format_unsigned(p, (uint64_t)(fixed % 1000000) + 1000000) + 1;
+    *--p = '.';
+    p = format_unsigned(p, (uint64_t)(fixed / 1000000));
+    if (signbit(a))
+        *--p = '-';
+    size_t len = end - p;
+    memcpy(reserve(len), p, len);
+    out_len += len;
+}
+
+// the next character of stdin, EOF at its end
+static int next_char(void) {
+    if (in_pos == in_len) {
+        if (in_eof)
+            return EOF;
+        if (stdout_tty < 0)
+            stdout_tty = isatty(STDOUT_FILENO);
+        if (stdout_tty && out_len)
+            flush_output();
+        ssize_t n = read(STDIN_FILENO, in_buf, IN_SIZE);
+        if (n <= 0) {
+            in_eof = 1;
+            return EOF;
+        }
+        in_pos = 0;
+        in_len = n;
+    }
+    return (unsigned char)in_buf[in_pos++];
+}
+
+static void unread_char(void) { in_pos--; }
+
+// scanf("%d"): blanks, a sign and digits; 0 if there is no number
+int input() {
+    int c;
+    do {
+        c = next_char();
+    } while (c == ' ' || c == '\n' || c == '\t' || c == '\r' || c == '\v' ||
+             c == '\f');
+    int negative = 0;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        c = next_char();
+    }
+    uint32_t value = 0;
+    while (c >= '0' && c <= '9') {
+        value = value * 10 + (c - '0');
+        c = next_char();
+    }
+    if (c != EOF)
+        unread_char();
+    return (int)(negative ? 0u - value : value);
+}
+
+void neg_idx_except() {
+    static const char msg[] = "negative index exception\n";
+    memcpy(reserve(sizeof(msg) - 1), msg, sizeof(msg) - 1);
+    out_len += sizeof(msg) - 1;
+    exit(0);
+}
@@ -0,0 +1,93 @@
+/* The counters of a program compiled with -fprofile-generate. The program
+ * keeps them in one array of records
+ *     <name hash> <checksum> <n> <count>...
+ * one per function with a count for each of its n blocks, see Profile.hpp.
+ * main starts with profile_init(), and at exit the records are written to
+ * $CMINUSF_PROFILE, or cminusf.profile in the working directory, as a line
+ * "cminusf-profile" and one line of numbers per record. The counts of an
+ * earlier run of the same program found there are added, so several runs
+ * make up one profile. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "io.h"
+
+static const char magic[] = "cminusf-profile";
+
+static unsigned *counters;
+static int num_counters;
+static int registered;
+
+// the header words of records in both arrays are the same
+static int same_records(const unsigned long long *old, int num_old) {
+    if (num_old != num_counters)
+        return 0;
+    for (int i = 0; i + 3 <= num_counters; i += 3 + (int)counters[i + 2]) {
+        for (int j = i; j < i + 3; j++) {
+            if (old[j] != counters[j])
+                return 0;
+        }
+    }
+    return 1;
+}
+
+// the numbers after the magic line of path, NULL if there is no profile
+static unsigned long long *read_old(const char *path, int *num_old) {
+    FILE *file = fopen(path, "r");
+    if (!file)
+        return NULL;
+    char word[sizeof(magic)];
+    unsigned long long *old = malloc(sizeof(*old) * (num_counters + 1));
+    *num_old = 0;
+    if (old && fscanf(file, "%15s", word) == 1 && strcmp(word, magic) == 0) {
+        while (*num_old <= num_counters &&
+               fscanf(file, "%llu", &old[*num_old]) == 1)
+            ++*num_old;
+    } else {
+        free(old);
+        old = NULL;
+    }
+    fclose(file);
+    return old;
+}
+
+void profile_flush(void) {
+    if (!counters)
+        return;
+    const char *path = getenv("CMINUSF_PROFILE");
+    if (!path || !*path)
+        path = "cminusf.profile";
+    int num_old = 0;
+    unsigned long long *old = read_old(path, &num_old);
+    if (old && !same_records(old, num_old)) {
+        free(old);
+        old = NULL;
+    }
+    FILE *file = fopen(path, "w");
+    if (file) {
+        fprintf(file, "%s\n", magic);
+        for (int i = 0; i + 3 <= num_counters;
+             i += 3 + (int)counters[i + 2]) {
+            fprintf(file, "%u %u %u", counters[i], counters[i + 1],
+                    counters[i + 2]);
+            for (int j = i + 3; j < i + 3 + (int)counters[i + 2]; j++)
+                fprintf(file, " %llu", counters[j] + (old ? old[j] : 0));
+            fprintf(file, "\n");
+        }
+        fclose(file);
+    }
+    free(old);
+    // written once, at exit or by a host that ran main
+    counters = NULL;
+}
+
+void profile_init(int *records, int size) {
+    if (!registered) {
+        registered = 1;
+        atexit(profile_flush);
+    }
+    counters = (unsigned *)records;
+    num_counters = size;
+}
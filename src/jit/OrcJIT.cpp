@@ -0,0 +1,429 @@
+#include "OrcJIT.hpp"
+
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <llvm/Config/llvm-config.h>
+#include <llvm/ExecutionEngine/Orc/ExecutionUtils.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/Support/Error.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// the runtime, from io.c
+extern "C" {
+int input();
+void output(int a);
+void outputFloat(float a);
+void neg_idx_except();
+void profile_init(int *records, int size);
+void profile_flush(void);
+}
+
+namespace {
+
+// LightIR to LLVM IR, one construct for one
+class Translator {
+  public:
+    Translator(::Module *m, llvm::LLVMContext &context)
+        : m_(m), context_(context), builder_(context),
+          module_(std::make_unique<llvm::Module>("cminus", context)) {}
+
+    std::unique_ptr<llvm::Module> translate();
+
+  private:
+    llvm::Type *get_type(::Type *type);
+    llvm::Constant *get_constant(::Constant *c, ::Type *type);
+    llvm::Value *get_value(::Value *val);
+    void translate_function(::Function *func);
+    void translate_instr(::Instruction *instr);
+
+    ::Module *m_;
+    llvm::LLVMContext &context_;
+    llvm::IRBuilder<> builder_;
+    std::unique_ptr<llvm::Module> module_;
+    std::unordered_map<::Value *, llvm::Value *> values_;
+    std::unordered_map<::BasicBlock *, llvm::BasicBlock *> blocks_;
+};
+
+std::unique_ptr<llvm::Module> Translator::translate() {
+    for (auto &global : m_->get_global_variable()) {
+        auto type = global.get_type()->get_pointer_element_type();
+        auto init = global.get_init();
+        values_[&global] = new llvm::GlobalVariable(
+            *module_, get_type(type), false,
+            llvm::GlobalValue::ExternalLinkage,
+            init ? get_constant(init, type)
+                 : llvm::Constant::getNullValue(get_type(type)),
+            global.get_name());
+    }
+    for (auto &func : m_->get_functions()) {
+        auto type = llvm::cast<llvm::FunctionType>(
+            get_type(func.get_type()));
+        values_[&func] = llvm::Function::Create(
+            type, llvm::Function::ExternalLinkage, func.get_name(), *module_);
+    }
+    for (auto &func : m_->get_functions()) {
+        if (not func.is_declaration())
+            translate_function(&func);
+    }
+    return std::move(module_);
+}
+
+llvm::Type *Translator::get_type(::Type *type) {
+    switch (type->get_type_id()) {
+    case ::Type::VoidTyID:
+        return llvm::Type::getVoidTy(context_);
+    case ::Type::IntegerTyID:
+        return type->is_int1_type() ? llvm::Type::getInt1Ty(context_)
+                                    : llvm::Type::getInt32Ty(context_);
+    case ::Type::FloatTyID:
+        return llvm::Type::getFloatTy(context_);
+    case ::Type::PointerTyID:
+        return llvm::PointerType::getUnqual(
+            get_type(type->get_pointer_element_type()));
+    case ::Type::ArrayTyID: {
+        auto array = static_cast<::ArrayType *>(type);
+        return llvm::ArrayType::get(get_type(array->get_element_type()),
+                                    array->get_num_of_elements());
+    }
+    case ::Type::VectorTyID: {
+        auto vector = static_cast<::VectorType *>(type);
+        return llvm::FixedVectorType::get(get_type(vector->get_element_type()),
+                                          vector->get_num_of_elements());
+    }
+    case ::Type::FunctionTyID: {
+        auto func = static_cast<::FunctionType *>(type);
+        std::vector<llvm::Type *> params;
+        for (unsigned i = 0; i < func->get_num_of_args(); i++)
+            params.push_back(get_type(func->get_param_type(i)));
+        return llvm::FunctionType::get(get_type(func->get_return_type()),
+                                       params, false);
+    }
+    case ::Type::LabelTyID:
+        return llvm::Type::getLabelTy(context_);
+    }
+    assert(false && "unknown type");
+    return nullptr;
+}
+
+llvm::Constant *Translator::get_constant(::Constant *c, ::Type *type) {
+    if (auto i = c->dyn_cast<ConstantInt>()) {
+        if (type->is_int1_type())
+            return llvm::ConstantInt::get(get_type(type), i->get_value() != 0);
+        return llvm::ConstantInt::getSigned(get_type(type), i->get_value());
+    }
+    if (auto f = c->dyn_cast<ConstantFP>())
+        return llvm::ConstantFP::get(get_type(type), f->get_value());
+    if (auto array = c->dyn_cast<ConstantArray>()) {
+        auto elem_type = static_cast<::ArrayType *>(type)->get_element_type();
+        std::vector<llvm::Constant *> elems;
+        for (unsigned i = 0; i < array->get_size_of_array(); i++)
+            elems.push_back(get_constant(array->get_element_value(i), elem_type));
+        return llvm::ConstantArray::get(
+            llvm::cast<llvm::ArrayType>(get_type(type)), elems);
+    }
+    return llvm::Constant::getNullValue(get_type(type));
+}
+
+llvm::Value *Translator::get_value(::Value *val) {
+    if (auto c = val->dyn_cast<::Constant>())
+        return get_constant(c, val->get_type());
+    auto it = values_.find(val);
+    assert(it != values_.end() && "use before the definition");
+    return it->second;
+}
+
+void Translator::translate_function(::Function *func) {
+    auto llvm_func = llvm::cast<llvm::Function>(values_.at(func));
+    auto arg = llvm_func->arg_begin();
+    for (auto &param : func->get_args())
+        values_[&param] = &*arg++;
+
+    // reverse post order, so that a value is defined before its uses
+    // outside phis; unreachable blocks are dropped
+    std::vector<::BasicBlock *> order;
+    std::unordered_set<::BasicBlock *> visited;
+    std::vector<std::pair<::BasicBlock *, bool>> stack{
+        {&func->get_basic_blocks().front(), false}};
+    while (not stack.empty()) {
+        auto [bb, done] = stack.back();
+        stack.pop_back();
+        if (done) {
+            order.push_back(bb);
+            continue;
+        }
+        if (not visited.insert(bb).second)
+            continue;
+        stack.push_back({bb, true});
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (not visited.count(succ))
+                stack.push_back({succ, false});
+        }
+    }
+    std::reverse(order.begin(), order.end());
+
+    blocks_.clear();
+    for (auto &bb : func->get_basic_blocks()) {
+        if (visited.count(&bb))
+            blocks_[&bb] = llvm::BasicBlock::Create(context_, bb.get_name(),
+                                                    llvm_func);
+    }
+    // the phis first, their operands may come later
+    std::vector<::PhiInst *> phis;
+    for (auto bb : order) {
+        builder_.SetInsertPoint(blocks_.at(bb));
+        for (auto &instr : bb->get_instructions()) {
+            if (not instr.is_phi())
+                break;
+            values_[&instr] = builder_.CreatePHI(get_type(instr.get_type()), 2);
+            phis.push_back(instr.as<PhiInst>());
+        }
+    }
+    for (auto bb : order) {
+        builder_.SetInsertPoint(blocks_.at(bb));
+        for (auto &instr : bb->get_instructions()) {
+            if (not instr.is_phi())
+                translate_instr(&instr);
+        }
+    }
+    for (auto phi : phis) {
+        auto llvm_phi = llvm::cast<llvm::PHINode>(values_.at(phi));
+        for (auto &[val, pred] : phi->get_phi_pairs()) {
+            if (blocks_.count(pred))
+                llvm_phi->addIncoming(get_value(val), blocks_.at(pred));
+        }
+    }
+}
+
+void Translator::translate_instr(::Instruction *instr) {
+    auto op = [&](unsigned i) { return get_value(instr->get_operand(i)); };
+    auto &b = builder_;
+    llvm::Value *result = nullptr;
+    switch (instr->get_instr_type()) {
+    case ::Instruction::ret:
+        if (instr->get_num_operand())
+            b.CreateRet(op(0));
+        else
+            b.CreateRetVoid();
+        break;
+    case ::Instruction::br:
+        if (instr->get_num_operand() == 1)
+            b.CreateBr(blocks_.at(instr->get_operand(0)->as<BasicBlock>()));
+        else
+            b.CreateCondBr(op(0),
+                           blocks_.at(instr->get_operand(1)->as<BasicBlock>()),
+                           blocks_.at(instr->get_operand(2)->as<BasicBlock>()));
+        break;
+    case ::Instruction::add:
+        result = b.CreateAdd(op(0), op(1));
+        break;
+    case ::Instruction::sub:
+        result = b.CreateSub(op(0), op(1));
+        break;
+    case ::Instruction::mul:
+        result = b.CreateMul(op(0), op(1));
+        break;
+    case ::Instruction::sdiv:
+        result = b.CreateSDiv(op(0), op(1));
+        break;
+    case ::Instruction::fadd:
+        result = b.CreateFAdd(op(0), op(1));
+        break;
+    case ::Instruction::fsub:
+        result = b.CreateFSub(op(0), op(1));
+        break;
+    case ::Instruction::fmul:
+        result = b.CreateFMul(op(0), op(1));
+        break;
+    case ::Instruction::fdiv:
+        result = b.CreateFDiv(op(0), op(1));
+        break;
+    case ::Instruction::alloca:
+        result = b.CreateAlloca(
+            get_type(instr->as<AllocaInst>()->get_alloca_type()));
+        break;
+    case ::Instruction::load:
+        // a vector is only as aligned as its elements, see IRprinter
+        result = b.CreateAlignedLoad(
+            get_type(instr->get_type()), op(0),
+            llvm::MaybeAlign(instr->get_type()->get_scalar_type()->get_size()));
+        break;
+    case ::Instruction::store:
+        b.CreateAlignedStore(op(0), op(1),
+                             llvm::MaybeAlign(instr->get_operand(0)
+                                                  ->get_type()
+                                                  ->get_scalar_type()
+                                                  ->get_size()));
+        break;
+    case ::Instruction::ge:
+        result = b.CreateICmpSGE(op(0), op(1));
+        break;
+    case ::Instruction::gt:
+        result = b.CreateICmpSGT(op(0), op(1));
+        break;
+    case ::Instruction::le:
+        result = b.CreateICmpSLE(op(0), op(1));
+        break;
+    case ::Instruction::lt:
+        result = b.CreateICmpSLT(op(0), op(1));
+        break;
+    case ::Instruction::eq:
+        result = b.CreateICmpEQ(op(0), op(1));
+        break;
+    case ::Instruction::ne:
+        result = b.CreateICmpNE(op(0), op(1));
+        break;
+    // the builder's float compares are unordered
+    case ::Instruction::fge:
+        result = b.CreateFCmpUGE(op(0), op(1));
+        break;
+    case ::Instruction::fgt:
+        result = b.CreateFCmpUGT(op(0), op(1));
+        break;
+    case ::Instruction::fle:
+        result = b.CreateFCmpULE(op(0), op(1));
+        break;
+    case ::Instruction::flt:
+        result = b.CreateFCmpULT(op(0), op(1));
+        break;
+    case ::Instruction::feq:
+        result = b.CreateFCmpUEQ(op(0), op(1));
+        break;
+    case ::Instruction::fne:
+        result = b.CreateFCmpUNE(op(0), op(1));
+        break;
+    case ::Instruction::phi:
+        break;
+    case ::Instruction::call: {
+        auto callee = llvm::cast<llvm::Function>(op(0));
+        std::vector<llvm::Value *> args;
+        for (unsigned i = 1; i < instr->get_num_operand(); i++)
+            args.push_back(op(i));
+        result = b.CreateCall(callee, args);
+        break;
+    }
+    case ::Instruction::getelementptr: {
+        auto ptr = instr->get_operand(0);
+        std::vector<llvm::Value *> idxs;
+        for (unsigned i = 1; i < instr->get_num_operand(); i++)
+            idxs.push_back(op(i));
+        result = b.CreateGEP(
+            get_type(ptr->get_type()->get_pointer_element_type()),
+            get_value(ptr), idxs);
+        break;
+    }
+    case ::Instruction::zext:
+        result = b.CreateZExt(op(0), get_type(instr->get_type()));
+        break;
+    case ::Instruction::fptosi:
+        result = b.CreateFPToSI(op(0), get_type(instr->get_type()));
+        break;
+    case ::Instruction::sitofp:
+        result = b.CreateSIToFP(op(0), get_type(instr->get_type()));
+        break;
+    case ::Instruction::bitcast:
+        result = b.CreateBitCast(op(0), get_type(instr->get_type()));
+        break;
+    }
+    if (result)
+        values_[instr] = result;
+}
+
+// stops at an llvm error, like the asserts of ir we cannot handle
+template <typename T> T check(llvm::Expected<T> value) {
+    if (not value) {
+        llvm::errs() << "jit: " << llvm::toString(value.takeError()) << "\n";
+        std::exit(1);
+    }
+    return std::move(*value);
+}
+
+void check(llvm::Error error) {
+    if (error) {
+        llvm::errs() << "jit: " << llvm::toString(std::move(error)) << "\n";
+        std::exit(1);
+    }
+}
+
+} // namespace
+
+int OrcJIT::run() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+
+    auto context = std::make_unique<llvm::LLVMContext>();
+    auto module = Translator(m_, *context).translate();
+    assert(not llvm::verifyModule(*module, &llvm::errs()) &&
+           "Translated module is broken");
+
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+    llvm::PassBuilder builder;
+    builder.registerModuleAnalyses(mam);
+    builder.registerCGSCCAnalyses(cgam);
+    builder.registerFunctionAnalyses(fam);
+    builder.registerLoopAnalyses(lam);
+    builder.crossRegisterProxies(lam, fam, cgam, mam);
+    builder.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2)
+        .run(*module, mam);
+
+    auto jit = check(llvm::orc::LLJITBuilder().create());
+    auto &dylib = jit->getMainJITDylib();
+    llvm::orc::SymbolMap runtime;
+    auto bind = [&](const char *name, auto *func) {
+        runtime[jit->mangleAndIntern(name)] = llvm::JITEvaluatedSymbol(
+            llvm::pointerToJITTargetAddress(func),
+            llvm::JITSymbolFlags::Exported | llvm::JITSymbolFlags::Callable);
+    };
+    bind("input", &input);
+    bind("output", &output);
+    bind("outputFloat", &outputFloat);
+    bind("neg_idx_except", &neg_idx_except);
+    bind("profile_init", &profile_init);
+    check(dylib.define(llvm::orc::absoluteSymbols(runtime)));
+    // memset and the like the optimizer may call
+    dylib.addGenerator(
+        check(llvm::orc::DynamicLibrarySearchGenerator::GetForCurrentProcess(
+            jit->getDataLayout().getGlobalPrefix())));
+    check(jit->addIRModule(
+        llvm::orc::ThreadSafeModule(std::move(module), std::move(context))));
+
+    auto main = check(jit->lookup("main"));
+#if LLVM_VERSION_MAJOR >= 15
+    auto address = main.getValue();
+#else
+    auto address = main.getAddress();
+#endif
+    bool returns_int = false;
+    for (auto &func : m_->get_functions()) {
+        if (func.get_name() == "main")
+            returns_int = not func.get_return_type()->is_void_type();
+    }
+    int result = 0;
+    if (returns_int)
+        result = reinterpret_cast<int (*)()>(address)();
+    else
+        reinterpret_cast<void (*)()>(address)();
+    // -fprofile-generate: the counters go away with the jit
+    profile_flush();
+    std::fflush(stdout);
+    return result;
+}
@@ -8,7 +8,7 @@
 
 BasicBlock::BasicBlock(Module *m, const std::string &name = "",
                        Function *parent = nullptr)
-    : Value(m->get_label_type(), name), parent_(parent) {
+    : Value(m->get_label_type(), BasicBlockVal, name), parent_(parent) {
     assert(parent && "currently parent should not be nullptr");
     parent_->add_basic_block(this);
 }
@@ -40,32 +40,41 @@ void BasicBlock::add_instruction(Instruction *instr) {
     instr_list_.push_back(instr);
 }
 
-std::string BasicBlock::print() {
-    std::string bb_ir;
-    bb_ir += this->get_name();
-    bb_ir += ":";
+void BasicBlock::take_succ_basic_blocks(BasicBlock *from) {
+    for (auto succ : from->succ_bbs_) {
+        std::replace(succ->pre_bbs_.begin(), succ->pre_bbs_.end(), from, this);
+        succ_bbs_.push_back(succ);
+        for (auto &instr : succ->get_instructions()) {
+            if (not instr.is_phi())
+                break;
+            instr.as<PhiInst>()->replace_incoming_block(from, this);
+        }
+    }
+    from->succ_bbs_.clear();
+}
+
+void BasicBlock::print(std::ostream &os) {
+    os << get_print_name(this) << ":";
     // print prebb
     if (!this->get_pre_basic_blocks().empty()) {
-        bb_ir += "                                                ; preds = ";
+        os << "                                                ; preds = ";
     }
     for (auto bb : this->get_pre_basic_blocks()) {
         if (bb != *this->get_pre_basic_blocks().begin()) {
-            bb_ir += ", ";
+            os << ", ";
         }
-        bb_ir += print_as_op(bb, false);
+        print_as_op(os, bb, false);
     }
 
     // print prebb
     if (!this->get_parent()) {
-        bb_ir += "\n";
-        bb_ir += "; Error: Block without parent!";
+        os << "\n";
+        os << "; Error: Block without parent!";
     }
-    bb_ir += "\n";
+    os << "\n";
     for (auto &instr : this->get_instructions()) {
-        bb_ir += "  ";
-        bb_ir += instr.print();
-        bb_ir += "\n";
+        os << "  ";
+        instr.print(os);
+        os << "\n";
     }
-
-    return bb_ir;
 }
@@ -0,0 +1,1036 @@
+#include "BinaryIR.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <map>
+#include <set>
+#include <string>
+
+namespace {
+
+constexpr uint32_t magic = 0x3152494c; // "LIR1"
+constexpr uint32_t version = 4;
+constexpr uint32_t no_init = ~0u;
+
+enum HeaderWord : uint32_t {
+    h_magic,
+    h_version,
+    h_num_words,
+    h_checksum,
+    h_num_types,
+    h_types,
+    h_num_constants,
+    h_constants,
+    h_num_globals,
+    h_globals,
+    h_num_functions,
+    h_functions,
+    header_size,
+};
+
+// FNV-1a of all words but the checksum itself: a cache entry may have
+// rotted, and a flipped bit in a constant still reads fine
+uint32_t checksum(uint32_t hash, const char *data, std::size_t size) {
+    for (std::size_t i = 0; i < size; i++)
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    return hash;
+}
+uint32_t checksum(const char *data, std::size_t num_words) {
+    constexpr auto word = sizeof(uint32_t);
+    auto hash = checksum(2166136261u, data, h_checksum * word);
+    return checksum(hash, data + (h_checksum + 1) * word,
+                    (num_words - h_checksum - 1) * word);
+}
+
+// the kind of an operand, in the top 3 bits
+enum RefKind : uint32_t {
+    ref_constant,
+    ref_global,
+    ref_function,
+    ref_argument,
+    ref_block,
+    ref_instruction,
+};
+constexpr unsigned ref_shift = 29;
+constexpr uint32_t ref_index_mask = (1u << ref_shift) - 1;
+
+uint32_t make_ref(RefKind kind, std::size_t index) {
+    assert(index <= ref_index_mask && "Too many values for binary ir");
+    return kind << ref_shift | static_cast<uint32_t>(index);
+}
+
+void put_string(std::vector<uint32_t> &out, const std::string &s) {
+    out.push_back(s.size());
+    auto pos = out.size();
+    out.resize(pos + (s.size() + 3) / 4, 0);
+    std::memcpy(out.data() + pos, s.data(), s.size());
+}
+
+class Writer {
+  public:
+    Writer(Module *m, Function *only) : m_(m), only_(only) {}
+    void write(std::ostream &os);
+
+  private:
+    uint32_t type_id(Type *ty);
+    uint32_t constant_id(Constant *c);
+    uint32_t ref(Value *v);
+    void write_body(Function &func);
+
+    Module *m_;
+    Function *only_;
+    std::vector<uint32_t> types_, constants_, bodies_;
+    std::map<Type *, uint32_t> type_ids_;
+    std::map<Constant *, uint32_t> constant_ids_;
+    std::map<Value *, uint32_t> module_refs_;
+    // the arguments, blocks and instructions of the function being written
+    std::map<Value *, uint32_t> local_refs_;
+};
+
+uint32_t Writer::type_id(Type *ty) {
+    auto it = type_ids_.find(ty);
+    if (it != type_ids_.end())
+        return it->second;
+    // what a type refers to goes first
+    std::vector<uint32_t> record{static_cast<uint32_t>(ty->get_type_id())};
+    switch (ty->get_type_id()) {
+    case Type::IntegerTyID:
+        record.push_back(static_cast<IntegerType *>(ty)->get_num_bits());
+        break;
+    case Type::PointerTyID:
+        record.push_back(type_id(ty->get_pointer_element_type()));
+        break;
+    case Type::ArrayTyID: {
+        auto array_ty = static_cast<ArrayType *>(ty);
+        record.push_back(type_id(array_ty->get_element_type()));
+        record.push_back(array_ty->get_num_of_elements());
+        break;
+    }
+    case Type::VectorTyID: {
+        auto vector_ty = static_cast<VectorType *>(ty);
+        record.push_back(type_id(vector_ty->get_element_type()));
+        record.push_back(vector_ty->get_num_of_elements());
+        break;
+    }
+    case Type::FunctionTyID: {
+        auto func_ty = static_cast<FunctionType *>(ty);
+        record.push_back(type_id(func_ty->get_return_type()));
+        record.push_back(func_ty->get_num_of_args());
+        for (unsigned i = 0; i < func_ty->get_num_of_args(); i++)
+            record.push_back(type_id(func_ty->get_param_type(i)));
+        break;
+    }
+    default:
+        break;
+    }
+    types_.insert(types_.end(), record.begin(), record.end());
+    auto id = type_ids_.size();
+    type_ids_[ty] = id;
+    return id;
+}
+
+uint32_t Writer::constant_id(Constant *c) {
+    auto it = constant_ids_.find(c);
+    if (it != constant_ids_.end())
+        return it->second;
+    std::vector<uint32_t> record{c->get_value_id(), type_id(c->get_type())};
+    if (auto ci = c->dyn_cast<ConstantInt>()) {
+        record.push_back(static_cast<uint32_t>(ci->get_value()));
+    } else if (auto cf = c->dyn_cast<ConstantFP>()) {
+        float val = cf->get_value();
+        uint32_t bits;
+        std::memcpy(&bits, &val, sizeof(bits));
+        record.push_back(bits);
+    } else if (auto ca = c->dyn_cast<ConstantArray>()) {
+        record.push_back(ca->get_size_of_array());
+        for (unsigned i = 0; i < ca->get_size_of_array(); i++)
+            record.push_back(constant_id(ca->get_element_value(i)));
+    }
+    constants_.insert(constants_.end(), record.begin(), record.end());
+    auto id = constant_ids_.size();
+    constant_ids_[c] = id;
+    return id;
+}
+
+uint32_t Writer::ref(Value *v) {
+    if (auto c = v->dyn_cast<Constant>())
+        return make_ref(ref_constant, constant_id(c));
+    auto it = module_refs_.find(v);
+    if (it != module_refs_.end())
+        return it->second;
+    it = local_refs_.find(v);
+    assert(it != local_refs_.end() && "Operand from another function");
+    return it->second;
+}
+
+void Writer::write_body(Function &func) {
+    local_refs_.clear();
+    for (auto &arg : func.get_args())
+        local_refs_[&arg] = make_ref(ref_argument, arg.get_arg_no());
+    std::size_t num_blocks = 0, num_instrs = 0;
+    for (auto &bb : func.get_basic_blocks()) {
+        local_refs_[&bb] = make_ref(ref_block, num_blocks++);
+        for (auto &instr : bb.get_instructions())
+            local_refs_[&instr] = make_ref(ref_instruction, num_instrs++);
+    }
+
+    bodies_.push_back(num_blocks);
+    for (auto &bb : func.get_basic_blocks())
+        put_string(bodies_, bb.get_name());
+    for (auto &bb : func.get_basic_blocks()) {
+        for (auto *edges : {&bb.get_pre_basic_blocks(),
+                            &bb.get_succ_basic_blocks()}) {
+            bodies_.push_back(edges->size());
+            for (auto other : *edges)
+                bodies_.push_back(ref(other) & ref_index_mask);
+        }
+        bodies_.push_back(bb.get_num_of_instr());
+        for (auto &instr : bb.get_instructions()) {
+            bodies_.push_back(instr.get_instr_type());
+            bodies_.push_back(type_id(instr.get_type()));
+            put_string(bodies_, instr.get_name());
+            if (auto phi = instr.dyn_cast<PhiInst>()) {
+                // the pairs are stored as value, block operands
+                bodies_.push_back(2 * phi->get_num_incoming());
+                for (auto &[val, pre_bb] : phi->get_phi_pairs()) {
+                    bodies_.push_back(ref(val));
+                    bodies_.push_back(ref(pre_bb));
+                }
+                continue;
+            }
+            bodies_.push_back(instr.get_num_operand());
+            for (auto op : instr.get_operands())
+                bodies_.push_back(ref(op));
+        }
+    }
+}
+
+void Writer::write(std::ostream &os) {
+    // with only_ the tables hold what its body refers to
+    std::set<Value *> used;
+    if (only_) {
+        used.insert(only_);
+        for (auto &bb : only_->get_basic_blocks())
+            for (auto &instr : bb.get_instructions())
+                for (auto op : instr.get_operands())
+                    if (op->is<GlobalVariable>() or op->is<Function>())
+                        used.insert(op);
+    }
+    auto listed = [&](Value *v) { return not only_ or used.count(v); };
+    std::size_t num_globals = 0, num_functions = 0;
+    for (auto &global : m_->get_global_variable())
+        if (listed(&global))
+            module_refs_[&global] = make_ref(ref_global, num_globals++);
+    for (auto &func : m_->get_functions())
+        if (listed(&func))
+            module_refs_[&func] = make_ref(ref_function, num_functions++);
+
+    std::vector<uint32_t> globals, functions;
+    for (auto &global : m_->get_global_variable()) {
+        if (not listed(&global))
+            continue;
+        put_string(globals, global.get_name());
+        auto ty = global.get_type()->get_pointer_element_type();
+        globals.push_back(type_id(ty));
+        globals.push_back(global.is_const());
+        globals.push_back(global.get_init() ? constant_id(global.get_init())
+                                            : no_init);
+    }
+    // body offsets are relative to the bodies until the tables are placed
+    std::vector<std::size_t> body_words;
+    for (auto &func : m_->get_functions()) {
+        if (not listed(&func))
+            continue;
+        put_string(functions, func.get_name());
+        functions.push_back(type_id(func.get_type()));
+        body_words.push_back(functions.size());
+        functions.push_back(0);
+        for (auto &arg : func.get_args())
+            put_string(functions, arg.get_name());
+        if (not func.is_declaration() and (not only_ or &func == only_)) {
+            // 0 marks a declaration, so bodies start one word in
+            functions[body_words.back()] = bodies_.size() + 1;
+            write_body(func);
+        }
+    }
+
+    std::vector<uint32_t> header(header_size);
+    header[h_magic] = magic;
+    header[h_version] = version;
+    header[h_num_types] = type_ids_.size();
+    header[h_types] = header_size;
+    header[h_num_constants] = constant_ids_.size();
+    header[h_constants] = header[h_types] + types_.size();
+    header[h_num_globals] = num_globals;
+    header[h_globals] = header[h_constants] + constants_.size();
+    header[h_num_functions] = num_functions;
+    header[h_functions] = header[h_globals] + globals.size();
+    auto bodies_start = header[h_functions] + functions.size();
+    header[h_num_words] = bodies_start + bodies_.size();
+    for (auto pos : body_words) {
+        if (functions[pos])
+            functions[pos] += bodies_start - 1;
+    }
+
+    std::vector<uint32_t> words;
+    words.reserve(header[h_num_words]);
+    for (auto *section : {&header, &types_, &constants_, &globals, &functions,
+                          &bodies_})
+        words.insert(words.end(), section->begin(), section->end());
+    words[h_checksum] =
+        checksum(reinterpret_cast<const char *>(words.data()), words.size());
+    os.write(reinterpret_cast<const char *>(words.data()),
+             words.size() * sizeof(uint32_t));
+}
+
+} // namespace
+
+void write_binary_ir(Module *m, std::ostream &os) {
+    Writer(m, nullptr).write(os);
+}
+
+void write_binary_ir(Module *m, std::ostream &os, Function *only) {
+    Writer(m, only).write(os);
+}
+
+BinaryIRReader::BinaryIRReader(const char *data, std::size_t size)
+    : data_(data), num_words_(size / sizeof(uint32_t)) {}
+
+namespace {
+
+// walks the records from a word offset on; a read past the end or out of a
+// table gives 0 or nullptr and clears ok, so a record can be read whole and
+// checked once
+struct Cursor {
+    const char *data;
+    std::size_t num_words;
+    std::size_t pos;
+    bool ok{true};
+
+    uint32_t at(std::size_t word) {
+        if (word >= num_words) {
+            ok = false;
+            return 0;
+        }
+        uint32_t w;
+        std::memcpy(&w, data + word * sizeof(uint32_t), sizeof(w));
+        return w;
+    }
+    uint32_t next() { return at(pos++); }
+    // the number of entries that follow, each at least a word
+    uint32_t count() {
+        auto n = next();
+        if (pos > num_words or n > num_words - pos) {
+            ok = false;
+            return 0;
+        }
+        return n;
+    }
+    std::string string() {
+        std::size_t size = next();
+        auto words = (size + 3) / 4;
+        if (pos > num_words or words > num_words - pos) {
+            ok = false;
+            return {};
+        }
+        std::string s(data + pos * sizeof(uint32_t), size);
+        pos += words;
+        return s;
+    }
+    // the entry of table the next word is the index of
+    template <typename T> T *entry(const std::vector<T *> &table) {
+        auto index = next();
+        if (index >= table.size()) {
+            ok = false;
+            return nullptr;
+        }
+        return table[index];
+    }
+};
+
+// what PointerType and AllocaInst take
+bool is_pointee(Type *ty) {
+    return ty->is_integer_type() or ty->is_float_type() or
+           ty->is_array_type() or ty->is_pointer_type() or
+           ty->is_vector_type();
+}
+bool is_allocated(Type *ty) {
+    return is_pointee(ty) and not ty->is_vector_type();
+}
+
+} // namespace
+
+std::unique_ptr<Module> BinaryIRReader::read_module() {
+    auto m = std::make_unique<Module>();
+    if (not read_tables(m.get(), false))
+        return nullptr;
+    return m;
+}
+
+bool BinaryIRReader::read_into(Module *m) { return read_tables(m, true); }
+
+bool BinaryIRReader::read_tables(Module *m, bool bind) {
+    Cursor in{data_, num_words_, 0};
+    if (num_words_ < header_size or in.at(h_magic) != magic or
+        in.at(h_version) != version or in.at(h_num_words) != num_words_ or
+        in.at(h_checksum) != checksum(data_, num_words_))
+        return false;
+    m_ = m;
+
+    in.pos = in.at(h_types);
+    for (uint32_t i = 0, n = in.at(h_num_types); i < n and in.ok; i++) {
+        auto tid = static_cast<Type::TypeID>(in.next());
+        switch (tid) {
+        case Type::VoidTyID:
+            types_.push_back(m->get_void_type());
+            break;
+        case Type::LabelTyID:
+            types_.push_back(m->get_label_type());
+            break;
+        case Type::IntegerTyID: {
+            auto bits = in.next();
+            if (bits != 1 and bits != 32)
+                return false;
+            types_.push_back(bits == 1 ? m->get_int1_type()
+                                       : m->get_int32_type());
+            break;
+        }
+        case Type::FloatTyID:
+            types_.push_back(m->get_float_type());
+            break;
+        case Type::PointerTyID: {
+            auto elem = in.entry(types_);
+            if (elem == nullptr or not is_pointee(elem))
+                return false;
+            types_.push_back(m->get_pointer_type(elem));
+            break;
+        }
+        case Type::ArrayTyID: {
+            auto elem = in.entry(types_);
+            auto num = in.next();
+            if (elem == nullptr or not ArrayType::is_valid_element_type(elem))
+                return false;
+            types_.push_back(m->get_array_type(elem, num));
+            break;
+        }
+        case Type::VectorTyID: {
+            auto elem = in.entry(types_);
+            auto num = in.next();
+            if (elem == nullptr or
+                not VectorType::is_valid_element_type(elem) or num == 0)
+                return false;
+            types_.push_back(m->get_vector_type(elem, num));
+            break;
+        }
+        case Type::FunctionTyID: {
+            auto ret = in.entry(types_);
+            std::vector<Type *> params(in.count());
+            for (auto &param : params) {
+                param = in.entry(types_);
+                if (param and not FunctionType::is_valid_argument_type(param))
+                    return false;
+            }
+            if (not in.ok or not FunctionType::is_valid_return_type(ret))
+                return false;
+            types_.push_back(m->get_function_type(ret, params));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    in.pos = in.at(h_constants);
+    for (uint32_t i = 0, n = in.at(h_num_constants); i < n and in.ok; i++) {
+        auto value_id = in.next();
+        auto ty = in.entry(types_);
+        if (ty == nullptr)
+            return false;
+        switch (value_id) {
+        case Value::ConstantIntVal: {
+            auto val = static_cast<int>(in.next());
+            if (not ty->is_integer_type())
+                return false;
+            constants_.push_back(ty->is_int1_type()
+                                     ? ConstantInt::get(val != 0, m)
+                                     : ConstantInt::get(val, m));
+            break;
+        }
+        case Value::ConstantFPVal: {
+            auto bits = in.next();
+            if (not ty->is_float_type())
+                return false;
+            float val;
+            std::memcpy(&val, &bits, sizeof(val));
+            constants_.push_back(ConstantFP::get(val, m));
+            break;
+        }
+        case Value::ConstantZeroVal:
+            if (not is_pointee(ty))
+                return false;
+            constants_.push_back(ConstantZero::get(ty, m));
+            break;
+        case Value::ConstantArrayVal: {
+            std::vector<Constant *> elems(in.count());
+            for (auto &elem : elems)
+                elem = in.entry(constants_);
+            if (not in.ok or not ty->is_array_type())
+                return false;
+            auto array_ty = static_cast<ArrayType *>(ty);
+            if (array_ty->get_num_of_elements() != elems.size())
+                return false;
+            for (auto elem : elems)
+                if (elem->get_type() != array_ty->get_element_type())
+                    return false;
+            constants_.push_back(ConstantArray::get(array_ty, elems));
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+
+    // the values of m by name when binding
+    std::unordered_map<std::string, Value *> named;
+    if (bind) {
+        for (auto &global : m->get_global_variable())
+            named[global.get_name()] = &global;
+        for (auto &func : m->get_functions())
+            named[func.get_name()] = &func;
+    }
+    auto find = [&](const std::string &name, Type *ty) -> Value * {
+        auto it = named.find(name);
+        if (it == named.end() or it->second->get_type() != ty)
+            return nullptr;
+        return it->second;
+    };
+
+    in.pos = in.at(h_globals);
+    for (uint32_t i = 0, n = in.at(h_num_globals); i < n and in.ok; i++) {
+        auto name = in.string();
+        auto ty = in.entry(types_);
+        bool is_const = in.next();
+        auto init_id = in.next();
+        Constant *init = nullptr;
+        if (init_id != no_init) {
+            in.pos--;
+            init = in.entry(constants_);
+        }
+        if (not in.ok or not is_pointee(ty) or
+            (init and init->get_type() != ty))
+            return false;
+        if (bind) {
+            auto global = find(name, m->get_pointer_type(ty));
+            if (global == nullptr or not global->is<GlobalVariable>())
+                return false;
+            globals_.push_back(global->as<GlobalVariable>());
+            continue;
+        }
+        globals_.push_back(GlobalVariable::create(name, m, ty, is_const, init));
+    }
+
+    in.pos = in.at(h_functions);
+    for (uint32_t i = 0, n = in.at(h_num_functions); i < n and in.ok; i++) {
+        auto name = in.string();
+        auto ty = in.entry(types_);
+        if (ty == nullptr or not ty->is_function_type())
+            return false;
+        Function *func;
+        if (bind) {
+            auto found = find(name, ty);
+            if (found == nullptr or not found->is<Function>())
+                return false;
+            func = found->as<Function>();
+        } else {
+            func = Function::create(static_cast<FunctionType *>(ty), name, m);
+        }
+        auto body = in.next();
+        for (auto &arg : func->get_args()) {
+            auto arg_name = in.string();
+            if (not bind)
+                arg.set_name(arg_name);
+        }
+        functions_.push_back(func);
+        if (body)
+            bodies_[func] = body;
+    }
+    return in.ok;
+}
+
+bool BinaryIRReader::is_materialized(Function *func) const {
+    return not bodies_.count(func);
+}
+
+bool BinaryIRReader::materialize_all() {
+    bool ok = true;
+    for (auto func : functions_)
+        ok = materialize(func) and ok;
+    return ok;
+}
+
+bool BinaryIRReader::materialize(Function *func) {
+    auto body = bodies_.find(func);
+    if (body == bodies_.end())
+        return true;
+    assert(func->is_declaration() && "Materializing into a definition");
+    Cursor in{data_, num_words_, body->second};
+    bodies_.erase(body);
+
+    std::vector<Argument *> args;
+    for (auto &arg : func->get_args())
+        args.push_back(&arg);
+    std::vector<std::string> block_names(in.count());
+    for (auto &name : block_names)
+        name = in.string();
+    auto num_blocks = block_names.size();
+
+    // where the records are, by block and instruction
+    struct Record {
+        uint32_t op_id;
+        Type *type;
+        std::string name;
+        std::vector<uint32_t> ops;
+    };
+    std::vector<std::vector<uint32_t>> preds(num_blocks), succs(num_blocks);
+    std::vector<std::vector<uint32_t>> block_instrs(num_blocks);
+    std::vector<Record> records;
+    for (std::size_t b = 0; b < num_blocks and in.ok; b++) {
+        for (auto *edges : {&preds[b], &succs[b]}) {
+            edges->resize(in.count());
+            for (auto &other : *edges)
+                other = in.next();
+        }
+        auto num_instrs = in.count();
+        for (uint32_t i = 0; i < num_instrs and in.ok; i++) {
+            Record record;
+            record.op_id = in.next();
+            record.type = in.entry(types_);
+            record.name = in.string();
+            record.ops.resize(in.count());
+            for (auto &op : record.ops)
+                op = in.next();
+            block_instrs[b].push_back(records.size());
+            records.push_back(std::move(record));
+        }
+    }
+    if (not in.ok or num_blocks == 0)
+        return false;
+
+    // everything is checked before the first block is made, so a broken
+    // body leaves func a declaration; these are the checks the constructors
+    // of the instructions assert
+    auto kind = [](uint32_t ref) { return ref >> ref_shift; };
+    auto type_of = [&](uint32_t ref) -> Type * {
+        std::size_t index = ref & ref_index_mask;
+        switch (kind(ref)) {
+        case ref_constant:
+            return index < constants_.size() ? constants_[index]->get_type()
+                                             : nullptr;
+        case ref_global:
+            return index < globals_.size() ? globals_[index]->get_type()
+                                           : nullptr;
+        case ref_function:
+            return index < functions_.size() ? functions_[index]->get_type()
+                                             : nullptr;
+        case ref_argument:
+            return index < args.size() ? args[index]->get_type() : nullptr;
+        case ref_block:
+            return index < num_blocks ? m_->get_label_type() : nullptr;
+        case ref_instruction:
+            return index < records.size() ? records[index].type : nullptr;
+        }
+        return nullptr;
+    };
+    auto is_block = [&](uint32_t ref) {
+        return kind(ref) == ref_block and (ref & ref_index_mask) < num_blocks;
+    };
+    auto void_ty = m_->get_void_type();
+    // the type the instruction of record has, nullptr if it is not one
+    auto result_type = [&](const Record &record) -> Type * {
+        auto &ops = record.ops;
+        std::vector<Type *> tys;
+        for (auto op : ops) {
+            tys.push_back(type_of(op));
+            if (tys.back() == nullptr)
+                return nullptr;
+        }
+        auto ty = record.type;
+        switch (record.op_id) {
+        case Instruction::ret:
+            if (ops.empty())
+                return func->get_return_type() == void_ty ? void_ty : nullptr;
+            return ops.size() == 1 and tys[0] != void_ty and
+                           tys[0] == func->get_return_type()
+                       ? void_ty
+                       : nullptr;
+        case Instruction::br:
+            if (ops.size() == 1)
+                return is_block(ops[0]) ? void_ty : nullptr;
+            return ops.size() == 3 and tys[0]->is_int1_type() and
+                           is_block(ops[1]) and is_block(ops[2])
+                       ? void_ty
+                       : nullptr;
+        case Instruction::add:
+        case Instruction::sub:
+        case Instruction::mul:
+        case Instruction::sdiv:
+            return ops.size() == 2 and tys[0] == tys[1] and
+                           tys[0]->get_scalar_type()->is_int32_type()
+                       ? tys[0]
+                       : nullptr;
+        case Instruction::fadd:
+        case Instruction::fsub:
+        case Instruction::fmul:
+        case Instruction::fdiv:
+            return ops.size() == 2 and tys[0] == tys[1] and
+                           tys[0]->get_scalar_type()->is_float_type()
+                       ? tys[0]
+                       : nullptr;
+        case Instruction::alloca:
+            return ops.empty() and ty->is_pointer_type() and
+                           is_allocated(ty->get_pointer_element_type())
+                       ? ty
+                       : nullptr;
+        case Instruction::load:
+            if (ops.size() != 1 or not tys[0]->is_pointer_type())
+                return nullptr;
+            ty = tys[0]->get_pointer_element_type();
+            return ty->is_integer_type() or ty->is_float_type() or
+                           ty->is_pointer_type() or ty->is_vector_type()
+                       ? ty
+                       : nullptr;
+        case Instruction::store:
+            return ops.size() == 2 and tys[1]->is_pointer_type() and
+                           tys[1]->get_pointer_element_type() == tys[0]
+                       ? void_ty
+                       : nullptr;
+        case Instruction::ge:
+        case Instruction::gt:
+        case Instruction::le:
+        case Instruction::lt:
+        case Instruction::eq:
+        case Instruction::ne:
+            return ops.size() == 2 and tys[0]->is_int32_type() and
+                           tys[1]->is_int32_type()
+                       ? m_->get_int1_type()
+                       : nullptr;
+        case Instruction::fge:
+        case Instruction::fgt:
+        case Instruction::fle:
+        case Instruction::flt:
+        case Instruction::feq:
+        case Instruction::fne:
+            return ops.size() == 2 and tys[0]->is_float_type() and
+                           tys[1]->is_float_type()
+                       ? m_->get_int1_type()
+                       : nullptr;
+        case Instruction::call: {
+            if (ops.empty() or kind(ops[0]) != ref_function)
+                return nullptr;
+            auto func_ty = static_cast<FunctionType *>(tys[0]);
+            if (func_ty->get_num_of_args() != ops.size() - 1)
+                return nullptr;
+            for (unsigned i = 0; i < func_ty->get_num_of_args(); i++)
+                if (func_ty->get_param_type(i) != tys[i + 1])
+                    return nullptr;
+            return func_ty->get_return_type();
+        }
+        case Instruction::getelementptr: {
+            // as GetElementPtrInst::get_element_type()
+            if (ops.empty() or not tys[0]->is_pointer_type())
+                return nullptr;
+            for (std::size_t i = 1; i < ops.size(); i++)
+                if (not tys[i]->is_integer_type())
+                    return nullptr;
+            auto elem = tys[0]->get_pointer_element_type();
+            if (not elem->is_array_type() and not elem->is_integer_type() and
+                not elem->is_float_type())
+                return nullptr;
+            for (std::size_t i = 2; i < ops.size(); i++) {
+                if (not elem->is_array_type())
+                    break;
+                elem = static_cast<ArrayType *>(elem)->get_element_type();
+                if (i + 1 < ops.size() and not elem->is_array_type())
+                    return nullptr;
+            }
+            return m_->get_pointer_type(elem);
+        }
+        case Instruction::zext:
+            return ops.size() == 1 and tys[0]->is_integer_type() and
+                           ty->is_integer_type() and
+                           static_cast<IntegerType *>(tys[0])->get_num_bits() <
+                               static_cast<IntegerType *>(ty)->get_num_bits()
+                       ? ty
+                       : nullptr;
+        case Instruction::fptosi:
+            return ops.size() == 1 and tys[0]->is_float_type() and
+                           ty->is_integer_type()
+                       ? ty
+                       : nullptr;
+        case Instruction::sitofp:
+            return ops.size() == 1 and tys[0]->is_integer_type()
+                       ? m_->get_float_type()
+                       : nullptr;
+        case Instruction::bitcast:
+            return ops.size() == 1 and tys[0]->is_pointer_type() and
+                           ty->is_pointer_type()
+                       ? ty
+                       : nullptr;
+        case Instruction::phi:
+            if (ops.size() % 2 or not(ty->is_integer_type() or
+                                      ty->is_float_type() or
+                                      ty->is_pointer_type() or
+                                      ty->is_vector_type()))
+                return nullptr;
+            for (std::size_t i = 0; i < ops.size(); i += 2)
+                if (tys[i] != ty or not is_block(ops[i + 1]))
+                    return nullptr;
+            return ty;
+        }
+        return nullptr;
+    };
+    // the stored edges are those of the branches, in some order
+    std::vector<std::vector<uint32_t>> branch_preds(num_blocks);
+    for (std::size_t b = 0; b < num_blocks; b++) {
+        auto &instrs = block_instrs[b];
+        if (instrs.empty())
+            return false;
+        for (auto i : instrs) {
+            auto &record = records[i];
+            if (result_type(record) != record.type)
+                return false;
+            bool is_terminator = record.op_id == Instruction::ret or
+                                 record.op_id == Instruction::br;
+            if (is_terminator != (i == instrs.back()))
+                return false;
+        }
+        std::vector<uint32_t> targets;
+        auto &terminator = records[instrs.back()];
+        for (auto op : terminator.ops) {
+            if (kind(op) == ref_block and terminator.op_id == Instruction::br) {
+                targets.push_back(op & ref_index_mask);
+                branch_preds[op & ref_index_mask].push_back(b);
+            }
+        }
+        auto stored = succs[b];
+        std::sort(stored.begin(), stored.end());
+        std::sort(targets.begin(), targets.end());
+        if (stored != targets)
+            return false;
+    }
+    for (std::size_t b = 0; b < num_blocks; b++) {
+        auto stored = preds[b];
+        std::sort(stored.begin(), stored.end());
+        if (stored != branch_preds[b])
+            return false;
+    }
+
+    // the other instructions need their operands, which come before them in
+    // a reverse post order of the reachable blocks; unreachable blocks wait
+    // until their operands are there
+    std::vector<std::size_t> order;
+    std::vector<char> seen(num_blocks, 0);
+    std::vector<std::pair<std::size_t, std::size_t>> dfs{{0, 0}};
+    seen[0] = 1;
+    while (not dfs.empty()) {
+        auto &[b, next] = dfs.back();
+        if (next < succs[b].size()) {
+            auto succ = succs[b][next++];
+            if (not seen[succ]) {
+                seen[succ] = 1;
+                dfs.emplace_back(succ, 0);
+            }
+        } else {
+            order.push_back(b);
+            dfs.pop_back();
+        }
+    }
+    std::reverse(order.begin(), order.end());
+    for (std::size_t b = 0; b < num_blocks; b++) {
+        if (not seen[b])
+            order.push_back(b);
+    }
+
+    // the order the blocks get their instructions in, found before any is
+    // made; operands that refer to each other in a cycle are broken ir
+    std::vector<char> made(records.size(), 0);
+    for (std::size_t i = 0; i < records.size(); i++)
+        made[i] = records[i].op_id == Instruction::phi;
+    auto ready = [&](std::size_t b) {
+        for (auto i : block_instrs[b]) {
+            if (records[i].op_id == Instruction::phi)
+                continue;
+            for (auto op : records[i].ops) {
+                auto index = op & ref_index_mask;
+                // an earlier instruction of the same block is made first
+                if (kind(op) == ref_instruction and not made[index] and
+                    not(block_instrs[b].front() <= index and index < i))
+                    return false;
+            }
+        }
+        return true;
+    };
+    std::vector<std::size_t> schedule;
+    while (not order.empty()) {
+        std::vector<std::size_t> waiting;
+        for (auto b : order) {
+            if (not ready(b)) {
+                waiting.push_back(b);
+                continue;
+            }
+            schedule.push_back(b);
+            for (auto i : block_instrs[b])
+                made[i] = 1;
+        }
+        if (waiting.size() == order.size())
+            return false;
+        order = std::move(waiting);
+    }
+
+    std::vector<BasicBlock *> blocks(num_blocks);
+    for (std::size_t b = 0; b < num_blocks; b++) {
+        blocks[b] = BasicBlock::create(m_, "", func);
+        blocks[b]->set_name(block_names[b]);
+    }
+    std::vector<Instruction *> instrs(records.size(), nullptr);
+    auto resolve = [&](uint32_t ref) -> Value * {
+        auto index = ref & ref_index_mask;
+        switch (kind(ref)) {
+        case ref_constant:
+            return constants_[index];
+        case ref_global:
+            return globals_[index];
+        case ref_function:
+            return functions_[index];
+        case ref_argument:
+            return args[index];
+        case ref_block:
+            return blocks[index];
+        default:
+            return instrs[index];
+        }
+    };
+
+    // phis first, their incoming values may come from anywhere
+    for (std::size_t b = 0; b < num_blocks; b++) {
+        for (auto i : block_instrs[b]) {
+            if (records[i].op_id != Instruction::phi)
+                continue;
+            instrs[i] = PhiInst::create_phi(records[i].type, blocks[b]);
+            blocks[b]->add_instruction(instrs[i]);
+        }
+    }
+
+    auto create = [&](Record &record, BasicBlock *bb) -> Instruction * {
+        std::vector<Value *> ops;
+        for (auto op : record.ops)
+            ops.push_back(resolve(op));
+        auto rest = [&]() {
+            return std::vector<Value *>(ops.begin() + 1, ops.end());
+        };
+        switch (record.op_id) {
+        case Instruction::ret:
+            return ops.empty() ? ReturnInst::create_void_ret(bb)
+                               : ReturnInst::create_ret(ops[0], bb);
+        case Instruction::br:
+            return ops.size() == 1
+                       ? BranchInst::create_br(ops[0]->as<BasicBlock>(), bb)
+                       : BranchInst::create_cond_br(
+                             ops[0], ops[1]->as<BasicBlock>(),
+                             ops[2]->as<BasicBlock>(), bb);
+        case Instruction::add:
+            return IBinaryInst::create_add(ops[0], ops[1], bb);
+        case Instruction::sub:
+            return IBinaryInst::create_sub(ops[0], ops[1], bb);
+        case Instruction::mul:
+            return IBinaryInst::create_mul(ops[0], ops[1], bb);
+        case Instruction::sdiv:
+            return IBinaryInst::create_sdiv(ops[0], ops[1], bb);
+        case Instruction::fadd:
+            return FBinaryInst::create_fadd(ops[0], ops[1], bb);
+        case Instruction::fsub:
+            return FBinaryInst::create_fsub(ops[0], ops[1], bb);
+        case Instruction::fmul:
+            return FBinaryInst::create_fmul(ops[0], ops[1], bb);
+        case Instruction::fdiv:
+            return FBinaryInst::create_fdiv(ops[0], ops[1], bb);
+        case Instruction::alloca:
+            return AllocaInst::create_alloca(
+                record.type->get_pointer_element_type(), bb);
+        case Instruction::load:
+            return LoadInst::create_load(ops[0], bb);
+        case Instruction::store:
+            return StoreInst::create_store(ops[0], ops[1], bb);
+        case Instruction::ge:
+            return ICmpInst::create_ge(ops[0], ops[1], bb);
+        case Instruction::gt:
+            return ICmpInst::create_gt(ops[0], ops[1], bb);
+        case Instruction::le:
+            return ICmpInst::create_le(ops[0], ops[1], bb);
+        case Instruction::lt:
+            return ICmpInst::create_lt(ops[0], ops[1], bb);
+        case Instruction::eq:
+            return ICmpInst::create_eq(ops[0], ops[1], bb);
+        case Instruction::ne:
+            return ICmpInst::create_ne(ops[0], ops[1], bb);
+        case Instruction::fge:
+            return FCmpInst::create_fge(ops[0], ops[1], bb);
+        case Instruction::fgt:
+            return FCmpInst::create_fgt(ops[0], ops[1], bb);
+        case Instruction::fle:
+            return FCmpInst::create_fle(ops[0], ops[1], bb);
+        case Instruction::flt:
+            return FCmpInst::create_flt(ops[0], ops[1], bb);
+        case Instruction::feq:
+            return FCmpInst::create_feq(ops[0], ops[1], bb);
+        case Instruction::fne:
+            return FCmpInst::create_fne(ops[0], ops[1], bb);
+        case Instruction::call:
+            return CallInst::create_call(ops[0]->as<Function>(), rest(), bb);
+        case Instruction::getelementptr:
+            return GetElementPtrInst::create_gep(ops[0], rest(), bb);
+        case Instruction::zext:
+            return ZextInst::create_zext(ops[0], record.type, bb);
+        case Instruction::fptosi:
+            return FpToSiInst::create_fptosi(ops[0], record.type, bb);
+        case Instruction::sitofp:
+            return SiToFpInst::create_sitofp(ops[0], bb);
+        case Instruction::bitcast:
+            return BitCastInst::create_bitcast(ops[0], record.type, bb);
+        }
+        // the checks above let no other opcode through
+        return nullptr;
+    };
+    for (auto b : schedule) {
+        for (auto i : block_instrs[b]) {
+            if (records[i].op_id != Instruction::phi)
+                instrs[i] = create(records[i], blocks[b]);
+        }
+    }
+
+    for (std::size_t i = 0; i < records.size(); i++) {
+        if (records[i].op_id == Instruction::phi) {
+            auto phi = instrs[i]->as<PhiInst>();
+            for (std::size_t op = 0; op + 1 < records[i].ops.size(); op += 2)
+                phi->add_phi_pair_operand(
+                    resolve(records[i].ops[op]),
+                    resolve(records[i].ops[op + 1])->as<BasicBlock>());
+        }
+        instrs[i]->set_name(records[i].name);
+    }
+    // the branches made edges in the order they were created, the stored
+    // lists keep the order the module had
+    for (std::size_t b = 0; b < num_blocks; b++) {
+        blocks[b]->reset();
+        for (auto pred : preds[b])
+            blocks[b]->add_pre_basic_block(blocks[pred]);
+        for (auto succ : succs[b])
+            blocks[b]->add_succ_basic_block(blocks[succ]);
+    }
+    return true;
+}
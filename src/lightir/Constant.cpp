@@ -1,64 +1,41 @@
 #include "Constant.hpp"
 #include "Module.hpp"
 
+#include <cstring>
 #include <iostream>
 #include <memory>
-#include <sstream>
-#include <unordered_map>
-
-struct pair_hash {
-    template <typename T>
-    std::size_t operator()(const std::pair<T, Module *> val) const {
-        auto lhs = std::hash<T>()(val.first);
-        auto rhs =
-            std::hash<uintptr_t>()(reinterpret_cast<uintptr_t>(val.second));
-        return lhs ^ rhs;
-    }
-};
-
-static std::unordered_map<std::pair<int, Module *>,
-                          std::unique_ptr<ConstantInt>, pair_hash>
-    cached_int;
-static std::unordered_map<std::pair<bool, Module *>,
-                          std::unique_ptr<ConstantInt>, pair_hash>
-    cached_bool;
-static std::unordered_map<std::pair<float, Module *>,
-                          std::unique_ptr<ConstantFP>, pair_hash>
-    cached_float;
-static std::unordered_map<Type *, std::unique_ptr<ConstantZero>> cached_zero;
+#include <mutex>
 
 ConstantInt *ConstantInt::get(int val, Module *m) {
-    if (cached_int.find(std::make_pair(val, m)) != cached_int.end())
-        return cached_int[std::make_pair(val, m)].get();
-    return (cached_int[std::make_pair(val, m)] = std::unique_ptr<ConstantInt>(
-                new ConstantInt(m->get_int32_type(), val)))
-        .get();
+    std::lock_guard<std::mutex> lock(m->constants_mutex_);
+    auto &slot = m->int_constants_[val];
+    if (not slot)
+        slot.reset(new (m) ConstantInt(m->get_int32_type(), val));
+    return slot.get();
 }
 ConstantInt *ConstantInt::get(bool val, Module *m) {
-    if (cached_bool.find(std::make_pair(val, m)) != cached_bool.end())
-        return cached_bool[std::make_pair(val, m)].get();
-    return (cached_bool[std::make_pair(val, m)] = std::unique_ptr<ConstantInt>(
-                new ConstantInt(m->get_int1_type(), val ? 1 : 0)))
-        .get();
+    std::lock_guard<std::mutex> lock(m->constants_mutex_);
+    auto &slot = m->bool_constants_[val];
+    if (not slot)
+        slot.reset(new (m) ConstantInt(m->get_int1_type(), val ? 1 : 0));
+    return slot.get();
 }
-std::string ConstantInt::print() {
-    std::string const_ir;
+void ConstantInt::print(std::ostream &os) {
     Type *ty = this->get_type();
     if (ty->is_integer_type() &&
         static_cast<IntegerType *>(ty)->get_num_bits() == 1) {
         // int1
-        const_ir += (this->get_value() == 0) ? "false" : "true";
+        os << ((this->get_value() == 0) ? "false" : "true");
     } else {
         // int32
-        const_ir += std::to_string(this->get_value());
+        os << this->get_value();
     }
-    return const_ir;
 }
 
 ConstantArray::ConstantArray(ArrayType *ty, const std::vector<Constant *> &val)
-    : Constant(ty, "") {
+    : Constant(ty, ConstantArrayVal, "") {
     for (unsigned i = 0; i < val.size(); i++)
-        set_operand(i, val[i]);
+        add_operand(val[i]);
     this->const_array.assign(val.begin(), val.end());
 }
 
@@ -68,49 +45,68 @@ Constant *ConstantArray::get_element_value(int index) {
 
 ConstantArray *ConstantArray::get(ArrayType *ty,
                                   const std::vector<Constant *> &val) {
-    return new ConstantArray(ty, val);
+    auto *m = ty->get_module();
+    std::lock_guard<std::mutex> lock(m->constants_mutex_);
+    m->array_constants_.emplace_back(new (m) ConstantArray(ty, val));
+    return m->array_constants_.back().get();
 }
 
-std::string ConstantArray::print() {
-    std::string const_ir;
-    const_ir += this->get_type()->print();
-    const_ir += " ";
-    const_ir += "[";
+void ConstantArray::print(std::ostream &os) {
+    this->get_type()->print(os);
+    os << " [";
     for (unsigned i = 0; i < this->get_size_of_array(); i++) {
         Constant *element = get_element_value(i);
-        if (!dynamic_cast<ConstantArray *>(get_element_value(i))) {
-            const_ir += element->get_type()->print();
+        if (!element->is<ConstantArray>()) {
+            element->get_type()->print(os);
+            os << " ";
         }
-        const_ir += element->print();
-        if (i < this->get_size_of_array()) {
-            const_ir += ", ";
+        element->print(os);
+        if (i + 1 < this->get_size_of_array()) {
+            os << ", ";
         }
     }
-    const_ir += "]";
-    return const_ir;
+    os << "]";
 }
 
 ConstantFP *ConstantFP::get(float val, Module *m) {
-    if (cached_float.find(std::make_pair(val, m)) != cached_float.end())
-        return cached_float[std::make_pair(val, m)].get();
-    return (cached_float[std::make_pair(val, m)] = std::unique_ptr<ConstantFP>(
-                new ConstantFP(m->get_float_type(), val)))
-        .get();
+    // unique by bit pattern, 0.0 and -0.0 are different constants
+    uint32_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    std::lock_guard<std::mutex> lock(m->constants_mutex_);
+    auto &slot = m->float_constants_[bits];
+    if (not slot)
+        slot.reset(new (m) ConstantFP(m->get_float_type(), val));
+    return slot.get();
 }
 
-std::string ConstantFP::print() {
-    std::stringstream fp_ir_ss;
-    std::string fp_ir;
-    double val = this->get_value();
-    fp_ir_ss << "0x" << std::hex << *(uint64_t *)&val << std::endl;
-    fp_ir_ss >> fp_ir;
-    return fp_ir;
+ConstantFP::ConstantFP(Type *ty, float val)
+    : Constant(ty, ConstantFPVal, ""), val_(val) {
+    // as std::hex would, without the leading zeros
+    double wide = val;
+    uint64_t bits;
+    std::memcpy(&bits, &wide, sizeof(bits));
+    char digits[16];
+    int n = 0;
+    do {
+        digits[n++] = "0123456789abcdef"[bits & 0xf];
+        bits >>= 4;
+    } while (bits != 0);
+    text_len_ = 0;
+    text_[text_len_++] = '0';
+    text_[text_len_++] = 'x';
+    while (n > 0)
+        text_[text_len_++] = digits[--n];
+    text_[text_len_] = '\0';
 }
 
+void ConstantFP::print(std::ostream &os) { os.write(text_, text_len_); }
+
 ConstantZero *ConstantZero::get(Type *ty, Module *m) {
-    if (not cached_zero[ty])
-        cached_zero[ty] = std::unique_ptr<ConstantZero>(new ConstantZero(ty));
-    return cached_zero[ty].get();
+    std::lock_guard<std::mutex> lock(m->constants_mutex_);
+    auto &slot = m->zero_constants_[ty];
+    if (not slot)
+        slot.reset(new (m) ConstantZero(ty));
+    return slot.get();
 }
 
-std::string ConstantZero::print() { return "zeroinitializer"; }
+void ConstantZero::print(std::ostream &os) { os << "zeroinitializer"; }
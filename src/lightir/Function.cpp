@@ -2,8 +2,12 @@
 #include "IRprinter.hpp"
 #include "Module.hpp"
 
+#include <algorithm>
+#include <unordered_set>
+#include <vector>
+
 Function::Function(FunctionType *ty, const std::string &name, Module *parent)
-    : Value(ty, name), parent_(parent), seq_cnt_(0) {
+    : Value(ty, FunctionVal, name), parent_(parent) {
     // num_args_ = ty->getNumParams();
     parent->add_function(this);
     // build args
@@ -13,7 +17,7 @@ Function::Function(FunctionType *ty, const std::string &name, Module *parent)
 }
 Function *Function::create(FunctionType *ty, const std::string &name,
                            Module *parent) {
-    return new Function(ty, name, parent);
+    return new (parent) Function(ty, name, parent);
 }
 
 FunctionType *Function::get_function_type() const {
@@ -42,90 +46,122 @@ void Function::remove(BasicBlock *bb) {
     }
 }
 
-void Function::add_basic_block(BasicBlock *bb) { basic_blocks_.push_back(bb); }
+void Function::take_basic_blocks(Function *from) {
+    while (not from->basic_blocks_.empty()) {
+        auto bb = &from->basic_blocks_.front();
+        from->basic_blocks_.remove(bb);
+        bb->parent_ = this;
+        basic_blocks_.push_back(bb);
+    }
+}
 
-void Function::set_instr_name() {
-    std::map<Value *, int> seq;
-    for (auto &arg : this->get_args()) {
-        if (seq.find(&arg) == seq.end()) {
-            auto seq_num = seq.size() + seq_cnt_;
-            if (arg.set_name("arg" + std::to_string(seq_num))) {
-                seq.insert({&arg, seq_num});
-            }
-        }
+unsigned Function::remove_unreachable_basic_blocks() {
+    std::unordered_set<BasicBlock *> reachable;
+    std::vector<BasicBlock *> stack{get_entry_block()};
+    reachable.insert(get_entry_block());
+    while (not stack.empty()) {
+        auto bb = stack.back();
+        stack.pop_back();
+        for (auto succ : bb->get_succ_basic_blocks())
+            if (reachable.insert(succ).second)
+                stack.push_back(succ);
     }
-    for (auto &bb1 : basic_blocks_) {
-        auto bb = &bb1;
-        if (seq.find(bb) == seq.end()) {
-            auto seq_num = seq.size() + seq_cnt_;
-            if (bb->set_name("label" + std::to_string(seq_num))) {
-                seq.insert({bb, seq_num});
-            }
-        }
-        for (auto &instr : bb->get_instructions()) {
-            if (!instr.is_void() && seq.find(&instr) == seq.end()) {
-                auto seq_num = seq.size() + seq_cnt_;
-                if (instr.set_name("op" + std::to_string(seq_num))) {
-                    seq.insert({&instr, seq_num});
-                }
+    std::vector<BasicBlock *> to_erase;
+    for (auto &bb : basic_blocks_)
+        if (not reachable.count(&bb))
+            to_erase.push_back(&bb);
+
+    for (auto bb : to_erase) {
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (not reachable.count(succ))
+                continue;
+            for (auto &instr : succ->get_instructions()) {
+                if (not instr.is_phi())
+                    break;
+                instr.as<PhiInst>()->remove_incoming(bb);
             }
         }
     }
-    seq_cnt_ += seq.size();
+    // unreachable blocks may refer to each other, drop all references first
+    for (auto bb : to_erase)
+        for (auto &instr : bb->get_instructions())
+            instr.remove_all_operands();
+    for (auto bb : to_erase) {
+        bb->erase_from_parent();
+        delete bb;
+    }
+    return to_erase.size();
 }
 
-std::string Function::print() {
-    set_instr_name();
-    std::string func_ir;
+void Function::drop_body() {
+    // the blocks refer to each other, drop all references first
+    for (auto &bb : basic_blocks_)
+        for (auto &instr : bb.get_instructions())
+            instr.remove_all_operands();
+    while (not basic_blocks_.empty()) {
+        auto bb = &basic_blocks_.front();
+        basic_blocks_.remove(bb);
+        delete bb;
+    }
+}
+
+void Function::add_basic_block(BasicBlock *bb) { basic_blocks_.push_back(bb); }
+
+unsigned Function::renumber_basic_blocks() {
+    unsigned index = 0;
+    for (auto &bb : basic_blocks_)
+        bb.index_ = index++;
+    return index;
+}
+
+void Function::print(std::ostream &os) {
+    SlotTracker slot_tracker(this);
+    slot_tracker_ = &slot_tracker;
     if (this->is_declaration()) {
-        func_ir += "declare ";
+        os << "declare ";
     } else {
-        func_ir += "define ";
+        os << "define ";
     }
 
-    func_ir += this->get_return_type()->print();
-    func_ir += " ";
-    func_ir += print_as_op(this, false);
-    func_ir += "(";
+    this->get_return_type()->print(os);
+    os << " ";
+    print_as_op(os, this, false);
+    os << "(";
 
     // print arg
     if (this->is_declaration()) {
         for (unsigned i = 0; i < this->get_num_of_args(); i++) {
             if (i)
-                func_ir += ", ";
-            func_ir += static_cast<FunctionType *>(this->get_type())
-                           ->get_param_type(i)
-                           ->print();
+                os << ", ";
+            static_cast<FunctionType *>(this->get_type())
+                ->get_param_type(i)
+                ->print(os);
         }
     } else {
         for (auto &arg : get_args()) {
             if (&arg != &*get_args().begin())
-                func_ir += ", ";
-            func_ir += arg.print();
+                os << ", ";
+            arg.print(os);
         }
     }
-    func_ir += ")";
+    os << ")";
 
     // print bb
     if (this->is_declaration()) {
-        func_ir += "\n";
+        os << "\n";
     } else {
-        func_ir += " {";
-        func_ir += "\n";
+        os << " {";
+        os << "\n";
         for (auto &bb1 : this->get_basic_blocks()) {
             auto bb = &bb1;
-            func_ir += bb->print();
+            bb->print(os);
         }
-        func_ir += "}";
+        os << "}";
     }
-
-    return func_ir;
+    slot_tracker_ = nullptr;
 }
 
-std::string Argument::print() {
-    std::string arg_ir;
-    arg_ir += this->get_type()->print();
-    arg_ir += " %";
-    arg_ir += this->get_name();
-    return arg_ir;
+void Argument::print(std::ostream &os) {
+    this->get_type()->print(os);
+    os << " %" << get_print_name(this);
 }
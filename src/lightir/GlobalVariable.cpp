@@ -3,7 +3,7 @@
 
 GlobalVariable::GlobalVariable(std::string name, Module *m, Type *ty,
                                bool is_const, Constant *init)
-    : User(ty, name), is_const_(is_const), init_val_(init) {
+    : User(ty, GlobalVariableVal, name), is_const_(is_const), init_val_(init) {
     m->add_global_variable(this);
     if (init) {
         this->add_operand(init);
@@ -13,16 +13,13 @@ GlobalVariable::GlobalVariable(std::string name, Module *m, Type *ty,
 GlobalVariable *GlobalVariable::create(std::string name, Module *m, Type *ty,
                                        bool is_const,
                                        Constant *init = nullptr) {
-    return new GlobalVariable(name, m, PointerType::get(ty), is_const, init);
+    return new (m) GlobalVariable(name, m, PointerType::get(ty), is_const, init);
 }
 
-std::string GlobalVariable::print() {
-    std::string global_val_ir;
-    global_val_ir += print_as_op(this, false);
-    global_val_ir += " = ";
-    global_val_ir += (this->is_const() ? "constant " : "global ");
-    global_val_ir += this->get_type()->get_pointer_element_type()->print();
-    global_val_ir += " ";
-    global_val_ir += this->get_init()->print();
-    return global_val_ir;
+void GlobalVariable::print(std::ostream &os) {
+    print_as_op(os, this, false);
+    os << " = " << (this->is_const() ? "constant " : "global ");
+    this->get_type()->get_pointer_element_type()->print(os);
+    os << " ";
+    this->get_init()->print(os);
 }
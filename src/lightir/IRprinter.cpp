@@ -1,26 +1,107 @@
 #include "IRprinter.hpp"
 #include "Instruction.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
 #include <type_traits>
 
-std::string print_as_op(Value *v, bool print_ty) {
-    std::string op_ir;
+namespace {
+// the prefixes SlotTracker numbers with
+const char *slot_prefix(const Value *v) {
+    if (v->is<Argument>())
+        return "arg";
+    if (v->is<BasicBlock>())
+        return "label";
+    return "op";
+}
+
+// the number at the end of an argN/labelN/opN name, -1 for others
+long name_number(const std::string &name) {
+    for (const char *prefix : {"arg", "label", "op"}) {
+        auto len = std::strlen(prefix);
+        if (name.size() > len and name.compare(0, len, prefix) == 0 and
+            std::all_of(name.begin() + len, name.end(), [](char c) {
+                return std::isdigit(static_cast<unsigned char>(c));
+            }))
+            return std::atol(name.c_str() + len);
+    }
+    return -1;
+}
+} // namespace
+
+SlotTracker::SlotTracker(Function *func) {
+    long max_number = -1;
+    std::vector<const Value *> unnamed;
+    auto visit = [&](const Value *v) {
+        if (v->get_name().empty())
+            unnamed.push_back(v);
+        else
+            max_number = std::max(max_number, name_number(v->get_name()));
+    };
+    for (auto &arg : func->get_args())
+        visit(&arg);
+    for (auto &bb : func->get_basic_blocks()) {
+        visit(&bb);
+        for (auto &instr : bb.get_instructions())
+            if (not instr.is_void())
+                visit(&instr);
+    }
+    unsigned next = max_number + 1;
+    slots_.reserve(unnamed.size());
+    for (auto v : unnamed)
+        slots_.emplace(v, next++);
+}
+
+std::string SlotTracker::get_name(const Value *v) const {
+    auto it = slots_.find(v);
+    if (it == slots_.end())
+        return v->get_name();
+    return slot_prefix(v) + std::to_string(it->second);
+}
+
+std::string get_print_name(const Value *v) {
+    if (not v->get_name().empty())
+        return v->get_name();
+    // only the parents are looked at
+    auto val = const_cast<Value *>(v);
+    Function *func = nullptr;
+    if (auto arg = val->dyn_cast<Argument>())
+        func = arg->get_parent();
+    else if (auto bb = val->dyn_cast<BasicBlock>())
+        func = bb->get_parent();
+    else if (auto instr = val->dyn_cast<Instruction>())
+        func = instr->get_parent() ? instr->get_function() : nullptr;
+    if (func == nullptr)
+        return "";
+    if (auto tracker = func->get_slot_tracker())
+        return tracker->get_name(v);
+    return SlotTracker(func).get_name(v);
+}
+
+void print_as_op(std::ostream &os, Value *v, bool print_ty) {
     if (print_ty) {
-        op_ir += v->get_type()->print();
-        op_ir += " ";
+        v->get_type()->print(os);
+        os << " ";
     }
 
-    if (dynamic_cast<GlobalVariable *>(v)) {
-        op_ir += "@" + v->get_name();
-    } else if (dynamic_cast<Function *>(v)) {
-        op_ir += "@" + v->get_name();
-    } else if (dynamic_cast<Constant *>(v)) {
-        op_ir += v->print();
+    if (v->is<GlobalVariable>()) {
+        os << "@" << v->get_name();
+    } else if (v->is<Function>()) {
+        os << "@" << v->get_name();
+    } else if (v->is<Constant>()) {
+        v->print(os);
     } else {
-        op_ir += "%" + v->get_name();
+        os << "%" << get_print_name(v);
     }
+}
 
-    return op_ir;
+std::string print_as_op(Value *v, bool print_ty) {
+    std::ostringstream ss;
+    print_as_op(ss, v, print_ty);
+    return ss.str();
 }
 
 std::string print_instr_op_name(Instruction::OpID id) {
@@ -87,32 +168,29 @@ std::string print_instr_op_name(Instruction::OpID id) {
         return "fptosi";
     case Instruction::sitofp:
         return "sitofp";
+    case Instruction::bitcast:
+        return "bitcast";
     }
     assert(false && "Must be bug");
 }
 
-template <class BinInst> std::string print_binary_inst(const BinInst &inst) {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += inst.get_name();
-    instr_ir += " = ";
-    instr_ir += inst.get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += inst.get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    instr_ir += print_as_op(inst.get_operand(0), false);
-    instr_ir += ", ";
+template <class BinInst>
+void print_binary_inst(std::ostream &os, const BinInst &inst) {
+    os << "%" << get_print_name(&inst) << " = " << inst.get_instr_op_name() << " ";
+    inst.get_operand(0)->get_type()->print(os);
+    os << " ";
+    print_as_op(os, inst.get_operand(0), false);
+    os << ", ";
     if (inst.get_operand(0)->get_type() == inst.get_operand(1)->get_type()) {
-        instr_ir += print_as_op(inst.get_operand(1), false);
+        print_as_op(os, inst.get_operand(1), false);
     } else {
-        instr_ir += print_as_op(inst.get_operand(1), true);
+        print_as_op(os, inst.get_operand(1), true);
     }
-    return instr_ir;
 }
-std::string IBinaryInst::print() { return print_binary_inst(*this); }
-std::string FBinaryInst::print() { return print_binary_inst(*this); }
+void IBinaryInst::print(std::ostream &os) { print_binary_inst(os, *this); }
+void FBinaryInst::print(std::ostream &os) { print_binary_inst(os, *this); }
 
-template <class CMP> std::string print_cmp_inst(const CMP &inst) {
+template <class CMP> void print_cmp_inst(std::ostream &os, const CMP &inst) {
     std::string cmp_type;
     if (inst.is_cmp())
         cmp_type = "icmp";
@@ -120,216 +198,145 @@ template <class CMP> std::string print_cmp_inst(const CMP &inst) {
         cmp_type = "fcmp";
     else
         assert(false && "Unexpected case");
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += inst.get_name();
-    instr_ir += " = " + cmp_type + " ";
-    instr_ir += inst.get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += inst.get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    instr_ir += print_as_op(inst.get_operand(0), false);
-    instr_ir += ", ";
+    os << "%" << get_print_name(&inst) << " = " << cmp_type << " "
+       << inst.get_instr_op_name() << " ";
+    inst.get_operand(0)->get_type()->print(os);
+    os << " ";
+    print_as_op(os, inst.get_operand(0), false);
+    os << ", ";
     if (inst.get_operand(0)->get_type() == inst.get_operand(1)->get_type()) {
-        instr_ir += print_as_op(inst.get_operand(1), false);
+        print_as_op(os, inst.get_operand(1), false);
     } else {
-        instr_ir += print_as_op(inst.get_operand(1), true);
+        print_as_op(os, inst.get_operand(1), true);
     }
-    return instr_ir;
 }
-std::string ICmpInst::print() { return print_cmp_inst(*this); }
-std::string FCmpInst::print() { return print_cmp_inst(*this); }
+void ICmpInst::print(std::ostream &os) { print_cmp_inst(os, *this); }
+void FCmpInst::print(std::ostream &os) { print_cmp_inst(os, *this); }
 
-std::string CallInst::print() {
-    std::string instr_ir;
+void CallInst::print(std::ostream &os) {
     if (!this->is_void()) {
-        instr_ir += "%";
-        instr_ir += this->get_name();
-        instr_ir += " = ";
+        os << "%" << get_print_name(this) << " = ";
     }
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += this->get_function_type()->get_return_type()->print();
-
-    instr_ir += " ";
-    assert(dynamic_cast<Function *>(this->get_operand(0)) &&
+    os << get_instr_op_name() << " ";
+    this->get_function_type()->get_return_type()->print(os);
+    os << " ";
+    assert(this->get_operand(0)->is<Function>() &&
            "Wrong call operand function");
-    instr_ir += print_as_op(this->get_operand(0), false);
-    instr_ir += "(";
+    print_as_op(os, this->get_operand(0), false);
+    os << "(";
     for (unsigned i = 1; i < this->get_num_operand(); i++) {
         if (i > 1)
-            instr_ir += ", ";
-        instr_ir += this->get_operand(i)->get_type()->print();
-        instr_ir += " ";
-        instr_ir += print_as_op(this->get_operand(i), false);
+            os << ", ";
+        this->get_operand(i)->get_type()->print(os);
+        os << " ";
+        print_as_op(os, this->get_operand(i), false);
     }
-    instr_ir += ")";
-    return instr_ir;
+    os << ")";
 }
 
-std::string BranchInst::print() {
-    std::string instr_ir;
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += print_as_op(this->get_operand(0), true);
+void BranchInst::print(std::ostream &os) {
+    os << get_instr_op_name() << " ";
+    print_as_op(os, this->get_operand(0), true);
     if (is_cond_br()) {
-        instr_ir += ", ";
-        instr_ir += print_as_op(this->get_operand(1), true);
-        instr_ir += ", ";
-        instr_ir += print_as_op(this->get_operand(2), true);
+        os << ", ";
+        print_as_op(os, this->get_operand(1), true);
+        os << ", ";
+        print_as_op(os, this->get_operand(2), true);
     }
-    return instr_ir;
 }
 
-std::string ReturnInst::print() {
-    std::string instr_ir;
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
+void ReturnInst::print(std::ostream &os) {
+    os << get_instr_op_name() << " ";
     if (!is_void_ret()) {
-        instr_ir += this->get_operand(0)->get_type()->print();
-        instr_ir += " ";
-        instr_ir += print_as_op(this->get_operand(0), false);
+        this->get_operand(0)->get_type()->print(os);
+        os << " ";
+        print_as_op(os, this->get_operand(0), false);
     } else {
-        instr_ir += "void";
+        os << "void";
     }
-
-    return instr_ir;
 }
 
-std::string GetElementPtrInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
+void GetElementPtrInst::print(std::ostream &os) {
+    os << "%" << get_print_name(this) << " = " << get_instr_op_name() << " ";
     assert(this->get_operand(0)->get_type()->is_pointer_type());
-    instr_ir +=
-        this->get_operand(0)->get_type()->get_pointer_element_type()->print();
-    instr_ir += ", ";
+    this->get_operand(0)->get_type()->get_pointer_element_type()->print(os);
+    os << ", ";
     for (unsigned i = 0; i < this->get_num_operand(); i++) {
         if (i > 0)
-            instr_ir += ", ";
-        instr_ir += this->get_operand(i)->get_type()->print();
-        instr_ir += " ";
-        instr_ir += print_as_op(this->get_operand(i), false);
+            os << ", ";
+        this->get_operand(i)->get_type()->print(os);
+        os << " ";
+        print_as_op(os, this->get_operand(i), false);
     }
-    return instr_ir;
 }
 
-std::string StoreInst::print() {
-    std::string instr_ir;
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += this->get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    instr_ir += print_as_op(this->get_operand(0), false);
-    instr_ir += ", ";
-    instr_ir += print_as_op(this->get_operand(1), true);
-    return instr_ir;
+// a vector is accessed where its elements are, llvm would assume the
+// alignment of the whole vector
+static void print_vector_align(std::ostream &os, Type *ty) {
+    if (ty->is_vector_type())
+        os << ", align " << ty->get_scalar_type()->get_size();
 }
 
-std::string LoadInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    assert(this->get_operand(0)->get_type()->is_pointer_type());
-    instr_ir +=
-        this->get_operand(0)->get_type()->get_pointer_element_type()->print();
-    instr_ir += ",";
-    instr_ir += " ";
-    instr_ir += print_as_op(this->get_operand(0), true);
-    return instr_ir;
+void StoreInst::print(std::ostream &os) {
+    os << get_instr_op_name() << " ";
+    this->get_operand(0)->get_type()->print(os);
+    os << " ";
+    print_as_op(os, this->get_operand(0), false);
+    os << ", ";
+    print_as_op(os, this->get_operand(1), true);
+    print_vector_align(os, this->get_operand(0)->get_type());
 }
 
-std::string AllocaInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += get_alloca_type()->print();
-    return instr_ir;
-}
-
-std::string ZextInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += this->get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    instr_ir += print_as_op(this->get_operand(0), false);
-    instr_ir += " to ";
-    instr_ir += this->get_dest_type()->print();
-    return instr_ir;
+void LoadInst::print(std::ostream &os) {
+    os << "%" << get_print_name(this) << " = " << get_instr_op_name() << " ";
+    assert(this->get_operand(0)->get_type()->is_pointer_type());
+    this->get_operand(0)->get_type()->get_pointer_element_type()->print(os);
+    os << ", ";
+    print_as_op(os, this->get_operand(0), true);
+    print_vector_align(os, get_type());
 }
 
-std::string FpToSiInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += this->get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    instr_ir += print_as_op(this->get_operand(0), false);
-    instr_ir += " to ";
-    instr_ir += this->get_dest_type()->print();
-    return instr_ir;
+void AllocaInst::print(std::ostream &os) {
+    os << "%" << get_print_name(this) << " = " << get_instr_op_name() << " ";
+    get_alloca_type()->print(os);
 }
 
-std::string SiToFpInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += this->get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    instr_ir += print_as_op(this->get_operand(0), false);
-    instr_ir += " to ";
-    instr_ir += this->get_dest_type()->print();
-    return instr_ir;
+template <class CastInst>
+void print_cast_inst(std::ostream &os, const CastInst &inst) {
+    os << "%" << get_print_name(&inst) << " = " << inst.get_instr_op_name() << " ";
+    inst.get_operand(0)->get_type()->print(os);
+    os << " ";
+    print_as_op(os, inst.get_operand(0), false);
+    os << " to ";
+    inst.get_dest_type()->print(os);
 }
+void ZextInst::print(std::ostream &os) { print_cast_inst(os, *this); }
+void FpToSiInst::print(std::ostream &os) { print_cast_inst(os, *this); }
+void SiToFpInst::print(std::ostream &os) { print_cast_inst(os, *this); }
+void BitCastInst::print(std::ostream &os) { print_cast_inst(os, *this); }
 
-std::string PhiInst::print() {
-    std::string instr_ir;
-    instr_ir += "%";
-    instr_ir += this->get_name();
-    instr_ir += " = ";
-    instr_ir += get_instr_op_name();
-    instr_ir += " ";
-    instr_ir += this->get_operand(0)->get_type()->print();
-    instr_ir += " ";
-    for (unsigned i = 0; i < this->get_num_operand() / 2; i++) {
+void PhiInst::print(std::ostream &os) {
+    os << "%" << get_print_name(this) << " = " << get_instr_op_name() << " ";
+    this->get_type()->print(os);
+    os << " ";
+    for (unsigned i = 0; i < this->get_num_incoming(); i++) {
         if (i > 0)
-            instr_ir += ", ";
-        instr_ir += "[ ";
-        instr_ir += print_as_op(this->get_operand(2 * i), false);
-        instr_ir += ", ";
-        instr_ir += print_as_op(this->get_operand(2 * i + 1), false);
-        instr_ir += " ]";
+            os << ", ";
+        os << "[ ";
+        print_as_op(os, this->get_incoming_value(i), false);
+        os << ", ";
+        print_as_op(os, this->get_incoming_block(i), false);
+        os << " ]";
     }
-    if (this->get_num_operand() / 2 <
+    if (this->get_num_incoming() <
         this->get_parent()->get_pre_basic_blocks().size()) {
         for (auto pre_bb : this->get_parent()->get_pre_basic_blocks()) {
-            if (std::find(this->get_operands().begin(),
-                          this->get_operands().end(),
-                          static_cast<Value *>(pre_bb)) ==
-                this->get_operands().end()) {
+            if (get_incoming_index(pre_bb) < 0) {
                 // find a pre_bb is not in phi
-                instr_ir += ", [ undef, " + print_as_op(pre_bb, false) + " ]";
+                os << ", [ undef, ";
+                print_as_op(os, pre_bb, false);
+                os << " ]";
             }
         }
     }
-    return instr_ir;
 }
@@ -12,11 +12,15 @@
 #include <vector>
 
 Instruction::Instruction(Type *ty, OpID id, BasicBlock *parent)
-    : User(ty, ""), op_id_(id), parent_(parent) {
+    : User(ty, InstructionVal + id, ""), op_id_(id), parent_(parent) {
     if (parent)
         parent->add_instruction(this);
 }
 
+Module *Instruction::get_module_of(BasicBlock *bb) {
+    return bb ? bb->get_module() : nullptr;
+}
+
 Function *Instruction::get_function() { return parent_->get_parent(); }
 Module *Instruction::get_module() { return parent_->get_module(); }
 
@@ -25,9 +29,10 @@ std::string Instruction::get_instr_op_name() const {
 }
 
 IBinaryInst::IBinaryInst(OpID id, Value *v1, Value *v2, BasicBlock *bb)
-    : BaseInst<IBinaryInst>(bb->get_module()->get_int32_type(), id, bb) {
-    assert(v1->get_type()->is_int32_type() && v2->get_type()->is_int32_type() &&
-           "IBinaryInst operands are not both i32");
+    : BaseInst<IBinaryInst>(v1->get_type(), id, bb) {
+    assert(v1->get_type()->get_scalar_type()->is_int32_type() &&
+           v1->get_type() == v2->get_type() &&
+           "IBinaryInst operands are not both i32 or the same i32 vector");
     add_operand(v1);
     add_operand(v2);
 }
@@ -46,9 +51,10 @@ IBinaryInst *IBinaryInst::create_sdiv(Value *v1, Value *v2, BasicBlock *bb) {
 }
 
 FBinaryInst::FBinaryInst(OpID id, Value *v1, Value *v2, BasicBlock *bb)
-    : BaseInst<FBinaryInst>(bb->get_module()->get_float_type(), id, bb) {
-    assert(v1->get_type()->is_float_type() && v2->get_type()->is_float_type() &&
-           "FBinaryInst operands are not both float");
+    : BaseInst<FBinaryInst>(v1->get_type(), id, bb) {
+    assert(v1->get_type()->get_scalar_type()->is_float_type() &&
+           v1->get_type() == v2->get_type() &&
+           "FBinaryInst operands are not both float or the same float vector");
     add_operand(v1);
     add_operand(v2);
 }
@@ -93,6 +99,36 @@ ICmpInst *ICmpInst::create_eq(Value *v1, Value *v2, BasicBlock *bb) {
 ICmpInst *ICmpInst::create_ne(Value *v1, Value *v2, BasicBlock *bb) {
     return create(ne, v1, v2, bb);
 }
+Instruction::OpID ICmpInst::get_swapped_op(OpID op) {
+    switch (op) {
+    case lt:
+        return gt;
+    case le:
+        return ge;
+    case gt:
+        return lt;
+    case ge:
+        return le;
+    default:
+        return op;
+    }
+}
+Instruction::OpID ICmpInst::get_inverse_op(OpID op) {
+    switch (op) {
+    case lt:
+        return ge;
+    case le:
+        return gt;
+    case gt:
+        return le;
+    case ge:
+        return lt;
+    case eq:
+        return ne;
+    default:
+        return eq;
+    }
+}
 
 FCmpInst::FCmpInst(OpID id, Value *lhs, Value *rhs, BasicBlock *bb)
     : BaseInst<FCmpInst>(bb->get_module()->get_int1_type(), id, bb) {
@@ -168,14 +204,11 @@ BranchInst::BranchInst(Value *cond, BasicBlock *if_true, BasicBlock *if_false,
 }
 
 BranchInst::~BranchInst() {
-    std::list<BasicBlock *> succs;
-    if (is_cond_br()) {
-        succs.push_back(static_cast<BasicBlock *>(get_operand(1)));
-        succs.push_back(static_cast<BasicBlock *>(get_operand(2)));
-    } else {
-        succs.push_back(static_cast<BasicBlock *>(get_operand(0)));
-    }
-    for (auto succ_bb : succs) {
+    // operands are already dropped when the module is torn down
+    if (get_num_operand() == 0)
+        return;
+    for (unsigned i = is_cond_br() ? 1 : 0; i < get_num_operand(); i++) {
+        auto succ_bb = static_cast<BasicBlock *>(get_operand(i));
         if (succ_bb) {
             succ_bb->remove_pre_basic_block(get_parent());
             get_parent()->remove_succ_basic_block(succ_bb);
@@ -183,6 +216,21 @@ BranchInst::~BranchInst() {
     }
 }
 
+void BranchInst::replace_successor(BasicBlock *from, BasicBlock *to) {
+    if (from == to)
+        return;
+    auto bb = get_parent();
+    for (unsigned i = is_cond_br() ? 1 : 0; i < get_num_operand(); i++) {
+        if (get_operand(i) != from)
+            continue;
+        set_operand(i, to);
+        to->add_pre_basic_block(bb);
+    }
+    from->remove_pre_basic_block(bb);
+    auto &succs = bb->get_succ_basic_blocks();
+    std::replace(succs.begin(), succs.end(), from, to);
+}
+
 BranchInst *BranchInst::create_cond_br(Value *cond, BasicBlock *if_true,
                                        BasicBlock *if_false, BasicBlock *bb) {
     return create(cond, if_true, if_false, bb);
@@ -276,7 +324,7 @@ LoadInst::LoadInst(Value *ptr, BasicBlock *bb)
     : BaseInst<LoadInst>(ptr->get_type()->get_pointer_element_type(), load,
                          bb) {
     assert((get_type()->is_integer_type() or get_type()->is_float_type() or
-            get_type()->is_pointer_type()) &&
+            get_type()->is_pointer_type() or get_type()->is_vector_type()) &&
            "Should not load value with type except int/float");
     add_operand(ptr);
 }
@@ -345,14 +393,25 @@ SiToFpInst *SiToFpInst::create_sitofp(Value *val, BasicBlock *bb) {
     return create(val, bb->get_module()->get_float_type(), bb);
 }
 
+BitCastInst::BitCastInst(Value *val, Type *ty, BasicBlock *bb)
+    : BaseInst<BitCastInst>(ty, bitcast, bb) {
+    assert(val->get_type()->is_pointer_type() && ty->is_pointer_type() &&
+           "BitCastInst only casts pointers");
+    add_operand(val);
+}
+
+BitCastInst *BitCastInst::create_bitcast(Value *val, Type *ty,
+                                         BasicBlock *bb) {
+    return create(val, ty, bb);
+}
+
 PhiInst::PhiInst(Type *ty, std::vector<Value *> vals,
                  std::vector<BasicBlock *> val_bbs, BasicBlock *bb)
     : BaseInst<PhiInst>(ty, phi) {
     assert(vals.size() == val_bbs.size() && "Unmatched vals and bbs");
     for (unsigned i = 0; i < vals.size(); i++) {
         assert(ty == vals[i]->get_type() && "Bad type for phi");
-        add_operand(vals[i]);
-        add_operand(val_bbs[i]);
+        add_phi_pair_operand(vals[i], val_bbs[i]);
     }
     this->set_parent(bb);
 }
@@ -362,52 +421,133 @@ PhiInst *PhiInst::create_phi(Type *ty, BasicBlock *bb,
                              std::vector<BasicBlock *> val_bbs) {
     return create(ty, vals, val_bbs, bb);
 }
+
+void PhiInst::build_index() const {
+    index_.clear();
+    index_has_repeats_ = false;
+    for (unsigned i = 0; i < incoming_bbs_.size(); i++)
+        if (not index_.try_emplace(incoming_bbs_[i], i).second)
+            index_has_repeats_ = true;
+    index_valid_ = true;
+}
+
+int PhiInst::get_incoming_index(const BasicBlock *pre_bb) const {
+    if (get_num_incoming() >= index_threshold) {
+        if (not index_valid_)
+            build_index();
+        if (not index_has_repeats_) {
+            auto it = index_.find(pre_bb);
+            return it == index_.end() ? -1 : static_cast<int>(it->second);
+        }
+    }
+    for (unsigned i = 0; i < incoming_bbs_.size(); i++)
+        if (incoming_bbs_[i] == pre_bb)
+            return i;
+    return -1;
+}
+
+void PhiInst::add_phi_pair_operand(Value *val, BasicBlock *pre_bb) {
+    add_operand(val);
+    incoming_bbs_.push_back(pre_bb);
+    if (index_valid_ and
+        not index_.try_emplace(pre_bb, incoming_bbs_.size() - 1).second)
+        index_has_repeats_ = true;
+}
+
+void PhiInst::set_incoming_block(unsigned i, BasicBlock *pre_bb) {
+    auto old_bb = incoming_bbs_[i];
+    incoming_bbs_[i] = pre_bb;
+    if (not index_valid_)
+        return;
+    if (index_has_repeats_) {
+        // the change may have removed the last repeat, find out on demand
+        index_valid_ = false;
+        return;
+    }
+    index_.erase(old_bb);
+    if (not index_.try_emplace(pre_bb, i).second)
+        index_has_repeats_ = true;
+}
+
+void PhiInst::remove_incoming(const BasicBlock *pre_bb) {
+    auto i = get_incoming_index(pre_bb);
+    if (i < 0)
+        return;
+    unsigned last = incoming_bbs_.size() - 1;
+    auto moved_bb = incoming_bbs_[last];
+    remove_operand_unordered(i);
+    incoming_bbs_[i] = moved_bb;
+    incoming_bbs_.pop_back();
+    if (not index_valid_)
+        return;
+    if (index_has_repeats_) {
+        index_valid_ = false;
+        return;
+    }
+    index_.erase(pre_bb);
+    if (static_cast<unsigned>(i) != last)
+        index_[moved_bb] = i;
+}
+
+void PhiInst::replace_incoming_block(const BasicBlock *old_bb,
+                                     BasicBlock *new_bb) {
+    if (old_bb == new_bb)
+        return;
+    for (int i; (i = get_incoming_index(old_bb)) >= 0;)
+        set_incoming_block(i, new_bb);
+}
 Instruction *FBinaryInst::clone(BasicBlock *prt) const  {
-  return new FBinaryInst(op_id_, get_operand(0), get_operand(1), prt);
+  return create(op_id_, get_operand(0), get_operand(1), prt);
 }
 
 Instruction *ICmpInst::clone(BasicBlock *prt) const  {
-  return new ICmpInst(op_id_, get_operand(0), get_operand(1), prt);
+  return create(op_id_, get_operand(0), get_operand(1), prt);
 }
 
 Instruction *FCmpInst::clone(BasicBlock *prt) const  {
-  return new FCmpInst(op_id_, get_operand(0), get_operand(1), prt);
+  return create(op_id_, get_operand(0), get_operand(1), prt);
 }
 
 
 
 Instruction *ReturnInst::clone(BasicBlock *prt) const  {
-  return new ReturnInst(get_operand(0), prt);
+  return create(get_operand(0), prt);
 }
 
 Instruction *StoreInst::clone(BasicBlock *prt) const  {
-  return new StoreInst(get_operand(0), get_operand(1), prt);
+  return create(get_operand(0), get_operand(1), prt);
 }
 
 Instruction *LoadInst::clone(BasicBlock *prt) const  {
-  return new LoadInst(get_operand(0), prt);
+  return create(get_operand(0), prt);
 }
 
 Instruction *AllocaInst::clone(BasicBlock *prt) const  {
-  return new AllocaInst(get_alloca_type(), prt);
+  return create(get_alloca_type(), prt);
 }
 
 Instruction *ZextInst::clone(BasicBlock *prt) const  {
-  return new ZextInst(get_operand(0), get_type(), prt);
+  return create(get_operand(0), get_type(), prt);
 }
 
 Instruction *FpToSiInst::clone(BasicBlock *prt) const  {
-  return new FpToSiInst(get_operand(0), get_type(), prt);
+  return create(get_operand(0), get_type(), prt);
 }
 
 Instruction *SiToFpInst::clone(BasicBlock *prt) const  {
-  return new SiToFpInst(get_operand(0), get_type(), prt);
+  return create(get_operand(0), get_type(), prt);
+}
+
+Instruction *BitCastInst::clone(BasicBlock *prt) const  {
+  return create(get_operand(0), get_type(), prt);
 }
 
 Instruction *PhiInst::clone(BasicBlock *prt) const  {
-  auto temp = new PhiInst(get_type(), {}, {}, prt);
-    for (unsigned i = 0; i < get_num_operand(); i += 2) {
-        temp->add_phi_pair_operand(get_operand(i), get_operand(i + 1));
+  auto temp = create(get_type(), std::vector<Value *>{},
+                     std::vector<BasicBlock *>{}, prt);
+    for (unsigned i = 0; i < get_num_incoming(); i++) {
+        temp->add_phi_pair_operand(get_incoming_value(i),
+                                   get_incoming_block(i));
     }
     return temp;
 }
\ No newline at end of file
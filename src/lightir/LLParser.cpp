@@ -0,0 +1,1099 @@
+#include "LLParser.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <vector>
+
+namespace {
+
+enum class Tok {
+    eof,
+    error,
+    local,     // %name
+    global,    // @name
+    label_def, // name:
+    word,      // keywords and types
+    integer,
+    hex, // 0x..., a double as printed by ConstantFP
+    fp,  // 1.5e+00
+    string,
+    attr_ref, // #0
+    punct,    // = , ( ) [ ] { } *
+};
+
+struct Token {
+    Tok kind{Tok::eof};
+    // without the sigil or the quotes
+    std::string text;
+    unsigned line{1}, col{1};
+};
+
+bool is_name_char(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) or c == '-' or
+           c == '$' or c == '.' or c == '_';
+}
+
+// copied to go back to a position, the parser reads function bodies in a
+// second pass
+class Lexer {
+  public:
+    Lexer(const char *data, std::size_t size)
+        : cur_(data), end_(data + size), line_start_(data) {}
+
+    Token next();
+
+  private:
+    Token make(Tok kind, const char *start, std::string text) const {
+        Token tok;
+        tok.kind = kind;
+        tok.text = std::move(text);
+        tok.line = line_;
+        tok.col = start - line_start_ + 1;
+        return tok;
+    }
+    // a name after % or @, plain or quoted
+    Token name(Tok kind, const char *start);
+
+    const char *cur_, *end_;
+    unsigned line_{1};
+    const char *line_start_;
+};
+
+Token Lexer::name(Tok kind, const char *start) {
+    if (cur_ < end_ and *cur_ == '"') {
+        auto close = static_cast<const char *>(
+            std::memchr(cur_ + 1, '"', end_ - cur_ - 1));
+        if (close == nullptr)
+            return make(Tok::error, start, "unterminated name");
+        std::string text(cur_ + 1, close);
+        cur_ = close + 1;
+        return make(kind, start, text);
+    }
+    auto begin = cur_;
+    while (cur_ < end_ and is_name_char(*cur_))
+        cur_++;
+    if (begin == cur_)
+        return make(Tok::error, start, "empty name");
+    return make(kind, start, std::string(begin, cur_));
+}
+
+Token Lexer::next() {
+    while (cur_ < end_) {
+        if (*cur_ == '\n') {
+            cur_++;
+            line_++;
+            line_start_ = cur_;
+        } else if (std::isspace(static_cast<unsigned char>(*cur_))) {
+            cur_++;
+        } else if (*cur_ == ';' or (*cur_ == '!' and cur_ == line_start_)) {
+            // comments, and metadata which is only skipped at the top level
+            while (cur_ < end_ and *cur_ != '\n')
+                cur_++;
+        } else {
+            break;
+        }
+    }
+    auto start = cur_;
+    if (cur_ == end_)
+        return make(Tok::eof, start, "");
+    char c = *cur_++;
+    switch (c) {
+    case '%':
+        return name(Tok::local, start);
+    case '@':
+        return name(Tok::global, start);
+    case '#': {
+        auto begin = cur_;
+        while (cur_ < end_ and std::isdigit(static_cast<unsigned char>(*cur_)))
+            cur_++;
+        return make(Tok::attr_ref, start, std::string(begin, cur_));
+    }
+    case '"': {
+        auto close = static_cast<const char *>(
+            std::memchr(cur_, '"', end_ - cur_));
+        if (close == nullptr)
+            return make(Tok::error, start, "unterminated string");
+        std::string text(cur_, close);
+        cur_ = close + 1;
+        return make(Tok::string, start, text);
+    }
+    case '=':
+    case ',':
+    case '(':
+    case ')':
+    case '[':
+    case ']':
+    case '{':
+    case '}':
+    case '<':
+    case '>':
+    case '*':
+        return make(Tok::punct, start, std::string(1, c));
+    }
+    if (c == '0' and cur_ < end_ and *cur_ == 'x') {
+        cur_++;
+        auto begin = cur_;
+        while (cur_ < end_ and std::isxdigit(static_cast<unsigned char>(*cur_)))
+            cur_++;
+        return make(Tok::hex, start, std::string(begin, cur_));
+    }
+    if (c == '-' or std::isdigit(static_cast<unsigned char>(c))) {
+        while (cur_ < end_ and std::isdigit(static_cast<unsigned char>(*cur_)))
+            cur_++;
+        if (cur_ < end_ and *cur_ == ':' and c != '-') {
+            cur_++;
+            return make(Tok::label_def, start, std::string(start, cur_ - 1));
+        }
+        if (cur_ == start + 1 and c == '-')
+            return make(Tok::error, start, "stray '-'");
+        if (cur_ < end_ and (*cur_ == '.' or *cur_ == 'e' or *cur_ == 'E')) {
+            if (*cur_ == '.')
+                cur_++;
+            while (cur_ < end_ and
+                   std::isdigit(static_cast<unsigned char>(*cur_)))
+                cur_++;
+            if (cur_ < end_ and (*cur_ == 'e' or *cur_ == 'E')) {
+                cur_++;
+                if (cur_ < end_ and (*cur_ == '+' or *cur_ == '-'))
+                    cur_++;
+                while (cur_ < end_ and
+                       std::isdigit(static_cast<unsigned char>(*cur_)))
+                    cur_++;
+            }
+            return make(Tok::fp, start, std::string(start, cur_));
+        }
+        return make(Tok::integer, start, std::string(start, cur_));
+    }
+    if (is_name_char(c)) {
+        while (cur_ < end_ and is_name_char(*cur_))
+            cur_++;
+        if (cur_ < end_ and *cur_ == ':') {
+            cur_++;
+            return make(Tok::label_def, start, std::string(start, cur_ - 1));
+        }
+        return make(Tok::word, start, std::string(start, cur_));
+    }
+    return make(Tok::error, start, "unexpected character '" +
+                                       std::string(1, c) + "'");
+}
+
+// skipped in front of globals and functions
+bool is_linkage_word(const std::string &word) {
+    static const char *words[] = {
+        "dso_local", "dso_preemptable", "internal", "private", "external",
+        "common", "weak", "linkonce_odr", "unnamed_addr", "local_unnamed_addr",
+    };
+    for (auto w : words) {
+        if (word == w)
+            return true;
+    }
+    return false;
+}
+
+class LLParser {
+  public:
+    LLParser(const char *data, std::size_t size) : lexer_(data, size) {
+        advance();
+    }
+    std::unique_ptr<Module> parse(std::string &error);
+
+  private:
+    struct Body {
+        Function *func;
+        // the names of the arguments, empty for unnamed ones
+        std::vector<std::string> arg_names;
+        // the lexer after the '{'
+        Lexer lexer;
+        Token tok;
+    };
+
+    void advance() { tok_ = lexer_.next(); }
+    bool fail(const std::string &msg) {
+        if (error_.empty())
+            error_ = std::to_string(tok_.line) + ":" +
+                     std::to_string(tok_.col) + ": " + msg;
+        return false;
+    }
+    std::string found() const {
+        switch (tok_.kind) {
+        case Tok::eof:
+            return "the end of the file";
+        case Tok::error:
+            return tok_.text;
+        case Tok::local:
+            return "'%" + tok_.text + "'";
+        case Tok::global:
+            return "'@" + tok_.text + "'";
+        case Tok::label_def:
+            return "'" + tok_.text + ":'";
+        case Tok::attr_ref:
+            return "'#" + tok_.text + "'";
+        default:
+            return "'" + tok_.text + "'";
+        }
+    }
+    bool expected(const std::string &what) {
+        return fail("expected " + what + " but found " + found());
+    }
+    bool is_punct(char c) const {
+        return tok_.kind == Tok::punct and tok_.text[0] == c;
+    }
+    bool accept(char c) {
+        if (not is_punct(c))
+            return false;
+        advance();
+        return true;
+    }
+    bool expect(char c) {
+        return accept(c) or expected("'" + std::string(1, c) + "'");
+    }
+    bool is_word(const char *word) const {
+        return tok_.kind == Tok::word and tok_.text == word;
+    }
+    bool accept_word(const char *word) {
+        if (not is_word(word))
+            return false;
+        advance();
+        return true;
+    }
+    bool expect_word(const char *word) {
+        return accept_word(word) or expected("'" + std::string(word) + "'");
+    }
+    void skip_linkage() {
+        while (tok_.kind == Tok::word and is_linkage_word(tok_.text))
+            advance();
+    }
+    // ", align N" after alloca, load, store and globals
+    bool skip_align() {
+        if (is_punct(',')) {
+            advance();
+            if (not expect_word("align"))
+                return false;
+            if (tok_.kind != Tok::integer)
+                return expected("an alignment");
+            advance();
+        }
+        return true;
+    }
+
+    bool parse_top_level();
+    bool parse_global(const std::string &name);
+    bool parse_function(bool define);
+    bool skip_braces();
+
+    bool parse_type(Type *&ty);
+    bool is_type_start() const;
+    bool parse_constant(Type *ty, Constant *&c);
+    // a local, global or constant used as ty
+    bool parse_value(Type *ty, Value *&v);
+    bool parse_typed_value(Value *&v);
+    bool parse_label(BasicBlock *&bb);
+
+    bool parse_body(Body &body);
+    bool parse_instruction(BasicBlock *bb);
+    bool parse_binary(Instruction::OpID id, const std::string &name,
+                      BasicBlock *bb, Instruction *&instr);
+    bool parse_cmp(bool is_float, BasicBlock *bb, Instruction *&instr);
+    bool parse_cast(Instruction::OpID id, BasicBlock *bb,
+                    Instruction *&instr);
+    bool parse_gep(BasicBlock *bb, Instruction *&instr);
+    bool parse_call(BasicBlock *bb, Instruction *&instr);
+    bool parse_phi(BasicBlock *bb, Instruction *&instr);
+    bool define_local(const std::string &name, Value *v);
+
+    Lexer lexer_;
+    Token tok_;
+    std::string error_;
+    std::unique_ptr<Module> m_;
+    std::map<std::string, Value *> globals_;
+    std::vector<Body> bodies_;
+
+    // of the function being parsed
+    Function *func_{nullptr};
+    std::map<std::string, Value *> locals_;
+    // uses before the definition, an argument stands in as it is a plain
+    // value with no parent to keep track of
+    std::map<std::string, std::unique_ptr<Argument>> forward_refs_;
+};
+
+bool LLParser::is_type_start() const {
+    return is_punct('[') or is_punct('<') or is_word("void") or
+           is_word("label") or is_word("float") or (tok_.kind == Tok::word and tok_.text[0] == 'i' and
+                                tok_.text.size() > 1 and
+                                std::isdigit(static_cast<unsigned char>(
+                                    tok_.text[1])));
+}
+
+bool LLParser::parse_type(Type *&ty) {
+    if (accept('[')) {
+        if (tok_.kind != Tok::integer)
+            return expected("the number of elements");
+        auto num = std::atol(tok_.text.c_str());
+        advance();
+        Type *elem;
+        if (not expect_word("x") or not parse_type(elem) or not expect(']'))
+            return false;
+        if (not ArrayType::is_valid_element_type(elem) or num < 0)
+            return fail("bad array type");
+        ty = m_->get_array_type(elem, num);
+    } else if (accept('<')) {
+        if (tok_.kind != Tok::integer)
+            return expected("the number of elements");
+        auto num = std::atol(tok_.text.c_str());
+        advance();
+        Type *elem;
+        if (not expect_word("x") or not parse_type(elem) or not expect('>'))
+            return false;
+        if (not VectorType::is_valid_element_type(elem) or num <= 0)
+            return fail("bad vector type");
+        ty = m_->get_vector_type(elem, num);
+    } else if (accept_word("void")) {
+        ty = m_->get_void_type();
+    } else if (accept_word("label")) {
+        ty = m_->get_label_type();
+    } else if (accept_word("float")) {
+        ty = m_->get_float_type();
+    } else if (accept_word("i1")) {
+        ty = m_->get_int1_type();
+    } else if (accept_word("i32")) {
+        ty = m_->get_int32_type();
+    } else if (is_type_start()) {
+        return fail("only i1 and i32 are integer types here");
+    } else {
+        return expected("a type");
+    }
+    while (is_punct('*')) {
+        if (ty->is_void_type() or ty->is_label_type())
+            return fail("bad pointer type");
+        advance();
+        ty = m_->get_pointer_type(ty);
+    }
+    return true;
+}
+
+bool LLParser::parse_constant(Type *ty, Constant *&c) {
+    if (accept_word("zeroinitializer")) {
+        c = ConstantZero::get(ty, m_.get());
+        return true;
+    }
+    if (ty->is_int1_type()) {
+        if (accept_word("true")) {
+            c = ConstantInt::get(true, m_.get());
+            return true;
+        }
+        if (accept_word("false")) {
+            c = ConstantInt::get(false, m_.get());
+            return true;
+        }
+        if (tok_.kind == Tok::integer and
+            (tok_.text == "0" or tok_.text == "1")) {
+            c = ConstantInt::get(tok_.text == "1", m_.get());
+            advance();
+            return true;
+        }
+        return expected("an i1 constant");
+    }
+    if (ty->is_int32_type()) {
+        if (tok_.kind != Tok::integer)
+            return expected("an i32 constant");
+        auto val = std::strtoll(tok_.text.c_str(), nullptr, 10);
+        if (val < INT32_MIN or val > UINT32_MAX)
+            return fail("constant out of range for i32");
+        c = ConstantInt::get(static_cast<int>(val), m_.get());
+        advance();
+        return true;
+    }
+    if (ty->is_float_type()) {
+        float val;
+        if (tok_.kind == Tok::hex) {
+            // a double, of which the float is the closest value
+            uint64_t bits = std::strtoull(tok_.text.c_str(), nullptr, 16);
+            double dval;
+            std::memcpy(&dval, &bits, sizeof(dval));
+            val = dval;
+        } else if (tok_.kind == Tok::fp) {
+            val = std::strtod(tok_.text.c_str(), nullptr);
+        } else {
+            return expected("a float constant");
+        }
+        c = ConstantFP::get(val, m_.get());
+        advance();
+        return true;
+    }
+    if (ty->is_array_type()) {
+        auto array_ty = static_cast<ArrayType *>(ty);
+        std::vector<Constant *> elems;
+        if (not expect('['))
+            return false;
+        while (not accept(']')) {
+            if (not elems.empty() and not expect(','))
+                return false;
+            Type *elem_ty;
+            Constant *elem;
+            if (not parse_type(elem_ty))
+                return false;
+            if (elem_ty != array_ty->get_element_type())
+                return fail("array element of type " + elem_ty->print() +
+                            " in " + ty->print());
+            if (not parse_constant(elem_ty, elem))
+                return false;
+            elems.push_back(elem);
+        }
+        if (elems.size() != array_ty->get_num_of_elements())
+            return fail("wrong number of elements for " + ty->print());
+        c = ConstantArray::get(array_ty, elems);
+        return true;
+    }
+    return fail("no constants of type " + ty->print());
+}
+
+bool LLParser::parse_value(Type *ty, Value *&v) {
+    if (tok_.kind == Tok::global) {
+        auto it = globals_.find(tok_.text);
+        if (it == globals_.end())
+            return fail("use of undefined value " + found());
+        v = it->second;
+    } else if (tok_.kind == Tok::local) {
+        auto it = locals_.find(tok_.text);
+        if (it != locals_.end()) {
+            v = it->second;
+        } else {
+            auto &ref = forward_refs_[tok_.text];
+            if (ref == nullptr) {
+                if (ty->is_label_type() or ty->is_void_type())
+                    return fail("use of undefined value " + found());
+                ref = std::make_unique<Argument>(ty, tok_.text);
+            }
+            v = ref.get();
+        }
+    } else {
+        Constant *c;
+        if (not parse_constant(ty, c))
+            return false;
+        v = c;
+        return true;
+    }
+    if (v->get_type() != ty)
+        return fail(found() + " is " + v->get_type()->print() + ", not " +
+                    ty->print());
+    advance();
+    return true;
+}
+
+bool LLParser::parse_typed_value(Value *&v) {
+    Type *ty;
+    return parse_type(ty) and parse_value(ty, v);
+}
+
+bool LLParser::parse_label(BasicBlock *&bb) {
+    if (tok_.kind != Tok::local)
+        return expected("a block");
+    auto it = locals_.find(tok_.text);
+    if (it == locals_.end() or not it->second->is<BasicBlock>())
+        return fail(found() + " is no block");
+    bb = it->second->as<BasicBlock>();
+    advance();
+    return true;
+}
+
+std::unique_ptr<Module> LLParser::parse(std::string &error) {
+    m_ = std::make_unique<Module>();
+    // globals, declarations and the headers of the definitions first, so
+    // that bodies see all of them
+    bool ok = true;
+    while (ok and tok_.kind != Tok::eof)
+        ok = parse_top_level();
+    for (auto &body : bodies_) {
+        if (not ok)
+            break;
+        ok = parse_body(body);
+    }
+    if (not ok) {
+        error = error_;
+        // the placeholders unlink from the instructions before those go
+        forward_refs_.clear();
+        return nullptr;
+    }
+    return std::move(m_);
+}
+
+bool LLParser::parse_top_level() {
+    if (tok_.kind == Tok::global) {
+        auto name = tok_.text;
+        advance();
+        return expect('=') and parse_global(name);
+    }
+    if (accept_word("declare"))
+        return parse_function(false);
+    if (accept_word("define"))
+        return parse_function(true);
+    if (accept_word("source_filename"))
+        return expect('=') and
+               (tok_.kind == Tok::string ? (advance(), true)
+                                         : expected("a file name"));
+    if (accept_word("target")) {
+        if (not accept_word("datalayout") and not accept_word("triple"))
+            return expected("'datalayout' or 'triple'");
+        return expect('=') and (tok_.kind == Tok::string
+                                    ? (advance(), true)
+                                    : expected("a string"));
+    }
+    if (accept_word("attributes")) {
+        if (tok_.kind != Tok::attr_ref)
+            return expected("an attribute group");
+        advance();
+        return expect('=') and skip_braces();
+    }
+    return expected("a global, 'declare' or 'define'");
+}
+
+bool LLParser::parse_global(const std::string &name) {
+    skip_linkage();
+    bool is_const;
+    if (accept_word("global"))
+        is_const = false;
+    else if (accept_word("constant"))
+        is_const = true;
+    else
+        return expected("'global' or 'constant'");
+    Type *ty;
+    Constant *init;
+    if (not parse_type(ty) or not parse_constant(ty, init) or not skip_align())
+        return false;
+    if (globals_.count(name))
+        return fail("redefinition of @" + name);
+    globals_[name] = GlobalVariable::create(name, m_.get(), ty, is_const, init);
+    return true;
+}
+
+bool LLParser::parse_function(bool define) {
+    skip_linkage();
+    Type *ret_ty;
+    if (not parse_type(ret_ty))
+        return false;
+    if (not FunctionType::is_valid_return_type(ret_ty))
+        return fail("bad return type " + ret_ty->print());
+    if (tok_.kind != Tok::global)
+        return expected("a function name");
+    auto name = tok_.text;
+    if (globals_.count(name))
+        return fail("redefinition of @" + name);
+    advance();
+
+    std::vector<Type *> params;
+    std::vector<std::string> arg_names;
+    if (not expect('('))
+        return false;
+    while (not accept(')')) {
+        if (not params.empty() and not expect(','))
+            return false;
+        Type *ty;
+        if (not parse_type(ty))
+            return false;
+        if (not FunctionType::is_valid_argument_type(ty))
+            return fail("bad argument type " + ty->print());
+        // parameter attributes as clang writes them
+        while (tok_.kind == Tok::word)
+            advance();
+        params.push_back(ty);
+        arg_names.emplace_back();
+        if (tok_.kind == Tok::local) {
+            if (not define)
+                return fail("argument names in a declaration");
+            arg_names.back() = tok_.text;
+            advance();
+        }
+    }
+    while (tok_.kind == Tok::attr_ref or
+           (tok_.kind == Tok::word and is_linkage_word(tok_.text)))
+        advance();
+
+    auto func =
+        Function::create(m_->get_function_type(ret_ty, params), name, m_.get());
+    globals_[name] = func;
+    if (not define)
+        return true;
+    if (not is_punct('{'))
+        return expected("'{'");
+    advance();
+    bodies_.push_back({func, std::move(arg_names), lexer_, tok_});
+    // the body is read once all functions are known
+    while (not is_punct('}')) {
+        if (tok_.kind == Tok::eof)
+            return expected("'}'");
+        if (tok_.kind == Tok::error)
+            return fail(tok_.text);
+        if (is_punct('{'))
+            return fail("unexpected '{'");
+        advance();
+    }
+    advance();
+    return true;
+}
+
+bool LLParser::skip_braces() {
+    if (not expect('{'))
+        return false;
+    while (not accept('}')) {
+        if (tok_.kind == Tok::eof)
+            return expected("'}'");
+        if (tok_.kind == Tok::error)
+            return fail(tok_.text);
+        advance();
+    }
+    return true;
+}
+
+bool LLParser::define_local(const std::string &name, Value *v) {
+    if (not locals_.emplace(name, v).second)
+        return fail("redefinition of %" + name);
+    auto ref = forward_refs_.find(name);
+    if (ref != forward_refs_.end()) {
+        if (ref->second->get_type() != v->get_type())
+            return fail("%" + name + " is used as " +
+                        ref->second->get_type()->print() + " but is " +
+                        v->get_type()->print());
+        ref->second->replace_all_use_with(v);
+        forward_refs_.erase(ref);
+    }
+    return true;
+}
+
+bool LLParser::parse_body(Body &body) {
+    func_ = body.func;
+    locals_.clear();
+    lexer_ = body.lexer;
+    tok_ = body.tok;
+    // names llvm gives unnamed arguments and an unnamed entry block
+    unsigned next_number = 0;
+    auto arg = func_->get_args().begin();
+    for (auto &name : body.arg_names) {
+        // clang writes the numbers out, the entry block comes after them
+        if (not name.empty() and
+            std::all_of(name.begin(), name.end(), [](unsigned char c) {
+                return std::isdigit(c);
+            }))
+            next_number = std::strtoul(name.c_str(), nullptr, 10) + 1;
+        auto &arg_name = name.empty() ? (name = std::to_string(next_number++))
+                                      : name;
+        arg->set_name(arg_name);
+        if (not define_local(arg_name, &*arg++))
+            return false;
+    }
+
+    // all blocks first, in the order of their labels, for the branches
+    {
+        auto lexer = lexer_;
+        auto tok = tok_;
+        if (tok.kind != Tok::label_def) {
+            auto bb = BasicBlock::create(m_.get(), "", func_);
+            bb->set_name(std::to_string(next_number++));
+            if (not define_local(bb->get_name(), bb))
+                return false;
+        }
+        for (; not(tok.kind == Tok::punct and tok.text[0] == '}');
+             tok = lexer.next()) {
+            if (tok.kind != Tok::label_def)
+                continue;
+            auto bb = BasicBlock::create(m_.get(), "", func_);
+            bb->set_name(tok.text);
+            if (not define_local(tok.text, bb)) {
+                tok_ = tok;
+                return fail("redefinition of block " + tok.text);
+            }
+        }
+    }
+
+    auto bb = func_->get_entry_block();
+    if (tok_.kind == Tok::label_def)
+        advance();
+    while (not accept('}')) {
+        if (tok_.kind == Tok::label_def) {
+            bb = locals_[tok_.text]->as<BasicBlock>();
+            advance();
+            continue;
+        }
+        if (bb->is_terminated())
+            return fail("instruction after the terminator of %" +
+                        bb->get_name());
+        if (not parse_instruction(bb))
+            return false;
+    }
+    for (auto &block : func_->get_basic_blocks()) {
+        if (not block.is_terminated())
+            return fail("block %" + block.get_name() + " has no terminator");
+    }
+    if (not forward_refs_.empty())
+        return fail("use of undefined value %" + forward_refs_.begin()->first);
+    return true;
+}
+
+bool LLParser::parse_instruction(BasicBlock *bb) {
+    std::string name;
+    if (tok_.kind == Tok::local) {
+        name = tok_.text;
+        advance();
+        if (not expect('='))
+            return false;
+    }
+    if (tok_.kind != Tok::word)
+        return expected("an instruction");
+    auto opcode = tok_.text;
+    auto line = tok_.line, col = tok_.col;
+    advance();
+
+    static const std::map<std::string, Instruction::OpID> binary_ops = {
+        {"add", Instruction::add},   {"sub", Instruction::sub},
+        {"mul", Instruction::mul},   {"sdiv", Instruction::sdiv},
+        {"fadd", Instruction::fadd}, {"fsub", Instruction::fsub},
+        {"fmul", Instruction::fmul}, {"fdiv", Instruction::fdiv},
+    };
+    static const std::map<std::string, Instruction::OpID> cast_ops = {
+        {"zext", Instruction::zext},
+        {"fptosi", Instruction::fptosi},
+        {"sitofp", Instruction::sitofp},
+        {"bitcast", Instruction::bitcast},
+    };
+
+    Instruction *instr = nullptr;
+    bool ok;
+    if (binary_ops.count(opcode)) {
+        ok = parse_binary(binary_ops.at(opcode), opcode, bb, instr);
+    } else if (opcode == "icmp" or opcode == "fcmp") {
+        ok = parse_cmp(opcode == "fcmp", bb, instr);
+    } else if (cast_ops.count(opcode)) {
+        ok = parse_cast(cast_ops.at(opcode), bb, instr);
+    } else if (opcode == "getelementptr") {
+        ok = parse_gep(bb, instr);
+    } else if (opcode == "call") {
+        ok = parse_call(bb, instr);
+    } else if (opcode == "phi") {
+        ok = parse_phi(bb, instr);
+    } else if (opcode == "alloca") {
+        Type *ty;
+        ok = parse_type(ty) and skip_align();
+        if (ok and not(ty->is_integer_type() or ty->is_float_type() or
+                       ty->is_array_type() or ty->is_pointer_type()))
+            ok = fail("cannot alloca " + ty->print());
+        if (ok)
+            instr = AllocaInst::create_alloca(ty, bb);
+    } else if (opcode == "load") {
+        Type *ty;
+        Value *ptr;
+        ok = parse_type(ty) and expect(',') and parse_typed_value(ptr) and
+             skip_align();
+        if (ok and not(ty->is_integer_type() or ty->is_float_type() or
+                       ty->is_pointer_type() or ty->is_vector_type()))
+            ok = fail("cannot load " + ty->print());
+        if (ok and ptr->get_type() != m_->get_pointer_type(ty))
+            ok = fail("load of " + ty->print() + " from " +
+                      ptr->get_type()->print());
+        if (ok)
+            instr = LoadInst::create_load(ptr, bb);
+    } else if (opcode == "store") {
+        Value *val, *ptr;
+        ok = parse_typed_value(val) and expect(',') and
+             parse_typed_value(ptr) and skip_align();
+        if (ok and ptr->get_type() != m_->get_pointer_type(val->get_type()))
+            ok = fail("store of " + val->get_type()->print() + " to " +
+                      ptr->get_type()->print());
+        if (ok)
+            instr = StoreInst::create_store(val, ptr, bb);
+    } else if (opcode == "br") {
+        BasicBlock *if_true, *if_false;
+        if (accept_word("label")) {
+            ok = parse_label(if_true);
+            if (ok)
+                instr = BranchInst::create_br(if_true, bb);
+        } else {
+            Value *cond;
+            ok = expect_word("i1") and parse_value(m_->get_int1_type(), cond) and
+                 expect(',') and expect_word("label") and
+                 parse_label(if_true) and expect(',') and
+                 expect_word("label") and parse_label(if_false);
+            if (ok)
+                instr = BranchInst::create_cond_br(cond, if_true, if_false, bb);
+        }
+    } else if (opcode == "ret") {
+        auto ret_ty = func_->get_return_type();
+        if (accept_word("void")) {
+            ok = ret_ty->is_void_type() or fail("ret void in a function "
+                                                "returning " +
+                                                ret_ty->print());
+            if (ok)
+                instr = ReturnInst::create_void_ret(bb);
+        } else {
+            Value *val;
+            ok = parse_typed_value(val);
+            if (ok and val->get_type() != ret_ty)
+                ok = fail("ret " + val->get_type()->print() +
+                          " in a function returning " + ret_ty->print());
+            if (ok)
+                instr = ReturnInst::create_ret(val, bb);
+        }
+    } else {
+        ok = fail("unknown instruction '" + opcode + "'");
+    }
+    if (not ok)
+        return false;
+
+    if (name.empty())
+        return true;
+    if (instr->is_void()) {
+        tok_.line = line;
+        tok_.col = col;
+        return fail("cannot name the void result of " + opcode);
+    }
+    instr->set_name(name);
+    return define_local(name, instr);
+}
+
+bool LLParser::parse_binary(Instruction::OpID id, const std::string &name,
+                            BasicBlock *bb, Instruction *&instr) {
+    while (accept_word("nsw") or accept_word("nuw") or accept_word("exact"))
+        ;
+    Type *ty;
+    Value *lhs, *rhs;
+    if (not parse_type(ty) or not parse_value(ty, lhs) or not expect(','))
+        return false;
+    // the printer gives the type again when the operands differ in type
+    Type *rhs_ty = ty;
+    if (is_type_start() and not parse_type(rhs_ty))
+        return false;
+    if (not parse_value(rhs_ty, rhs))
+        return false;
+    bool is_float = id >= Instruction::fadd;
+    if (ty != rhs_ty or
+        ty->get_scalar_type() !=
+            (is_float ? static_cast<Type *>(m_->get_float_type())
+                      : m_->get_int32_type()))
+        return fail(name + " needs two " + (is_float ? "float" : "i32") +
+                    " operands or two vectors of them");
+    switch (id) {
+    case Instruction::add:
+        instr = IBinaryInst::create_add(lhs, rhs, bb);
+        break;
+    case Instruction::sub:
+        instr = IBinaryInst::create_sub(lhs, rhs, bb);
+        break;
+    case Instruction::mul:
+        instr = IBinaryInst::create_mul(lhs, rhs, bb);
+        break;
+    case Instruction::sdiv:
+        instr = IBinaryInst::create_sdiv(lhs, rhs, bb);
+        break;
+    case Instruction::fadd:
+        instr = FBinaryInst::create_fadd(lhs, rhs, bb);
+        break;
+    case Instruction::fsub:
+        instr = FBinaryInst::create_fsub(lhs, rhs, bb);
+        break;
+    case Instruction::fmul:
+        instr = FBinaryInst::create_fmul(lhs, rhs, bb);
+        break;
+    default:
+        instr = FBinaryInst::create_fdiv(lhs, rhs, bb);
+        break;
+    }
+    return true;
+}
+
+bool LLParser::parse_cmp(bool is_float, BasicBlock *bb, Instruction *&instr) {
+    // fcmp is unordered in LightIR, the ordered predicates are not taken
+    static const char *int_preds[] = {"sge", "sgt", "sle", "slt", "eq", "ne"};
+    static const char *float_preds[] = {"uge", "ugt", "ule",
+                                        "ult", "ueq", "une"};
+    auto preds = is_float ? float_preds : int_preds;
+    int pred = -1;
+    for (int i = 0; i < 6; i++) {
+        if (is_word(preds[i]))
+            pred = i;
+    }
+    if (pred < 0)
+        return expected(is_float ? "an unordered fcmp predicate"
+                                 : "a signed icmp predicate");
+    advance();
+    Type *ty, *rhs_ty;
+    Value *lhs, *rhs;
+    if (not parse_type(ty) or not parse_value(ty, lhs) or not expect(','))
+        return false;
+    rhs_ty = ty;
+    if (is_type_start() and not parse_type(rhs_ty))
+        return false;
+    if (not parse_value(rhs_ty, rhs))
+        return false;
+    if (ty != rhs_ty or
+        ty != (is_float ? static_cast<Type *>(m_->get_float_type())
+                        : m_->get_int32_type()))
+        return fail(std::string(is_float ? "fcmp" : "icmp") + " needs two " +
+                    (is_float ? "float" : "i32") + " operands");
+    if (is_float) {
+        using Create = FCmpInst *(*)(Value *, Value *, BasicBlock *);
+        static const Create creates[] = {
+            FCmpInst::create_fge, FCmpInst::create_fgt, FCmpInst::create_fle,
+            FCmpInst::create_flt, FCmpInst::create_feq, FCmpInst::create_fne,
+        };
+        instr = creates[pred](lhs, rhs, bb);
+    } else {
+        using Create = ICmpInst *(*)(Value *, Value *, BasicBlock *);
+        static const Create creates[] = {
+            ICmpInst::create_ge, ICmpInst::create_gt, ICmpInst::create_le,
+            ICmpInst::create_lt, ICmpInst::create_eq, ICmpInst::create_ne,
+        };
+        instr = creates[pred](lhs, rhs, bb);
+    }
+    return true;
+}
+
+bool LLParser::parse_cast(Instruction::OpID id, BasicBlock *bb,
+                          Instruction *&instr) {
+    Value *val;
+    Type *ty;
+    if (not parse_typed_value(val) or not expect_word("to") or
+        not parse_type(ty))
+        return false;
+    auto from = val->get_type();
+    switch (id) {
+    case Instruction::zext:
+        if (not from->is_integer_type() or not ty->is_integer_type() or
+            static_cast<IntegerType *>(from)->get_num_bits() >=
+                static_cast<IntegerType *>(ty)->get_num_bits())
+            return fail("zext needs a narrower integer");
+        instr = ZextInst::create_zext(val, ty, bb);
+        break;
+    case Instruction::fptosi:
+        if (not from->is_float_type() or not ty->is_integer_type())
+            return fail("fptosi needs a float and an integer type");
+        instr = FpToSiInst::create_fptosi(val, ty, bb);
+        break;
+    case Instruction::bitcast:
+        if (not from->is_pointer_type() or not ty->is_pointer_type())
+            return fail("bitcast needs two pointer types");
+        instr = BitCastInst::create_bitcast(val, ty, bb);
+        break;
+    default:
+        if (not from->is_integer_type() or not ty->is_float_type())
+            return fail("sitofp needs an integer and float");
+        instr = SiToFpInst::create_sitofp(val, bb);
+        break;
+    }
+    return true;
+}
+
+bool LLParser::parse_gep(BasicBlock *bb, Instruction *&instr) {
+    accept_word("inbounds");
+    Type *ty;
+    Value *ptr;
+    if (not parse_type(ty) or not expect(',') or not parse_typed_value(ptr))
+        return false;
+    if (ptr->get_type() != m_->get_pointer_type(ty))
+        return fail("getelementptr into " + ty->print() + " through " +
+                    ptr->get_type()->print());
+    if (not ty->is_array_type() and not ty->is_integer_type() and
+        not ty->is_float_type())
+        return fail("getelementptr into " + ty->print());
+    std::vector<Value *> idxs;
+    // the first index steps over the pointer, each next one into an array
+    Type *elem = ty;
+    while (accept(',')) {
+        Value *idx;
+        if (not parse_typed_value(idx))
+            return false;
+        if (not idx->get_type()->is_integer_type())
+            return fail("getelementptr index is no integer");
+        if (not idxs.empty()) {
+            if (not elem->is_array_type())
+                return fail("too many getelementptr indices");
+            elem = elem->get_array_element_type();
+        }
+        idxs.push_back(idx);
+    }
+    if (idxs.empty())
+        return fail("getelementptr without indices");
+    instr = GetElementPtrInst::create_gep(ptr, idxs, bb);
+    return true;
+}
+
+bool LLParser::parse_call(BasicBlock *bb, Instruction *&instr) {
+    Type *ret_ty;
+    if (not parse_type(ret_ty))
+        return false;
+    if (tok_.kind != Tok::global)
+        return expected("a function");
+    auto it = globals_.find(tok_.text);
+    if (it == globals_.end() or not it->second->is<Function>())
+        return fail(found() + " is no function");
+    auto func = it->second->as<Function>();
+    if (func->get_return_type() != ret_ty)
+        return fail(found() + " returns " + func->get_return_type()->print());
+    advance();
+    std::vector<Value *> args;
+    if (not expect('('))
+        return false;
+    while (not accept(')')) {
+        if (not args.empty() and not expect(','))
+            return false;
+        Type *ty;
+        Value *arg;
+        if (not parse_type(ty))
+            return false;
+        while (tok_.kind == Tok::word and not is_type_start() and
+               tok_.text != "true" and tok_.text != "false" and
+               tok_.text != "zeroinitializer")
+            advance();
+        if (not parse_value(ty, arg))
+            return false;
+        if (args.size() >= func->get_num_of_args() or
+            func->get_function_type()->get_param_type(args.size()) != ty)
+            return fail("argument " + std::to_string(args.size() + 1) +
+                        " does not match @" + func->get_name());
+        args.push_back(arg);
+    }
+    if (args.size() != func->get_num_of_args())
+        return fail("too few arguments for @" + func->get_name());
+    instr = CallInst::create_call(func, args, bb);
+    return true;
+}
+
+bool LLParser::parse_phi(BasicBlock *bb, Instruction *&instr) {
+    Type *ty;
+    if (not parse_type(ty))
+        return false;
+    std::vector<Value *> vals;
+    std::vector<BasicBlock *> bbs;
+    do {
+        Value *val = nullptr;
+        BasicBlock *pred;
+        if (not expect('['))
+            return false;
+        // the printer writes undef for predecessors without a value
+        if (not accept_word("undef") and not parse_value(ty, val))
+            return false;
+        if (not expect(',') or not parse_label(pred) or not expect(']'))
+            return false;
+        if (val) {
+            vals.push_back(val);
+            bbs.push_back(pred);
+        }
+    } while (accept(','));
+    // phis are made apart from their block, see PhiInst::create_phi
+    instr = PhiInst::create_phi(ty, bb, vals, bbs);
+    bb->add_instruction(instr);
+    return true;
+}
+
+} // namespace
+
+std::unique_ptr<Module> parse_ll(const char *data, std::size_t size,
+                                 std::string &error) {
+    return LLParser(data, size).parse(error);
+}
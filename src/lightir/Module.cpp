@@ -1,16 +1,60 @@
 #include "Module.hpp"
+#include "Constant.hpp"
 #include "Function.hpp"
 #include "GlobalVariable.hpp"
 
 #include <memory>
+#include <sstream>
 #include <string>
 
-Module::Module() {
+Module::Module(bool use_arena) : use_arena_(use_arena) {
     void_ty_ = std::make_unique<Type>(Type::VoidTyID, this);
     label_ty_ = std::make_unique<Type>(Type::LabelTyID, this);
     int1_ty_ = std::make_unique<IntegerType>(1, this);
     int32_ty_ = std::make_unique<IntegerType>(32, this);
     float32_ty_ = std::make_unique<FloatType>(this);
+    int32_ptr_ty_ = get_pointer_type(int32_ty_.get());
+    float32_ptr_ty_ = get_pointer_type(float32_ty_.get());
+}
+
+Module::~Module() {
+    // values still refer to each other across functions, blocks and
+    // constants, so cut every link before anything is destroyed
+    drop_all_references();
+    // the ilists and constant tables destroy every node, arena memory is
+    // released afterwards
+}
+
+void Module::drop_all_references() {
+    for (auto &func : function_list_) {
+        func.clear_use_list_unchecked();
+        for (auto &arg : func.get_args())
+            arg.clear_use_list_unchecked();
+        for (auto &bb : func.get_basic_blocks()) {
+            bb.clear_use_list_unchecked();
+            for (auto &instr : bb.get_instructions()) {
+                instr.clear_use_list_unchecked();
+                instr.drop_operands_for_teardown();
+            }
+        }
+    }
+    for (auto &global : global_list_) {
+        global.clear_use_list_unchecked();
+        global.drop_operands_for_teardown();
+    }
+    for (auto &entry : int_constants_)
+        entry.second->clear_use_list_unchecked();
+    for (auto &constant : bool_constants_)
+        if (constant)
+            constant->clear_use_list_unchecked();
+    for (auto &entry : float_constants_)
+        entry.second->clear_use_list_unchecked();
+    for (auto &entry : zero_constants_)
+        entry.second->clear_use_list_unchecked();
+    for (auto &constant : array_constants_) {
+        constant->clear_use_list_unchecked();
+        constant->drop_operands_for_teardown();
+    }
 }
 
 Type *Module::get_void_type() { return void_ty_.get(); }
@@ -18,35 +62,77 @@ Type *Module::get_label_type() { return label_ty_.get(); }
 IntegerType *Module::get_int1_type() { return int1_ty_.get(); }
 IntegerType *Module::get_int32_type() { return int32_ty_.get(); }
 FloatType *Module::get_float_type() { return float32_ty_.get(); }
-PointerType *Module::get_int32_ptr_type() {
-    return get_pointer_type(int32_ty_.get());
+PointerType *Module::get_int32_ptr_type() { return int32_ptr_ty_; }
+PointerType *Module::get_float_ptr_type() { return float32_ptr_ty_; }
+
+bool TypeKeyInfo::isEqual(const TypeKey &key, const Type *ty) {
+    if (ty == getEmptyKey() or ty == getTombstoneKey() or
+        key.hash != ty->get_hash() or key.tid != ty->get_type_id())
+        return false;
+    switch (key.tid) {
+    case Type::PointerTyID:
+        return key.contained ==
+               static_cast<const PointerType *>(ty)->get_element_type();
+    case Type::ArrayTyID: {
+        auto array_ty = static_cast<const ArrayType *>(ty);
+        return key.contained == array_ty->get_element_type() and
+               key.num_elements == array_ty->get_num_of_elements();
+    }
+    case Type::VectorTyID: {
+        auto vector_ty = static_cast<const VectorType *>(ty);
+        return key.contained == vector_ty->get_element_type() and
+               key.num_elements == vector_ty->get_num_of_elements();
+    }
+    case Type::FunctionTyID: {
+        auto func_ty = static_cast<const FunctionType *>(ty);
+        return key.contained == func_ty->get_return_type() and
+               key.params == llvm::ArrayRef<Type *>(func_ty->get_params());
+    }
+    default:
+        return false;
+    }
 }
-PointerType *Module::get_float_ptr_type() {
-    return get_pointer_type(float32_ty_.get());
+
+template <typename T, typename Create>
+T *Module::intern_type(const TypeKey &key,
+                       std::vector<std::unique_ptr<T>> &owned, Create create) {
+    std::lock_guard<std::mutex> lock(types_mutex_);
+    auto it = types_.find_as(key);
+    if (it != types_.end())
+        return static_cast<T *>(*it);
+    owned.push_back(create());
+    types_.insert(owned.back().get());
+    return owned.back().get();
 }
 
 PointerType *Module::get_pointer_type(Type *contained) {
-    if (pointer_map_.find(contained) == pointer_map_.end()) {
-        pointer_map_[contained] = std::make_unique<PointerType>(contained);
-    }
-    return pointer_map_[contained].get();
+    return intern_type(TypeKey(Type::PointerTyID, contained, 0),
+                       pointer_types_, [&] {
+                           return std::make_unique<PointerType>(contained);
+                       });
 }
 
 ArrayType *Module::get_array_type(Type *contained, unsigned num_elements) {
-    if (array_map_.find({contained, num_elements}) == array_map_.end()) {
-        array_map_[{contained, num_elements}] =
-            std::make_unique<ArrayType>(contained, num_elements);
-    }
-    return array_map_[{contained, num_elements}].get();
+    return intern_type(
+        TypeKey(Type::ArrayTyID, contained, num_elements), array_types_, [&] {
+            return std::make_unique<ArrayType>(contained, num_elements);
+        });
+}
+
+VectorType *Module::get_vector_type(Type *contained, unsigned num_elements) {
+    return intern_type(
+        TypeKey(Type::VectorTyID, contained, num_elements), vector_types_, [&] {
+            return std::make_unique<VectorType>(contained, num_elements);
+        });
 }
 
 FunctionType *Module::get_function_type(Type *retty,
-                                        std::vector<Type *> &args) {
-    if (not function_map_.count({retty, args})) {
-        function_map_[{retty, args}] =
-            std::make_unique<FunctionType>(retty, args);
-    }
-    return function_map_[{retty, args}].get();
+                                        llvm::ArrayRef<Type *> args) {
+    return intern_type(TypeKey(Type::FunctionTyID, retty, 0, args),
+                       function_types_, [&] {
+                           return std::make_unique<FunctionType>(retty,
+                                                                 args.vec());
+                       });
 }
 
 void Module::add_function(Function *f) { function_list_.push_back(f); }
@@ -58,23 +144,19 @@ llvm::ilist<GlobalVariable> &Module::get_global_variable() {
     return global_list_;
 }
 
-void Module::set_print_name() {
-    for (auto &func : this->get_functions()) {
-        func.set_instr_name();
-    }
-    return;
-}
-
-std::string Module::print() {
-    set_print_name();
-    std::string module_ir;
+void Module::print(std::ostream &os) {
     for (auto &global_val : this->global_list_) {
-        module_ir += global_val.print();
-        module_ir += "\n";
+        global_val.print(os);
+        os << "\n";
     }
     for (auto &func : this->function_list_) {
-        module_ir += func.print();
-        module_ir += "\n";
+        func.print(os);
+        os << "\n";
     }
-    return module_ir;
+}
+
+std::string Module::print() {
+    std::ostringstream ss;
+    print(ss);
+    return ss.str();
 }
@@ -3,11 +3,24 @@
 
 #include <array>
 #include <cassert>
+#include <llvm/ADT/Hashing.h>
+#include <sstream>
 #include <stdexcept>
 
 Type::Type(TypeID tid, Module *m) {
     tid_ = tid;
     m_ = m;
+    hash_ = hash_of(tid, nullptr, 0);
+}
+
+std::size_t Type::hash_of(TypeID tid, const Type *contained, unsigned num,
+                          llvm::ArrayRef<Type *> params) {
+    // on the hashes of the parts rather than their addresses, so the same
+    // in every run
+    auto hash = llvm::hash_combine(tid, contained ? contained->hash_ : 0, num);
+    for (auto param : params)
+        hash = llvm::hash_combine(hash, param->hash_);
+    return hash;
 }
 
 bool Type::is_int1_type() const {
@@ -31,6 +44,12 @@ Type *Type::get_array_element_type() const {
     assert(false and "get_array_element_type() called on non-array type");
 }
 
+Type *Type::get_scalar_type() const {
+    if (this->is_vector_type())
+        return static_cast<const VectorType *>(this)->get_element_type();
+    return const_cast<Type *>(this);
+}
+
 unsigned Type::get_size() const {
     switch (get_type_id()) {
     case IntegerTyID: {
@@ -47,6 +66,11 @@ unsigned Type::get_size() const {
         auto num_elements = array_type->get_num_of_elements();
         return element_size * num_elements;
     }
+    case VectorTyID: {
+        auto vector_type = static_cast<const VectorType *>(this);
+        return vector_type->get_element_type()->get_size() *
+               vector_type->get_num_of_elements();
+    }
     case PointerTyID:
         return 8;
     case FloatTyID:
@@ -59,64 +83,70 @@ unsigned Type::get_size() const {
     assert(false && "unreachable");
 }
 
-std::string Type::print() const {
-    std::string type_ir;
+void Type::print(std::ostream &os) const {
     switch (this->get_type_id()) {
     case VoidTyID:
-        type_ir += "void";
+        os << "void";
         break;
     case LabelTyID:
-        type_ir += "label";
+        os << "label";
         break;
     case IntegerTyID:
-        type_ir += "i";
-        type_ir += std::to_string(
-            static_cast<const IntegerType *>(this)->get_num_bits());
+        os << "i" << static_cast<const IntegerType *>(this)->get_num_bits();
         break;
-    case FunctionTyID:
-        type_ir +=
-            static_cast<const FunctionType *>(this)->get_return_type()->print();
-        type_ir += " (";
-        for (unsigned i = 0;
-             i < static_cast<const FunctionType *>(this)->get_num_of_args();
-             i++) {
+    case FunctionTyID: {
+        auto func_type = static_cast<const FunctionType *>(this);
+        func_type->get_return_type()->print(os);
+        os << " (";
+        for (unsigned i = 0; i < func_type->get_num_of_args(); i++) {
             if (i)
-                type_ir += ", ";
-            type_ir += static_cast<const FunctionType *>(this)
-                           ->get_param_type(i)
-                           ->print();
+                os << ", ";
+            func_type->get_param_type(i)->print(os);
         }
-        type_ir += ")";
+        os << ")";
         break;
+    }
     case PointerTyID:
-        type_ir += this->get_pointer_element_type()->print();
-        type_ir += "*";
+        this->get_pointer_element_type()->print(os);
+        os << "*";
         break;
     case ArrayTyID:
-        type_ir += "[";
-        type_ir += std::to_string(
-            static_cast<const ArrayType *>(this)->get_num_of_elements());
-        type_ir += " x ";
-        type_ir +=
-            static_cast<const ArrayType *>(this)->get_element_type()->print();
-        type_ir += "]";
+        os << "["
+           << static_cast<const ArrayType *>(this)->get_num_of_elements()
+           << " x ";
+        static_cast<const ArrayType *>(this)->get_element_type()->print(os);
+        os << "]";
         break;
     case FloatTyID:
-        type_ir += "float";
+        os << "float";
+        break;
+    case VectorTyID:
+        os << "<"
+           << static_cast<const VectorType *>(this)->get_num_of_elements()
+           << " x ";
+        static_cast<const VectorType *>(this)->get_element_type()->print(os);
+        os << ">";
         break;
     default:
         break;
     }
-    return type_ir;
+}
+
+std::string Type::print() const {
+    std::ostringstream ss;
+    print(ss);
+    return ss.str();
 }
 
 IntegerType::IntegerType(unsigned num_bits, Module *m)
-    : Type(Type::IntegerTyID, m), num_bits_(num_bits) {}
+    : Type(Type::IntegerTyID, m), num_bits_(num_bits) {
+    hash_ = hash_of(Type::IntegerTyID, nullptr, num_bits);
+}
 
 unsigned IntegerType::get_num_bits() const { return num_bits_; }
 
 FunctionType::FunctionType(Type *result, std::vector<Type *> params)
-    : Type(Type::FunctionTyID, nullptr) {
+    : Type(Type::FunctionTyID, result->get_module()) {
     assert(is_valid_return_type(result) && "Invalid return type for function!");
     result_ = result;
 
@@ -125,6 +155,7 @@ FunctionType::FunctionType(Type *result, std::vector<Type *> params)
                "Not a valid type for function argument!");
         args_.push_back(p);
     }
+    hash_ = hash_of(Type::FunctionTyID, result, 0, args_);
 }
 
 bool FunctionType::is_valid_return_type(Type *ty) {
@@ -136,7 +167,8 @@ bool FunctionType::is_valid_argument_type(Type *ty) {
            ty->is_float_type();
 }
 
-FunctionType *FunctionType::get(Type *result, std::vector<Type *> params) {
+FunctionType *FunctionType::get(Type *result,
+                                const std::vector<Type *> &params) {
     return result->get_module()->get_function_type(result, params);
 }
 
@@ -152,6 +184,7 @@ ArrayType::ArrayType(Type *contained, unsigned num_elements)
     assert(is_valid_element_type(contained) &&
            "Not a valid type for array element!");
     contained_ = contained;
+    hash_ = hash_of(Type::ArrayTyID, contained, num_elements);
 }
 
 bool ArrayType::is_valid_element_type(Type *ty) {
@@ -165,11 +198,13 @@ ArrayType *ArrayType::get(Type *contained, unsigned num_elements) {
 PointerType::PointerType(Type *contained)
     : Type(Type::PointerTyID, contained->get_module()), contained_(contained) {
     static const std::array allowed_elem_type = {
-        Type::IntegerTyID, Type::FloatTyID, Type::ArrayTyID, Type::PointerTyID};
+        Type::IntegerTyID, Type::FloatTyID, Type::ArrayTyID, Type::PointerTyID,
+        Type::VectorTyID};
     auto elem_type_id = contained->get_type_id();
     assert(std::find(allowed_elem_type.begin(), allowed_elem_type.end(),
                      elem_type_id) != allowed_elem_type.end() &&
            "Not allowed type for pointer");
+    hash_ = hash_of(Type::PointerTyID, contained, 0);
 }
 
 PointerType *PointerType::get(Type *contained) {
@@ -179,3 +214,21 @@ PointerType *PointerType::get(Type *contained) {
 FloatType::FloatType(Module *m) : Type(Type::FloatTyID, m) {}
 
 FloatType *FloatType::get(Module *m) { return m->get_float_type(); }
+
+VectorType::VectorType(Type *contained, unsigned num_elements)
+    : Type(Type::VectorTyID, contained->get_module()),
+      num_elements_(num_elements) {
+    assert(is_valid_element_type(contained) &&
+           "Not a valid type for vector element!");
+    assert(num_elements > 0 && "Empty vector type");
+    contained_ = contained;
+    hash_ = hash_of(Type::VectorTyID, contained, num_elements);
+}
+
+bool VectorType::is_valid_element_type(Type *ty) {
+    return ty->is_int32_type() || ty->is_float_type();
+}
+
+VectorType *VectorType::get(Type *contained, unsigned num_elements) {
+    return contained->get_module()->get_vector_type(contained, num_elements);
+}
@@ -4,25 +4,24 @@
 
 void User::set_operand(unsigned i, Value *v) {
     assert(i < operands_.size() && "set_operand out of index");
-    if (operands_[i]) { // old operand
-        operands_[i]->remove_use(this, i);
-    }
-    if (v) { // new operand
+    auto &use = operands_[i];
+    if (use.used_) // old operand
+        use.used_->remove_use(this, i);
+    use.used_ = v;
+    if (v) // new operand
         v->add_use(this, i);
-    }
-    operands_[i] = v;
 }
 
 void User::add_operand(Value *v) {
     assert(v != nullptr && "bad use: add_operand(nullptr)");
-    v->add_use(this, operands_.size());
-    operands_.push_back(v);
+    operands_.emplace_back(this, operands_.size(), v);
+    v->add_use(this, operands_.size() - 1);
 }
 
 void User::remove_all_operands() {
     for (unsigned i = 0; i != operands_.size(); ++i) {
-        if (operands_[i]) {
-            operands_[i]->remove_use(this, i);
+        if (operands_[i].used_) {
+            operands_[i].used_->remove_use(this, i);
         }
     }
     operands_.clear();
@@ -30,12 +29,30 @@ void User::remove_all_operands() {
 
 void User::remove_operand(unsigned idx) {
     assert(idx < operands_.size() && "remove_operand out of index");
-    // influence on other operands
-    for (unsigned i = idx + 1; i < operands_.size(); ++i) {
-        operands_[i]->remove_use(this, i);
-        operands_[i]->add_use(this, i - 1);
-    }
-    // remove the designated operand
-    operands_[idx]->remove_use(this, idx);
+    // remove the designated operand, later use nodes keep their links when
+    // shifted and only need their operand number fixed
+    if (operands_[idx].used_)
+        operands_[idx].used_->remove_use(this, idx);
     operands_.erase(operands_.begin() + idx);
+    for (unsigned i = idx; i < operands_.size(); ++i) {
+        operands_[i].arg_no_ = i;
+    }
+}
+
+void User::remove_operand_unordered(unsigned idx) {
+    assert(idx < operands_.size() && "remove_operand out of index");
+    // moving into the slot unlinks its use node and relinks the last one in
+    // place, so only that one needs its operand number fixed
+    unsigned last = operands_.size() - 1;
+    if (idx != last) {
+        operands_[idx] = std::move(operands_[last]);
+        operands_[idx].arg_no_ = idx;
+    }
+    operands_.pop_back();
+}
+
+void User::drop_operands_for_teardown() {
+    for (auto &use : operands_)
+        use.forget_links();
+    operands_.clear();
 }
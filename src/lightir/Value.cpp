@@ -1,31 +1,126 @@
 #include "Value.hpp"
+#include "Module.hpp"
 #include "Type.hpp"
 #include "User.hpp"
 
 #include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <sstream>
 
-bool Value::set_name(std::string name) {
-    if (name_ == "") {
-        name_ = name;
-        return true;
-    }
-    return false;
+namespace {
+// every node allocated through Value::operator new is preceded by this header
+struct alignas(std::max_align_t) NodeHeader {
+    bool in_arena;
+};
+
+// the use list of a value that several functions can refer to is guarded by
+// one of a fixed set of locks, values local to a function need none. Other
+// threads relink the neighbours of a node, so even reading its own links
+// needs the lock.
+std::unique_lock<std::mutex> lock_use_list(const Value *val) {
+    static std::mutex mutexes[64];
+    if (val == nullptr)
+        return {};
+    auto id = val->get_value_id();
+    if (id < Value::FunctionVal or id >= Value::InstructionVal)
+        return {};
+    auto slot = (reinterpret_cast<std::uintptr_t>(val) >> 4) % 64;
+    return std::unique_lock<std::mutex>(mutexes[slot]);
+}
+
+const std::string empty_name;
+} // namespace
+
+void Use::unlink() {
+    auto lock = lock_use_list(get_used());
+    if (not prev_)
+        return;
+    *prev_ = next_;
+    if (next_)
+        next_->prev_ = prev_;
+    next_ = nullptr;
+    prev_ = nullptr;
+}
+
+void Use::take_links(Use &other) {
+    auto lock = lock_use_list(other.get_used());
+    if (not other.prev_)
+        return;
+    next_ = other.next_;
+    prev_ = other.prev_;
+    *prev_ = this;
+    if (next_)
+        next_->prev_ = &next_;
+    other.next_ = nullptr;
+    other.prev_ = nullptr;
+}
+
+void *Value::operator new(std::size_t size) {
+    auto header =
+        static_cast<NodeHeader *>(::operator new(sizeof(NodeHeader) + size));
+    header->in_arena = false;
+    return header + 1;
+}
+
+void *Value::operator new(std::size_t size, Module *m) {
+    if (m)
+        m->count_value(sizeof(NodeHeader) + size);
+    if (m == nullptr or not m->uses_arena())
+        return operator new(size);
+    auto header = static_cast<NodeHeader *>(
+        m->allocate(sizeof(NodeHeader) + size, alignof(NodeHeader)));
+    header->in_arena = true;
+    return header + 1;
+}
+
+void Value::operator delete(void *ptr) {
+    if (ptr == nullptr)
+        return;
+    auto header = static_cast<NodeHeader *>(ptr) - 1;
+    if (not header->in_arena)
+        ::operator delete(header);
+}
+
+void Value::operator delete(void *ptr, Module *) { operator delete(ptr); }
+
+Value::Value(Type *ty, unsigned value_id, const std::string &name)
+    : type_(ty), name_(&empty_name), value_id_(value_id) {
+    set_name(name);
+}
+
+bool Value::set_name(const std::string &name) {
+    if (not name_->empty())
+        return false;
+    if (not name.empty())
+        name_ = type_->get_module()->intern_name(name);
+    return true;
+}
+
+std::string Value::print() {
+    std::ostringstream ss;
+    print(ss);
+    return ss.str();
 }
 
 void Value::add_use(User *user, unsigned arg_no) {
-    use_list_.emplace_back(user, arg_no);
+    auto &use = user->operands_[arg_no];
+    assert(not use.is_linked() && "use is already linked");
+    assert(use.get_used() == this && "use of another value");
+    auto lock = lock_use_list(this);
+    use.link(use_head_);
 };
 
 void Value::remove_use(User *user, unsigned arg_no) {
-    auto target_use = Use(user, arg_no);
-    use_list_.remove_if([&](const Use &use) { return use == target_use; });
+    user->operands_[arg_no].unlink();
 }
 
 void Value::replace_all_use_with(Value *new_val) {
     if (this == new_val)
         return;
-    while (use_list_.size()) {
-        auto use = use_list_.begin();
+    while (use_head_) {
+        auto use = use_head_;
         use->val_->set_operand(use->arg_no_, new_val);
     }
 }
@@ -34,10 +129,10 @@ void Value::replace_use_with_if(Value *new_val,
                                 std::function<bool(Use *)> should_replace) {
     if (this == new_val)
         return;
-    for (auto iter = use_list_.begin(); iter != use_list_.end();) {
-        auto use = *iter++;
-        if (not should_replace(&use))
-            continue;
-        use.val_->set_operand(use.arg_no_, new_val);
+    for (auto use = use_head_; use;) {
+        auto next = use->next_;
+        if (should_replace(use))
+            use->val_->set_operand(use->arg_no_, new_val);
+        use = next;
     }
 }
@@ -14,6 +14,8 @@ int main(int argc, char *argv[]) {
 
     // Call the syntax analyzer.
     tree = parse(input);
+    if (!tree)
+        return 1;
     print_syntax_tree(stdout, tree);
     del_syntax_tree(tree);
     return 0;
@@ -1,32 +1,86 @@
 %{
+// mmap() and fdopen() under -std=c99
+#define _DEFAULT_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "syntax_tree.h"
 
-// external functions from lex
-extern int yylex();
-extern int yyparse();
-extern int yyrestart();
-extern FILE * yyin;
+%}
 
-// external variables from lexical_analyzer module
-extern int lines;
-extern char * yytext;
-extern int pos_end;
-extern int pos_start;
+%code requires {
+#ifndef YY_TYPEDEF_YY_SCANNER_T
+#define YY_TYPEDEF_YY_SCANNER_T
+typedef void *yyscan_t;
+#endif
+
+// the kinds of inner syntax tree nodes, leaves have their token number
+enum syntax_node_kind {
+    NODE_PROGRAM = 1,
+    NODE_DECLARATION_LIST,
+    NODE_DECLARATION,
+    NODE_VAR_DECLARATION,
+    NODE_TYPE_SPECIFIER,
+    NODE_FUN_DECLARATION,
+    NODE_PARAMS,
+    NODE_PARAM_LIST,
+    NODE_PARAM,
+    NODE_COMPOUND_STMT,
+    NODE_LOCAL_DECLARATIONS,
+    NODE_STATEMENT_LIST,
+    NODE_STATEMENT,
+    NODE_EXPRESSION_STMT,
+    NODE_SELECTION_STMT,
+    NODE_ITERATION_STMT,
+    NODE_RETURN_STMT,
+    NODE_EXPRESSION,
+    NODE_VAR,
+    NODE_SIMPLE_EXPRESSION,
+    NODE_RELOP,
+    NODE_ADDITIVE_EXPRESSION,
+    NODE_ADDOP,
+    NODE_TERM,
+    NODE_MULOP,
+    NODE_FACTOR,
+    NODE_INTEGER,
+    NODE_FLOAT,
+    NODE_CALL,
+    NODE_ARGS,
+    NODE_ARG_LIST,
+    NODE_EPSILON
+};
+}
 
-// Global syntax tree
-syntax_tree *gt;
+%code {
+// external functions from lex
+extern int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+extern int yylex_init_extra(parse_context *ctx, yyscan_t *scanner);
+extern int yylex_destroy(yyscan_t scanner);
+extern parse_context *yyget_extra(yyscan_t scanner);
+extern void yyset_in(FILE *input, yyscan_t scanner);
+extern struct yy_buffer_state *yy_scan_bytes(const char *bytes, int size,
+                                             yyscan_t scanner);
+extern struct yy_buffer_state *yy_scan_buffer(char *base, size_t size,
+                                              yyscan_t scanner);
 
 // Error reporting
-void yyerror(const char *s);
+void yyerror(yyscan_t scanner, const char *s);
 
 // Helper functions written for you with love
-syntax_tree_node *node(const char *node_name, int children_num, ...);
-%}
+syntax_tree_node *new_node(syntax_tree *tree, enum syntax_node_kind kind,
+                           int children_num, ...);
+#define node(kind, ...) new_node(yyget_extra(scanner)->tree, kind, __VA_ARGS__)
+}
+
+%define api.pure full
+%lex-param {yyscan_t scanner}
+%parse-param {yyscan_t scanner}
 
 /* TODO: Complete this definition. */
 %union {
@@ -76,132 +130,132 @@ syntax_tree_node *node(const char *node_name, int children_num, ...);
 %%
 /* TODO: Your rules here. */
 
-program : 	declaration-list {$$ = node( "program", 1, $1); gt->root = $$;}
+program : 	declaration-list {$$ = node(NODE_PROGRAM, 1, $1); yyget_extra(scanner)->tree->root = $$;}
 		;
 
-declaration-list 	: 	declaration-list declaration {$$ = node( "declaration-list", 2, $1, $2);}
-					|	declaration {$$ = node( "declaration-list", 1, $1);}
+declaration-list 	: 	declaration-list declaration {$$ = node(NODE_DECLARATION_LIST, 2, $1, $2);}
+					|	declaration {$$ = node(NODE_DECLARATION_LIST, 1, $1);}
 					;
 
-declaration : 	var-declaration {$$ = node( "declaration", 1, $1);}
-			| 	fun-declaration {$$ = node( "declaration", 1, $1);}
+declaration : 	var-declaration {$$ = node(NODE_DECLARATION, 1, $1);}
+			| 	fun-declaration {$$ = node(NODE_DECLARATION, 1, $1);}
 			;
 
-var-declaration : 	type-specifier IDENTIFIER SEMICOLON {$$ = node( "var-declaration", 3, $1, $2, $3);}
-                | 	type-specifier IDENTIFIER LBRACKET INTEGER RBRACKET SEMICOLON {$$ = node( "var-declaration", 6, $1, $2, $3, $4, $5, $6);}
+var-declaration : 	type-specifier IDENTIFIER SEMICOLON {$$ = node(NODE_VAR_DECLARATION, 3, $1, $2, $3);}
+                | 	type-specifier IDENTIFIER LBRACKET INTEGER RBRACKET SEMICOLON {$$ = node(NODE_VAR_DECLARATION, 6, $1, $2, $3, $4, $5, $6);}
                 ;
 
-type-specifier 	: 	INT {$$ = node( "type-specifier", 1, $1);}
-				| 	FLOAT { $$ = node( "type-specifier", 1, $1); }
-				| 	VOID {$$ = node( "type-specifier", 1, $1);}
+type-specifier 	: 	INT {$$ = node(NODE_TYPE_SPECIFIER, 1, $1);}
+				| 	FLOAT { $$ = node(NODE_TYPE_SPECIFIER, 1, $1); }
+				| 	VOID {$$ = node(NODE_TYPE_SPECIFIER, 1, $1);}
 				;
 
-fun-declaration : 	type-specifier IDENTIFIER LPARENTHESE params RPARENTHESE compound-stmt {$$ = node( "fun-declaration", 6, $1, $2, $3, $4, $5, $6);}
+fun-declaration : 	type-specifier IDENTIFIER LPARENTHESE params RPARENTHESE compound-stmt {$$ = node(NODE_FUN_DECLARATION, 6, $1, $2, $3, $4, $5, $6);}
 				;
 
-params 	: 	param-list {$$ = node( "params", 1, $1);}
-		|	VOID {$$ = node( "params", 1, $1);}
+params 	: 	param-list {$$ = node(NODE_PARAMS, 1, $1);}
+		|	VOID {$$ = node(NODE_PARAMS, 1, $1);}
 		;
 
-param-list 	: 	param-list COMMA param {$$ = node( "param-list", 3, $1, $2, $3);}
-			| 	param {$$ = node( "param-list", 1, $1);}
+param-list 	: 	param-list COMMA param {$$ = node(NODE_PARAM_LIST, 3, $1, $2, $3);}
+			| 	param {$$ = node(NODE_PARAM_LIST, 1, $1);}
 			;
 
-param 	: 	type-specifier IDENTIFIER {$$ = node( "param", 2, $1, $2);}
-		| 	type-specifier IDENTIFIER LBRACKET RBRACKET {$$ = node( "param", 4, $1, $2, $3, $4);}
+param 	: 	type-specifier IDENTIFIER {$$ = node(NODE_PARAM, 2, $1, $2);}
+		| 	type-specifier IDENTIFIER LBRACKET RBRACKET {$$ = node(NODE_PARAM, 4, $1, $2, $3, $4);}
 		;
 
-compound-stmt 	: 	LBRACE local-declarations statement-list RBRACE {$$ = node( "compound-stmt", 4, $1, $2, $3, $4);}
+compound-stmt 	: 	LBRACE local-declarations statement-list RBRACE {$$ = node(NODE_COMPOUND_STMT, 4, $1, $2, $3, $4);}
 				;
 
-local-declarations 	: 	local-declarations var-declaration {$$ = node( "local-declarations", 2, $1, $2);}
-| 	{$$ = node( "local-declarations",0);}
+local-declarations 	: 	local-declarations var-declaration {$$ = node(NODE_LOCAL_DECLARATIONS, 2, $1, $2);}
+| 	{$$ = node(NODE_LOCAL_DECLARATIONS, 0);}
 					;
 
-statement-list 	: 	statement-list statement {$$ = node( "statement-list", 2, $1, $2);}
-| 	{$$ = node( "statement-list",0);}
+statement-list 	: 	statement-list statement {$$ = node(NODE_STATEMENT_LIST, 2, $1, $2);}
+| 	{$$ = node(NODE_STATEMENT_LIST, 0);}
 				;
 
-statement 	: 	expression-stmt {$$ = node( "statement", 1, $1);}
-            | 	compound-stmt {$$ = node( "statement", 1, $1);}
-			| 	selection-stmt {$$ = node( "statement", 1, $1);}
-			| 	iteration-stmt {$$ = node( "statement", 1, $1);}
-			| 	return-stmt {$$ = node( "statement", 1, $1);}
+statement 	: 	expression-stmt {$$ = node(NODE_STATEMENT, 1, $1);}
+            | 	compound-stmt {$$ = node(NODE_STATEMENT, 1, $1);}
+			| 	selection-stmt {$$ = node(NODE_STATEMENT, 1, $1);}
+			| 	iteration-stmt {$$ = node(NODE_STATEMENT, 1, $1);}
+			| 	return-stmt {$$ = node(NODE_STATEMENT, 1, $1);}
 			;
 
-expression-stmt : 	expression SEMICOLON {$$ = node( "expression-stmt", 2, $1, $2);}
-				| 	SEMICOLON {$$ = node( "expression-stmt", 1, $1);}
+expression-stmt : 	expression SEMICOLON {$$ = node(NODE_EXPRESSION_STMT, 2, $1, $2);}
+				| 	SEMICOLON {$$ = node(NODE_EXPRESSION_STMT, 1, $1);}
 				;
 
-selection-stmt 	: 	IF LPARENTHESE expression RPARENTHESE statement {$$ = node( "selection-stmt", 5, $1, $2, $3, $4, $5);}
-				| 	IF LPARENTHESE expression RPARENTHESE statement ELSE statement {$$ = node( "selection-stmt", 7, $1, $2, $3, $4, $5, $6, $7);}
+selection-stmt 	: 	IF LPARENTHESE expression RPARENTHESE statement {$$ = node(NODE_SELECTION_STMT, 5, $1, $2, $3, $4, $5);}
+				| 	IF LPARENTHESE expression RPARENTHESE statement ELSE statement {$$ = node(NODE_SELECTION_STMT, 7, $1, $2, $3, $4, $5, $6, $7);}
 				;
 
-iteration-stmt 	: 	WHILE LPARENTHESE expression RPARENTHESE statement {$$ = node( "iteration-stmt", 5, $1, $2, $3, $4, $5);}
+iteration-stmt 	: 	WHILE LPARENTHESE expression RPARENTHESE statement {$$ = node(NODE_ITERATION_STMT, 5, $1, $2, $3, $4, $5);}
 				;
 
-return-stmt : 	RETURN SEMICOLON {$$ = node( "return-stmt", 2, $1, $2);}
-			| 	RETURN expression SEMICOLON {$$ = node( "return-stmt", 3, $1, $2, $3);}
+return-stmt : 	RETURN SEMICOLON {$$ = node(NODE_RETURN_STMT, 2, $1, $2);}
+			| 	RETURN expression SEMICOLON {$$ = node(NODE_RETURN_STMT, 3, $1, $2, $3);}
 			;
 
-expression 	: 	var ASSIN expression {$$ = node( "expression", 3, $1, $2, $3);}
-			| 	simple-expression {$$ = node( "expression", 1, $1);}
+expression 	: 	var ASSIN expression {$$ = node(NODE_EXPRESSION, 3, $1, $2, $3);}
+			| 	simple-expression {$$ = node(NODE_EXPRESSION, 1, $1);}
 			;
 
-var : 	IDENTIFIER {$$ = node( "var", 1, $1);}
-    | 	IDENTIFIER LBRACKET expression RBRACKET {$$ = node( "var", 4, $1, $2, $3, $4);}
+var : 	IDENTIFIER {$$ = node(NODE_VAR, 1, $1);}
+    | 	IDENTIFIER LBRACKET expression RBRACKET {$$ = node(NODE_VAR, 4, $1, $2, $3, $4);}
     ;
 
-simple-expression 	: 	additive-expression relop additive-expression {$$ = node( "simple-expression", 3, $1, $2, $3);}
-					| 	additive-expression {$$ = node( "simple-expression", 1, $1);}
+simple-expression 	: 	additive-expression relop additive-expression {$$ = node(NODE_SIMPLE_EXPRESSION, 3, $1, $2, $3);}
+					| 	additive-expression {$$ = node(NODE_SIMPLE_EXPRESSION, 1, $1);}
 					;
 
-relop 	: 	LT {$$ = node( "relop", 1, $1);}
-		| 	LTE {$$ = node( "relop", 1, $1);}
-		| 	GT {$$ = node( "relop", 1, $1);}
-		| 	GTE {$$ = node( "relop", 1, $1);}
-		| 	EQ {$$ = node( "relop", 1, $1);}
-		| 	NEQ {$$ = node( "relop", 1, $1);}
+relop 	: 	LT {$$ = node(NODE_RELOP, 1, $1);}
+		| 	LTE {$$ = node(NODE_RELOP, 1, $1);}
+		| 	GT {$$ = node(NODE_RELOP, 1, $1);}
+		| 	GTE {$$ = node(NODE_RELOP, 1, $1);}
+		| 	EQ {$$ = node(NODE_RELOP, 1, $1);}
+		| 	NEQ {$$ = node(NODE_RELOP, 1, $1);}
 		;
 
-additive-expression : 	additive-expression addop term  {$$ = node( "additive-expression", 3, $1, $2, $3);}
-					| 	term {$$ = node( "additive-expression", 1, $1);}
+additive-expression : 	additive-expression addop term  {$$ = node(NODE_ADDITIVE_EXPRESSION, 3, $1, $2, $3);}
+					| 	term {$$ = node(NODE_ADDITIVE_EXPRESSION, 1, $1);}
 					;
 
-addop 	: 	ADD {$$ = node( "addop", 1, $1);}
-		|	SUB {$$ = node( "addop", 1, $1);}
+addop 	: 	ADD {$$ = node(NODE_ADDOP, 1, $1);}
+		|	SUB {$$ = node(NODE_ADDOP, 1, $1);}
 		;
 
-term 	: 	term mulop factor {$$ = node( "term", 3, $1, $2, $3);}
-		| 	factor {$$ = node( "term", 1, $1);}
+term 	: 	term mulop factor {$$ = node(NODE_TERM, 3, $1, $2, $3);}
+		| 	factor {$$ = node(NODE_TERM, 1, $1);}
 		;
 
-mulop 	: 	MUL {$$ = node( "mulop", 1, $1);}
-		|	DIV {$$ = node( "mulop", 1, $1);}
+mulop 	: 	MUL {$$ = node(NODE_MULOP, 1, $1);}
+		|	DIV {$$ = node(NODE_MULOP, 1, $1);}
 		;
 
-factor 	: 	LPARENTHESE expression RPARENTHESE {$$ = node( "factor", 3, $1, $2, $3);}
-		|	var {$$ = node( "factor", 1, $1);}
-		|	call {$$ = node( "factor", 1, $1);}
-		|	integer {$$ = node( "factor", 1, $1);}
-		|	float {$$ = node( "factor", 1, $1);}
+factor 	: 	LPARENTHESE expression RPARENTHESE {$$ = node(NODE_FACTOR, 3, $1, $2, $3);}
+		|	var {$$ = node(NODE_FACTOR, 1, $1);}
+		|	call {$$ = node(NODE_FACTOR, 1, $1);}
+		|	integer {$$ = node(NODE_FACTOR, 1, $1);}
+		|	float {$$ = node(NODE_FACTOR, 1, $1);}
 		;
 
-integer 	: 	INTEGER {$$ = node( "integer", 1, $1);}
+integer 	: 	INTEGER {$$ = node(NODE_INTEGER, 1, $1);}
 		;
 
-float 	: 	FLOATPOINT {$$ = node( "float", 1, $1);}
+float 	: 	FLOATPOINT {$$ = node(NODE_FLOAT, 1, $1);}
 		;
 
-call 	: 	IDENTIFIER LPARENTHESE args RPARENTHESE {$$ = node( "call", 4, $1, $2, $3, $4);}
+call 	: 	IDENTIFIER LPARENTHESE args RPARENTHESE {$$ = node(NODE_CALL, 4, $1, $2, $3, $4);}
 		;
 
-args 	: 	arg-list {$$ = node( "args", 1, $1);}
-| 	{$$ = node( "args", 0);}
+args 	: 	arg-list {$$ = node(NODE_ARGS, 1, $1);}
+| 	{$$ = node(NODE_ARGS, 0);}
 		;
 
-arg-list 	: 	arg-list COMMA expression {$$ = node( "arg-list", 3, $1, $2, $3);}
-			| 	expression {$$ = node( "arg-list", 1, $1);}
+arg-list 	: 	arg-list COMMA expression {$$ = node(NODE_ARG_LIST, 3, $1, $2, $3);}
+			| 	expression {$$ = node(NODE_ARG_LIST, 1, $1);}
 			;
 
 
@@ -209,54 +263,176 @@ arg-list 	: 	arg-list COMMA expression {$$ = node( "arg-list", 3, $1, $2, $3);}
 %%
 
 /// The error reporting function.
-void yyerror(const char * s)
+void yyerror(yyscan_t scanner, const char * s)
 {
     // TO STUDENTS: This is just an example.
     // You can customize it as you like.
-    fprintf(stderr, "error at line %d column %d: %s\n", lines, pos_start, s);
+    // kept for the caller to print or send, a server has no stderr to spare
+    parse_context *ctx = yyget_extra(scanner);
+    snprintf(ctx->error_message, sizeof(ctx->error_message),
+             "error at line %d column %d: %s", ctx->lines, ctx->pos_start, s);
 }
 
 /// Parse input from file `input_path`, and prints the parsing results
 /// to stdout.  If input_path is NULL, read from stdin.
-///
-/// This function initializes essential states before running yyparse().
 syntax_tree *parse(const char *input_path)
 {
-    if (input_path != NULL) {
-        if (!(yyin = fopen(input_path, "r"))) {
-            fprintf(stderr, "[ERR] Open input file %s failed.\n", input_path);
-            exit(1);
+    parse_context ctx;
+    syntax_tree *tree = input_path == NULL ? parse_stream(&ctx, stdin)
+                                           : parse_file(&ctx, input_path);
+    if (tree == NULL)
+        fprintf(stderr, "%s\n", ctx.error_message);
+    return tree;
+}
+
+enum source_kind { SOURCE_STREAM, SOURCE_COPY, SOURCE_IN_PLACE };
+
+// yyparse() on a scanner of its own, reading `input` or `text`
+static syntax_tree *run_parser(parse_context *ctx, enum source_kind kind,
+                               FILE *input, char *text, size_t size)
+{
+    yyscan_t scanner;
+    ctx->lines = ctx->pos_start = ctx->pos_end = 1;
+    ctx->error_message[0] = '\0';
+    ctx->open_failed = 0;
+    ctx->tree = new_syntax_tree();
+    if (yylex_init_extra(ctx, &scanner) != 0) {
+        del_syntax_tree(ctx->tree);
+        return ctx->tree = NULL;
+    }
+    // the buffers are freed by yylex_destroy()
+    if (kind == SOURCE_STREAM)
+        yyset_in(input, scanner);
+    else if (kind == SOURCE_COPY)
+        yy_scan_bytes(text, (int)size, scanner);
+    else
+        yy_scan_buffer(text, size + 2, scanner);
+
+    int failed = yyparse(scanner);
+    yylex_destroy(scanner);
+    if (failed) {
+        // the arena frees the nodes left on the parser stack as well
+        del_syntax_tree(ctx->tree);
+        ctx->tree = NULL;
+    }
+    return ctx->tree;
+}
+
+/// Parse an already opened stream.
+syntax_tree *parse_stream(parse_context *ctx, FILE *input)
+{
+    return run_parser(ctx, SOURCE_STREAM, input, NULL, 0);
+}
+
+/// Parse a copy of the source text, which needs no terminating NUL.
+syntax_tree *parse_buffer(parse_context *ctx, const char *text, size_t size)
+{
+    return run_parser(ctx, SOURCE_COPY, NULL, (char *)text, size);
+}
+
+/// Scan the source text where it is, text[size] and text[size + 1] must be
+/// NUL. The scanner writes into the text while it runs.
+syntax_tree *parse_in_place(parse_context *ctx, char *text, size_t size)
+{
+    return run_parser(ctx, SOURCE_IN_PLACE, NULL, text, size);
+}
+
+/// Parse the file at `path`. Regular files are mapped and scanned in place,
+/// everything else is read through stdio.
+syntax_tree *parse_file(parse_context *ctx, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        snprintf(ctx->error_message, sizeof(ctx->error_message),
+                 "[ERR] Open input file %s failed.", path);
+        ctx->open_failed = 1;
+        return ctx->tree = NULL;
+    }
+
+    struct stat st;
+    char *base = MAP_FAILED;
+    size_t size = 0, length = 0;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        size = st.st_size;
+        long page = sysconf(_SC_PAGESIZE);
+        length = (size + 2 + page - 1) / page * page;
+        // zero pages with the file mapped over their front, so that the
+        // two NULs follow it even if it fills its last page. Private, as
+        // the scanner writes into the text.
+        base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base != MAP_FAILED &&
+            mmap(base, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+                 fd, 0) == MAP_FAILED) {
+            munmap(base, length);
+            base = MAP_FAILED;
         }
-    } else {
-        yyin = stdin;
+    }
+    if (base == MAP_FAILED) {
+        FILE *input = fdopen(fd, "r");
+        syntax_tree *tree = parse_stream(ctx, input);
+        fclose(input);
+        return tree;
     }
 
-    lines = pos_start = pos_end = 1;
-    gt = new_syntax_tree();
-    yyrestart(yyin);
-    yyparse();
-    return gt;
+    close(fd);
+    syntax_tree *tree = parse_in_place(ctx, base, size);
+    munmap(base, length);
+    return tree;
 }
 
+static const char *const node_names[] = {
+    [NODE_PROGRAM] = "program",
+    [NODE_DECLARATION_LIST] = "declaration-list",
+    [NODE_DECLARATION] = "declaration",
+    [NODE_VAR_DECLARATION] = "var-declaration",
+    [NODE_TYPE_SPECIFIER] = "type-specifier",
+    [NODE_FUN_DECLARATION] = "fun-declaration",
+    [NODE_PARAMS] = "params",
+    [NODE_PARAM_LIST] = "param-list",
+    [NODE_PARAM] = "param",
+    [NODE_COMPOUND_STMT] = "compound-stmt",
+    [NODE_LOCAL_DECLARATIONS] = "local-declarations",
+    [NODE_STATEMENT_LIST] = "statement-list",
+    [NODE_STATEMENT] = "statement",
+    [NODE_EXPRESSION_STMT] = "expression-stmt",
+    [NODE_SELECTION_STMT] = "selection-stmt",
+    [NODE_ITERATION_STMT] = "iteration-stmt",
+    [NODE_RETURN_STMT] = "return-stmt",
+    [NODE_EXPRESSION] = "expression",
+    [NODE_VAR] = "var",
+    [NODE_SIMPLE_EXPRESSION] = "simple-expression",
+    [NODE_RELOP] = "relop",
+    [NODE_ADDITIVE_EXPRESSION] = "additive-expression",
+    [NODE_ADDOP] = "addop",
+    [NODE_TERM] = "term",
+    [NODE_MULOP] = "mulop",
+    [NODE_FACTOR] = "factor",
+    [NODE_INTEGER] = "integer",
+    [NODE_FLOAT] = "float",
+    [NODE_CALL] = "call",
+    [NODE_ARGS] = "args",
+    [NODE_ARG_LIST] = "arg-list",
+    [NODE_EPSILON] = "epsilon",
+};
+
 /// A helper function to quickly construct a tree node.
 ///
-/// e.g. $$ = node("program", 1, $1);
-syntax_tree_node *node(const char *name, int children_num, ...)
+/// e.g. $$ = node(NODE_PROGRAM, 1, $1);
+syntax_tree_node *new_node(syntax_tree *tree, enum syntax_node_kind kind,
+                           int children_num, ...)
 {
-    syntax_tree_node *p = new_syntax_tree_node(name);
-    syntax_tree_node *child;
 	// 这里表示 epsilon结点是通过 children_num == 0 来判断的
     if (children_num == 0) {
-        child = new_syntax_tree_node("epsilon");
-        syntax_tree_add_child(p, child);
-    } else {
-        va_list ap;
-        va_start(ap, children_num);
-        for (int i = 0; i < children_num; ++i) {
-            child = va_arg(ap, syntax_tree_node *);
-            syntax_tree_add_child(p, child);
-        }
-        va_end(ap);
+        syntax_tree_node *p = syntax_tree_new_node(tree, kind, node_names[kind], 1);
+        p->children[0] = syntax_tree_new_node(tree, NODE_EPSILON, "epsilon", 0);
+        return p;
     }
+    syntax_tree_node *p = syntax_tree_new_node(tree, kind, node_names[kind], children_num);
+    va_list ap;
+    va_start(ap, children_num);
+    for (int i = 0; i < children_num; ++i)
+        p->children[i] = va_arg(ap, syntax_tree_node *);
+    va_end(ap);
     return p;
 }
@@ -0,0 +1,76 @@
+#include "AliasAnalysis.hpp"
+#include "Constant.hpp"
+#include "FuncInfo.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <vector>
+
+namespace {
+// number of scalars in a value of type ty
+long get_num_scalars(Type *ty) {
+    if (ty->is_array_type()) {
+        auto array_ty = static_cast<ArrayType *>(ty);
+        return array_ty->get_num_of_elements() *
+               get_num_scalars(array_ty->get_element_type());
+    }
+    return 1;
+}
+
+// allocas and globals are distinct objects, everything else may point into
+// one of them
+bool is_identified_object(Value *base) {
+    return base->is<AllocaInst>() or base->is<GlobalVariable>();
+}
+} // namespace
+
+AliasAnalysis::Location AliasAnalysis::decompose(Value *ptr) {
+    Location loc{FuncInfo::get_first_addr(ptr), true, 0};
+    // geps from the base up to ptr
+    std::vector<GetElementPtrInst *> geps;
+    for (auto val = ptr; val != loc.base;) {
+        auto gep = val->dyn_cast<GetElementPtrInst>();
+        if (not gep) {
+            loc.const_offset = false;
+            return loc;
+        }
+        geps.push_back(gep);
+        val = gep->get_operand(0);
+    }
+    for (auto it = geps.rbegin(); it != geps.rend(); ++it) {
+        auto gep = *it;
+        auto ty = gep->get_operand(0)->get_type()->get_pointer_element_type();
+        for (unsigned i = 1; i < gep->get_num_operand(); ++i) {
+            auto idx = gep->get_operand(i)->dyn_cast<ConstantInt>();
+            if (not idx) {
+                loc.const_offset = false;
+                return loc;
+            }
+            // the first index steps over whole pointees, the others into
+            // the array
+            if (i > 1)
+                ty = static_cast<ArrayType *>(ty)->get_element_type();
+            loc.offset += idx->get_value() * get_num_scalars(ty);
+        }
+    }
+    return loc;
+}
+
+AliasAnalysis::AliasResult AliasAnalysis::alias(Value *ptr1, Value *ptr2) {
+    if (ptr1 == ptr2)
+        return MustAlias;
+    auto loc1 = decompose(ptr1), loc2 = decompose(ptr2);
+    if (loc1.base != loc2.base) {
+        if (is_identified_object(loc1.base) and
+            is_identified_object(loc2.base))
+            return NoAlias;
+        // no pointer to a local array can reach a function through its
+        // arguments or memory, only globals can
+        if (loc1.base->is<AllocaInst>() or loc2.base->is<AllocaInst>())
+            return NoAlias;
+        return MayAlias;
+    }
+    if (loc1.const_offset and loc2.const_offset)
+        return loc1.offset == loc2.offset ? MustAlias : NoAlias;
+    return MayAlias;
+}
@@ -0,0 +1,68 @@
+#include "BlockLayout.hpp"
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+
+void BlockLayout::run_on_func(Function *func) {
+    std::vector<BasicBlock *> blocks;
+    std::unordered_map<BasicBlock *, long> counts;
+    std::unordered_map<BasicBlock *, unsigned> positions;
+    bool has_counts = false;
+    for (auto &bb : func->get_basic_blocks()) {
+        positions[&bb] = blocks.size();
+        blocks.push_back(&bb);
+        counts[&bb] = bb.get_count();
+        has_counts |= bb.get_count() >= 0;
+    }
+    if (not has_counts)
+        return;
+    // the blocks without a count take those of their predecessors
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto bb : blocks) {
+            if (counts[bb] >= 0)
+                continue;
+            for (auto pred : bb->get_pre_basic_blocks())
+                counts[bb] = std::max(counts[bb], counts[pred]);
+            changed |= counts[bb] >= 0;
+        }
+    }
+    auto hotter = [&](BasicBlock *a, BasicBlock *b) {
+        auto count_a = std::max(counts[a], 0l), count_b = std::max(counts[b], 0l);
+        return count_a != count_b ? count_a > count_b
+                                  : positions[a] < positions[b];
+    };
+
+    // chains of hottest successors, each starting at the hottest block left
+    std::vector<BasicBlock *> by_count(blocks);
+    std::sort(by_count.begin(), by_count.end(), hotter);
+    std::unordered_map<BasicBlock *, bool> placed;
+    std::vector<BasicBlock *> order;
+    auto next_start = by_count.begin();
+    for (auto bb = blocks.front(); bb;) {
+        placed[bb] = true;
+        order.push_back(bb);
+        BasicBlock *next = nullptr;
+        for (auto succ : bb->get_succ_basic_blocks())
+            if (not placed[succ] and (next == nullptr or hotter(succ, next)))
+                next = succ;
+        while (next == nullptr and next_start != by_count.end()) {
+            if (not placed[*next_start])
+                next = *next_start;
+            ++next_start;
+        }
+        bb = next;
+    }
+
+    unsigned num_moved = 0;
+    auto &list = func->get_basic_blocks();
+    for (std::size_t i = 0; i < order.size(); i++) {
+        num_moved += order[i] != blocks[i];
+        list.splice(list.end(), list, order[i]->getIterator());
+    }
+    if (num_moved)
+        add_stat("blocks moved", num_moved);
+}
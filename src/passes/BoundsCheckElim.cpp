@@ -0,0 +1,268 @@
+#include "BoundsCheckElim.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace {
+constexpr std::int64_t int_min = INT_MIN, int_max = INT_MAX;
+// ranges growing more often than this go to the full range
+constexpr unsigned widen_after = 3;
+// how far up the dominator tree branches narrow a value
+constexpr unsigned max_refine_depth = 32;
+
+bool is_abort_call(Instruction &instr) {
+    return instr.is_call() and
+           instr.get_operand(0)->get_name() == "neg_idx_except";
+}
+} // namespace
+
+void BoundsCheckElim::prepare() { dominators_ = get_analysis<Dominators>(); }
+
+void BoundsCheckElim::run_on_func(Function *func) {
+    FuncState state;
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto &instr : bb.get_instructions()) {
+            if (is_abort_call(instr))
+                state.abort_bbs.insert(&bb);
+        }
+    }
+    // without guards there is nothing to remove
+    if (state.abort_bbs.empty())
+        return;
+    solve(state, func);
+    if (remove_guards(state, func))
+        func->remove_unreachable_basic_blocks();
+}
+
+BoundsCheckElim::Range BoundsCheckElim::get_range(FuncState &state,
+                                                  Value *val) {
+    if (auto constant = val->dyn_cast<ConstantInt>())
+        return {constant->get_value(), constant->get_value()};
+    if (val->is<Instruction>() and val->get_type()->is_int32_type()) {
+        auto it = state.ranges.find(val);
+        return it == state.ranges.end() ? Range{1, 0} : it->second;
+    }
+    // arguments
+    return {int_min, int_max};
+}
+
+BoundsCheckElim::Range BoundsCheckElim::get_range_at(FuncState &state,
+                                                     Value *val,
+                                                     BasicBlock *bb) {
+    auto range = get_range(state, val);
+    // every path to bb goes through the edge from the single predecessor
+    // of each of its dominators that may go on
+    for (unsigned depth = 0; bb and depth < max_refine_depth and
+                             not range.empty();
+         depth++) {
+        BasicBlock *pred = nullptr;
+        unsigned num_preds = 0;
+        for (auto pre_bb : bb->get_pre_basic_blocks()) {
+            if (state.abort_bbs.count(pre_bb))
+                continue;
+            pred = pre_bb;
+            num_preds++;
+        }
+        if (num_preds == 1 and pred->is_terminated()) {
+            auto br = pred->get_terminator()->dyn_cast<BranchInst>();
+            if (br and br->is_cond_br() and
+                br->get_operand(1) != br->get_operand(2))
+                range = refine(state, range, val, br->get_condition(),
+                               br->get_operand(1) == bb);
+        }
+        bb = dominators_->get_idom(bb);
+    }
+    return range;
+}
+
+BoundsCheckElim::Range BoundsCheckElim::refine(FuncState &state, Range range,
+                                               Value *val, Value *cond,
+                                               bool taken) {
+    auto cmp = cond->dyn_cast<ICmpInst>();
+    if (cmp == nullptr)
+        return range;
+    auto op = cmp->get_instr_type();
+    auto lhs = cmp->get_operand(0), rhs = cmp->get_operand(1);
+
+    // the builder branches on `icmp ne (zext c), 0`
+    auto zero = rhs->dyn_cast<ConstantInt>();
+    auto ext = lhs->dyn_cast<ZextInst>();
+    if ((op == Instruction::ne or op == Instruction::eq) and ext and zero and
+        zero->get_value() == 0)
+        return refine(state, range, val, ext->get_operand(0),
+                      op == Instruction::ne ? taken : not taken);
+
+    Value *other;
+    if (lhs == val) {
+        other = rhs;
+    } else if (rhs == val) {
+        other = lhs;
+        op = ICmpInst::get_swapped_op(op);
+    } else {
+        return range;
+    }
+    if (not taken)
+        op = ICmpInst::get_inverse_op(op);
+    auto bound = get_range(state, other);
+    if (bound.empty())
+        return range;
+
+    switch (op) {
+    case Instruction::lt:
+        range.hi = std::min(range.hi, bound.hi - 1);
+        break;
+    case Instruction::le:
+        range.hi = std::min(range.hi, bound.hi);
+        break;
+    case Instruction::gt:
+        range.lo = std::max(range.lo, bound.lo + 1);
+        break;
+    case Instruction::ge:
+        range.lo = std::max(range.lo, bound.lo);
+        break;
+    case Instruction::eq:
+        range.lo = std::max(range.lo, bound.lo);
+        range.hi = std::min(range.hi, bound.hi);
+        break;
+    default:
+        // only a constant at the end of the range comes off
+        if (bound.lo == bound.hi) {
+            if (range.lo == bound.lo)
+                range.lo++;
+            else if (range.hi == bound.lo)
+                range.hi--;
+        }
+        break;
+    }
+    return range;
+}
+
+BoundsCheckElim::Range BoundsCheckElim::compute(FuncState &state,
+                                                Instruction *instr) {
+    auto bb = instr->get_parent();
+    Range result{int_min, int_max};
+    switch (instr->get_instr_type()) {
+    case Instruction::phi:
+        result = {1, 0};
+        for (auto &[val, pre_bb] : instr->as<PhiInst>()->get_phi_pairs()) {
+            if (state.abort_bbs.count(pre_bb))
+                continue;
+            auto range = get_range_at(state, val, pre_bb);
+            if (range.empty())
+                continue;
+            result = result.empty() ? range
+                                    : Range{std::min(result.lo, range.lo),
+                                            std::max(result.hi, range.hi)};
+        }
+        return result;
+    case Instruction::zext:
+        return {0, 1};
+    case Instruction::add:
+    case Instruction::sub:
+    case Instruction::mul:
+    case Instruction::sdiv: {
+        auto a = get_range_at(state, instr->get_operand(0), bb);
+        auto b = get_range_at(state, instr->get_operand(1), bb);
+        if (a.empty() or b.empty())
+            return {1, 0};
+        if (instr->is_add()) {
+            result = {a.lo + b.lo, a.hi + b.hi};
+        } else if (instr->is_sub()) {
+            result = {a.lo - b.hi, a.hi - b.lo};
+        } else {
+            // the corners, with a divisor of one sign only
+            if (instr->is_div() and b.lo <= 0 and b.hi >= 0)
+                break;
+            std::int64_t corners[4];
+            unsigned i = 0;
+            for (auto x : {a.lo, a.hi}) {
+                for (auto y : {b.lo, b.hi})
+                    corners[i++] = instr->is_mul() ? x * y : x / y;
+            }
+            result = {*std::min_element(corners, corners + 4),
+                      *std::max_element(corners, corners + 4)};
+        }
+        // a result that may wrap around can be anything
+        if (result.lo < int_min or result.hi > int_max)
+            result = {int_min, int_max};
+        break;
+    }
+    default:
+        break;
+    }
+    return result;
+}
+
+void BoundsCheckElim::solve(FuncState &state, Function *func) {
+    // definitions come before their uses except in phis
+    auto &order = dominators_->get_dom_dfs_order(func);
+    bool changed;
+    do {
+        changed = false;
+        for (auto bb : order) {
+            for (auto &instr : bb->get_instructions()) {
+                if (not instr.get_type()->is_int32_type())
+                    continue;
+                auto range = compute(state, &instr);
+                if (range.empty())
+                    continue;
+                auto old = get_range(state, &instr);
+                if (old.empty()) {
+                    state.ranges[&instr] = range;
+                    changed = true;
+                    continue;
+                }
+                Range joined{std::min(old.lo, range.lo),
+                             std::max(old.hi, range.hi)};
+                if (joined.lo == old.lo and joined.hi == old.hi)
+                    continue;
+                if (++state.updates[&instr] > widen_after) {
+                    if (joined.lo < old.lo)
+                        joined.lo = int_min;
+                    if (joined.hi > old.hi)
+                        joined.hi = int_max;
+                }
+                state.ranges[&instr] = joined;
+                changed = true;
+            }
+        }
+    } while (changed);
+}
+
+bool BoundsCheckElim::remove_guards(FuncState &state, Function *func) {
+    bool changed = false;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not bb.is_terminated())
+            continue;
+        auto br = bb.get_terminator()->dyn_cast<BranchInst>();
+        if (br == nullptr or not br->is_cond_br())
+            continue;
+        auto right_bb = br->get_operand(1)->as<BasicBlock>();
+        auto wrong_bb = br->get_operand(2)->as<BasicBlock>();
+        auto cmp = br->get_condition()->dyn_cast<ICmpInst>();
+        if (not state.abort_bbs.count(wrong_bb) or cmp == nullptr or
+            cmp->get_instr_type() != Instruction::ge)
+            continue;
+        auto zero = cmp->get_operand(1)->dyn_cast<ConstantInt>();
+        if (zero == nullptr or zero->get_value() != 0)
+            continue;
+        auto range = get_range_at(state, cmp->get_operand(0), &bb);
+        if (range.empty() or range.lo < 0)
+            continue;
+        for (auto &instr : wrong_bb->get_instructions()) {
+            if (not instr.is_phi())
+                break;
+            instr.as<PhiInst>()->remove_incoming(&bb);
+        }
+        // the destructor drops both edges, the new branch adds one back
+        bb.erase_instr(br);
+        BranchInst::create_br(right_bb, &bb);
+        add_stat("checks removed");
+        changed = true;
+    }
+    return changed;
+}
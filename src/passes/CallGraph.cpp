@@ -0,0 +1,86 @@
+#include "CallGraph.hpp"
+#include "BasicBlock.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <unordered_set>
+
+void CallGraph::run() {
+    nodes_.clear();
+    sccs_.clear();
+    for (auto &func : m_->get_functions())
+        nodes_[&func];
+    for (auto &func : m_->get_functions()) {
+        auto &node = nodes_[&func];
+        for (auto &bb : func.get_basic_blocks()) {
+            for (auto &inst : bb.get_instructions()) {
+                if (not inst.is_call())
+                    continue;
+                auto callee = inst.get_operand(0)->as<Function>();
+                node.call_sites.push_back(inst.as<CallInst>());
+                if (callee == &func)
+                    node.recursive = true;
+                if (std::find(node.callees.begin(), node.callees.end(),
+                              callee) != node.callees.end())
+                    continue;
+                node.callees.push_back(callee);
+                nodes_[callee].callers.push_back(&func);
+            }
+        }
+    }
+    compute_sccs();
+}
+
+void CallGraph::compute_sccs() {
+    // iterative Tarjan, an SCC is complete once its root is finished and
+    // SCCs complete callees first
+    std::unordered_map<Function *, unsigned> index, low;
+    std::unordered_set<Function *> on_stack;
+    std::vector<Function *> scc_stack;
+    // (function, next callee)
+    std::vector<std::pair<Function *, unsigned>> stack;
+    unsigned counter = 0;
+    auto push = [&](Function *func) {
+        index[func] = low[func] = counter++;
+        scc_stack.push_back(func);
+        on_stack.insert(func);
+        stack.push_back({func, 0});
+    };
+    for (auto &root : m_->get_functions()) {
+        if (index.count(&root))
+            continue;
+        push(&root);
+        while (not stack.empty()) {
+            auto func = stack.back().first;
+            auto &callees = nodes_[func].callees;
+            if (stack.back().second < callees.size()) {
+                auto callee = callees[stack.back().second++];
+                if (not index.count(callee))
+                    push(callee);
+                else if (on_stack.count(callee))
+                    low[func] = std::min(low[func], index[callee]);
+                continue;
+            }
+            if (low[func] == index[func]) {
+                SCC scc;
+                Function *member;
+                do {
+                    member = scc_stack.back();
+                    scc_stack.pop_back();
+                    on_stack.erase(member);
+                    scc.push_back(member);
+                    nodes_[member].scc = sccs_.size();
+                } while (member != func);
+                if (scc.size() > 1)
+                    for (auto member : scc)
+                        nodes_[member].recursive = true;
+                sccs_.push_back(std::move(scc));
+            }
+            stack.pop_back();
+            if (not stack.empty()) {
+                auto caller = stack.back().first;
+                low[caller] = std::min(low[caller], low[func]);
+            }
+        }
+    }
+}
@@ -1,23 +1,34 @@
 #include "ConstPropagation.hpp"
 
+#include "BasicBlock.hpp"
+#include "Function.hpp"
 #include "Instruction.hpp"
 #include "logging.hpp"
 
+#include <climits>
+#include <cmath>
+
+// i32 arithmetic wraps around like the generated code does
+static int wrap(long long value) { return static_cast<int>(static_cast<unsigned>(value)); }
+
 ConstantInt *ConstFolder::compute(Instruction::OpID op, ConstantInt *value1, ConstantInt *value2) {
     int c_value1 = value1->get_value();
     int c_value2 = value2->get_value();
 
     switch (op) {
     case Instruction::add:
-        return ConstantInt::get(c_value1 + c_value2, module_);
+        return ConstantInt::get(wrap((long long)c_value1 + c_value2), module_);
         break;
     case Instruction::sub:
-        return ConstantInt::get(c_value1 - c_value2, module_);
+        return ConstantInt::get(wrap((long long)c_value1 - c_value2), module_);
         break;
     case Instruction::mul:
-        return ConstantInt::get(c_value1 * c_value2, module_);
+        return ConstantInt::get(wrap((long long)c_value1 * c_value2), module_);
         break;
     case Instruction::sdiv:
+        // traps at runtime
+        if (c_value2 == 0 || (c_value1 == INT_MIN && c_value2 == -1))
+            return nullptr;
         return ConstantInt::get(static_cast<int>(c_value1 / c_value2), module_);
         break;
     case Instruction::eq:
@@ -44,7 +55,7 @@ ConstantInt *ConstFolder::compute(Instruction::OpID op, ConstantInt *value1, Con
     }
 }
 
-ConstantFP *ConstFolder::compute(Instruction::OpID op, ConstantFP *value1, ConstantFP *value2) {
+Constant *ConstFolder::compute(Instruction::OpID op, ConstantFP *value1, ConstantFP *value2) {
     float c_value1 = value1->get_value();
     float c_value2 = value2->get_value();
     switch (op) {
@@ -60,36 +71,40 @@ ConstantFP *ConstFolder::compute(Instruction::OpID op, ConstantFP *value1, Const
     case Instruction::fdiv:
         return ConstantFP::get(c_value1 / c_value2, module_);
         break;
+    // fcmp yields an i1
     case Instruction::feq:
-        return ConstantFP::get(c_value1 == c_value2, module_);
+        return ConstantInt::get(c_value1 == c_value2, module_);
         break;
     case Instruction::fne:
-        return ConstantFP::get(c_value1 != c_value2, module_);
+        return ConstantInt::get(c_value1 != c_value2, module_);
         break;
     case Instruction::fgt:
-        return ConstantFP::get(c_value1 > c_value2, module_);
+        return ConstantInt::get(c_value1 > c_value2, module_);
         break;
     case Instruction::fge:
-        return ConstantFP::get(c_value1 >= c_value2, module_);
+        return ConstantInt::get(c_value1 >= c_value2, module_);
         break;
     case Instruction::flt:
-        return ConstantFP::get(c_value1 < c_value2, module_);
+        return ConstantInt::get(c_value1 < c_value2, module_);
         break;
     case Instruction::fle:
-        return ConstantFP::get(c_value1 <= c_value2, module_);
+        return ConstantInt::get(c_value1 <= c_value2, module_);
         break;
     default:
         return nullptr;
         break;
     }
 }
-ConstantFP *ConstFolder::compute(Instruction::OpID op, ConstantInt *value1) {
+Constant *ConstFolder::compute(Instruction::OpID op, ConstantInt *value1) {
     int c_value1 = value1->get_value();
 
     switch (op) {
     case Instruction::sitofp:
         return ConstantFP::get((float) c_value1, module_);
         break;
+    case Instruction::zext:
+        return ConstantInt::get(c_value1, module_);
+        break;
 
     default:
         return nullptr;
@@ -101,6 +116,9 @@ ConstantInt *ConstFolder::compute(Instruction::OpID op, ConstantFP *value1) {
     float c_value1 = value1->get_value();
     switch (op) {
     case Instruction::fptosi:
+        // out of range (or nan) is undefined, leave it to runtime
+        if (not(c_value1 > -2147483904.0f && c_value1 < 2147483648.0f))
+            return nullptr;
         return ConstantInt::get(static_cast<int>(c_value1), module_);
         break;
 
@@ -111,106 +129,259 @@ ConstantInt *ConstFolder::compute(Instruction::OpID op, ConstantFP *value1) {
 }
 
 ConstantFP *cast_constantfp(Value *value) {
-    auto constant_fp_ptr = dynamic_cast<ConstantFP *>(value);
+    auto constant_fp_ptr = value->dyn_cast<ConstantFP>();
     if (constant_fp_ptr) {
         return constant_fp_ptr;
     }
     return nullptr;
 }
 ConstantInt *cast_constantint(Value *value) {
-    auto constant_int_ptr = dynamic_cast<ConstantInt *>(value);
+    auto constant_int_ptr = value->dyn_cast<ConstantInt>();
     if (constant_int_ptr) {
         return constant_int_ptr;
     }
     return nullptr;
 }
 
-void ConstPropagation::run() {
-    for (auto &func : m_->get_functions()) {
+void ConstPropagation::run_on_func(Function *func) {
+    FuncState state;
+    auto entry = func->get_entry_block();
+    state.executable_bbs.insert(entry);
+    state.bb_work_list.push_back(entry);
+    while (not state.bb_work_list.empty() or
+           not state.instr_work_list.empty()) {
+        while (not state.instr_work_list.empty()) {
+            auto instr = state.instr_work_list.back();
+            state.instr_work_list.pop_back();
+            if (state.executable_bbs.count(instr->get_parent()))
+                visit(state, instr);
+        }
+        while (not state.bb_work_list.empty()) {
+            auto bb = state.bb_work_list.back();
+            state.bb_work_list.pop_back();
+            for (auto &instr : bb->get_instructions())
+                visit(state, &instr);
+        }
+    }
 
-        for (auto &bb : func.get_basic_blocks()) {
-            wait_delete.clear();
+    replace_constants(state, func);
+    remove_dead_blocks(state, func);
+}
 
-            for (auto &instr : bb.get_instructions()) {
-                // clear glbalvar_def map
+ConstPropagation::LatticeValue ConstPropagation::get_lattice(FuncState &state,
+                                                            Value *val) {
+    if (val->is<ConstantInt>() or val->is<ConstantFP>())
+        return {LatticeValue::constant, static_cast<Constant *>(val)};
+    if (val->is<Instruction>()) {
+        auto it = state.lattice.find(val);
+        return it == state.lattice.end() ? LatticeValue() : it->second;
+    }
+    // arguments, globals, zero initializers
+    return {LatticeValue::overdefined, nullptr};
+}
 
-                if (instr.is_add() || instr.is_sub() || instr.is_mul() || instr.is_div()) {
-                    auto value1 = cast_constantint(instr.get_operand(0));
-                    auto value2 = cast_constantint(instr.get_operand(1));
-                    if (value1 && value2) {
-                        auto fold_const = folder->compute(instr.get_instr_type(), value1, value2);
+void ConstPropagation::update(FuncState &state, Instruction *instr,
+                              LatticeValue val) {
+    auto &old = state.lattice[instr];
+    // values only ever go down the lattice
+    if (old.state == LatticeValue::overdefined or
+        (old.state == val.state and old.value == val.value))
+        return;
+    if (old.state == LatticeValue::constant and val.state != LatticeValue::undef)
+        val.state = LatticeValue::overdefined;
+    if (val.state == LatticeValue::undef)
+        return;
+    old = val;
+    for (auto &use : instr->get_use_list()) {
+        if (auto user = use.val_->dyn_cast<Instruction>())
+            state.instr_work_list.push_back(user);
+    }
+}
 
-                        instr.replace_all_use_with(fold_const);
-                        wait_delete.push_back(&instr);
-                    }
-                }
-                // TODO: fold other type of expression
-                throw std::runtime_error("Lab2: 你有一个TODO需要完成！");
-            }
-            globalvar_def.clear();
-            for (auto instr : wait_delete) {
-                bb.erase_instr(instr);
-            }
+void ConstPropagation::mark_edge_executable(FuncState &state,
+                                            BasicBlock *from, BasicBlock *to) {
+    if (not state.executable_edges.insert({from, to}).second)
+        return;
+    if (state.executable_bbs.insert(to).second) {
+        state.bb_work_list.push_back(to);
+        return;
+    }
+    // a new incoming edge of a visited block only matters for its phis
+    for (auto &instr : to->get_instructions()) {
+        if (not instr.is_phi())
+            break;
+        state.instr_work_list.push_back(&instr);
+    }
+}
+
+void ConstPropagation::visit(FuncState &state, Instruction *instr) {
+    if (instr->is_phi())
+        return visit_phi(state, instr->as<PhiInst>());
+    if (instr->is_br())
+        return visit_br(state, instr->as<BranchInst>());
+
+    switch (instr->get_instr_type()) {
+    case Instruction::add: case Instruction::sub:
+    case Instruction::mul: case Instruction::sdiv:
+    case Instruction::fadd: case Instruction::fsub:
+    case Instruction::fmul: case Instruction::fdiv:
+    case Instruction::ge: case Instruction::gt: case Instruction::le:
+    case Instruction::lt: case Instruction::eq: case Instruction::ne:
+    case Instruction::fge: case Instruction::fgt: case Instruction::fle:
+    case Instruction::flt: case Instruction::feq: case Instruction::fne:
+    case Instruction::zext: case Instruction::fptosi:
+    case Instruction::sitofp: {
+        std::vector<Constant *> ops;
+        for (auto op : instr->get_operands()) {
+            auto val = get_lattice(state, op);
+            if (val.state == LatticeValue::overdefined)
+                return update(state, instr, {LatticeValue::overdefined, nullptr});
+            if (val.state == LatticeValue::undef)
+                return; // wait for the operand
+            ops.push_back(val.value);
         }
+        auto folded = fold(instr, ops);
+        if (folded)
+            update(state, instr, {LatticeValue::constant, folded});
+        else
+            update(state, instr, {LatticeValue::overdefined, nullptr});
+        return;
     }
+    case Instruction::ret:
+    case Instruction::store:
+        return;
+    default:
+        // memory and calls
+        if (not instr->is_void())
+            update(state, instr, {LatticeValue::overdefined, nullptr});
+        return;
+    }
+}
+
+void ConstPropagation::visit_phi(FuncState &state, PhiInst *phi) {
+    LatticeValue result;
+    for (auto &[val, pre_bb] : phi->get_phi_pairs()) {
+        if (not state.executable_edges.count({pre_bb, phi->get_parent()}))
+            continue;
+        auto in = get_lattice(state, val);
+        if (in.state == LatticeValue::undef)
+            continue;
+        if (in.state == LatticeValue::overdefined or
+            (result.state == LatticeValue::constant and result.value != in.value)) {
+            result = {LatticeValue::overdefined, nullptr};
+            break;
+        }
+        result = in;
+    }
+    update(state, phi, result);
+}
+
+void ConstPropagation::visit_br(FuncState &state, BranchInst *br) {
+    auto bb = br->get_parent();
+    if (not br->is_cond_br()) {
+        mark_edge_executable(state, bb, br->get_operand(0)->as<BasicBlock>());
+        return;
+    }
+    auto if_true = br->get_operand(1)->as<BasicBlock>();
+    auto if_false = br->get_operand(2)->as<BasicBlock>();
+    auto cond = get_lattice(state, br->get_condition());
+    if (cond.state == LatticeValue::undef)
+        return;
+    if (cond.state == LatticeValue::constant) {
+        auto taken = cond.value->as<ConstantInt>()->get_value() ? if_true : if_false;
+        mark_edge_executable(state, bb, taken);
+        return;
+    }
+    mark_edge_executable(state, bb, if_true);
+    mark_edge_executable(state, bb, if_false);
+}
+
+Constant *ConstPropagation::fold(Instruction *instr, const std::vector<Constant *> &ops) {
+    auto op = instr->get_instr_type();
+    if (ops.size() == 1) {
+        if (auto val = cast_constantint(ops[0]))
+            return folder_.compute(op, val);
+        return folder_.compute(op, ops[0]->as<ConstantFP>());
+    }
+    if (auto lhs = cast_constantint(ops[0]))
+        return folder_.compute(op, lhs, ops[1]->as<ConstantInt>());
+    return folder_.compute(op, ops[0]->as<ConstantFP>(), ops[1]->as<ConstantFP>());
+}
 
-    for (auto &func : m_->get_functions()) {
-        for (auto &bb : func.get_basic_blocks()) {
-            builder->set_insert_point(&bb);
-            // TODO: check if conditional branch's condition is constant
-            throw std::runtime_error("Lab2: 你有一个TODO需要完成！");
+void ConstPropagation::replace_constants(FuncState &state, Function *func) {
+    std::vector<Instruction *> wait_delete;
+    std::vector<std::pair<BranchInst *, ConstantInt *>> const_branches;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not state.executable_bbs.count(&bb))
+            continue;
+        for (auto &instr : bb.get_instructions()) {
+            auto val = get_lattice(state, &instr);
+            if (val.state == LatticeValue::constant) {
+                instr.replace_all_use_with(val.value);
+                wait_delete.push_back(&instr);
+            }
+        }
+        if (not bb.is_terminated())
+            continue;
+        auto br = bb.get_terminator()->dyn_cast<BranchInst>();
+        if (br and br->is_cond_br()) {
+            auto cond = get_lattice(state, br->get_condition());
+            if (cond.state == LatticeValue::constant)
+                const_branches.emplace_back(br, cond.value->as<ConstantInt>());
         }
-        for (auto bb : delete_bb) {
-            clear_blocks_recs(bb);
+    }
+    for (auto instr : wait_delete)
+        instr->get_parent()->erase_instr(instr);
+    add_stat("constants folded", wait_delete.size());
+    for (auto &[br, cond] : const_branches)
+        fold_branch(br, cond);
+    add_stat("branches folded", const_branches.size());
+}
+
+void ConstPropagation::fold_branch(BranchInst *br, ConstantInt *cond) {
+    auto bb = br->get_parent();
+    auto if_true = br->get_operand(1)->as<BasicBlock>();
+    auto if_false = br->get_operand(2)->as<BasicBlock>();
+    auto taken = cond->get_value() ? if_true : if_false;
+    auto dropped = cond->get_value() ? if_false : if_true;
+    if (dropped != taken) {
+        for (auto &instr : dropped->get_instructions()) {
+            if (not instr.is_phi())
+                break;
+            instr.as<PhiInst>()->remove_incoming(bb);
         }
-        delete_bb.clear();
-    }
-}
-
-bool ConstPropagation::is_entry(BasicBlock *bb) {
-    // TODO
-    throw std::runtime_error("Lab2: 你有一个TODO需要完成！");
-    return false;
-}
-
-void ConstPropagation::clear_blocks_recs(BasicBlock *start_bb) {
-    auto func = start_bb->get_parent();
-    if (func == nullptr) {
-        LOG(ERROR) << "basic block-" << start_bb->get_name() << " has no parent function";
-    } else {
-        auto prev_bb = start_bb->get_pre_basic_blocks();
-        // start_bb has no previous bb and is not the entry of parent function
-        if (prev_bb.size() == 0 && !is_entry(start_bb)) {
-            func->remove(start_bb);
-            auto succ_bb = start_bb->get_succ_basic_blocks();
-            for (auto each_succ_bb : succ_bb) {
-                std::vector<Instruction*> del_inst;
-                for (auto &instr1 : each_succ_bb->get_instructions()) {
-                    auto instr = &instr1;
-                    if (instr->is_phi()) {
-                        LOG(DEBUG) << "Find a PHI instruction in the sucess node of "
-                                      "useless branch";
-                        for (int i = 1; i < instr->get_num_operand(); i += 2) {
-                            if (instr->get_operand(i) == start_bb &&
-                                start_bb->get_pre_basic_blocks().size() <= 0) {
-                                LOG(DEBUG) << "remove unuseful phi branch in the index of " << i - 1
-                                           << " and " << i;
-
-                                instr->remove_operand(i - 1);
-                                instr->remove_operand(i - 1);
-                            }
-                        }
-                        int operands_num_phi = instr->get_num_operand();
-                        if (operands_num_phi == 2) {
-                            auto value = instr->get_operand(0);
-                            instr->replace_all_use_with(cast_constantint(value));
-                            del_inst.push_back(instr);
-                        }
-                    }
-                }
-                for(auto instr : del_inst) each_succ_bb->erase_instr(instr);
-                clear_blocks_recs(each_succ_bb);
+    }
+    // the destructor of br unlinks bb from both successors
+    bb->erase_instr(br);
+    BranchInst::create_br(taken, bb);
+}
+
+void ConstPropagation::remove_dead_blocks(FuncState &state, Function *func) {
+    std::vector<BasicBlock *> dead_bbs;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not state.executable_bbs.count(&bb))
+            dead_bbs.push_back(&bb);
+    }
+    // values of dead blocks can only reach live code through phis on edges
+    // leaving them
+    for (auto bb : dead_bbs) {
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (not state.executable_bbs.count(succ))
+                continue;
+            for (auto &instr : succ->get_instructions()) {
+                if (not instr.is_phi())
+                    break;
+                instr.as<PhiInst>()->remove_incoming(bb);
             }
         }
     }
+    for (auto bb : dead_bbs) {
+        for (auto &instr : bb->get_instructions())
+            instr.remove_all_operands();
+    }
+    for (auto bb : dead_bbs) {
+        func->remove(bb);
+        delete bb;
+    }
+    add_stat("blocks removed", dead_bbs.size());
 }
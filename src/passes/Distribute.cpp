@@ -0,0 +1,295 @@
+#include "Distribute.hpp"
+#include "BinaryIR.hpp"
+#include "FuncInfo.hpp"
+#include "PassManager.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+namespace {
+
+// the passes that look at more than one function
+const std::vector<std::string> interprocedural = {"inline", "func-inline",
+                                                  "globalopt"};
+
+void put_word(std::string &out, std::uint32_t word) {
+    out.append(reinterpret_cast<const char *>(&word), sizeof(word));
+}
+
+bool get_word(const std::string &in, std::size_t &pos, std::uint32_t &word) {
+    if (in.size() - pos < sizeof(word))
+        return false;
+    std::memcpy(&word, in.data() + pos, sizeof(word));
+    pos += sizeof(word);
+    return true;
+}
+
+// send() does not raise SIGPIPE when the worker is gone, but the worker's
+// stdout may be a pipe
+bool write_all(int fd, const char *data, std::size_t size, bool is_socket) {
+    while (size > 0) {
+        auto n = is_socket ? send(fd, data, size, MSG_NOSIGNAL)
+                           : write(fd, data, size);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool read_all(int fd, char *data, std::size_t size) {
+    while (size > 0) {
+        auto n = read(fd, data, size);
+        if (n <= 0)
+            return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool send_message(int fd, const std::string &message, bool is_socket) {
+    std::string length;
+    put_word(length, message.size());
+    return write_all(fd, length.data(), length.size(), is_socket) and
+           write_all(fd, message.data(), message.size(), is_socket);
+}
+
+bool receive_message(int fd, std::string &message) {
+    std::uint32_t length;
+    if (not read_all(fd, reinterpret_cast<char *>(&length), sizeof(length)))
+        return false;
+    message.resize(length);
+    return read_all(fd, message.data(), length);
+}
+
+// a reply with a body that reads back, a broken one of a worker counts as
+// the worker failing
+bool is_body(const std::string &reply) {
+    if (reply.empty() or reply[0] != 'o')
+        return false;
+    BinaryIRReader reader(reply.data() + 1, reply.size() - 1);
+    auto m = reader.read_module();
+    return m and reader.materialize_all();
+}
+
+} // namespace
+
+Distributor::Distributor(unsigned num_workers) : num_workers_(num_workers) {}
+
+Distributor::~Distributor() {
+    // a worker ends with its stdin
+    for (auto &worker : workers_) {
+        if (worker.fd >= 0)
+            close(worker.fd);
+        waitpid(worker.pid, nullptr, 0);
+    }
+}
+
+Distributor::Pipeline Distributor::split_pipeline(const std::string &text) {
+    auto [head, rest] = PassManager::split_pipeline(text, "ipcp");
+    auto [module, functions] =
+        PassManager::split_pipeline_after(head, interprocedural);
+    return {module, functions, rest};
+}
+
+void Distributor::start_workers(unsigned num_workers,
+                                const std::string &pipeline) {
+    std::vector<std::string> args = {"cminusfc", "--worker"};
+    std::string path = "/proc/self/exe";
+    auto command = std::getenv("CMINUSF_WORKER");
+    if (command and *command) {
+        args = {"sh", "-c", command};
+        path = "/bin/sh";
+    }
+    std::vector<char *> argv;
+    for (auto &arg : args)
+        argv.push_back(arg.data());
+    argv.push_back(nullptr);
+
+    for (unsigned i = 0; i < num_workers; i++) {
+        // close-on-exec, so that no worker holds the socket of another one
+        // open; dup2 clears the flag for stdin and stdout
+        int fds[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+            return;
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+        posix_spawn_file_actions_adddup2(&actions, fds[1], STDOUT_FILENO);
+        pid_t pid;
+        int error = posix_spawn(&pid, path.c_str(), &actions, nullptr,
+                                argv.data(), environ);
+        posix_spawn_file_actions_destroy(&actions);
+        close(fds[1]);
+        if (error != 0) {
+            close(fds[0]);
+            return;
+        }
+        workers_.push_back({pid, fds[0]});
+        if (not send_message(fds[0], pipeline, true)) {
+            close(fds[0]);
+            workers_.back().fd = -1;
+        }
+    }
+}
+
+void Distributor::run(Module *m, const std::string &pipeline) {
+    trace::Scope scope("distribute");
+    std::vector<Function *> funcs;
+    for (auto &func : m->get_functions()) {
+        if (not func.is_declaration())
+            funcs.push_back(&func);
+    }
+    num_functions_ = funcs.size();
+    if (funcs.empty() or pipeline.empty())
+        return;
+
+    // the effects of the callees, taken before any body changes
+    FuncInfo func_info(m);
+    func_info.run();
+    std::vector<std::string> jobs;
+    for (auto func : funcs) {
+        std::vector<Function *> callees;
+        std::unordered_set<Function *> seen;
+        for (auto &bb : func->get_basic_blocks())
+            for (auto &instr : bb.get_instructions())
+                if (instr.is_call()) {
+                    auto callee = instr.get_operand(0)->as<Function>();
+                    if (seen.insert(callee).second)
+                        callees.push_back(callee);
+                }
+        std::string job;
+        put_word(job, callees.size());
+        for (auto callee : callees) {
+            put_word(job, func_info.get_effect(callee));
+            put_word(job, callee->get_name().size());
+            job += callee->get_name();
+        }
+        std::ostringstream body;
+        write_binary_ir(m, body, func);
+        jobs.push_back(job + body.str());
+    }
+
+    if (workers_.empty())
+        start_workers(std::min<std::size_t>(num_workers_, jobs.size()),
+                      pipeline);
+    std::vector<std::string> replies(jobs.size());
+    std::atomic<std::size_t> next{0};
+    std::atomic<unsigned> num_remote{0};
+    // one thread per worker takes the next job until none is left
+    auto work = [&](Worker *worker) {
+        for (std::size_t i; (i = next++) < jobs.size();) {
+            if (worker and worker->fd >= 0) {
+                auto &reply = replies[i];
+                if (send_message(worker->fd, jobs[i], true) and
+                    receive_message(worker->fd, reply) and is_body(reply)) {
+                    num_remote++;
+                    continue;
+                }
+                close(worker->fd);
+                worker->fd = -1;
+            }
+            replies[i] = compile_job(pipeline, jobs[i]);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (auto &worker : workers_)
+        threads.emplace_back(work, &worker);
+    if (workers_.empty())
+        work(nullptr);
+    for (auto &thread : threads)
+        thread.join();
+    num_remote_ = num_remote;
+
+    // in module order, as the function cache puts its bodies in place
+    for (std::size_t i = 0; i < funcs.size(); i++) {
+        auto &reply = replies[i];
+        // a body the passes of the coordinator could not compile either
+        // stays as it is
+        if (reply.empty() or reply[0] != 'o')
+            continue;
+        BinaryIRReader reader(reply.data() + 1, reply.size() - 1);
+        if (not reader.read_into(m) or reader.is_materialized(funcs[i]))
+            continue;
+        funcs[i]->drop_body();
+        // the same checks as in is_body() or on a body of the coordinator
+        reader.materialize(funcs[i]);
+    }
+}
+
+std::string Distributor::compile_job(const std::string &pipeline,
+                                     const std::string &job) {
+    std::size_t pos = 0;
+    std::uint32_t num_callees;
+    std::unordered_map<std::string, std::uint32_t> effects;
+    if (not get_word(job, pos, num_callees))
+        return "ebad job";
+    for (std::uint32_t i = 0; i < num_callees; i++) {
+        std::uint32_t effect, length;
+        if (not get_word(job, pos, effect) or not get_word(job, pos, length) or
+            job.size() - pos < length)
+            return "ebad job";
+        effects[job.substr(pos, length)] = effect;
+        pos += length;
+    }
+
+    BinaryIRReader reader(job.data() + pos, job.size() - pos);
+    auto m = reader.read_module();
+    if (m == nullptr or not reader.materialize_all())
+        return "eno binary ir of this compiler";
+    Function *body = nullptr;
+    for (auto &func : m->get_functions()) {
+        if (not func.is_declaration()) {
+            body = &func;
+            continue;
+        }
+        auto it = effects.find(func.get_name());
+        if (it != effects.end())
+            func.set_effect_summary(it->second);
+    }
+    if (body == nullptr)
+        return "eno function body";
+
+    PassManager pm(m.get());
+    auto error = pm.add_pipeline(pipeline);
+    if (not error.empty())
+        return "ebad pipeline: " + error;
+    pm.run();
+    std::ostringstream reply;
+    reply << 'o';
+    write_binary_ir(m.get(), reply, body);
+    return reply.str();
+}
+
+int Distributor::serve_worker() {
+    // the replies go to the real stdout, anything the passes print to
+    // std::cout to stderr
+    int out = dup(STDOUT_FILENO);
+    if (out < 0 or dup2(STDERR_FILENO, STDOUT_FILENO) < 0)
+        return 1;
+    std::string pipeline, job;
+    if (not receive_message(STDIN_FILENO, pipeline))
+        return 1;
+    while (receive_message(STDIN_FILENO, job)) {
+        if (not send_message(out, compile_job(pipeline, job), false))
+            return 1;
+    }
+    return 0;
+}
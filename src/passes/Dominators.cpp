@@ -1,146 +1,229 @@
 #include "Dominators.hpp"
 #include "Function.hpp"
+#include "IRprinter.hpp"
+#include <algorithm>
 #include <fstream>
 #include <vector>
 
-void Dominators::run() {
-    for(auto &f1 : m_->get_functions()) {
-        auto f = &f1;
-        if(f->is_declaration())
-            continue;
-        run_on_func(f);
+void Dominators::prepare() {
+    // all entries exist before the functions are handled concurrently, so
+    // run_on_func only looks them up
+    trees_.clear();
+    for (auto &f : m_->get_functions()) {
+        if (not f.is_declaration())
+            trees_[&f];
     }
 }
 
 void Dominators::run_on_func(Function *f) {
-    dom_post_order_.clear();
-    dom_dfs_order_.clear();
-    for(auto &bb1 : f->get_basic_blocks()) {
-        auto bb = &bb1;
-        idom_.insert({bb, nullptr});
-        dom_frontier_.insert({bb, {}});
-        dom_tree_succ_blocks_.insert({bb, {}});
-    }
-    create_reverse_post_order(f);
-    create_idom(f);
-    create_dominance_frontier(f);
-    create_dom_tree_succ(f);
-    create_dom_dfs_order(f);
+    auto n = f->renumber_basic_blocks();
+    auto it = trees_.find(f);
+    auto &tree = it != trees_.end() ? it->second : trees_[f];
+    tree = DomTree();
+    tree.blocks_.reserve(n);
+    for (auto &bb : f->get_basic_blocks())
+        tree.blocks_.push_back(&bb);
+    tree.post_order_.assign(n, NONE);
+    tree.idom_.assign(n, NONE);
+    tree.dom_frontier_.resize(n);
+    tree.dom_tree_succ_blocks_.resize(n);
+    tree.dom_tree_L_.assign(n, 0);
+    tree.dom_tree_R_.assign(n, 0);
+    tree.dfs_parent_.assign(n, NONE);
+    dfs(tree);
+    if (algo_ == Algorithm::SemiNCA)
+        create_idom_semi_nca(tree);
+    else
+        create_idom(tree);
+    create_dominance_frontier(tree);
+    create_dom_tree_succ(tree);
+    create_dom_dfs_order(tree);
 }
 
-BasicBlock *Dominators::intersect(BasicBlock *b1, BasicBlock *b2) {
+unsigned Dominators::intersect(const DomTree &tree, unsigned b1, unsigned b2) {
     while (b1 != b2) {
-        while (get_post_order(b1) < get_post_order(b2)) {
-            b1 = get_idom(b1);
+        while (tree.post_order_[b1] < tree.post_order_[b2]) {
+            b1 = tree.idom_[b1];
         }
-        while (get_post_order(b2) < get_post_order(b1)) {
-            b2 = get_idom(b2);
+        while (tree.post_order_[b2] < tree.post_order_[b1]) {
+            b2 = tree.idom_[b2];
         }
     }
     return b1;
 }
 
-void Dominators::create_reverse_post_order(Function *f) {
-    BBSet visited;
-    dfs(f->get_entry_block(), visited);
-}
-
-void Dominators::dfs(BasicBlock *bb, std::set<BasicBlock *> &visited) {
-    visited.insert(bb);
-    for (auto &succ : bb->get_succ_basic_blocks()) {
-        if (visited.find(succ) == visited.end()) {
-            dfs(succ, visited);
+void Dominators::dfs(DomTree &tree) {
+    // iterative, deep CFGs would overflow the call stack; the entry block
+    // always gets index 0
+    using SuccIter = BasicBlock::BlockList::iterator;
+    std::vector<std::pair<unsigned, SuccIter>> stack;
+    auto visit = [&](unsigned bb, unsigned parent) {
+        // mark as visited, the real number is assigned after the successors
+        tree.post_order_[bb] = 0;
+        tree.dfs_parent_[bb] = parent;
+        tree.pre_order_vec_.push_back(bb);
+        stack.emplace_back(bb,
+                           tree.blocks_[bb]->get_succ_basic_blocks().begin());
+    };
+    visit(0, NONE);
+    while (not stack.empty()) {
+        auto &[bb, it] = stack.back();
+        if (it != tree.blocks_[bb]->get_succ_basic_blocks().end()) {
+            auto succ = (*it++)->get_index();
+            if (tree.post_order_[succ] == NONE)
+                visit(succ, bb);
+            continue;
         }
+        tree.post_order_[bb] = tree.post_order_vec_.size();
+        tree.post_order_vec_.push_back(bb);
+        stack.pop_back();
     }
-    post_order_vec_.push_back(bb);
-    post_order_.insert({bb, post_order_.size()});
 }
 
-void Dominators::create_idom(Function *f) {
+void Dominators::create_idom(DomTree &tree) {
     // 分析得到 f 中各个基本块的 idom
-    idom_[f->get_entry_block()] = f->get_entry_block();
+    tree.idom_[0] = 0;
     bool changed;
     do {
         changed = false;
-        for (auto it = post_order_vec_.rbegin(); it != post_order_vec_.rend();
-             it++) {
+        for (auto it = tree.post_order_vec_.rbegin();
+             it != tree.post_order_vec_.rend(); it++) {
             auto bb = *it;
-            if (bb == f->get_entry_block())
-                continue;
-            if (bb->get_pre_basic_blocks().empty())
+            if (bb == 0)
                 continue;
-            BasicBlock *first_pred = bb->get_pre_basic_blocks().front();
-            BasicBlock *new_idom = first_pred;
-            for (auto &pred : bb->get_pre_basic_blocks()) {
-                if (pred == first_pred)
+            // intersect the processed predecessors, unreachable ones and
+            // those not visited yet in this round have no idom
+            unsigned new_idom = NONE;
+            for (auto &pred : tree.blocks_[bb]->get_pre_basic_blocks()) {
+                auto p = pred->get_index();
+                if (tree.idom_[p] == NONE)
                     continue;
-                if (get_idom(pred) != nullptr) {
-                    new_idom = intersect(pred, new_idom);
-                }
+                new_idom = new_idom == NONE ? p : intersect(tree, p, new_idom);
             }
-            if (new_idom != get_idom(bb)) {
+            if (new_idom != tree.idom_[bb]) {
                 changed = true;
-                idom_[bb] = new_idom;
+                tree.idom_[bb] = new_idom;
             }
         }
     } while (changed);
 }
 
-void Dominators::create_dominance_frontier(Function *f) {
+void Dominators::create_idom_semi_nca(DomTree &tree) {
+    // Semi-NCA: compute semidominators like Lengauer-Tarjan, then get each
+    // idom as the nearest common ancestor of its dfs parent and its sdom.
+    // Everything below is in dfs preorder numbers.
+    auto &vertex = tree.pre_order_vec_;
+    unsigned n = vertex.size();
+    std::vector<unsigned> pre(tree.blocks_.size(), NONE);
+    for (unsigned i = 0; i < n; i++)
+        pre[vertex[i]] = i;
+    std::vector<unsigned> parent(n), semi(n), label(n), idom(n);
+    std::vector<unsigned> ancestor(n, NONE);
+    for (unsigned i = 0; i < n; i++) {
+        parent[i] = i == 0 ? NONE : pre[tree.dfs_parent_[vertex[i]]];
+        semi[i] = label[i] = i;
+    }
+
+    // min semi on the path from v to its forest root, with path compression
+    std::vector<unsigned> path;
+    auto eval = [&](unsigned v) {
+        if (ancestor[v] == NONE)
+            return v;
+        for (auto x = v; ancestor[ancestor[x]] != NONE; x = ancestor[x])
+            path.push_back(x);
+        while (not path.empty()) {
+            auto x = path.back();
+            path.pop_back();
+            auto a = ancestor[x];
+            if (semi[label[a]] < semi[label[x]])
+                label[x] = label[a];
+            ancestor[x] = ancestor[a];
+        }
+        return label[v];
+    };
+
+    for (unsigned w = n - 1; w > 0; w--) {
+        for (auto &pred : tree.blocks_[vertex[w]]->get_pre_basic_blocks()) {
+            auto v = pre[pred->get_index()];
+            if (v == NONE) // unreachable
+                continue;
+            semi[w] = std::min(semi[w], semi[eval(v)]);
+        }
+        ancestor[w] = parent[w];
+    }
+
+    idom[0] = 0;
+    for (unsigned w = 1; w < n; w++) {
+        idom[w] = parent[w];
+        while (idom[w] > semi[w])
+            idom[w] = idom[idom[w]];
+    }
+    for (unsigned w = 0; w < n; w++)
+        tree.idom_[vertex[w]] = vertex[idom[w]];
+}
+
+void Dominators::create_dominance_frontier(DomTree &tree) {
     // 分析得到 f 中各个基本块的支配边界集合
-    for (auto &bb1 : f->get_basic_blocks()) {
-        auto bb = &bb1;
-        if (bb->get_pre_basic_blocks().size() >= 2) {
-            for (auto &pred : bb->get_pre_basic_blocks()) {
-                auto runner = pred;
-                while (runner != get_idom(bb)) {
-                    dom_frontier_[runner].insert(bb);
-                    runner = get_idom(runner);
-                }
+    // blocks are visited in index order, so every frontier list comes out
+    // sorted and a repeated block can only be at its back
+    for (unsigned bb = 0; bb < tree.blocks_.size(); bb++) {
+        auto &preds = tree.blocks_[bb]->get_pre_basic_blocks();
+        if (preds.size() < 2 or tree.idom_[bb] == NONE)
+            continue;
+        for (auto &pred : preds) {
+            auto runner = pred->get_index();
+            if (tree.idom_[runner] == NONE)
+                continue;
+            while (runner != tree.idom_[bb]) {
+                auto &df = tree.dom_frontier_[runner];
+                if (df.empty() or df.back() != tree.blocks_[bb])
+                    df.push_back(tree.blocks_[bb]);
+                runner = tree.idom_[runner];
             }
         }
     }
-
 }
 
-void Dominators::create_dom_tree_succ(Function *f) {
+void Dominators::create_dom_tree_succ(DomTree &tree) {
     // 分析得到 f 中各个基本块的支配树后继
-    for (auto &bb1 : f->get_basic_blocks()) {
-        auto bb = &bb1;
-        if (get_idom(bb) != nullptr && get_idom(bb) != bb) {
-            dom_tree_succ_blocks_[get_idom(bb)].insert(bb);
+    for (unsigned bb = 0; bb < tree.blocks_.size(); bb++) {
+        auto idom = tree.idom_[bb];
+        if (idom != NONE && idom != bb) {
+            tree.dom_tree_succ_blocks_[idom].push_back(tree.blocks_[bb]);
         }
     }
 }
 
-void Dominators::create_dom_dfs_order(Function *f) {
+void Dominators::create_dom_dfs_order(DomTree &tree) {
     // 分析得到 f 中各个基本块的支配树上的dfs序L,R
     unsigned int order = 0;
-    std::function<void(BasicBlock *)> dfs = [&](BasicBlock *bb) {
-        dom_tree_L_[bb] = ++ order;
-        dom_dfs_order_.push_back(bb);
-        for (auto &succ : dom_tree_succ_blocks_[bb]) {
-            dfs(succ);
-        }
-        dom_tree_R_[bb] = order;
+    // (block, next child to visit)
+    std::vector<std::pair<unsigned, unsigned>> stack;
+    auto visit = [&](unsigned bb) {
+        tree.dom_tree_L_[bb] = ++order;
+        tree.dom_dfs_order_.push_back(tree.blocks_[bb]);
+        stack.emplace_back(bb, 0);
     };
-    dfs(f->get_entry_block());
-    dom_post_order_ =
-        std::vector(dom_dfs_order_.rbegin(), dom_dfs_order_.rend());
+    visit(0);
+    while (not stack.empty()) {
+        auto &[bb, child] = stack.back();
+        auto &succs = tree.dom_tree_succ_blocks_[bb];
+        if (child < succs.size()) {
+            visit(succs[child++]->get_index());
+            continue;
+        }
+        tree.dom_tree_R_[bb] = order;
+        stack.pop_back();
+    }
+    tree.dom_post_order_ = std::vector(tree.dom_dfs_order_.rbegin(),
+                                       tree.dom_dfs_order_.rend());
 }
 
 void Dominators::print_idom(Function *f) {
-    f->get_parent()->set_print_name();
-    int counter = 0;
+    SlotTracker slot_tracker(f);
     std::map<BasicBlock *, std::string> bb_id;
-    for (auto &bb1 : f->get_basic_blocks()) {
-        auto bb = &bb1;
-        if (bb->get_name().empty())
-            bb_id[bb] = "bb" + std::to_string(counter);
-        else
-            bb_id[bb] = bb->get_name();
-        counter++;
-    }
+    for (auto &bb : f->get_basic_blocks())
+        bb_id[&bb] = slot_tracker.get_name(&bb);
     printf("Immediate dominance of function %s:\n", f->get_name().c_str());
     for (auto &bb1 : f->get_basic_blocks()) {
         auto bb = &bb1;
@@ -156,17 +239,10 @@ void Dominators::print_idom(Function *f) {
 }
 
 void Dominators::print_dominance_frontier(Function *f) {
-    f->get_parent()->set_print_name();
-    int counter = 0;
+    SlotTracker slot_tracker(f);
     std::map<BasicBlock *, std::string> bb_id;
-    for (auto &bb1 : f->get_basic_blocks()) {
-        auto bb = &bb1;
-        if (bb->get_name().empty())
-            bb_id[bb] = "bb" + std::to_string(counter);
-        else
-            bb_id[bb] = bb->get_name();
-        counter++;
-    }
+    for (auto &bb : f->get_basic_blocks())
+        bb_id[&bb] = slot_tracker.get_name(&bb);
     printf("Dominance Frontier of function %s:\n", f->get_name().c_str());
     for (auto &bb1 : f->get_basic_blocks()) {
         auto bb = &bb1;
@@ -191,9 +267,9 @@ void Dominators::print_dominance_frontier(Function *f) {
 
 void Dominators::dump_cfg(Function *f)
 {
-    f->get_parent()->set_print_name();
     if(f->is_declaration())
         return;
+    SlotTracker slot_tracker(f);
     std::vector<std::string> edge_set;
     bool has_edges = false;
     for (auto &bb : f->get_basic_blocks()) {
@@ -201,14 +277,14 @@ void Dominators::dump_cfg(Function *f)
         if(!succ_blocks.empty())
             has_edges = true;
         for (auto succ : succ_blocks) {
-            edge_set.push_back('\t' + bb.get_name() + "->" + succ->get_name() + ";\n");
+            edge_set.push_back('\t' + slot_tracker.get_name(&bb) + "->" + slot_tracker.get_name(succ) + ";\n");
         }
     }
     std::string digraph = "digraph G {\n";
     if (!has_edges && !f->get_basic_blocks().empty()) {
         // 如果没有边且至少有一个基本块，添加一个自环以显示唯一的基本块
         auto &bb = f->get_basic_blocks().front();
-        digraph += '\t' + bb.get_name() + ";\n";
+        digraph += '\t' + slot_tracker.get_name(&bb) + ";\n";
     } else {
         for (auto &edge : edge_set) {
             digraph += edge;
@@ -225,16 +301,17 @@ void Dominators::dump_cfg(Function *f)
 
 void Dominators::dump_dominator_tree(Function *f)
 {
-    f->get_parent()->set_print_name();
     if(f->is_declaration())
         return;
+    SlotTracker slot_tracker(f);
 
     std::vector<std::string> edge_set;
     bool has_edges = false; // 用于检查是否有边存在
 
     for (auto &b : f->get_basic_blocks()) {
-        if (idom_.find(&b) != idom_.end() && idom_[&b] != &b) {
-            edge_set.push_back('\t' + idom_[&b]->get_name() + "->" + b.get_name() + ";\n");
+        auto idom = get_idom(&b);
+        if (idom && idom != &b) {
+            edge_set.push_back('\t' + slot_tracker.get_name(idom) + "->" + slot_tracker.get_name(&b) + ";\n");
             has_edges = true; // 如果存在支配边，标记为 true
         }
     }
@@ -244,7 +321,7 @@ void Dominators::dump_dominator_tree(Function *f)
     if (!has_edges && !f->get_basic_blocks().empty()) {
         // 如果没有边且至少有一个基本块，直接添加该块以显示它
         auto &b = f->get_basic_blocks().front();
-        digraph += '\t' + b.get_name() + ";\n";
+        digraph += '\t' + slot_tracker.get_name(&b) + ";\n";
     } else {
         for (auto &edge : edge_set) {
             digraph += edge;
@@ -1,102 +1,100 @@
 #include "FuncInfo.hpp"
+#include "CallGraph.hpp"
 #include "Function.hpp"
 
+#include <algorithm>
+
+namespace {
+const char *effect_names[] = {"readnone", "readonly", "argmemonly", "any"};
+} // namespace
+
 void FuncInfo::run() {
+    auto call_graph = get_analysis<CallGraph>();
+    std::unordered_map<Function *, MemEffect> local_effects;
     for (auto &f : m_->get_functions()) {
-        auto func = &f;
-        trivial_mark(func);
-        if (not is_pure[func])
-            worklist.push_back(func);
+        local_effects[&f] = get_local_effect(&f);
+        effects_[&f] = local_effects[&f];
     }
-    while (worklist.empty() == false) {
-        auto now = worklist.front();
-        worklist.pop_front();
-        process(now);
+    // 被调用者所在的分量已经处理完毕，分量内部从局部影响出发迭代
+    for (auto &scc : call_graph->get_sccs()) {
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto func : scc) {
+                auto effect = local_effects[func];
+                for (auto call : call_graph->get_call_sites(func))
+                    effect = std::max(effect, get_inst_effect(call));
+                if (effect != effects_[func]) {
+                    effects_[func] = effect;
+                    changed = true;
+                }
+            }
+        }
     }
     log();
 }
 
 void FuncInfo::log() {
-    for (auto it : is_pure) {
-        LOG_INFO << it.first->get_name() << " is pure? " << it.second;
+    // in module order, not that of the map
+    for (auto &func : m_->get_functions()) {
+        LOG_INFO << func.get_name() << " is "
+                 << effect_names[effects_.at(&func)];
     }
 }
 
-// 有 store 操作的函数非纯函数来处理
-void FuncInfo::trivial_mark(Function *func) {
-    if (func->is_declaration() or func->get_name() == "main") {
-        is_pure[func] = false;
-        return;
-    }
-    // 只要传入数组，都作为非纯函数处理
-    for (auto it = func->get_function_type()->param_begin();
-         it != func->get_function_type()->param_end(); ++it) {
-        auto arg_type = *it;
-        if (arg_type->is_integer_type() == false and
-            arg_type->is_float_type() == false) {
-            is_pure[func] = false;
-            return;
-        }
-    }
+// 调用的影响在 run 中按调用图传播，这里只看 load 与 store
+FuncInfo::MemEffect FuncInfo::get_local_effect(Function *func) {
+    if (func->is_declaration() and func->get_effect_summary() >= 0)
+        return static_cast<MemEffect>(func->get_effect_summary());
+    if (func->is_declaration() or func->get_name() == "main")
+        return Any;
+    MemEffect effect = ReadNone;
     for (auto &bb : func->get_basic_blocks())
-        for (auto &inst : bb.get_instructions()) {
-            if (is_side_effect_inst(&inst)) {
-                is_pure[func] = false;
-                return;
-            }
-        }
-    is_pure[func] = true;
+        for (auto &inst : bb.get_instructions())
+            if (not inst.is_call())
+                effect = std::max(effect, get_inst_effect(&inst));
+    return effect;
 }
 
-void FuncInfo::process(Function *func) {
-    for (auto &use : func->get_use_list()) {
-        LOG_INFO << use.val_->print() << " uses func: " << func->get_name();
-        if (auto inst = dynamic_cast<Instruction *>(use.val_)) {
-            auto func = (inst->get_parent()->get_parent());
-            if (is_pure[func]) {
-                is_pure[func] = false;
-                worklist.push_back(func);
-            }
-        } else
-            LOG_WARNING << "Value besides instruction uses a function";
-    }
-}
-
-// 对局部变量进行 store 没有副作用
-bool FuncInfo::is_side_effect_inst(Instruction *inst) {
-    if (inst->is_store()) {
-        if (is_local_store(dynamic_cast<StoreInst *>(inst)))
-            return false;
-        return true;
-    }
+// 对局部变量的读写没有副作用
+FuncInfo::MemEffect FuncInfo::get_inst_effect(Instruction *inst) {
+    if (inst->is_store())
+        return get_store_effect(inst->as<StoreInst>()->get_lval());
     if (inst->is_load()) {
-        if (is_local_load(dynamic_cast<LoadInst *>(inst)))
-            return false;
-        return true;
+        auto addr = get_first_addr(inst->get_operand(0));
+        return addr->is<AllocaInst>() ? ReadNone : ReadOnly;
+    }
+    if (inst->is_call()) {
+        auto callee = inst->get_operand(0)->as<Function>();
+        auto effect = effects_.at(callee);
+        if (effect != ArgMemOnly)
+            return effect;
+        // the callee writes what the arguments point to, and may read
+        effect = ReadOnly;
+        for (unsigned i = 1; i < inst->get_num_operand(); i++) {
+            auto arg = inst->get_operand(i);
+            if (arg->get_type()->is_pointer_type())
+                effect = std::max(effect, get_store_effect(arg));
+        }
+        return effect;
     }
-    // call 指令的副作用会在后续 bfs 中计算
-    return false;
+    return ReadNone;
 }
 
-bool FuncInfo::is_local_load(LoadInst *inst) {
-    auto addr =
-        dynamic_cast<Instruction *>(get_first_addr(inst->get_operand(0)));
-    if (addr and addr->is_alloca())
-        return true;
-    return false;
+FuncInfo::MemEffect FuncInfo::get_store_effect(Value *ptr) {
+    auto addr = get_first_addr(ptr);
+    if (addr->is<AllocaInst>())
+        return ReadNone;
+    if (addr->is<Argument>())
+        return ArgMemOnly;
+    return Any;
 }
 
-bool FuncInfo::is_local_store(StoreInst *inst) {
-    auto addr = dynamic_cast<Instruction *>(get_first_addr(inst->get_lval()));
-    if (addr and addr->is_alloca())
-        return true;
-    return false;
-}
 Value *FuncInfo::get_first_addr(Value *val) {
-    if (auto inst = dynamic_cast<Instruction *>(val)) {
+    if (auto inst = val->dyn_cast<Instruction>()) {
         if (inst->is_alloca())
             return inst;
-        if (inst->is_gep())
+        if (inst->is_gep() or inst->is_bitcast())
             return get_first_addr(inst->get_operand(0));
         if (inst->is_load())
             return val;
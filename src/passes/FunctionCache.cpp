@@ -0,0 +1,170 @@
+#include "FunctionCache.hpp"
+#include "BinaryIR.hpp"
+#include "CallGraph.hpp"
+#include "GlobalVariable.hpp"
+#include "PassManager.hpp"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <llvm/Support/MemoryBuffer.h>
+#include <sstream>
+#include <unistd.h>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+bool refers_to_global(Function &func) {
+    for (auto &bb : func.get_basic_blocks())
+        for (auto &instr : bb.get_instructions())
+            for (auto op : instr.get_operands())
+                if (op->is<GlobalVariable>())
+                    return true;
+    return false;
+}
+
+} // namespace
+
+FunctionCache::FunctionCache(std::filesystem::path dir, std::string context)
+    : dir_(std::move(dir)), context_(std::move(context)) {}
+
+std::string FunctionCache::hash(const std::string &text) {
+    // FNV-1a, twice with different offsets for 128 bits
+    std::uint64_t hash[2] = {14695981039346656037ull, 7809847782465536322ull};
+    for (auto &h : hash) {
+        for (unsigned char c : text)
+            h = (h ^ c) * 1099511628211ull;
+    }
+    char hex[33];
+    std::snprintf(hex, sizeof(hex), "%016llx%016llx",
+                  static_cast<unsigned long long>(hash[0]),
+                  static_cast<unsigned long long>(hash[1]));
+    return hex;
+}
+
+void FunctionCache::write_entry(const std::filesystem::path &dir,
+                                const std::string &key,
+                                const std::string &data) {
+    static std::atomic<unsigned> num_written{0};
+    std::error_code ec;
+    std::filesystem::create_directories(dir, ec);
+    auto tmp = dir / (key + ".tmp." + std::to_string(getpid()) + "." +
+                      std::to_string(num_written++));
+    {
+        std::ofstream entry(tmp, std::ios::binary);
+        if (not(entry << data))
+            return;
+    }
+    std::filesystem::rename(tmp, dir / (key + ".lir"), ec);
+    if (ec)
+        std::filesystem::remove(tmp, ec);
+}
+
+std::filesystem::path
+FunctionCache::entry_path(const std::string &fingerprint) const {
+    return dir_ / ("fn-" + fingerprint + ".lir");
+}
+
+void FunctionCache::load(Module *m, PassManager &pm) {
+    trace::Scope scope("load-functions");
+    CallGraph call_graph(m);
+    call_graph.run();
+
+    // the hash of each function as printed, and its place in the module
+    std::unordered_map<Function *, std::string> hashes;
+    std::unordered_map<Function *, std::size_t> positions;
+    std::vector<Function *> global_users;
+    for (auto &func : m->get_functions()) {
+        std::ostringstream text;
+        func.print(text);
+        hashes[&func] = hash(text.str());
+        positions[&func] = positions.size();
+        if (refers_to_global(func))
+            global_users.push_back(&func);
+    }
+    // the functions called from roots directly or not and the roots, in
+    // module order
+    auto reach = [&](const std::vector<Function *> &roots) {
+        std::unordered_set<Function *> seen(roots.begin(), roots.end());
+        std::vector<Function *> result(roots.begin(), roots.end());
+        for (std::size_t i = 0; i < result.size(); i++)
+            for (auto callee : call_graph.get_callees(result[i]))
+                if (seen.insert(callee).second)
+                    result.push_back(callee);
+        std::sort(result.begin(), result.end(),
+                  [&](Function *a, Function *b) {
+                      return positions[a] < positions[b];
+                  });
+        return result;
+    };
+
+    std::ostringstream cluster_text;
+    for (auto &global : m->get_global_variable()) {
+        global.print(cluster_text);
+        cluster_text << '\n';
+    }
+    for (auto func : reach(global_users))
+        cluster_text << hashes[func] << '\n';
+    auto cluster = hash(cluster_text.str());
+    std::unordered_set<Function *> global_user_set(global_users.begin(),
+                                                   global_users.end());
+
+    std::vector<Function *> defs;
+    for (auto &func : m->get_functions()) {
+        if (func.is_declaration())
+            continue;
+        std::ostringstream key_text;
+        key_text << context_ << '\n' << hashes[&func] << '\n';
+        bool uses_globals = false;
+        for (auto callee : reach({&func})) {
+            key_text << hashes[callee] << '\n';
+            uses_globals |= global_user_set.count(callee) != 0;
+        }
+        if (uses_globals)
+            key_text << cluster << '\n';
+        fingerprints_[&func] = hash(key_text.str());
+        defs.push_back(&func);
+    }
+    num_functions_ = defs.size();
+
+    // all fingerprints first, they are taken on the bodies as built
+    for (auto func : defs) {
+        auto buffer = llvm::MemoryBuffer::getFile(
+            entry_path(fingerprints_[func]).string(), false, false);
+        if (not buffer)
+            continue;
+        auto data = (*buffer)->getBufferStart();
+        auto size = (*buffer)->getBufferSize();
+        // a broken or foreign entry is a miss, store() then overwrites it;
+        // the body is read back on its own first, before the one built is
+        // dropped
+        BinaryIRReader check(data, size);
+        auto scratch = check.read_module();
+        if (scratch == nullptr or not check.materialize_all())
+            continue;
+        BinaryIRReader reader(data, size);
+        if (not reader.read_into(m) or reader.is_materialized(func))
+            continue;
+        func->drop_body();
+        reader.materialize(func);
+        pm.freeze(func);
+        fingerprints_.erase(func);
+        num_hits_++;
+    }
+}
+
+void FunctionCache::store(Module *m) {
+    trace::Scope scope("store-functions");
+    for (auto &func : m->get_functions()) {
+        auto it = fingerprints_.find(&func);
+        if (it == fingerprints_.end())
+            continue;
+        std::ostringstream data;
+        write_binary_ir(m, data, &func);
+        write_entry(dir_, "fn-" + it->second, data.str());
+    }
+}
@@ -2,203 +2,226 @@
 #include "../../include/lightir/Function.hpp"
 
 #include "BasicBlock.hpp"
+#include "CallGraph.hpp"
+#include "Constant.hpp"
 #include "Instruction.hpp"
 #include "Value.hpp"
 #include "logging.hpp"
+#include <algorithm>
 #include <cassert>
+#include <map>
 #include <utility>
 #include <vector>
 
 void FunctionInline::run() { inline_all_functions(); }
 
-void FunctionInline::inline_all_functions() {
-    
-    std::set<Function *> recursive_func;
-    for (auto &func : m_->get_functions()) {
-        for (auto &bb : func.get_basic_blocks()) {
-            for (auto &inst : bb.get_instructions()) {
-                if (inst.is_call()) {
-                    auto call = &inst;
-                    auto func1 = static_cast<Function *>(call->get_operand(0));
-                    if (func1 == &func) {
-                        recursive_func.insert(func1);
-                        break;
-                    }
-                }
-            }
-        }
+unsigned FunctionInline::count_instructions(Function *func) {
+    auto it = func_size_.find(func);
+    if (it != func_size_.end())
+        return it->second;
+    unsigned size = 0;
+    for (auto &bb : func->get_basic_blocks())
+        size += bb.get_num_of_instr();
+    return func_size_[func] = size;
+}
+
+int FunctionInline::get_inline_cost(CallInst *call, Function *callee) {
+    int cost = count_instructions(callee);
+    for (unsigned i = 1; i < call->get_num_operand(); ++i) {
+        auto arg = call->get_operand(i);
+        if (arg->is<ConstantInt>() or arg->is<ConstantFP>())
+            cost -= const_arg_bonus;
     }
-    for (auto &func : m_->get_functions()) {
-        if (outside_func.find(func.get_name()) != outside_func.end()) {
-            continue;
-        }
-    a1:
-        for (auto &bb : func.get_basic_blocks()) {
-            for (auto &inst : bb.get_instructions()) {
-                if (inst.is_call()) {
-                    auto call = &inst;
-                    auto func1 = static_cast<Function *>(call->get_operand(0));
-                    if (func1 == &func) {
-                        continue;
-                    }
-                    if (recursive_func.find(func1) != recursive_func.end())
-                        continue;
-                    if (outside_func.find(func1->get_name()) !=
-                        outside_func.end())
-                        continue;
-                    if(func1->get_basic_blocks().size() >=6){
-                        continue;
-                    }
-                    inline_function(call, func1);
-                    goto a1;
-                }
+    return cost;
+}
+
+bool FunctionInline::is_hot(CallInst *call) const {
+    auto count = call->get_parent()->get_count();
+    return hot_count_ > 0 and count >= hot_count_;
+}
+
+void FunctionInline::inline_all_functions() {
+    auto call_graph = get_analysis<CallGraph>();
+    func_size_.clear();
+    long max_count = -1;
+    for (auto &func : m_->get_functions())
+        for (auto &bb : func.get_basic_blocks())
+            max_count = std::max(max_count, bb.get_count());
+    hot_count_ = max_count > 0 ? std::max(max_count / hot_call_divisor, 1l) : 0;
+    for (auto &scc : call_graph->get_sccs()) {
+        for (auto func : scc) {
+            if (skips(func) or
+                outside_func.find(func->get_name()) != outside_func.end())
+                continue;
+            // only calls of func itself change while func is processed, and
+            // calls copied in from callees were already considered there
+            auto call_sites = call_graph->get_call_sites(func);
+
+            auto size = count_instructions(func);
+            auto size_limit = size + caller_growth_budget;
+            auto hot_size_limit = size + hot_caller_growth_budget;
+            for (auto call : call_sites) {
+                auto callee = call->get_operand(0)->as<Function>();
+                if (callee->is_declaration() or
+                    call_graph->is_recursive(callee) or
+                    outside_func.find(callee->get_name()) != outside_func.end())
+                    continue;
+                auto callee_size = count_instructions(callee);
+                bool hot = is_hot(call);
+                if (get_inline_cost(call, callee) >
+                        (hot ? hot_inline_threshold : inline_threshold) or
+                    size + callee_size > (hot ? hot_size_limit : size_limit))
+                    continue;
+                inline_function(call, callee);
+                size += callee_size;
+                add_stat("call sites inlined");
+                if (hot)
+                    add_stat("hot call sites inlined");
             }
+            func_size_[func] = size;
         }
     }
 }
 
 void FunctionInline::inline_function(Instruction *call, Function *origin) {
+    auto call_bb = call->get_parent();
+    auto call_func = call_bb->get_parent();
+    auto module = call_func->get_parent();
+    auto entry = call_func->get_entry_block();
     std::map<Value *, Value *> v_map;
-    std::vector<BasicBlock *> bb_list;
-    std::vector<Instruction *> ret_list; // 记录函数所有出口
     for (auto &arg : origin->get_args()) {
         v_map.insert(std::make_pair(static_cast<Value *>(&arg),
                                     call->get_operand(arg.get_arg_no() + 1)));
     }
-    auto call_bb = call->get_parent();
-    auto call_func = call_bb->get_parent();
-    std::vector<BasicBlock *> ret_void_bbs;
+    auto map_value = [&](Value *val) {
+        auto it = v_map.find(val);
+        return it == v_map.end() ? val : it->second;
+    };
+
+    // the copies run as often as the blocks of origin scaled to this call,
+    // which origin's blocks no longer do
+    auto call_count = call_bb->get_count();
+    auto entry_count = origin->get_entry_block()->get_count();
+    auto scale = [&](long count) {
+        if (call_count < 0 or count < 0 or entry_count <= 0)
+            return -1l;
+        return static_cast<long>(static_cast<double>(count) *
+                                 std::min(call_count, entry_count) /
+                                 entry_count);
+    };
+
+    // 先建好所有基本块，分支和 phi 可以直接引用后面的块
+    std::vector<BasicBlock *> bb_list;
     for (auto &bb : origin->get_basic_blocks()) {
-        auto bb_new =
-            BasicBlock::create(call_func->get_parent(), "", call_func);
+        auto bb_new = BasicBlock::create(module, "", call_func);
         v_map.insert(std::make_pair(static_cast<Value *>(&bb),
                                     static_cast<Value *>(bb_new)));
         bb_list.push_back(bb_new);
+        auto count = scale(bb.get_count());
+        bb_new->set_count(count);
+        if (count >= 0)
+            bb.set_count(bb.get_count() - count);
+    }
+    // call 之后的指令放到 ret_bb，所有 ret 都跳转到这里
+    auto ret_bb = BasicBlock::create(module, "", call_func);
+    ret_bb->set_count(call_count);
+    std::vector<std::pair<Value *, BasicBlock *>> ret_list;
+    std::vector<Instruction *> inst_list;
+    auto bb_it = bb_list.begin();
+    for (auto &bb : origin->get_basic_blocks()) {
+        auto bb_new = *bb_it++;
         for (auto &inst : bb.get_instructions()) {
-            if (inst.is_ret() && origin->get_return_type()->is_void_type()) {
-                ret_void_bbs.push_back(bb_new);
+            Instruction *inst_new;
+            if (inst.is_ret()) {
+                if (inst.get_num_operand() > 0)
+                    ret_list.push_back({inst.get_operand(0), bb_new});
+                BranchInst::create_br(ret_bb, bb_new);
                 continue;
+            } else if (inst.is_br()) {
+                // the condition is fixed up with the other operands below
+                auto br = inst.as<BranchInst>();
+                if (br->is_cond_br())
+                    inst_new = BranchInst::create_cond_br(
+                        br->get_condition(),
+                        map_value(br->get_operand(1))->as<BasicBlock>(),
+                        map_value(br->get_operand(2))->as<BasicBlock>(),
+                        bb_new);
+                else
+                    inst_new = BranchInst::create_br(
+                        map_value(br->get_operand(0))->as<BasicBlock>(),
+                        bb_new);
+            } else if (inst.is_call()) {
+                auto func = inst.get_operand(0)->as<Function>();
+                inst_new = CallInst::create_call(
+                    func,
+                    {inst.get_operands().begin() + 1, inst.get_operands().end()},
+                    bb_new);
+            } else if (inst.is_alloca()) {
+                // keep the frame size fixed when the call sits in a loop
+                inst_new = inst.clone(bb_new);
+                bb_new->remove_instr(inst_new);
+                entry->add_instr_begin(inst_new);
+                inst_new->set_parent(entry);
+            } else {
+                inst_new = inst.clone(bb_new);
+                // phis are not inserted on creation, they come first in bb
+                if (inst.is_phi())
+                    bb_new->add_instruction(inst_new);
             }
-            if (inst.is_phi()) {
-                ;
-            }
-            
-            Instruction *inst_new ;
-            if (inst.is_call()) {
-                auto call = static_cast<CallInst *>(&inst);
-                auto func = static_cast<Function *>(call->get_operand(0));
-                // 
-                inst_new = new CallInst(func, {call->get_operands().begin() + 1, call->get_operands().end()}, bb_new);
-            }
-            else inst_new = inst.clone(bb_new);
-            // 
-            if (inst.is_phi())
-                bb_new->add_instr_begin(inst_new);
             v_map.insert(std::make_pair(static_cast<Value *>(&inst),
                                         static_cast<Value *>(inst_new)));
-            if (inst.is_ret()) {
-                ret_list.push_back(inst_new);
-            }
+            inst_list.push_back(inst_new);
         }
     }
-    for (auto bb : bb_list) {
-        for (auto &inst : bb->get_instructions()) {
-            for (int i = 0; i < inst.get_num_operand(); i++) {
-                if (inst.is_phi()) {
-                    ;
-                }
-                auto op = inst.get_operand(i);
-                if (v_map.find(op) != v_map.end()) {
-                    inst.set_operand(i, v_map[op]);
-                }
-            }
-        }
-    }
-    Value *ret_val = nullptr; // 返回值
-    bool is_terminated = false;
-    auto bb_new = BasicBlock::create(call_func->get_parent(), "", call_func);
-    if (!origin->get_return_type()->is_void_type()) {
-        // 
-        if (ret_list.size() == 1) {
-            auto ret = ret_list.front();
-            ret_val = ret->get_operand(0);
-            auto ret_bb = ret->get_parent();
-            ret_bb->remove_instr(ret);
-            BranchInst::create_br(bb_new, ret_bb);
-        } else {
-            // TODO: 处理多个返回值的情况
-            // 提示：
-            // 1. 需要创建一个新的基本块(bb_phi)用于存放phi指令
-            // 2. 对于每个返回指令：
-            //    - 记录其所在的基本块
-            //    - 移除返回指令
-            //    - 添加跳转到bb_phi的分支指令
-            // 3. 创建phi指令：
-            //    - 设置正确的返回类型
-            //    - 为每个返回路径添加phi对
-            // 4. 将phi指令添加到bb_phi
-            // 5. 设置返回值
-            // 6. 将bb_phi添加到基本块列表
-            // 7. 添加从bb_phi到bb_new的跳转
+    for (auto inst : inst_list) {
+        for (unsigned i = 0; i < inst->get_num_operand(); i++) {
+            auto op = inst->get_operand(i);
+            auto op_new = map_value(op);
+            if (op_new != op)
+                inst->set_operand(i, op_new);
         }
-    } else {
-        assert(ret_void_bbs.size() > 0);
-        for (auto bb : ret_void_bbs) {
-            BranchInst::create_br(bb_new, bb);
+        if (auto phi = inst->dyn_cast<PhiInst>()) {
+            for (unsigned i = 0; i < phi->get_num_incoming(); i++)
+                phi->set_incoming_block(
+                    i, map_value(phi->get_incoming_block(i))->as<BasicBlock>());
         }
     }
-    std::vector<Instruction *> del_list;
-    // 
-    // 
-    BranchInst* br = nullptr;
+
+    // split call_bb after the call
+    std::vector<Instruction *> move_list;
+    bool after_call = false;
     for (auto &inst : call_bb->get_instructions()) {
-    // 
-        if (!is_terminated) {
-            // 如果前一个基本块还没遇到这条跳转指令
-            if (&(inst) == call) {
-                
-                
-                br = BranchInst::create_br(bb_list.front(), call_bb);
-                // bb_1->add_instruction(br);
-                // call_bb->insert_before(&inst, br);
-                // inst.replace_all_use_with(br);
-                if (!origin->get_return_type()->is_void_type()) {
-                    // 
-                    // auto temp = call->get_use_list().begin();
-                    call->replace_all_use_with(ret_val);
-                    // 
-                    // 
+        if (after_call)
+            move_list.push_back(&inst);
+        else if (&inst == call)
+            after_call = true;
+    }
+    for (auto inst : move_list) {
+        call_bb->remove_instr(inst);
+        ret_bb->add_instruction(inst);
+        inst->set_parent(ret_bb);
+    }
+    ret_bb->take_succ_basic_blocks(call_bb);
 
-                }
-                // call_bb->remove_instr(call);
-                // del_list.push_back(call);
-                is_terminated = true;
-            }
+    if (not origin->get_return_type()->is_void_type()) {
+        Value *ret_val;
+        if (ret_list.size() == 1) {
+            ret_val = map_value(ret_list.front().first);
         } else {
-            // call_bb->remove_instr(&inst);
-            if(dynamic_cast<BranchInst*>(&inst) == br){
-                continue;
+            // 多个返回点，用 phi 合并返回值
+            std::vector<Value *> vals;
+            std::vector<BasicBlock *> val_bbs;
+            for (auto [val, bb] : ret_list) {
+                vals.push_back(map_value(val));
+                val_bbs.push_back(bb);
             }
-            del_list.push_back(&inst);
+            auto phi = PhiInst::create_phi(origin->get_return_type(), ret_bb,
+                                           vals, val_bbs);
+            ret_bb->add_instr_begin(phi);
+            ret_val = phi;
         }
+        call->replace_all_use_with(ret_val);
     }
-    // 
-    call_bb->remove_instr(call);
-    origin->remove_use(call, 0);
-    // 
-    for (auto inst : del_list) {
-        
-        call_bb->remove_instr(inst);
-        bb_new->add_instruction(inst);
-        inst->set_parent(bb_new);
-    }
-
-    // 
-    // br->set_parent(call_bb);
-    // 
-    origin->reset_bbs();
-    // 
-    call_func->reset_bbs();
-    
-    return;
-}
\ No newline at end of file
+    call_bb->erase_instr(call);
+    BranchInst::create_br(bb_list.front(), call_bb);
+}
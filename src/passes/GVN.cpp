@@ -0,0 +1,126 @@
+#include "GVN.hpp"
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <functional>
+
+std::size_t GVN::ExpressionHash::operator()(const Expression &expr) const {
+    auto combine = [](std::size_t seed, std::size_t h) {
+        return seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2));
+    };
+    std::size_t seed = std::hash<unsigned>()(expr.op);
+    seed = combine(seed, std::hash<Type *>()(expr.type));
+    for (auto op : expr.operands)
+        seed = combine(seed, std::hash<Value *>()(op));
+    return seed;
+}
+
+void GVN::run() {
+    dominators_ = get_analysis<Dominators>();
+    func_info_ = get_analysis<FuncInfo>();
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        run_on_func(&func);
+    }
+}
+
+bool GVN::get_expression(Instruction *instr, Expression *expr) {
+    switch (instr->get_instr_type()) {
+    case Instruction::add:
+    case Instruction::mul:
+    case Instruction::fadd:
+    case Instruction::fmul:
+    case Instruction::eq:
+    case Instruction::ne:
+    case Instruction::feq:
+    case Instruction::fne:
+        // commutative, the operand order does not matter
+        expr->operands.assign(instr->get_operands().begin(),
+                              instr->get_operands().end());
+        std::sort(expr->operands.begin(), expr->operands.end(),
+                  std::less<Value *>());
+        break;
+    case Instruction::sub:
+    case Instruction::sdiv:
+    case Instruction::fsub:
+    case Instruction::fdiv:
+    case Instruction::ge:
+    case Instruction::gt:
+    case Instruction::le:
+    case Instruction::lt:
+    case Instruction::fge:
+    case Instruction::fgt:
+    case Instruction::fle:
+    case Instruction::flt:
+    case Instruction::getelementptr:
+    case Instruction::zext:
+    case Instruction::sitofp:
+    case Instruction::fptosi:
+    case Instruction::bitcast:
+        expr->operands.assign(instr->get_operands().begin(),
+                              instr->get_operands().end());
+        break;
+    case Instruction::call: {
+        auto func = instr->get_operand(0)->as<Function>();
+        if (instr->is_void() or not func_info_->is_pure_function(func))
+            return false;
+        expr->operands.assign(instr->get_operands().begin(),
+                              instr->get_operands().end());
+        break;
+    }
+    default:
+        return false;
+    }
+    expr->op = instr->get_instr_type();
+    expr->type = instr->get_type();
+    return true;
+}
+
+void GVN::run_on_func(Function *func) {
+    leaders_.clear();
+    // iterative walk of the dom tree, a block's expressions go out of scope
+    // once all blocks it dominates are done
+    struct Scope {
+        BasicBlock *bb;
+        unsigned next_child;
+        std::vector<Expression> inserted;
+    };
+    std::vector<Scope> stack;
+    auto enter = [&](BasicBlock *bb) {
+        Scope scope{bb, 0, {}};
+        std::vector<Instruction *> wait_delete;
+        for (auto &instr : bb->get_instructions()) {
+            Expression expr;
+            if (not get_expression(&instr, &expr))
+                continue;
+            auto it = leaders_.find(expr);
+            if (it != leaders_.end()) {
+                instr.replace_all_use_with(it->second);
+                wait_delete.push_back(&instr);
+            } else {
+                leaders_.emplace(expr, &instr);
+                scope.inserted.push_back(std::move(expr));
+            }
+        }
+        for (auto instr : wait_delete)
+            bb->erase_instr(instr);
+        add_stat("instructions eliminated", wait_delete.size());
+        stack.push_back(std::move(scope));
+    };
+
+    enter(func->get_entry_block());
+    while (not stack.empty()) {
+        auto &top = stack.back();
+        auto &children = dominators_->get_dom_tree_succ_blocks(top.bb);
+        if (top.next_child < children.size()) {
+            enter(children[top.next_child++]);
+            continue;
+        }
+        for (auto &expr : top.inserted)
+            leaders_.erase(expr);
+        stack.pop_back();
+    }
+}
@@ -0,0 +1,194 @@
+#include "GlobalOpt.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+
+namespace {
+Constant *get_zero(Type *ty, Module *m) {
+    if (ty->is_float_type())
+        return ConstantFP::get(0.f, m);
+    return ConstantInt::get(0, m);
+}
+
+// the first instruction of bb after its allocas
+Instruction *get_first_non_alloca(BasicBlock *bb) {
+    for (auto &instr : bb->get_instructions())
+        if (not instr.is_alloca())
+            return &instr;
+    return nullptr;
+}
+} // namespace
+
+void GlobalOpt::run() {
+    func_info_ = get_analysis<FuncInfo>();
+    Function *main = nullptr;
+    for (auto &func : m_->get_functions())
+        if (func.get_name() == "main" and not func.is_declaration() and
+            func.get_use_list().empty())
+            main = &func;
+
+    std::vector<GlobalVariable *> globals;
+    for (auto &global : m_->get_global_variable())
+        globals.push_back(&global);
+    for (auto global : globals) {
+        GlobalUses uses;
+        collect_uses(global, uses);
+        if (uses.escapes or std::any_of(uses.funcs.begin(), uses.funcs.end(),
+                                        [&](Function *f) { return skips(f); }))
+            continue;
+        if (not constify(global, uses) and not remove_stores(global, uses) and
+            main and uses.funcs.size() == 1 and uses.funcs.count(main))
+            localize(global, main);
+    }
+
+    std::vector<GlobalVariable *> unused;
+    for (auto &global : m_->get_global_variable())
+        if (global.get_use_list().empty())
+            unused.push_back(&global);
+    for (auto global : unused)
+        m_->get_global_variable().erase(global);
+    if (not unused.empty())
+        add_stat("globals removed", unused.size());
+}
+
+void GlobalOpt::collect_uses(Value *ptr, GlobalUses &uses) {
+    for (auto &use : ptr->get_use_list()) {
+        auto instr = use.val_->dyn_cast<Instruction>();
+        if (instr == nullptr) {
+            uses.escapes = true;
+            continue;
+        }
+        uses.funcs.insert(instr->get_function());
+        if (auto load = instr->dyn_cast<LoadInst>()) {
+            uses.loads.push_back(load);
+        } else if (instr->is_store() and use.arg_no_ == 1) {
+            uses.stores.push_back(instr->as<StoreInst>());
+        } else if (instr->is_gep() and use.arg_no_ == 0) {
+            uses.geps.push_back(instr->as<GetElementPtrInst>());
+            collect_uses(instr, uses);
+        } else if (instr->is_call() and use.arg_no_ != 0 and
+                   not instr->get_operand(0)->as<Function>()->is_declaration()) {
+            uses.calls.push_back(instr->as<CallInst>());
+        } else {
+            uses.escapes = true;
+        }
+    }
+}
+
+Constant *GlobalOpt::get_loaded_value(GlobalVariable *global,
+                                      LoadInst *load) {
+    auto init = global->get_init();
+    if (init == nullptr or init->is<ConstantZero>())
+        return get_zero(load->get_type(), m_);
+    auto ptr = load->get_operand(0);
+    if (ptr == global)
+        return init->is<ConstantArray>() ? nullptr : init;
+    // @g[0][c] of a constant array
+    auto gep = ptr->dyn_cast<GetElementPtrInst>();
+    auto array = init->dyn_cast<ConstantArray>();
+    if (gep == nullptr or array == nullptr or gep->get_operand(0) != global or
+        gep->get_num_operand() != 3)
+        return nullptr;
+    auto first = gep->get_operand(1)->dyn_cast<ConstantInt>();
+    auto index = gep->get_operand(2)->dyn_cast<ConstantInt>();
+    if (first == nullptr or index == nullptr or first->get_value() != 0 or
+        index->get_value() < 0 or
+        static_cast<unsigned>(index->get_value()) >=
+            array->get_size_of_array())
+        return nullptr;
+    auto element = array->get_element_value(index->get_value());
+    if (element->is<ConstantZero>())
+        return get_zero(load->get_type(), m_);
+    return element;
+}
+
+bool GlobalOpt::constify(GlobalVariable *global, GlobalUses &uses) {
+    // a global nobody reads is left to remove_stores()
+    if (not uses.stores.empty() or (uses.loads.empty() and uses.calls.empty()))
+        return false;
+    // a readonly callee does not write the arrays it is passed
+    for (auto call : uses.calls) {
+        auto callee = call->get_operand(0)->as<Function>();
+        if (not func_info_->is_readonly_function(callee))
+            return false;
+    }
+    if (not global->is_const()) {
+        global->set_const(true);
+        add_stat("globals made constant");
+    }
+    for (auto load : uses.loads) {
+        auto value = get_loaded_value(global, load);
+        if (value == nullptr)
+            continue;
+        load->replace_all_use_with(value);
+        load->get_parent()->erase_instr(load);
+        add_stat("loads folded");
+    }
+    return true;
+}
+
+bool GlobalOpt::remove_stores(GlobalVariable *global, GlobalUses &uses) {
+    if (not uses.loads.empty() or not uses.calls.empty())
+        return false;
+    if (uses.stores.empty())
+        return true;
+    for (auto store : uses.stores)
+        store->get_parent()->erase_instr(store);
+    add_stat("stores removed", uses.stores.size());
+    // the geps only led to the stores
+    for (auto it = uses.geps.rbegin(); it != uses.geps.rend(); ++it)
+        if ((*it)->get_use_list().empty())
+            (*it)->get_parent()->erase_instr(*it);
+    return true;
+}
+
+bool GlobalOpt::localize(GlobalVariable *global, Function *main) {
+    auto type = global->get_type()->get_pointer_element_type();
+    auto array_type = type->is_array_type()
+                          ? static_cast<ArrayType *>(type)
+                          : nullptr;
+    if (array_type and
+        array_type->get_num_of_elements() > max_local_elements)
+        return false;
+    auto init = global->get_init();
+    // element i of the initializer, the initializer itself for a scalar
+    auto get_init = [&](unsigned i, Type *ty) -> Value * {
+        auto value = init;
+        if (auto array = init ? init->dyn_cast<ConstantArray>() : nullptr)
+            value = array->get_element_value(i);
+        if (value == nullptr or value->is<ConstantZero>())
+            return get_zero(ty, m_);
+        return value;
+    };
+
+    auto entry = main->get_entry_block();
+    auto alloca = entry->create_before(
+        &entry->get_instructions().front(),
+        [&](BasicBlock *bb) { return AllocaInst::create_alloca(type, bb); });
+    global->replace_all_use_with(alloca);
+    // the global started out with its initializer, the local gets it first
+    auto pos = get_first_non_alloca(entry);
+    if (array_type) {
+        auto zero = ConstantInt::get(0, m_);
+        auto elem_type = array_type->get_element_type();
+        for (unsigned i = 0; i < array_type->get_num_of_elements(); i++) {
+            auto index = ConstantInt::get(static_cast<int>(i), m_);
+            auto gep = entry->create_before(pos, [&](BasicBlock *bb) {
+                return GetElementPtrInst::create_gep(alloca, {zero, index}, bb);
+            });
+            entry->create_before(pos, [&](BasicBlock *bb) {
+                return StoreInst::create_store(get_init(i, elem_type), gep, bb);
+            });
+        }
+    } else {
+        auto value = get_init(0, type);
+        entry->create_before(pos, [&](BasicBlock *bb) {
+            return StoreInst::create_store(value, alloca, bb);
+        });
+    }
+    add_stat("globals made local");
+    return true;
+}
@@ -0,0 +1,167 @@
+#include "IPConstProp.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+namespace {
+bool is_constant(Value *val) {
+    return val->is<ConstantInt>() or val->is<ConstantFP>();
+}
+
+bool is_call_of(Value *val, Function *func) {
+    auto call = val->dyn_cast<CallInst>();
+    return call and call->get_operand(0) == func;
+}
+} // namespace
+
+void IPConstProp::run() {
+    bool changed;
+    do {
+        changed = false;
+        std::vector<Function *> funcs;
+        for (auto &func : m_->get_functions())
+            if (not func.is_declaration() and func.get_name() != "main")
+                funcs.push_back(&func);
+        for (auto func : funcs) {
+            std::vector<CallInst *> calls;
+            if (not get_calls(func, calls) or calls.empty())
+                continue;
+            changed |= propagate_args(func, calls);
+            changed |= propagate_return(func, calls);
+            // func is replaced when its signature changes
+            changed |= remove_dead_args(func, calls);
+        }
+    } while (changed);
+}
+
+bool IPConstProp::get_calls(Function *func, std::vector<CallInst *> &calls) {
+    for (auto &use : func->get_use_list()) {
+        if (use.arg_no_ != 0 or not is_call_of(use.val_, func))
+            return false;
+        calls.push_back(use.val_->as<CallInst>());
+    }
+    return true;
+}
+
+bool IPConstProp::propagate_args(Function *func,
+                                 const std::vector<CallInst *> &calls) {
+    bool changed = false;
+    for (auto &arg : func->get_args()) {
+        if (arg.get_use_list().empty())
+            continue;
+        Value *value = nullptr;
+        for (auto call : calls) {
+            auto op = call->get_operand(arg.get_arg_no() + 1);
+            if (op == &arg)
+                continue;
+            if (not is_constant(op) or (value and op != value)) {
+                value = nullptr;
+                break;
+            }
+            value = op;
+        }
+        if (value == nullptr)
+            continue;
+        arg.replace_all_use_with(value);
+        add_stat("arguments made constant");
+        changed = true;
+    }
+    return changed;
+}
+
+bool IPConstProp::propagate_return(Function *func,
+                                   const std::vector<CallInst *> &calls) {
+    if (func->get_return_type()->is_void_type())
+        return false;
+    Value *value = nullptr;
+    for (auto &bb : func->get_basic_blocks()) {
+        auto ret = bb.get_terminator()->dyn_cast<ReturnInst>();
+        if (ret == nullptr)
+            continue;
+        auto op = ret->get_operand(0);
+        if (is_call_of(op, func))
+            continue;
+        if (not is_constant(op) or (value and op != value))
+            return false;
+        value = op;
+    }
+    if (value == nullptr)
+        return false;
+    bool changed = false;
+    for (auto call : calls) {
+        if (call->get_use_list().empty())
+            continue;
+        call->replace_all_use_with(value);
+        add_stat("call results made constant");
+        changed = true;
+    }
+    return changed;
+}
+
+bool IPConstProp::remove_dead_args(Function *func,
+                                   const std::vector<CallInst *> &calls) {
+    // the operand numbers of the arguments that stay
+    std::vector<unsigned> live_args;
+    std::vector<Type *> param_types;
+    for (auto &arg : func->get_args()) {
+        if (arg.get_use_list().empty())
+            continue;
+        live_args.push_back(arg.get_arg_no() + 1);
+        param_types.push_back(arg.get_type());
+    }
+    // the result is dead if at most the ret of a recursive call uses it
+    bool dead_ret = not func->get_return_type()->is_void_type();
+    for (auto call : calls) {
+        for (auto &use : call->get_use_list()) {
+            auto ret = use.val_->dyn_cast<ReturnInst>();
+            if (ret == nullptr or ret->get_function() != func)
+                dead_ret = false;
+        }
+    }
+    if (not dead_ret and live_args.size() == func->get_num_of_args())
+        return false;
+    add_stat("arguments removed", func->get_num_of_args() - live_args.size());
+    if (dead_ret)
+        add_stat("return values removed");
+
+    auto ret_type = dead_ret ? m_->get_void_type() : func->get_return_type();
+    auto new_func = Function::create(
+        m_->get_function_type(ret_type, param_types), func->get_name(), m_);
+    // keep the order of the functions in the module
+    m_->get_functions().remove(new_func);
+    m_->get_functions().insert(func->getIterator(), new_func);
+    new_func->take_basic_blocks(func);
+    auto new_arg = new_func->get_args().begin();
+    for (auto &arg : func->get_args()) {
+        if (arg.get_use_list().empty())
+            continue;
+        new_arg->set_name(arg.get_name());
+        arg.replace_all_use_with(&*new_arg);
+        ++new_arg;
+    }
+    if (dead_ret) {
+        for (auto &bb : new_func->get_basic_blocks()) {
+            if (not bb.get_terminator()->is_ret())
+                continue;
+            bb.erase_instr(bb.get_terminator());
+            ReturnInst::create_void_ret(&bb);
+        }
+    }
+
+    // the recursive calls now sit in new_func, they are replaced as well
+    for (auto call : calls) {
+        std::vector<Value *> args;
+        for (auto i : live_args)
+            args.push_back(call->get_operand(i));
+        auto bb = call->get_parent();
+        auto new_call = bb->create_before(call, [&](BasicBlock *bb) {
+            return CallInst::create_call(new_func, args, bb);
+        });
+        if (not dead_ret)
+            call->replace_all_use_with(new_call);
+        bb->erase_instr(call);
+    }
+    m_->get_functions().erase(func);
+    return true;
+}
@@ -0,0 +1,164 @@
+#include "InductionVars.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+
+#include <climits>
+
+void InductionVars::run() {
+    auto loop_info = get_analysis<LoopInfo>();
+    loops_.clear();
+    for (auto &func : m_->get_functions()) {
+        if (func.is_declaration())
+            continue;
+        for (auto loop : loop_info->get_loops_in_post_order(&func))
+            analyze(loop);
+    }
+}
+
+void InductionVars::analyze(Loop *loop) {
+    auto header = loop->get_header();
+    auto preheader = loop->get_preheader();
+    if (not preheader or loop->get_latches().size() != 1 or
+        header->get_pre_basic_blocks().size() != 2)
+        return;
+    auto latch = loop->get_latches().front();
+    auto &result = loops_[loop];
+    for (auto &instr : header->get_instructions()) {
+        if (not instr.is_phi())
+            break;
+        if (not instr.get_type()->is_int32_type())
+            continue;
+        auto phi = instr.as<PhiInst>();
+        Value *init = nullptr, *next_val = nullptr;
+        for (auto &[val, bb] : phi->get_phi_pairs()) {
+            if (bb == preheader)
+                init = val;
+            else if (bb == latch)
+                next_val = val;
+        }
+        // phi + c, c + phi or phi - c
+        auto next = next_val ? next_val->dyn_cast<IBinaryInst>() : nullptr;
+        if (init == nullptr or next == nullptr or
+            not(next->is_add() or next->is_sub()))
+            continue;
+        auto lhs = next->get_operand(0), rhs = next->get_operand(1);
+        if (next->is_add() and rhs == phi)
+            std::swap(lhs, rhs);
+        auto step = rhs->dyn_cast<ConstantInt>();
+        if (lhs != phi or step == nullptr)
+            continue;
+        result.ivs.push_back({phi, init, next,
+                              next->is_add() ? step->get_value()
+                                             : -step->get_value()});
+    }
+    find_trip_count(loop, result);
+}
+
+void InductionVars::find_trip_count(Loop *loop, LoopIVs &result) {
+    auto header = loop->get_header();
+    // the header is the only way out
+    for (auto bb : loop->get_blocks()) {
+        if (bb == header)
+            continue;
+        for (auto succ : bb->get_succ_basic_blocks())
+            if (not loop->contains(succ))
+                return;
+    }
+    auto br = header->get_terminator()->dyn_cast<BranchInst>();
+    if (br == nullptr or not br->is_cond_br())
+        return;
+    auto true_bb = br->get_operand(1)->as<BasicBlock>();
+    auto false_bb = br->get_operand(2)->as<BasicBlock>();
+    if (loop->contains(true_bb) == loop->contains(false_bb))
+        return;
+    // whether the body runs when the compare is true
+    bool stay = loop->contains(true_bb);
+    auto cmp = br->get_condition()->dyn_cast<ICmpInst>();
+    // the builder branches on `icmp ne (zext c), 0`
+    while (cmp and (cmp->get_instr_type() == Instruction::ne or
+                    cmp->get_instr_type() == Instruction::eq)) {
+        auto ext = cmp->get_operand(0)->dyn_cast<ZextInst>();
+        auto zero = cmp->get_operand(1)->dyn_cast<ConstantInt>();
+        if (ext == nullptr or zero == nullptr or zero->get_value() != 0)
+            break;
+        if (cmp->get_instr_type() == Instruction::eq)
+            stay = not stay;
+        cmp = ext->get_operand(0)->dyn_cast<ICmpInst>();
+    }
+    if (cmp == nullptr)
+        return;
+
+    auto op = cmp->get_instr_type();
+    auto lhs = cmp->get_operand(0), rhs = cmp->get_operand(1);
+    for (unsigned i = 0; i < result.ivs.size(); i++) {
+        auto &iv = result.ivs[i];
+        Value *other;
+        auto iv_op = op;
+        if (lhs == iv.phi) {
+            other = rhs;
+        } else if (rhs == iv.phi) {
+            other = lhs;
+            iv_op = ICmpInst::get_swapped_op(op);
+        } else {
+            continue;
+        }
+        if (not stay)
+            iv_op = ICmpInst::get_inverse_op(iv_op);
+        result.exit_var = i;
+        result.exit_op = iv_op;
+        result.exit_bound = other;
+        auto init = iv.init->dyn_cast<ConstantInt>();
+        auto bound = other->dyn_cast<ConstantInt>();
+        if (init and bound)
+            result.trip_count = compute_trip_count(
+                iv_op, init->get_value(), iv.step, bound->get_value());
+        return;
+    }
+}
+
+long InductionVars::compute_trip_count(Instruction::OpID op, long init,
+                                       long step, long bound) {
+    long count;
+    switch (op) {
+    case Instruction::lt:
+    case Instruction::le:
+        if (op == Instruction::le)
+            bound++;
+        if (init >= bound)
+            return 0;
+        if (step <= 0)
+            return -1;
+        count = (bound - init + step - 1) / step;
+        break;
+    case Instruction::gt:
+    case Instruction::ge:
+        if (op == Instruction::ge)
+            bound--;
+        if (init <= bound)
+            return 0;
+        if (step >= 0)
+            return -1;
+        count = (init - bound - step - 1) / -step;
+        break;
+    case Instruction::ne:
+        if (init == bound)
+            return 0;
+        if (step == 0 or (bound - init) % step != 0 or
+            (bound - init) / step < 0)
+            return -1;
+        count = (bound - init) / step;
+        break;
+    case Instruction::eq:
+        if (init != bound)
+            return 0;
+        return step == 0 ? -1 : 1;
+    default:
+        return -1;
+    }
+    // every value up to the one leaving the loop is computed in i32
+    auto last = init + count * step;
+    if (last < INT_MIN or last > INT_MAX)
+        return -1;
+    return count;
+}
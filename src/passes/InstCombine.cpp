@@ -0,0 +1,244 @@
+#include "InstCombine.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <cmath>
+
+namespace {
+bool is_int_const(Value *val, int c) {
+    auto ci = val->dyn_cast<ConstantInt>();
+    return ci and ci->get_value() == c;
+}
+// exact bit match, -0.0 is no +0.0 here
+bool is_fp_const(Value *val, float c) {
+    auto cf = val->dyn_cast<ConstantFP>();
+    return cf and cf->get_value() == c and
+           std::signbit(cf->get_value()) == std::signbit(c);
+}
+} // namespace
+
+void InstCombine::run() {
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        run_on_func(&func);
+    }
+}
+
+void InstCombine::push(Instruction *instr) {
+    if (in_work_list_.insert(instr).second)
+        work_list_.push_back(instr);
+}
+
+void InstCombine::run_on_func(Function *func) {
+    work_list_.clear();
+    in_work_list_.clear();
+    for (auto &bb : func->get_basic_blocks())
+        for (auto &instr : bb.get_instructions())
+            push(&instr);
+    while (not work_list_.empty()) {
+        auto instr = work_list_.back();
+        work_list_.pop_back();
+        in_work_list_.erase(instr);
+        auto new_val = simplify(instr);
+        if (not new_val)
+            continue;
+        if (auto new_instr = new_val->dyn_cast<Instruction>())
+            push(new_instr);
+        for (auto &use : instr->get_use_list())
+            push(use.val_->as<Instruction>());
+        instr->replace_all_use_with(new_val);
+        // operands that lost their last use are left to DeadCode
+        instr->get_parent()->erase_instr(instr);
+        add_stat("instructions combined");
+    }
+}
+
+Value *InstCombine::simplify(Instruction *instr) {
+    // the identities below give scalars, vector lanes are left alone
+    if (instr->get_type()->is_vector_type())
+        return nullptr;
+    switch (instr->get_instr_type()) {
+    case Instruction::add:
+    case Instruction::sub:
+    case Instruction::mul:
+    case Instruction::sdiv:
+        return simplify_ibinary(instr);
+    case Instruction::fadd:
+    case Instruction::fsub:
+    case Instruction::fmul:
+    case Instruction::fdiv:
+        return simplify_fbinary(instr);
+    case Instruction::ge:
+    case Instruction::gt:
+    case Instruction::le:
+    case Instruction::lt:
+    case Instruction::eq:
+    case Instruction::ne:
+        return simplify_icmp(instr);
+    case Instruction::fge:
+    case Instruction::fgt:
+    case Instruction::fle:
+    case Instruction::flt:
+    case Instruction::feq:
+    case Instruction::fne: {
+        auto lhs = instr->get_operand(0)->dyn_cast<ConstantFP>();
+        auto rhs = instr->get_operand(1)->dyn_cast<ConstantFP>();
+        if (lhs and rhs)
+            return folder_.compute(instr->get_instr_type(), lhs, rhs);
+        return nullptr;
+    }
+    case Instruction::zext:
+        return simplify_zext(instr);
+    default:
+        return nullptr;
+    }
+}
+
+Value *InstCombine::simplify_ibinary(Instruction *instr) {
+    auto op = instr->get_instr_type();
+    auto lhs = instr->get_operand(0), rhs = instr->get_operand(1);
+    auto c_lhs = lhs->dyn_cast<ConstantInt>();
+    auto c_rhs = rhs->dyn_cast<ConstantInt>();
+    if (c_lhs and c_rhs)
+        return folder_.compute(op, c_lhs, c_rhs);
+    // canonical form: constant on the right of commutative operations
+    if (c_lhs and (op == Instruction::add or op == Instruction::mul)) {
+        instr->set_operand(0, rhs);
+        instr->set_operand(1, lhs);
+        set_changed();
+        std::swap(lhs, rhs);
+        std::swap(c_lhs, c_rhs);
+    }
+    auto m = m_;
+    auto negate = [&](Value *val) {
+        return instr->get_parent()->create_before(instr, [&](BasicBlock *bb) {
+            return IBinaryInst::create_sub(ConstantInt::get(0, m), val, bb);
+        });
+    };
+    switch (op) {
+    case Instruction::add:
+        if (is_int_const(rhs, 0))
+            return lhs;
+        break;
+    case Instruction::sub:
+        if (is_int_const(rhs, 0))
+            return lhs;
+        if (lhs == rhs)
+            return ConstantInt::get(0, m_);
+        // 0-(0-x) -> x
+        if (is_int_const(lhs, 0))
+            if (auto inner = rhs->dyn_cast<IBinaryInst>())
+                if (inner->get_instr_type() == Instruction::sub and
+                    is_int_const(inner->get_operand(0), 0))
+                    return inner->get_operand(1);
+        break;
+    case Instruction::mul:
+        if (is_int_const(rhs, 0))
+            return rhs;
+        if (is_int_const(rhs, 1))
+            return lhs;
+        if (is_int_const(rhs, -1))
+            return negate(lhs);
+        if (is_int_const(rhs, 2))
+            return instr->get_parent()->create_before(
+                instr, [&](BasicBlock *bb) {
+                    return IBinaryInst::create_add(lhs, lhs, bb);
+                });
+        break;
+    case Instruction::sdiv:
+        if (is_int_const(rhs, 1))
+            return lhs;
+        // INT_MIN / -1 overflows either way
+        if (is_int_const(rhs, -1))
+            return negate(lhs);
+        if (is_int_const(lhs, 0) and c_rhs and c_rhs->get_value() != 0)
+            return lhs;
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+Value *InstCombine::simplify_fbinary(Instruction *instr) {
+    auto op = instr->get_instr_type();
+    auto lhs = instr->get_operand(0), rhs = instr->get_operand(1);
+    auto c_lhs = lhs->dyn_cast<ConstantFP>();
+    auto c_rhs = rhs->dyn_cast<ConstantFP>();
+    if (c_lhs and c_rhs)
+        return folder_.compute(op, c_lhs, c_rhs);
+    if (c_lhs and (op == Instruction::fadd or op == Instruction::fmul)) {
+        instr->set_operand(0, rhs);
+        instr->set_operand(1, lhs);
+        set_changed();
+        std::swap(lhs, rhs);
+    }
+    // x+0.0 and x*0.0 are no identities for -0.0, inf and nan
+    switch (op) {
+    case Instruction::fsub:
+        if (is_fp_const(rhs, 0))
+            return lhs;
+        break;
+    case Instruction::fmul:
+    case Instruction::fdiv:
+        if (is_fp_const(rhs, 1))
+            return lhs;
+        break;
+    default:
+        break;
+    }
+    return nullptr;
+}
+
+Value *InstCombine::simplify_icmp(Instruction *instr) {
+    auto op = instr->get_instr_type();
+    auto lhs = instr->get_operand(0), rhs = instr->get_operand(1);
+    auto c_lhs = lhs->dyn_cast<ConstantInt>();
+    auto c_rhs = rhs->dyn_cast<ConstantInt>();
+    if (c_lhs and c_rhs)
+        return folder_.compute(op, c_lhs, c_rhs);
+    if (lhs == rhs)
+        return ConstantInt::get(op == Instruction::ge or
+                                    op == Instruction::le or
+                                    op == Instruction::eq,
+                                m_);
+
+    // zext(c) != 0 is c, zext(c) == 0 is !c
+    auto zext = lhs->dyn_cast<ZextInst>();
+    if (not zext or not is_int_const(rhs, 0) or
+        (op != Instruction::ne and op != Instruction::eq))
+        return nullptr;
+    auto cond = zext->get_operand(0);
+    if (op == Instruction::ne)
+        return cond;
+    auto cmp = cond->dyn_cast<ICmpInst>();
+    if (not cmp)
+        return nullptr;
+    auto a = cmp->get_operand(0), b = cmp->get_operand(1);
+    return instr->get_parent()->create_before(instr, [&](BasicBlock *bb) {
+        switch (cmp->get_instr_type()) {
+        case Instruction::ge:
+            return ICmpInst::create_lt(a, b, bb);
+        case Instruction::gt:
+            return ICmpInst::create_le(a, b, bb);
+        case Instruction::le:
+            return ICmpInst::create_gt(a, b, bb);
+        case Instruction::lt:
+            return ICmpInst::create_ge(a, b, bb);
+        case Instruction::eq:
+            return ICmpInst::create_ne(a, b, bb);
+        default:
+            return ICmpInst::create_eq(a, b, bb);
+        }
+    });
+}
+
+Value *InstCombine::simplify_zext(Instruction *instr) {
+    auto val = instr->get_operand(0)->dyn_cast<ConstantInt>();
+    if (not val)
+        return nullptr;
+    return folder_.compute(Instruction::zext, val);
+}
@@ -0,0 +1,138 @@
+#include "LICM.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <vector>
+
+void LICM::run() {
+    func_info_ = get_analysis<FuncInfo>();
+    loop_info_ = get_analysis<LoopInfo>();
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        for (auto loop : loop_info_->get_loops_in_post_order(&func))
+            run_on_loop(loop);
+    }
+}
+
+void LICM::collect_stores(Loop *loop) {
+    stored_globals_.clear();
+    clobbers_all_ = false;
+    for (auto bb : loop->get_blocks()) {
+        for (auto &instr : bb->get_instructions()) {
+            if (instr.is_store()) {
+                auto base = FuncInfo::get_first_addr(
+                    instr.as<StoreInst>()->get_lval());
+                if (base->is<GlobalVariable>())
+                    stored_globals_.insert(base);
+                else if (not base->is<AllocaInst>())
+                    clobbers_all_ = true; // array argument
+            } else if (instr.is_call()) {
+                auto callee = instr.get_operand(0)->as<Function>();
+                // the array index check exits the program, nothing it
+                // could write is observed afterwards
+                if (callee->get_name() == "neg_idx_except")
+                    continue;
+                auto effect = func_info_->get_effect(callee);
+                if (effect == FuncInfo::Any) {
+                    clobbers_all_ = true;
+                } else if (effect == FuncInfo::ArgMemOnly) {
+                    // only what the arguments point to is written
+                    for (unsigned i = 1; i < instr.get_num_operand(); ++i) {
+                        auto arg = instr.get_operand(i);
+                        if (not arg->get_type()->is_pointer_type())
+                            continue;
+                        auto base = FuncInfo::get_first_addr(arg);
+                        if (base->is<GlobalVariable>())
+                            stored_globals_.insert(base);
+                        else if (not base->is<AllocaInst>())
+                            clobbers_all_ = true;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool LICM::is_invariant(Loop *loop, Instruction *instr) {
+    for (auto op : instr->get_operands()) {
+        auto op_instr = op->dyn_cast<Instruction>();
+        if (op_instr and loop->contains(op_instr->get_parent()))
+            return false;
+    }
+    return true;
+}
+
+bool LICM::can_hoist(Instruction *instr) {
+    switch (instr->get_instr_type()) {
+    case Instruction::add:
+    case Instruction::sub:
+    case Instruction::mul:
+    case Instruction::fadd:
+    case Instruction::fsub:
+    case Instruction::fmul:
+    case Instruction::fdiv:
+    case Instruction::ge:
+    case Instruction::gt:
+    case Instruction::le:
+    case Instruction::lt:
+    case Instruction::eq:
+    case Instruction::ne:
+    case Instruction::fge:
+    case Instruction::fgt:
+    case Instruction::fle:
+    case Instruction::flt:
+    case Instruction::feq:
+    case Instruction::fne:
+    case Instruction::getelementptr:
+    case Instruction::zext:
+    case Instruction::sitofp:
+    case Instruction::fptosi:
+    case Instruction::bitcast:
+        return true;
+    case Instruction::load: {
+        // the loop body may never run, only loads that cannot fault are
+        // speculated: a scalar global or a constant index into one
+        auto ptr = instr->as<LoadInst>()->get_lval();
+        auto base = FuncInfo::get_first_addr(ptr);
+        if (not base->is<GlobalVariable>() or clobbers_all_ or
+            stored_globals_.count(base))
+            return false;
+        for (; ptr != base; ptr = ptr->as<Instruction>()->get_operand(0)) {
+            auto gep = ptr->as<Instruction>();
+            for (unsigned i = 1; i < gep->get_num_operand(); ++i)
+                if (not gep->get_operand(i)->is<ConstantInt>())
+                    return false;
+        }
+        return true;
+    }
+    default:
+        // sdiv may trap, the rest has side effects or is a phi
+        return false;
+    }
+}
+
+void LICM::run_on_loop(Loop *loop) {
+    auto preheader = loop->get_preheader();
+    if (not preheader)
+        return;
+    collect_stores(loop);
+    auto terminator = preheader->get_terminator();
+    // dom tree pre order, operands are hoisted before their users
+    for (auto bb : loop->get_blocks()) {
+        std::vector<Instruction *> hoist;
+        for (auto &instr : bb->get_instructions())
+            if (can_hoist(&instr) and is_invariant(loop, &instr)) {
+                hoist.push_back(&instr);
+                // later instructions of bb see it as defined outside
+                instr.set_parent(preheader);
+            }
+        for (auto instr : hoist) {
+            bb->remove_instr(instr);
+            preheader->insert_before(terminator, instr);
+        }
+        add_stat("instructions hoisted", hoist.size());
+    }
+}
@@ -0,0 +1,172 @@
+#include "LoadStoreElim.hpp"
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+
+void LoadStoreElim::run() {
+    func_info_ = get_analysis<FuncInfo>();
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        run_on_func(&func);
+    }
+}
+
+void LoadStoreElim::run_on_func(Function *func) {
+    out_states_.clear();
+    no_return_.clear();
+    // reverse post order of the cfg
+    std::vector<BasicBlock *> post_order;
+    std::unordered_set<BasicBlock *> visited{func->get_entry_block()};
+    std::vector<std::pair<BasicBlock *, BasicBlock::BlockList::iterator>>
+        stack{{func->get_entry_block(),
+               func->get_entry_block()->get_succ_basic_blocks().begin()}};
+    while (not stack.empty()) {
+        auto &[bb, it] = stack.back();
+        if (it != bb->get_succ_basic_blocks().end()) {
+            auto succ = *it++;
+            if (visited.insert(succ).second)
+                stack.push_back({succ, succ->get_succ_basic_blocks().begin()});
+            continue;
+        }
+        post_order.push_back(bb);
+        stack.pop_back();
+    }
+    for (auto it = post_order.rbegin(); it != post_order.rend(); ++it) {
+        auto state = get_entry_state(*it);
+        run_on_block(*it, state);
+        out_states_[*it] = std::move(state);
+    }
+}
+
+LoadStoreElim::MemoryState LoadStoreElim::get_entry_state(BasicBlock *bb) {
+    auto &preds = bb->get_pre_basic_blocks();
+    if (preds.empty())
+        return {};
+    for (auto pred : preds)
+        if (not out_states_.count(pred))
+            return {}; // back edge or unreachable predecessor
+    // the entries every predecessor that may fall through agrees on
+    MemoryState state;
+    bool first = true;
+    for (auto pred : preds) {
+        if (no_return_.count(pred))
+            continue;
+        auto &other = out_states_[pred];
+        if (first) {
+            state = other;
+            first = false;
+            continue;
+        }
+        state.erase(std::remove_if(state.begin(), state.end(),
+                                   [&](const std::pair<Value *, Value *> &e) {
+                                       return std::find(other.begin(),
+                                                        other.end(),
+                                                        e) == other.end();
+                                   }),
+                    state.end());
+    }
+    return state;
+}
+
+void LoadStoreElim::clobber(MemoryState &state, Value *ptr) {
+    state.erase(std::remove_if(state.begin(), state.end(),
+                               [&](const std::pair<Value *, Value *> &e) {
+                                   return AliasAnalysis::alias(e.first, ptr) !=
+                                          AliasAnalysis::NoAlias;
+                               }),
+                state.end());
+}
+
+void LoadStoreElim::clobber_args(MemoryState &state, CallInst *call) {
+    for (unsigned i = 1; i < call->get_num_operand(); ++i) {
+        auto arg = call->get_operand(i);
+        if (not arg->get_type()->is_pointer_type())
+            continue;
+        // the callee may write anywhere in the object arg points into
+        auto base = FuncInfo::get_first_addr(arg);
+        bool identified = base->is<AllocaInst>() or base->is<GlobalVariable>();
+        state.erase(
+            std::remove_if(state.begin(), state.end(),
+                           [&](const std::pair<Value *, Value *> &e) {
+                               auto other = FuncInfo::get_first_addr(e.first);
+                               return not identified or other == base or
+                                      not(other->is<AllocaInst>() or
+                                          other->is<GlobalVariable>());
+                           }),
+            state.end());
+    }
+}
+
+void LoadStoreElim::run_on_block(BasicBlock *bb, MemoryState &state) {
+    // stores of this block not read since, candidates for being overwritten
+    std::vector<StoreInst *> pending_stores;
+    std::vector<Instruction *> wait_delete;
+    for (auto &instr : bb->get_instructions()) {
+        if (instr.is_load()) {
+            auto ptr = instr.as<LoadInst>()->get_lval();
+            auto known = std::find_if(
+                state.begin(), state.end(),
+                [&](const std::pair<Value *, Value *> &e) {
+                    return AliasAnalysis::alias(e.first, ptr) ==
+                               AliasAnalysis::MustAlias and
+                           e.second->get_type() == instr.get_type();
+                });
+            if (known != state.end()) {
+                instr.replace_all_use_with(known->second);
+                wait_delete.push_back(&instr);
+                add_stat("loads forwarded");
+                continue;
+            }
+            pending_stores.erase(
+                std::remove_if(pending_stores.begin(), pending_stores.end(),
+                               [&](StoreInst *store) {
+                                   return AliasAnalysis::alias(
+                                              store->get_lval(), ptr) !=
+                                          AliasAnalysis::NoAlias;
+                               }),
+                pending_stores.end());
+            state.push_back({ptr, &instr});
+        } else if (instr.is_store()) {
+            auto store = instr.as<StoreInst>();
+            auto ptr = store->get_lval(), val = store->get_rval();
+            // memory already holds val
+            if (std::find(state.begin(), state.end(), std::make_pair(ptr, val)) !=
+                state.end()) {
+                wait_delete.push_back(store);
+                add_stat("stores removed");
+                continue;
+            }
+            for (auto it = pending_stores.begin(); it != pending_stores.end();) {
+                if (AliasAnalysis::alias((*it)->get_lval(), ptr) ==
+                    AliasAnalysis::MustAlias) {
+                    wait_delete.push_back(*it);
+                    add_stat("stores removed");
+                    it = pending_stores.erase(it);
+                } else
+                    ++it;
+            }
+            clobber(state, ptr);
+            state.push_back({ptr, val});
+            pending_stores.push_back(store);
+        } else if (instr.is_call()) {
+            auto callee = instr.get_operand(0)->as<Function>();
+            // the array index check exits the program
+            if (callee->get_name() == "neg_idx_except")
+                no_return_.insert(bb);
+            auto effect = func_info_->get_effect(callee);
+            // the callee may read the pending stores
+            if (effect != FuncInfo::ReadNone)
+                pending_stores.clear();
+            if (effect == FuncInfo::Any)
+                state.clear();
+            else if (effect == FuncInfo::ArgMemOnly)
+                clobber_args(state, instr.as<CallInst>());
+        }
+    }
+    for (auto instr : wait_delete)
+        bb->erase_instr(instr);
+}
@@ -0,0 +1,182 @@
+#include "LoopInfo.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+std::vector<BasicBlock *> Loop::get_exit_blocks() const {
+    std::vector<BasicBlock *> exits;
+    for (auto bb : blocks_)
+        for (auto succ : bb->get_succ_basic_blocks())
+            if (not contains(succ) and
+                std::find(exits.begin(), exits.end(), succ) == exits.end())
+                exits.push_back(succ);
+    return exits;
+}
+
+void LoopInfo::run() {
+    dominators_ = get_analysis<Dominators>();
+    loops_.clear();
+    bb_loop_.clear();
+    for (auto &f : m_->get_functions()) {
+        if (f.is_declaration())
+            continue;
+        run_on_func(&f);
+    }
+}
+
+void LoopInfo::run_on_func(Function *f) {
+    discover_loops(f);
+    bool changed = false;
+    for (auto &loop : loops_[f].loops) {
+        if (loop->preheader_ or loop->header_ == f->get_entry_block())
+            continue;
+        create_preheader(loop.get());
+        changed = true;
+    }
+    if (changed) {
+        set_changed();
+        // the new blocks shift the numbering, keep the shared dominator
+        // tree valid and collect the loops again with the preheaders
+        // belonging to the enclosing loops
+        dominators_->run_on_func(f);
+        discover_loops(f);
+    }
+}
+
+void LoopInfo::discover_loops(Function *f) {
+    for (auto &bb : f->get_basic_blocks())
+        bb_loop_.erase(&bb);
+    auto &func_loops = loops_[f];
+    func_loops = FuncLoops();
+
+    auto &dom_dfs_order = dominators_->get_dom_dfs_order(f);
+    std::unordered_set<BasicBlock *> reachable(dom_dfs_order.begin(),
+                                               dom_dfs_order.end());
+    // inner headers are dominated by outer ones, so the dom tree post order
+    // finds inner loops first
+    for (auto header : dominators_->get_dom_post_order(f)) {
+        std::vector<BasicBlock *> work_list;
+        for (auto pred : header->get_pre_basic_blocks())
+            if (reachable.count(pred) and
+                dominators_->is_dominate(header, pred) and
+                std::find(work_list.begin(), work_list.end(), pred) ==
+                    work_list.end())
+                work_list.push_back(pred);
+        if (work_list.empty())
+            continue;
+
+        func_loops.loops.push_back(std::make_unique<Loop>(header));
+        auto loop = func_loops.loops.back().get();
+        loop->latches_ = work_list;
+        bb_loop_[header] = loop;
+        // walk backwards from the latches, a block already in a loop stands
+        // for its outermost loop found so far which becomes our sub loop
+        while (not work_list.empty()) {
+            auto bb = work_list.back();
+            work_list.pop_back();
+            auto it = bb_loop_.find(bb);
+            if (it == bb_loop_.end()) {
+                bb_loop_[bb] = loop;
+                for (auto pred : bb->get_pre_basic_blocks())
+                    if (reachable.count(pred))
+                        work_list.push_back(pred);
+                continue;
+            }
+            auto sub = it->second;
+            while (sub->parent_)
+                sub = sub->parent_;
+            if (sub == loop)
+                continue;
+            sub->parent_ = loop;
+            loop->sub_loops_.push_back(sub);
+            for (auto pred : sub->header_->get_pre_basic_blocks())
+                if (reachable.count(pred))
+                    work_list.push_back(pred);
+        }
+    }
+
+    for (auto bb : dom_dfs_order) {
+        for (auto loop = get_loop_for(bb); loop; loop = loop->parent_) {
+            loop->blocks_.push_back(bb);
+            loop->block_set_.insert(bb);
+        }
+    }
+    for (auto &loop : func_loops.loops) {
+        if (not loop->parent_)
+            func_loops.top_level.push_back(loop.get());
+        std::vector<BasicBlock *> outside;
+        for (auto pred : loop->header_->get_pre_basic_blocks())
+            if (not loop->contains(pred))
+                outside.push_back(pred);
+        if (outside.size() == 1 and
+            outside[0]->get_succ_basic_blocks().size() == 1)
+            loop->preheader_ = outside[0];
+    }
+}
+
+void LoopInfo::create_preheader(Loop *loop) {
+    auto header = loop->header_;
+    std::vector<BasicBlock *> outside;
+    for (auto pred : header->get_pre_basic_blocks())
+        if (not loop->contains(pred) and
+            std::find(outside.begin(), outside.end(), pred) == outside.end())
+            outside.push_back(pred);
+    assert(not outside.empty() && "loop header without entering edge");
+
+    auto preheader = BasicBlock::create(m_, "", header->get_parent());
+    // incoming values from outside merge in the preheader
+    for (auto &instr : header->get_instructions()) {
+        auto phi = instr.dyn_cast<PhiInst>();
+        if (not phi)
+            break;
+        std::vector<Value *> vals;
+        std::vector<BasicBlock *> val_bbs;
+        for (auto &[val, bb] : phi->get_phi_pairs()) {
+            if (loop->contains(bb))
+                continue;
+            vals.push_back(val);
+            val_bbs.push_back(bb);
+        }
+        for (auto bb : val_bbs)
+            phi->remove_incoming(bb);
+        if (vals.empty())
+            continue;
+        Value *incoming = vals[0];
+        if (std::any_of(vals.begin(), vals.end(),
+                        [&](Value *val) { return val != vals[0]; })) {
+            auto new_phi =
+                PhiInst::create_phi(phi->get_type(), preheader, vals, val_bbs);
+            preheader->add_instr_begin(new_phi);
+            incoming = new_phi;
+        }
+        phi->add_phi_pair_operand(incoming, preheader);
+    }
+
+    for (auto pred : outside) {
+        pred->get_terminator()->as<BranchInst>()->replace_successor(
+            header, preheader);
+    }
+    BranchInst::create_br(header, preheader);
+}
+
+std::vector<Loop *> LoopInfo::get_loops_in_post_order(Function *f) {
+    std::vector<Loop *> order;
+    // (loop, next sub loop)
+    std::vector<std::pair<Loop *, unsigned>> stack;
+    for (auto top : loops_[f].top_level) {
+        stack.push_back({top, 0});
+        while (not stack.empty()) {
+            auto &[loop, next] = stack.back();
+            if (next < loop->sub_loops_.size()) {
+                auto sub = loop->sub_loops_[next++];
+                stack.push_back({sub, 0});
+                continue;
+            }
+            order.push_back(loop);
+            stack.pop_back();
+        }
+    }
+    return order;
+}
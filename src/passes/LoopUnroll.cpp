@@ -0,0 +1,219 @@
+#include "LoopUnroll.hpp"
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+std::vector<PhiInst *> get_phis(BasicBlock *bb) {
+    std::vector<PhiInst *> phis;
+    for (auto &instr : bb->get_instructions()) {
+        if (not instr.is_phi())
+            break;
+        phis.push_back(instr.as<PhiInst>());
+    }
+    return phis;
+}
+
+// the incoming value and block of phi from pre_bb become val and new_bb
+void replace_incoming(PhiInst *phi, BasicBlock *pre_bb, Value *val,
+                      BasicBlock *new_bb) {
+    for (unsigned i = 0; i < phi->get_num_incoming(); i++) {
+        if (phi->get_incoming_block(i) == pre_bb) {
+            phi->set_incoming_value(i, val);
+            phi->set_incoming_block(i, new_bb);
+        }
+    }
+}
+} // namespace
+
+void LoopUnroll::run() {
+    auto loop_info = get_analysis<LoopInfo>();
+    auto induction_vars = get_analysis<InductionVars>();
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        bool changed = false;
+        // innermost loops share no blocks, unrolling one keeps the others
+        for (auto loop : loop_info->get_loops_in_post_order(&func)) {
+            auto trip_count = induction_vars->get_trip_count(loop);
+            if (trip_count >= 0 and can_unroll(loop))
+                changed |= run_on_loop(loop, trip_count);
+        }
+        // the original loop body after a full unroll
+        if (changed)
+            func.remove_unreachable_basic_blocks();
+    }
+}
+
+bool LoopUnroll::can_unroll(Loop *loop) {
+    // a known trip count means a single latch and the header as the only
+    // exit already
+    return loop->get_sub_loops().empty() and loop->get_preheader() and
+           loop->get_header()->get_pre_basic_blocks().size() == 2;
+}
+
+bool LoopUnroll::run_on_loop(Loop *loop, long trip_count) {
+    long size = 0;
+    for (auto bb : loop->get_blocks())
+        size += bb->get_num_of_instr();
+    if (trip_count * size <= size_budget_) {
+        unroll_full(loop, trip_count);
+        add_stat("loops fully unrolled");
+        return true;
+    }
+    // the peeled iterations and the copies in the loop cost the same
+    for (long factor = std::min<long>(factor_, trip_count); factor > 1;
+         factor--) {
+        if ((factor - 1 + trip_count % factor) * size > size_budget_)
+            continue;
+        peel(loop, trip_count % factor);
+        unroll_partial(loop, factor);
+        add_stat("loops partially unrolled");
+        return true;
+    }
+    return false;
+}
+
+BasicBlock *LoopUnroll::clone_iteration(Loop *loop, ValueMap &phi_values,
+                                        BasicBlock *&latch_copy) {
+    auto header = loop->get_header();
+    auto latch = loop->get_latches().front();
+    auto func = header->get_parent();
+    // the header phis are not copied, their uses take phi_values
+    ValueMap v_map = phi_values;
+    for (auto bb : loop->get_blocks()) {
+        // as hot as the original, which is what BlockLayout compares
+        auto bb_new = BasicBlock::create(m_, "", func);
+        bb_new->set_count(bb->get_count());
+        v_map[bb] = bb_new;
+    }
+    auto map_value = [&](Value *val) {
+        auto it = v_map.find(val);
+        return it == v_map.end() ? val : it->second;
+    };
+    auto map_target = [&](Value *bb) {
+        return bb == header ? header : map_value(bb)->as<BasicBlock>();
+    };
+
+    std::vector<Instruction *> instrs;
+    for (auto bb : loop->get_blocks()) {
+        auto bb_new = v_map[bb]->as<BasicBlock>();
+        for (auto &instr : bb->get_instructions()) {
+            if (bb == header and instr.is_phi())
+                continue;
+            Instruction *instr_new;
+            if (instr.is_br()) {
+                auto br = instr.as<BranchInst>();
+                if (bb == header) {
+                    // the exit test passes in every copy
+                    auto body = br->get_operand(1);
+                    if (not loop->contains(body->as<BasicBlock>()))
+                        body = br->get_operand(2);
+                    instr_new = BranchInst::create_br(map_target(body), bb_new);
+                } else if (br->is_cond_br()) {
+                    // the condition is mapped with the other operands below
+                    instr_new = BranchInst::create_cond_br(
+                        br->get_condition(), map_target(br->get_operand(1)),
+                        map_target(br->get_operand(2)), bb_new);
+                } else {
+                    instr_new = BranchInst::create_br(
+                        map_target(br->get_operand(0)), bb_new);
+                }
+            } else {
+                instr_new = instr.clone(bb_new);
+                // phis are not inserted on creation, they come first in bb
+                if (instr.is_phi())
+                    bb_new->add_instruction(instr_new);
+            }
+            v_map[&instr] = instr_new;
+            instrs.push_back(instr_new);
+        }
+    }
+    for (auto instr : instrs) {
+        // branch targets are final already, only the condition is left
+        unsigned num_operands = instr->get_num_operand();
+        if (instr->is_br())
+            num_operands = instr->as<BranchInst>()->is_cond_br() ? 1 : 0;
+        for (unsigned i = 0; i < num_operands; i++) {
+            auto op = instr->get_operand(i);
+            auto op_new = map_value(op);
+            if (op_new != op)
+                instr->set_operand(i, op_new);
+        }
+        if (auto phi = instr->dyn_cast<PhiInst>()) {
+            for (unsigned i = 0; i < phi->get_num_incoming(); i++)
+                phi->set_incoming_block(
+                    i, map_value(phi->get_incoming_block(i))->as<BasicBlock>());
+        }
+    }
+
+    ValueMap next_values;
+    for (auto phi : get_phis(header))
+        next_values[phi] = map_value(phi->get_incoming_value_for(latch));
+    phi_values = std::move(next_values);
+    latch_copy = v_map[latch]->as<BasicBlock>();
+    return v_map[header]->as<BasicBlock>();
+}
+
+void LoopUnroll::peel(Loop *loop, unsigned count) {
+    if (count == 0)
+        return;
+    auto header = loop->get_header();
+    auto preheader = loop->get_preheader();
+    ValueMap phi_values;
+    for (auto phi : get_phis(header))
+        phi_values[phi] = phi->get_incoming_value_for(preheader);
+    auto pred = preheader;
+    for (unsigned i = 0; i < count; i++) {
+        BasicBlock *latch_copy;
+        auto header_copy = clone_iteration(loop, phi_values, latch_copy);
+        pred->get_terminator()->as<BranchInst>()->replace_successor(
+            header, header_copy);
+        pred = latch_copy;
+    }
+    // the loop is entered from the last copy
+    for (auto phi : get_phis(header))
+        replace_incoming(phi, preheader, phi_values[phi], pred);
+}
+
+void LoopUnroll::unroll_partial(Loop *loop, unsigned factor) {
+    auto header = loop->get_header();
+    auto latch = loop->get_latches().front();
+    ValueMap phi_values;
+    for (auto phi : get_phis(header))
+        phi_values[phi] = phi->get_incoming_value_for(latch);
+    // the copies are made from the loop before its latch is redirected
+    std::vector<std::pair<BasicBlock *, BasicBlock *>> copies;
+    for (unsigned i = 1; i < factor; i++) {
+        BasicBlock *latch_copy;
+        auto header_copy = clone_iteration(loop, phi_values, latch_copy);
+        copies.emplace_back(header_copy, latch_copy);
+    }
+    auto pred = latch;
+    for (auto [header_copy, latch_copy] : copies) {
+        pred->get_terminator()->as<BranchInst>()->replace_successor(
+            header, header_copy);
+        pred = latch_copy;
+    }
+    // the back edge leaves the last copy
+    for (auto phi : get_phis(header))
+        replace_incoming(phi, latch, phi_values[phi], pred);
+}
+
+void LoopUnroll::unroll_full(Loop *loop, unsigned trip_count) {
+    peel(loop, trip_count);
+    // the test of the header fails the next time, the loop body is dead
+    auto header = loop->get_header();
+    auto br = header->get_terminator()->as<BranchInst>();
+    auto body = br->get_operand(1)->as<BasicBlock>();
+    auto exit = br->get_operand(2)->as<BasicBlock>();
+    if (not loop->contains(body))
+        std::swap(body, exit);
+    for (auto phi : get_phis(body))
+        phi->remove_incoming(header);
+    header->erase_instr(br);
+    BranchInst::create_br(exit, header);
+}
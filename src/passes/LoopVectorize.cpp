@@ -0,0 +1,272 @@
+#include "LoopVectorize.hpp"
+#include "AliasAnalysis.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+// the address a load or store goes through
+Value *get_address(Instruction *instr) {
+    return instr->is_load() ? instr->get_operand(0) : instr->get_operand(1);
+}
+
+// both compute the same address in every iteration
+bool same_address(Value *ptr1, Value *ptr2) {
+    if (ptr1 == ptr2)
+        return true;
+    auto gep1 = ptr1->dyn_cast<GetElementPtrInst>();
+    auto gep2 = ptr2->dyn_cast<GetElementPtrInst>();
+    if (gep1 == nullptr or gep2 == nullptr)
+        return false;
+    auto ops1 = gep1->get_operands(), ops2 = gep2->get_operands();
+    return std::equal(ops1.begin(), ops1.end(), ops2.begin(), ops2.end());
+}
+
+Instruction *create_binary(Instruction::OpID id, Value *lhs, Value *rhs,
+                           BasicBlock *bb) {
+    switch (id) {
+    case Instruction::add:
+        return IBinaryInst::create_add(lhs, rhs, bb);
+    case Instruction::sub:
+        return IBinaryInst::create_sub(lhs, rhs, bb);
+    case Instruction::mul:
+        return IBinaryInst::create_mul(lhs, rhs, bb);
+    case Instruction::sdiv:
+        return IBinaryInst::create_sdiv(lhs, rhs, bb);
+    case Instruction::fadd:
+        return FBinaryInst::create_fadd(lhs, rhs, bb);
+    case Instruction::fsub:
+        return FBinaryInst::create_fsub(lhs, rhs, bb);
+    case Instruction::fmul:
+        return FBinaryInst::create_fmul(lhs, rhs, bb);
+    default:
+        return FBinaryInst::create_fdiv(lhs, rhs, bb);
+    }
+}
+} // namespace
+
+void LoopVectorize::run() {
+    auto loop_info = get_analysis<LoopInfo>();
+    auto induction_vars = get_analysis<InductionVars>();
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        // only innermost loops change, the analyses of the others hold
+        for (auto loop : loop_info->get_loops_in_post_order(&func)) {
+            Plan plan;
+            if (not can_vectorize(loop, induction_vars, plan))
+                continue;
+            vectorize(loop, plan);
+            add_stat("loops vectorized");
+        }
+    }
+}
+
+bool LoopVectorize::can_vectorize(Loop *loop, InductionVars *induction_vars,
+                                  Plan &plan) {
+    auto header = loop->get_header();
+    auto preheader = loop->get_preheader();
+    if (not loop->get_sub_loops().empty() or preheader == nullptr or
+        loop->get_blocks().size() != 2 or loop->get_latches().size() != 1 or
+        header->get_pre_basic_blocks().size() != 2)
+        return false;
+    auto body = loop->get_latches().front();
+    if (body == header or body->get_pre_basic_blocks().size() != 1)
+        return false;
+    auto is_invariant = [&](Value *val) {
+        auto instr = val->dyn_cast<Instruction>();
+        return instr == nullptr or not loop->contains(instr->get_parent());
+    };
+
+    // while (iv < n) with iv = init, init + 1, ...
+    auto iv = induction_vars->get_exit_var(loop);
+    Instruction::OpID op{};
+    auto bound = induction_vars->get_exit_bound(loop, op);
+    if (iv == nullptr or iv->step != 1 or op != Instruction::lt or
+        not is_invariant(bound) or iv->next->get_parent() != body)
+        return false;
+    // the vector loop tests n - iv, it must not wrap around: iv stays in
+    // [init, n] once it is in the loop, init itself is checked here
+    auto init = iv->init->dyn_cast<ConstantInt>();
+    if (init == nullptr or init->get_value() < 0)
+        return false;
+    if (init->get_value() > 0) {
+        auto c_bound = bound->dyn_cast<ConstantInt>();
+        if (c_bound == nullptr or
+            static_cast<long>(c_bound->get_value()) - init->get_value() <
+                INT_MIN)
+            return false;
+    }
+    // the phi, the exit test and the branch
+    if (header->get_num_of_instr() != 3)
+        return false;
+
+    // the values of the body that become vectors
+    std::unordered_set<Value *> vectors, addresses;
+    std::vector<Instruction *> accesses;
+    auto is_vector_operand = [&](Value *val) {
+        return vectors.count(val) or is_invariant(val);
+    };
+    for (auto &instr : body->get_instructions()) {
+        if (&instr == iv->next or instr.is_br())
+            continue;
+        if (auto gep = instr.dyn_cast<GetElementPtrInst>()) {
+            auto num_ops = gep->get_num_operand();
+            auto elem = gep->get_element_type();
+            if (gep->get_operand(num_ops - 1) != iv->phi or
+                not VectorType::is_valid_element_type(elem))
+                return false;
+            for (unsigned i = 0; i + 1 < num_ops; i++)
+                if (not is_invariant(gep->get_operand(i)))
+                    return false;
+            // only an address of the accesses here
+            for (auto &use : gep->get_use_list()) {
+                auto user = use.val_->as<Instruction>();
+                if (user->get_parent() != body or
+                    not((user->is_load() and use.arg_no_ == 0) or
+                        (user->is_store() and use.arg_no_ == 1)))
+                    return false;
+            }
+            addresses.insert(gep);
+            continue;
+        }
+        if (instr.is_load() or instr.is_store()) {
+            if (not addresses.count(get_address(&instr)) or
+                (instr.is_store() and
+                 not is_vector_operand(instr.get_operand(0))))
+                return false;
+            accesses.push_back(&instr);
+        } else if (instr.isBinary()) {
+            if (not is_vector_operand(instr.get_operand(0)) or
+                not is_vector_operand(instr.get_operand(1)))
+                return false;
+        } else {
+            return false;
+        }
+        if (instr.is_void())
+            continue;
+        // the exit is in the header, nothing of the body is used after the
+        // loop, but check for other users in the body
+        for (auto &use : instr.get_use_list())
+            if (use.val_->as<Instruction>()->get_parent() != body)
+                return false;
+        vectors.insert(&instr);
+    }
+    // no iteration reads or writes what another one writes
+    for (std::size_t i = 0; i < accesses.size(); i++) {
+        for (std::size_t j = i + 1; j < accesses.size(); j++) {
+            if (accesses[i]->is_load() and accesses[j]->is_load())
+                continue;
+            auto ptr1 = get_address(accesses[i]);
+            auto ptr2 = get_address(accesses[j]);
+            if (not same_address(ptr1, ptr2) and
+                AliasAnalysis::alias(ptr1, ptr2) != AliasAnalysis::NoAlias)
+                return false;
+        }
+    }
+    plan = {iv, bound, body};
+    return true;
+}
+
+void LoopVectorize::vectorize(Loop *loop, const Plan &plan) {
+    auto header = loop->get_header();
+    auto preheader = loop->get_preheader();
+    auto func = header->get_parent();
+    auto vector_header = BasicBlock::create(m_, "", func);
+    auto vector_body = BasicBlock::create(m_, "", func);
+    auto iv = plan.iv;
+    splats_.clear();
+
+    // viv = phi [init, preheader], [viv + width, vector body]
+    // if (n - viv > width - 1) vector body else the scalar loop
+    auto viv = PhiInst::create_phi(m_->get_int32_type(), vector_header);
+    vector_header->add_instruction(viv);
+    auto left = IBinaryInst::create_sub(plan.bound, viv, vector_header);
+    auto enough = ICmpInst::create_gt(
+        left, ConstantInt::get(static_cast<int>(width) - 1, m_),
+        vector_header);
+    BranchInst::create_cond_br(enough, vector_body, header, vector_header);
+
+    std::unordered_map<Value *, Value *> v_map;
+    auto get_vector = [&](Value *val) {
+        auto it = v_map.find(val);
+        return it == v_map.end() ? get_splat(val, preheader) : it->second;
+    };
+    for (auto &instr : plan.body->get_instructions()) {
+        if (&instr == iv->next or instr.is_br())
+            continue;
+        Value *vector;
+        if (auto gep = instr.dyn_cast<GetElementPtrInst>()) {
+            // the first of width elements, seen as a vector of them
+            auto first = gep->clone(vector_body);
+            first->set_operand(first->get_num_operand() - 1, viv);
+            auto vector_ty = m_->get_vector_type(gep->get_element_type(), width);
+            vector = BitCastInst::create_bitcast(
+                first, m_->get_pointer_type(vector_ty), vector_body);
+        } else if (instr.is_load()) {
+            vector = LoadInst::create_load(v_map.at(instr.get_operand(0)),
+                                           vector_body);
+        } else if (instr.is_store()) {
+            vector = StoreInst::create_store(get_vector(instr.get_operand(0)),
+                                             v_map.at(instr.get_operand(1)),
+                                             vector_body);
+        } else {
+            vector = create_binary(instr.get_instr_type(),
+                                   get_vector(instr.get_operand(0)),
+                                   get_vector(instr.get_operand(1)),
+                                   vector_body);
+        }
+        v_map[&instr] = vector;
+    }
+    auto next = IBinaryInst::create_add(
+        viv, ConstantInt::get(static_cast<int>(width), m_), vector_body);
+    BranchInst::create_br(vector_header, vector_body);
+    viv->add_phi_pair_operand(iv->init, preheader);
+    viv->add_phi_pair_operand(next, vector_body);
+
+    // the scalar loop goes on from where the vector loop stopped
+    preheader->get_terminator()->as<BranchInst>()->replace_successor(
+        header, vector_header);
+    auto idx = iv->phi->get_incoming_index(preheader);
+    iv->phi->set_incoming_value(idx, viv);
+    iv->phi->set_incoming_block(idx, vector_header);
+}
+
+Value *LoopVectorize::get_splat(Value *val, BasicBlock *preheader) {
+    auto &splat = splats_[val];
+    if (splat)
+        return splat;
+    // the array lives in the entry block like the other allocas
+    auto entry = preheader->get_parent()->get_entry_block();
+    auto ty = val->get_type();
+    auto array = entry->create_before(
+        &entry->get_instructions().front(), [&](BasicBlock *bb) {
+            return AllocaInst::create_alloca(m_->get_array_type(ty, width),
+                                             bb);
+        });
+    auto pos = preheader->get_terminator();
+    auto zero = ConstantInt::get(0, m_);
+    for (unsigned i = 0; i < width; i++) {
+        auto elem = preheader->create_before(pos, [&](BasicBlock *bb) {
+            return GetElementPtrInst::create_gep(
+                array, {zero, ConstantInt::get(static_cast<int>(i), m_)}, bb);
+        });
+        preheader->create_before(pos, [&](BasicBlock *bb) {
+            return StoreInst::create_store(val, elem, bb);
+        });
+    }
+    auto vector_ty = m_->get_vector_type(ty, width);
+    auto ptr = preheader->create_before(pos, [&](BasicBlock *bb) {
+        return BitCastInst::create_bitcast(
+            array, m_->get_pointer_type(vector_ty), bb);
+    });
+    splat = preheader->create_before(
+        pos, [&](BasicBlock *bb) { return LoadInst::create_load(ptr, bb); });
+    return splat;
+}
@@ -3,162 +3,211 @@
 #include "Value.hpp"
 
 #include <memory>
+#include <unordered_set>
 
-void Mem2Reg::run() {
-    // 创建支配树分析 Pass 的实例
-    dominators_ = std::make_unique<Dominators>(m_);
-    // 建立支配树
-    dominators_->run();
-    // 以函数为单元遍历实现 Mem2Reg 算法
-    for (auto &f : m_->get_functions()) {
-        if (f.is_declaration())
-            continue;
-        func_ = &f;
-        var_val_stack.clear();
-        phi_lval.clear();
-        if (func_->get_basic_blocks().size() >= 1) {
-            // 对应伪代码中 phi 指令插入的阶段
-            generate_phi();
-            // 对应伪代码中重命名阶段
-            rename(func_->get_entry_block());
-        }
-        // 后续 DeadCode 将移除冗余的局部变量的分配空间
+void Mem2Reg::prepare() {
+    // 获取支配树分析结果
+    dominators_ = get_analysis<Dominators>();
+}
+
+// 以函数为单元实现 Mem2Reg 算法
+void Mem2Reg::run_on_func(Function *func) {
+    if (func->get_basic_blocks().size() >= 1) {
+        FuncState state;
+        state.func = func;
+        // 对应伪代码中 phi 指令插入的阶段
+        generate_phi(state);
+        // 对应伪代码中重命名阶段
+        rename(state, func->get_entry_block());
     }
+    // 后续 DeadCode 将移除冗余的局部变量的分配空间
 }
 
-void Mem2Reg::generate_phi() {
-    // global_live_var_name 是全局名字集合，以 alloca 出的局部变量来统计。
-    // 步骤一：找到活跃在多个 block 的全局名字集合，以及它们所属的 bb 块
-    std::set<Value *> global_live_var_name;
-    std::map<Value *, std::set<BasicBlock *>> live_var_2blocks;
-    for (auto &bb : func_->get_basic_blocks()) {
-        std::set<Value *> var_is_killed;
+void Mem2Reg::generate_phi(FuncState &state) {
+    // 步骤一：为被 store 过的局部变量编号，并按编号收集
+    // 定值块(有 store)与向上暴露使用块(块内第一次访问是 load)
+    std::vector<std::vector<BasicBlock *>> def_blocks, use_blocks;
+    for (auto &bb : state.func->get_basic_blocks()) {
         for (auto &instr : bb.get_instructions()) {
             if (instr.is_store()) {
                 // store i32 a, i32 *b
                 // a is r_val, b is l_val
                 auto l_val = static_cast<StoreInst *>(&instr)->get_lval();
-                if (is_valid_ptr(l_val)) {
-                    global_live_var_name.insert(l_val);
-                    live_var_2blocks[l_val].insert(&bb);
+                if (is_valid_ptr(l_val) and
+                    not state.var_index.count(l_val)) {
+                    state.var_index.emplace(l_val, state.vars.size());
+                    state.vars.push_back(l_val);
                 }
             }
         }
     }
+    def_blocks.resize(state.vars.size());
+    use_blocks.resize(state.vars.size());
+    state.var_val_stack.resize(state.vars.size());
+    // 每个变量在当前块内最后访问的块，用来识别块内第一次访问
+    std::vector<BasicBlock *> seen_in(state.vars.size(), nullptr);
+    for (auto &bb : state.func->get_basic_blocks()) {
+        for (auto &instr : bb.get_instructions()) {
+            if (not instr.is_load() and not instr.is_store())
+                continue;
+            auto l_val = instr.is_load()
+                             ? static_cast<LoadInst *>(&instr)->get_lval()
+                             : static_cast<StoreInst *>(&instr)->get_lval();
+            auto idx = state.get_var_index(l_val);
+            if (idx < 0)
+                continue;
+            if (seen_in[idx] != &bb and instr.is_load())
+                use_blocks[idx].push_back(&bb);
+            if (instr.is_store() and
+                (def_blocks[idx].empty() or def_blocks[idx].back() != &bb))
+                def_blocks[idx].push_back(&bb);
+            seen_in[idx] = &bb;
+        }
+    }
 
-    // 步骤二：从支配树获取支配边界信息，并在对应位置插入 phi 指令
-    std::map<std::pair<BasicBlock *, Value *>, bool>
-        bb_has_var_phi; // bb has phi for var
-    for (auto var : global_live_var_name) {
-        std::vector<BasicBlock *> work_list;
-        work_list.assign(live_var_2blocks[var].begin(),
-                         live_var_2blocks[var].end());
+    // 步骤二：逐个变量求活跃入口块，再从支配边界获取 phi 的位置。
+    // 只在变量活跃进入的边界块插入 phi（pruned SSA），
+    // 只在块内局部使用的变量没有任何活跃入口块，不产生 phi
+    std::unordered_set<BasicBlock *> live_in, is_def, has_phi;
+    std::vector<BasicBlock *> work_list;
+    for (unsigned idx = 0; idx < state.vars.size(); idx++) {
+        if (use_blocks[idx].empty())
+            continue;
+        // 沿前驱反向传播，直到定值块为止
+        live_in.clear();
+        is_def.clear();
+        is_def.insert(def_blocks[idx].begin(), def_blocks[idx].end());
+        work_list.assign(use_blocks[idx].begin(), use_blocks[idx].end());
+        live_in.insert(work_list.begin(), work_list.end());
+        while (not work_list.empty()) {
+            auto bb = work_list.back();
+            work_list.pop_back();
+            for (auto pred : bb->get_pre_basic_blocks())
+                if (not is_def.count(pred) and live_in.insert(pred).second)
+                    work_list.push_back(pred);
+        }
+
+        auto var = state.vars[idx];
+        has_phi.clear();
+        work_list.assign(def_blocks[idx].begin(), def_blocks[idx].end());
         for (unsigned i = 0; i < work_list.size(); i++) {
             auto bb = work_list[i];
-            for (auto bb_dominance_frontier_bb :
-                 dominators_->get_dominance_frontier(bb)) {
-                if (bb_has_var_phi.find({bb_dominance_frontier_bb, var}) ==
-                    bb_has_var_phi.end()) {
-                    // generate phi for bb_dominance_frontier_bb & add
-                    // bb_dominance_frontier_bb to work list
-                    auto phi = PhiInst::create_phi(
-                        var->get_type()->get_pointer_element_type(),
-                        bb_dominance_frontier_bb);
-                    phi_lval.emplace(phi, var);
-                    bb_dominance_frontier_bb->add_instr_begin(phi);
-                    work_list.push_back(bb_dominance_frontier_bb);
-                    bb_has_var_phi[{bb_dominance_frontier_bb, var}] = true;
-                }
+            for (auto df_bb : dominators_->get_dominance_frontier(bb)) {
+                if (not live_in.count(df_bb) or
+                    not has_phi.insert(df_bb).second)
+                    continue;
+                // generate phi for df_bb & add df_bb to work list
+                auto phi = PhiInst::create_phi(
+                    var->get_type()->get_pointer_element_type(), df_bb);
+                state.phi_lval.emplace(phi, idx);
+                df_bb->add_instr_begin(phi);
+                add_stat("phis inserted");
+                work_list.push_back(df_bb);
             }
         }
     }
 }
 
-void Mem2Reg::rename(BasicBlock *bb) {
+void Mem2Reg::rename(FuncState &state, BasicBlock *entry) {
     // 步骤一：将 phi 指令作为 lval 的最新定值，lval 即是为局部变量
     // alloca出的地址空间 步骤二：用 lval 最新的定值替代对应的load指令
     // 步骤三：将store 指令的 rval，也即被存入内存的值，作为 lval 的最新定值
     // 步骤四：为lval 对应的 phi 指令参数补充完整
-    // 步骤五：对 bb在支配树上的所有后继节点，递归执行 re_name 操作
+    // 步骤五：对 bb在支配树上的所有后继节点，执行 re_name 操作
     // 步骤六：pop出 lval的最新定值
     // 步骤七：清除冗余的指令
+    // 支配树用显式栈遍历，很深的支配树也不会耗尽调用栈。
+    // pushed 按顺序记录每次压栈的变量编号，块退出时弹回进入时的长度
+    struct Frame {
+        BasicBlock *bb;
+        unsigned child;       // 下一个要访问的支配树孩子
+        std::size_t log_size; // 进入时 pushed 的长度
+    };
+    std::vector<Frame> stack;
+    std::vector<unsigned> pushed;
     std::vector<Instruction *> wait_delete;
 
-    // 步骤三：将 phi 指令作为 lval 的最新定值，lval 即是为局部变量 alloca
-    // 出的地址空间
-    for (auto &instr : bb->get_instructions()) {
-        if (instr.is_phi()) {
-            auto phi_inst = static_cast<PhiInst *>(&instr);
-            // 检查phi指令是否在映射中（可能在ConstPropagation等优化后被删除）
-            if (phi_lval.find(phi_inst) != phi_lval.end()) {
-                auto l_val = phi_lval.at(phi_inst);
-                var_val_stack[l_val].push_back(&instr);
-            }
+    auto enter = [&](BasicBlock *bb) {
+        stack.push_back({bb, 0, pushed.size()});
+        auto push_val = [&](unsigned idx, Value *val) {
+            state.var_val_stack[idx].push_back(val);
+            pushed.push_back(idx);
+        };
+        // 步骤一：将 phi 指令作为 lval 的最新定值
+        for (auto &instr : bb->get_instructions()) {
+            if (not instr.is_phi())
+                break;
+            // 检查phi指令是否在映射中（可能是之前运行留下的phi）
+            auto it = state.phi_lval.find(static_cast<PhiInst *>(&instr));
+            if (it != state.phi_lval.end())
+                push_val(it->second, &instr);
         }
-    }
 
-    for (auto &instr : bb->get_instructions()) {
-        // 步骤四：用 lval 最新的定值替代对应的load指令
-        if (instr.is_load()) {
-            auto l_val = static_cast<LoadInst *>(&instr)->get_lval();
-            if (is_valid_ptr(l_val)) {
-                if (var_val_stack.find(l_val) != var_val_stack.end()) {
+        for (auto &instr : bb->get_instructions()) {
+            // 步骤二：用 lval 最新的定值替代对应的load指令
+            if (instr.is_load()) {
+                auto idx = state.get_var_index(
+                    static_cast<LoadInst *>(&instr)->get_lval());
+                // 没有到达定值的 load 读的是未初始化的值，保持原样
+                if (idx >= 0 and not state.var_val_stack[idx].empty()) {
                     // 此处指令替换会维护 UD 链与 DU 链
-                    instr.replace_all_use_with(var_val_stack[l_val].back());
+                    instr.replace_all_use_with(
+                        state.var_val_stack[idx].back());
                     wait_delete.push_back(&instr);
                 }
             }
-        }
-        // 步骤五：将 store 指令的 rval，也即被存入内存的值，作为 lval
-        // 的最新定值
-        if (instr.is_store()) {
-            auto l_val = static_cast<StoreInst *>(&instr)->get_lval();
-            auto r_val = static_cast<StoreInst *>(&instr)->get_rval();
-            if (is_valid_ptr(l_val)) {
-                var_val_stack[l_val].push_back(r_val);
-                wait_delete.push_back(&instr);
+            // 步骤三：将 store 指令的 rval，也即被存入内存的值，作为 lval
+            // 的最新定值
+            if (instr.is_store()) {
+                auto store = static_cast<StoreInst *>(&instr);
+                auto idx = state.get_var_index(store->get_lval());
+                if (idx >= 0) {
+                    push_val(idx, store->get_rval());
+                    wait_delete.push_back(&instr);
+                }
             }
         }
-    }
 
-    // 步骤六：为 lval 对应的 phi 指令参数补充完整
-    for (auto succ_bb : bb->get_succ_basic_blocks()) {
-        for (auto &instr : succ_bb->get_instructions()) {
-            if (instr.is_phi()) {
-                auto l_val = phi_lval.at(static_cast<PhiInst *>(&instr));
-                if (var_val_stack.find(l_val) != var_val_stack.end() &&
-                    var_val_stack[l_val].size() != 0) {
+        // 步骤四：为 lval 对应的 phi 指令参数补充完整
+        for (auto succ_bb : bb->get_succ_basic_blocks()) {
+            for (auto &instr : succ_bb->get_instructions()) {
+                if (not instr.is_phi())
+                    break;
+                // phis of an earlier run are no promoted variables
+                auto it = state.phi_lval.find(static_cast<PhiInst *>(&instr));
+                if (it == state.phi_lval.end())
+                    continue;
+                auto &vals = state.var_val_stack[it->second];
+                if (not vals.empty())
                     static_cast<PhiInst *>(&instr)->add_phi_pair_operand(
-                        var_val_stack[l_val].back(), bb);
-                }
+                        vals.back(), bb);
                 // 对于 phi 参数只有一个前驱定值的情况，将会输出 [ undef, bb ]
                 // 的参数格式
             }
         }
-    }
 
-    // 步骤七：对 bb 在支配树上的所有后继节点，递归执行 re_name 操作
-    for (auto dom_succ_bb : dominators_->get_dom_tree_succ_blocks(bb)) {
-        rename(dom_succ_bb);
-    }
+        // 步骤七：清除冗余的指令，它们的值已经记录在定值栈中
+        if (not wait_delete.empty())
+            add_stat("loads and stores removed", wait_delete.size());
+        for (auto instr : wait_delete)
+            bb->erase_instr(instr);
+        wait_delete.clear();
+    };
 
-    // 步骤八：pop出 lval 的最新定值
-    for (auto &instr : bb->get_instructions()) {
-        if (instr.is_store()) {
-            auto l_val = static_cast<StoreInst *>(&instr)->get_lval();
-            if (is_valid_ptr(l_val)) {
-                var_val_stack[l_val].pop_back();
-            }
-        } else if (instr.is_phi()) {
-            auto l_val = phi_lval.at(static_cast<PhiInst *>(&instr));
-            if (var_val_stack.find(l_val) != var_val_stack.end()) {
-                var_val_stack[l_val].pop_back();
-            }
+    enter(entry);
+    while (not stack.empty()) {
+        auto &frame = stack.back();
+        // 步骤五：对 bb 在支配树上的所有后继节点，执行 re_name 操作
+        auto &children = dominators_->get_dom_tree_succ_blocks(frame.bb);
+        if (frame.child < children.size()) {
+            enter(children[frame.child++]);
+            continue;
         }
-    }
-
-    // 清除冗余的指令
-    for (auto instr : wait_delete) {
-        bb->erase_instr(instr);
+        // 步骤六：pop出 lval 的最新定值
+        while (pushed.size() > frame.log_size) {
+            state.var_val_stack[pushed.back()].pop_back();
+            pushed.pop_back();
+        }
+        stack.pop_back();
     }
 }
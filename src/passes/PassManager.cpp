@@ -0,0 +1,522 @@
+#include "PassManager.hpp"
+#include "BlockLayout.hpp"
+#include "BoundsCheckElim.hpp"
+#include "ConstPropagation.hpp"
+#include "DeadCode.hpp"
+#include "FunctionInline.hpp"
+#include "GVN.hpp"
+#include "GlobalOpt.hpp"
+#include "IPConstProp.hpp"
+#include "InstCombine.hpp"
+#include "LICM.hpp"
+#include "LoadStoreElim.hpp"
+#include "LoopUnroll.hpp"
+#include "LoopVectorize.hpp"
+#include "MemoryReport.hpp"
+#include "Mem2Reg.hpp"
+#include "SROA.hpp"
+#include "SimplifyCFG.hpp"
+#include "TailRecursionElim.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+#include "Verifier.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <ctime>
+#include <cxxabi.h>
+#include <iomanip>
+#include <ostream>
+#include <typeinfo>
+
+namespace {
+
+// the counters of the function a FunctionPass runs on in this thread, kept
+// apart so that they are added up in function order rather than in the
+// order the threads happen to finish
+struct FuncStats {
+    const Pass *pass;
+    Pass::Stats *stats;
+};
+thread_local FuncStats func_stats{nullptr, nullptr};
+
+void add_to(Pass::Stats &stats, const std::string &name, long delta) {
+    for (auto &[stat, value] : stats) {
+        if (stat == name) {
+            value += delta;
+            return;
+        }
+    }
+    stats.emplace_back(name, delta);
+}
+
+void count_ir(Module *m, unsigned &instrs, unsigned &blocks) {
+    instrs = blocks = 0;
+    for (auto &func : m->get_functions()) {
+        for (auto &bb : func.get_basic_blocks()) {
+            blocks++;
+            instrs += bb.get_num_of_instr();
+        }
+    }
+}
+
+void print_json_string(std::ostream &os, const std::string &str) {
+    os << '"';
+    for (char c : str) {
+        if (c == '"' or c == '\\')
+            os << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            os << "\\u" << std::hex << std::setw(4) << std::setfill('0')
+               << int(c) << std::dec << std::setfill(' ');
+        else
+            os << c;
+    }
+    os << '"';
+}
+
+template <typename PassType> std::unique_ptr<Pass> make_pass(Module *m) {
+    return std::make_unique<PassType>(m);
+}
+
+// unroll-full: only loops unrolled completely, factor 1
+std::unique_ptr<Pass> make_full_unroll(Module *m) {
+    return std::make_unique<LoopUnroll>(m, 1);
+}
+
+// the names -passes knows, the second spelling of a pass is its option
+const std::pair<const char *, std::unique_ptr<Pass> (*)(Module *)>
+    pass_names[] = {
+        {"mem2reg", make_pass<Mem2Reg>},
+        {"dce", make_pass<DeadCode>},
+        {"sccp", make_pass<ConstPropagation>},
+        {"const-prop", make_pass<ConstPropagation>},
+        {"ipcp", make_pass<IPConstProp>},
+        {"globalopt", make_pass<GlobalOpt>},
+        {"tre", make_pass<TailRecursionElim>},
+        {"inline", make_pass<FunctionInline>},
+        {"func-inline", make_pass<FunctionInline>},
+        {"sroa", make_pass<SROA>},
+        {"lse", make_pass<LoadStoreElim>},
+        {"instcombine", make_pass<InstCombine>},
+        {"simplify-cfg", make_pass<SimplifyCFG>},
+        {"gvn", make_pass<GVN>},
+        {"licm", make_pass<LICM>},
+        {"bce", make_pass<BoundsCheckElim>},
+        {"unroll", make_pass<LoopUnroll>},
+        {"unroll-full", make_full_unroll},
+        {"vectorize", make_pass<LoopVectorize>},
+        {"block-layout", make_pass<BlockLayout>},
+        {"verify", make_pass<Verifier>},
+};
+
+std::unique_ptr<Pass> (*find_pass(const std::string &name))(Module *) {
+    for (auto &[pass_name, create] : pass_names) {
+        if (name == pass_name)
+            return create;
+    }
+    return nullptr;
+}
+
+// splits a pipeline into pass names, "(" for repeat( and ")"
+std::string parse_pipeline(const std::string &text,
+                           std::vector<std::string> &steps) {
+    if (text.empty())
+        return "";
+    unsigned depth = 0;
+    std::size_t pos = 0;
+    while (true) {
+        auto begin = pos;
+        while (pos < text.size() and
+               (std::isalnum(static_cast<unsigned char>(text[pos])) or
+                text[pos] == '-'))
+            pos++;
+        auto name = text.substr(begin, pos - begin);
+        if (name == "repeat" and pos < text.size() and text[pos] == '(') {
+            steps.push_back("(");
+            depth++;
+            pos++;
+            continue;
+        }
+        if (name.empty())
+            return "missing pass name at '" + text.substr(pos) + "'";
+        if (not find_pass(name))
+            return "unknown pass '" + name + "'";
+        steps.push_back(name);
+        while (pos < text.size() and text[pos] == ')') {
+            if (depth == 0)
+                return "unbalanced ')'";
+            steps.push_back(")");
+            depth--;
+            pos++;
+        }
+        if (pos == text.size())
+            break;
+        if (text[pos] != ',')
+            return "unexpected '" + text.substr(pos) + "'";
+        pos++;
+    }
+    if (depth != 0)
+        return "missing ')'";
+    return "";
+}
+
+} // namespace
+
+std::string Pass::get_name() const {
+    int status = 0;
+    char *name =
+        abi::__cxa_demangle(typeid(*this).name(), nullptr, nullptr, &status);
+    std::string result = status == 0 ? name : typeid(*this).name();
+    std::free(name);
+    return result;
+}
+
+void Pass::add_stat(const std::string &name, long delta) {
+    if (delta > 0)
+        set_changed();
+    if (func_stats.pass == this) {
+        add_to(*func_stats.stats, name, delta);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    add_to(stats_, name, delta);
+}
+
+bool Pass::skips(Function *func) const {
+    return func->is_declaration() or (am_ and am_->is_frozen(func));
+}
+
+ThreadPool *Pass::get_thread_pool() const {
+    return am_ ? am_->get_thread_pool() : nullptr;
+}
+
+void FunctionPass::run() {
+    prepare();
+    std::vector<Function *> funcs;
+    for (auto &func : m_->get_functions()) {
+        if (not skips(&func))
+            funcs.push_back(&func);
+    }
+    // an event per function, named after the pass
+    auto trace_name = trace::is_enabled() ? get_name() : std::string();
+    auto run_traced = [&](Function *func) {
+        trace::Scope scope(trace_name, func->get_name());
+        run_on_func(func);
+    };
+    if (auto pool = get_thread_pool()) {
+        std::vector<Stats> stats(funcs.size());
+        pool->parallel_for(funcs.size(), [&](std::size_t i) {
+            func_stats = {this, &stats[i]};
+            run_traced(funcs[i]);
+            func_stats = {nullptr, nullptr};
+        });
+        for (auto &func_stat : stats)
+            for (auto &[name, value] : func_stat)
+                add_stat(name, value);
+    } else
+        for (auto func : funcs)
+            run_traced(func);
+    finish();
+}
+
+PassManager::PassManager(Module *m) : m_(m), am_(m) {}
+PassManager::~PassManager() = default;
+
+void PassManager::set_num_threads(unsigned num_threads) {
+    am_.set_thread_pool(nullptr);
+    pool_.reset();
+    if (num_threads > 1) {
+        pool_ = std::make_unique<ThreadPool>(num_threads);
+        am_.set_thread_pool(pool_.get());
+    }
+}
+
+void PassManager::add_pass(std::unique_ptr<Pass> pass) {
+    pass->set_analysis_manager(&am_);
+    steps_.push_back({std::move(pass)});
+}
+
+void PassManager::begin_repeat() {
+    open_groups_.push_back(steps_.size());
+    steps_.push_back({});
+}
+
+void PassManager::end_repeat() {
+    assert(not open_groups_.empty() && "No repeat group to end");
+    steps_[open_groups_.back()].group_end = steps_.size();
+    open_groups_.pop_back();
+    steps_.push_back({});
+}
+
+void PassManager::add_callback(std::function<void()> fn) {
+    assert(open_groups_.empty() && "Callback inside a repeat group");
+    Step step;
+    step.callback = std::move(fn);
+    steps_.push_back(std::move(step));
+}
+
+std::string PassManager::check_pipeline(const std::string &text) {
+    std::vector<std::string> steps;
+    return parse_pipeline(text, steps);
+}
+
+bool PassManager::pipeline_has(const std::string &text,
+                               const std::string &name) {
+    std::vector<std::string> steps;
+    parse_pipeline(text, steps);
+    return std::find(steps.begin(), steps.end(), name) != steps.end();
+}
+
+std::pair<std::string, std::string>
+PassManager::split_pipeline(const std::string &text, const std::string &name) {
+    unsigned depth = 0;
+    std::size_t begin = 0;
+    for (std::size_t pos = 0; pos <= text.size(); pos++) {
+        if (pos < text.size() and text[pos] != ',') {
+            depth += text[pos] == '(';
+            depth -= text[pos] == ')';
+            continue;
+        }
+        if (depth != 0)
+            continue;
+        if (pipeline_has(text.substr(begin, pos - begin), name))
+            return {begin == 0 ? "" : text.substr(0, begin - 1),
+                    text.substr(begin)};
+        begin = pos + 1;
+    }
+    return {text, ""};
+}
+
+std::pair<std::string, std::string>
+PassManager::split_pipeline_after(const std::string &text,
+                                  const std::vector<std::string> &names) {
+    unsigned depth = 0;
+    std::size_t begin = 0, cut = 0;
+    for (std::size_t pos = 0; pos <= text.size(); pos++) {
+        if (pos < text.size() and text[pos] != ',') {
+            depth += text[pos] == '(';
+            depth -= text[pos] == ')';
+            continue;
+        }
+        if (depth != 0)
+            continue;
+        auto step = text.substr(begin, pos - begin);
+        for (auto &name : names)
+            if (pipeline_has(step, name))
+                cut = pos;
+        begin = pos + 1;
+    }
+    if (cut == 0)
+        return {"", text};
+    return {text.substr(0, cut), cut < text.size() ? text.substr(cut + 1) : ""};
+}
+
+std::string PassManager::level_pipeline(unsigned level) {
+    switch (level) {
+    case 0:
+        return "";
+    case 1:
+        return "dce,sccp,instcombine,simplify-cfg,dce";
+    default:
+        return "dce,tre,inline,dce,globalopt,sccp,dce,sroa,mem2reg,dce,"
+               "repeat(lse,instcombine,simplify-cfg,gvn,dce),licm,dce,unroll,"
+               "repeat(ipcp,sccp,bce,instcombine,simplify-cfg,dce)";
+    }
+}
+
+std::string PassManager::add_pipeline(const std::string &text) {
+    std::vector<std::string> steps;
+    auto error = parse_pipeline(text, steps);
+    if (not error.empty())
+        return error;
+    Pass *last = nullptr;
+    for (auto &step : steps) {
+        if (step == "(") {
+            begin_repeat();
+            last = nullptr;
+        } else if (step == ")") {
+            end_repeat();
+            last = nullptr;
+        } else {
+            auto pass = find_pass(step)(m_);
+            // running it once more would not change anything
+            if (last and typeid(*last) == typeid(*pass))
+                continue;
+            last = pass.get();
+            add_pass(std::move(pass));
+        }
+    }
+    return "";
+}
+
+void PassManager::run() {
+    assert(open_groups_.empty() && "Repeat group not ended");
+    records_.clear();
+    generation_ = 0;
+    unchanged_at_.clear();
+    verify_failure_.clear();
+    if (verify_each_)
+        verify("before the passes");
+    if (verify_failure_.empty())
+        run_steps(0, steps_.size());
+}
+
+void PassManager::verify(const std::string &where) {
+    trace::Scope scope("verify");
+    Verifier verifier(m_);
+    verifier.run();
+    if (not verifier.is_valid())
+        verify_failure_ =
+            "broken ir " + where + ":\n" + verifier.get_report();
+}
+
+bool PassManager::run_steps(std::size_t begin, std::size_t end) {
+    bool changed = false;
+    for (auto i = begin; i < end and verify_failure_.empty(); i++) {
+        if (steps_[i].callback) {
+            steps_[i].callback();
+            continue;
+        }
+        if (steps_[i].pass) {
+            changed |= run_pass(steps_[i].pass.get());
+            continue;
+        }
+        auto group_end = steps_[i].group_end;
+        for (unsigned round = 0; round < max_repeat; round++) {
+            if (not run_steps(i + 1, group_end) or not verify_failure_.empty())
+                break;
+            changed = true;
+        }
+        i = group_end;
+    }
+    return changed;
+}
+
+bool PassManager::run_pass(Pass *pass) {
+    auto type = std::type_index(typeid(*pass));
+    auto unchanged = unchanged_at_.find(type);
+    if (unchanged != unchanged_at_.end() and unchanged->second == generation_)
+        return false;
+
+    PassRecord record;
+    bool report = timing_ or stats_;
+    if (report) {
+        record.name = pass->get_name();
+        if (stats_)
+            count_ir(m_, record.instrs_before, record.blocks_before);
+    }
+    std::size_t values_before = 0, bytes_before = 0;
+    if (memory_) {
+        values_before = m_->get_num_values();
+        bytes_before = m_->get_value_bytes();
+    }
+    pass->clear_stats();
+    pass->clear_changed();
+    auto wall_start = std::chrono::steady_clock::now();
+    auto cpu_start = std::clock();
+
+    {
+        trace::Scope scope(trace::is_enabled() ? pass->get_name() : "");
+        pass->run();
+    }
+    bool changed = pass->changed();
+    // the ir the analyses were computed on is still there otherwise
+    if (changed) {
+        am_.invalidate(pass->get_preserved());
+        generation_++;
+    } else {
+        unchanged_at_[type] = generation_;
+    }
+
+    if (report) {
+        auto cpu_end = std::clock();
+        auto wall_end = std::chrono::steady_clock::now();
+        record.wall_ms =
+            std::chrono::duration<double, std::milli>(wall_end - wall_start)
+                .count();
+        record.cpu_ms = 1000.0 * (cpu_end - cpu_start) / CLOCKS_PER_SEC;
+        record.peak_rss_kb = peak_rss_kb();
+        if (stats_)
+            count_ir(m_, record.instrs_after, record.blocks_after);
+        record.stats = pass->get_stats();
+        records_.push_back(std::move(record));
+    }
+
+    if (memory_)
+        memory_->add_phase(pass->get_name(),
+                           m_->get_num_values() - values_before,
+                           m_->get_value_bytes() - bytes_before);
+
+    // after the timing, checking is not part of the pass
+    if (auto verifier = dynamic_cast<Verifier *>(pass)) {
+        if (not verifier->is_valid())
+            verify_failure_ = "broken ir:\n" + verifier->get_report();
+    } else if (verify_each_ and changed) {
+        verify("after " + pass->get_name());
+    }
+    return changed;
+}
+
+void PassManager::print_timing_report(std::ostream &os) const {
+    double wall_total = 0, cpu_total = 0;
+    for (auto &record : records_) {
+        wall_total += record.wall_ms;
+        cpu_total += record.cpu_ms;
+    }
+    os << "===--- Pass execution timing report ---===\n";
+    os << std::fixed << std::setprecision(3);
+    os << std::setw(12) << "Wall(ms)" << std::setw(12) << "CPU(ms)"
+       << std::setw(14) << "PeakRSS(KB)"
+       << "  Pass\n";
+    for (auto &record : records_) {
+        os << std::setw(12) << record.wall_ms << std::setw(12)
+           << record.cpu_ms << std::setw(14) << record.peak_rss_kb << "  "
+           << record.name << "\n";
+    }
+    os << std::setw(12) << wall_total << std::setw(12) << cpu_total
+       << std::setw(14) << "" << "  Total\n";
+    os.unsetf(std::ios::floatfield);
+}
+
+void PassManager::print_stats_report(std::ostream &os) const {
+    os << "===--- Pass statistics report ---===\n";
+    for (auto &record : records_) {
+        os << record.name << ": instructions " << record.instrs_before
+           << " -> " << record.instrs_after << ", blocks "
+           << record.blocks_before << " -> " << record.blocks_after << "\n";
+        for (auto &[name, value] : record.stats)
+            os << "    " << std::setw(8) << value << " " << name << "\n";
+    }
+}
+
+void PassManager::print_json_report(std::ostream &os) const {
+    os << "{\"passes\": [";
+    for (unsigned i = 0; i < records_.size(); i++) {
+        auto &record = records_[i];
+        os << (i ? ",\n  " : "\n  ") << "{\"name\": ";
+        print_json_string(os, record.name);
+        if (timing_) {
+            os << ", \"wall_ms\": " << record.wall_ms
+               << ", \"cpu_ms\": " << record.cpu_ms
+               << ", \"peak_rss_kb\": " << record.peak_rss_kb;
+        }
+        if (stats_) {
+            os << ", \"instructions_before\": " << record.instrs_before
+               << ", \"instructions_after\": " << record.instrs_after
+               << ", \"blocks_before\": " << record.blocks_before
+               << ", \"blocks_after\": " << record.blocks_after
+               << ", \"stats\": {";
+            for (unsigned j = 0; j < record.stats.size(); j++) {
+                os << (j ? ", " : "");
+                print_json_string(os, record.stats[j].first);
+                os << ": " << record.stats[j].second;
+            }
+            os << "}";
+        }
+        os << "}";
+    }
+    os << "\n]}\n";
+}
@@ -0,0 +1,168 @@
+#include "Profile.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "FunctionCache.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <sstream>
+
+namespace {
+
+const char magic[] = "cminusf-profile";
+
+void add_hash(std::uint32_t &hash, std::uint32_t word) {
+    for (int i = 0; i < 4; i++)
+        hash = (hash ^ ((word >> (8 * i)) & 0xff)) * 16777619u;
+}
+
+// where instructions go in front of the block's code
+Instruction *get_first_code(BasicBlock *bb) {
+    for (auto &instr : bb->get_instructions())
+        if (not instr.is_phi() and not instr.is_alloca())
+            return &instr;
+    return nullptr;
+}
+
+} // namespace
+
+std::uint32_t Profile::hash_name(const std::string &name) {
+    std::uint32_t hash = 2166136261u;
+    for (unsigned char c : name)
+        hash = (hash ^ c) * 16777619u;
+    return hash;
+}
+
+std::uint32_t Profile::get_checksum(Function *func) {
+    std::unordered_map<BasicBlock *, std::uint32_t> index;
+    for (auto &bb : func->get_basic_blocks())
+        index.emplace(&bb, index.size());
+    std::uint32_t hash = 2166136261u;
+    add_hash(hash, index.size());
+    for (auto &bb : func->get_basic_blocks()) {
+        std::uint32_t num_calls = 0;
+        for (auto &instr : bb.get_instructions())
+            num_calls += instr.is_call();
+        add_hash(hash, num_calls);
+        add_hash(hash, bb.get_succ_basic_blocks().size());
+        for (auto succ : bb.get_succ_basic_blocks())
+            add_hash(hash, index.at(succ));
+    }
+    return hash;
+}
+
+void Profile::instrument(Module *m) {
+    std::vector<Constant *> words;
+    std::vector<std::pair<BasicBlock *, int>> counters;
+    auto word = [&](std::uint32_t val) {
+        words.push_back(ConstantInt::get(static_cast<int>(val), m));
+    };
+    Function *main = nullptr;
+    for (auto &func : m->get_functions()) {
+        if (func.is_declaration())
+            continue;
+        if (func.get_name() == "main")
+            main = &func;
+        word(hash_name(func.get_name()));
+        word(get_checksum(&func));
+        word(func.get_num_basic_blocks());
+        for (auto &bb : func.get_basic_blocks()) {
+            counters.emplace_back(&bb, words.size());
+            word(0);
+        }
+    }
+    if (words.empty())
+        return;
+    auto array_type = m->get_array_type(m->get_int32_type(), words.size());
+    auto records =
+        GlobalVariable::create("profile_counters", m, array_type, false,
+                               ConstantArray::get(array_type, words));
+    auto zero = ConstantInt::get(0, m);
+
+    // count = count + 1 in front of the code of each block
+    for (auto [bb, index] : counters) {
+        auto pos = get_first_code(bb);
+        auto ptr = bb->create_before(pos, [&](BasicBlock *bb) {
+            return GetElementPtrInst::create_gep(
+                records, {zero, ConstantInt::get(index, m)}, bb);
+        });
+        auto count = bb->create_before(
+            pos, [&](BasicBlock *bb) { return LoadInst::create_load(ptr, bb); });
+        auto next = bb->create_before(pos, [&](BasicBlock *bb) {
+            return IBinaryInst::create_add(count, ConstantInt::get(1, m), bb);
+        });
+        bb->create_before(pos, [&](BasicBlock *bb) {
+            return StoreInst::create_store(next, ptr, bb);
+        });
+    }
+
+    if (main == nullptr)
+        return;
+    auto init_type = FunctionType::get(
+        m->get_void_type(), {m->get_int32_ptr_type(), m->get_int32_type()});
+    auto init = Function::create(init_type, "profile_init", m);
+    auto entry = main->get_entry_block();
+    auto pos = get_first_code(entry);
+    auto first = entry->create_before(pos, [&](BasicBlock *bb) {
+        return GetElementPtrInst::create_gep(records, {zero, zero}, bb);
+    });
+    entry->create_before(pos, [&](BasicBlock *bb) {
+        return CallInst::create_call(
+            init, {first, ConstantInt::get(static_cast<int>(words.size()), m)},
+            bb);
+    });
+}
+
+bool Profile::read(const std::filesystem::path &path, std::string &error) {
+    std::ifstream file(path, std::ios::binary);
+    if (not file) {
+        error = "cannot open profile '" + path.string() + "'";
+        return false;
+    }
+    std::string text((std::istreambuf_iterator<char>(file)),
+                     std::istreambuf_iterator<char>());
+    hash_ = FunctionCache::hash(text);
+    records_.clear();
+
+    std::istringstream in(text);
+    std::string word;
+    if (not(in >> word) or word != magic) {
+        error = "'" + path.string() + "' is no profile";
+        return false;
+    }
+    std::uint32_t name, checksum, num_blocks;
+    while (in >> name >> checksum >> num_blocks) {
+        Record record{checksum, std::vector<long>(num_blocks)};
+        for (auto &count : record.counts)
+            in >> count;
+        if (not in)
+            break;
+        records_[name] = std::move(record);
+    }
+    if (not in.eof()) {
+        error = "'" + path.string() + "' is a broken profile";
+        return false;
+    }
+    return true;
+}
+
+unsigned Profile::annotate(Module *m) const {
+    unsigned num_annotated = 0;
+    for (auto &func : m->get_functions()) {
+        if (func.is_declaration())
+            continue;
+        auto it = records_.find(hash_name(func.get_name()));
+        if (it == records_.end() or
+            it->second.checksum != get_checksum(&func) or
+            it->second.counts.size() != func.get_num_basic_blocks())
+            continue;
+        auto count = it->second.counts.begin();
+        for (auto &bb : func.get_basic_blocks())
+            bb.set_count(*count++);
+        num_annotated++;
+    }
+    return num_annotated;
+}
@@ -0,0 +1,80 @@
+#include "SROA.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+
+#include <vector>
+
+void SROA::run() {
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        std::vector<AllocaInst *> candidates;
+        for (auto &bb : func.get_basic_blocks())
+            for (auto &instr : bb.get_instructions())
+                if (auto alloca = instr.dyn_cast<AllocaInst>())
+                    if (alloca->get_alloca_type()->is_array_type() and
+                        can_split(alloca))
+                        candidates.push_back(alloca);
+        for (auto alloca : candidates)
+            split(alloca);
+    }
+}
+
+int SROA::get_const_index(AllocaInst *alloca, GetElementPtrInst *gep) {
+    if (gep->get_operand(0) != alloca or gep->get_num_operand() != 3)
+        return -1;
+    auto first = gep->get_operand(1)->dyn_cast<ConstantInt>();
+    auto idx = gep->get_operand(2)->dyn_cast<ConstantInt>();
+    auto num = static_cast<ArrayType *>(alloca->get_alloca_type())
+                   ->get_num_of_elements();
+    if (not first or first->get_value() != 0 or not idx or
+        idx->get_value() < 0 or idx->get_value() >= int(num))
+        return -1;
+    return idx->get_value();
+}
+
+bool SROA::can_split(AllocaInst *alloca) {
+    for (auto &use : alloca->get_use_list()) {
+        auto gep = use.val_->dyn_cast<GetElementPtrInst>();
+        if (not gep or get_const_index(alloca, gep) < 0)
+            return false;
+        // the element address must not escape, e.g. into a call
+        for (auto &gep_use : gep->get_use_list()) {
+            auto user = gep_use.val_->as<Instruction>();
+            if (user->is_load())
+                continue;
+            if (user->is_store() and gep_use.arg_no_ == 1)
+                continue;
+            return false;
+        }
+    }
+    return true;
+}
+
+void SROA::split(AllocaInst *alloca) {
+    auto bb = alloca->get_parent();
+    auto elem_type =
+        static_cast<ArrayType *>(alloca->get_alloca_type())->get_element_type();
+    std::map<int, AllocaInst *> elements;
+    // keep the new allocas where the array was
+    auto get_element = [&](int idx) {
+        auto &elem = elements[idx];
+        if (not elem)
+            elem = bb->create_before(alloca, [&](BasicBlock *bb) {
+                return AllocaInst::create_alloca(elem_type, bb);
+            });
+        return elem;
+    };
+
+    std::vector<GetElementPtrInst *> geps;
+    for (auto &use : alloca->get_use_list())
+        geps.push_back(use.val_->as<GetElementPtrInst>());
+    for (auto gep : geps) {
+        gep->replace_all_use_with(get_element(get_const_index(alloca, gep)));
+        gep->get_parent()->erase_instr(gep);
+    }
+    bb->erase_instr(alloca);
+    add_stat("arrays split");
+    add_stat("element allocas", elements.size());
+}
@@ -0,0 +1,162 @@
+#include "SimplifyCFG.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <vector>
+
+namespace {
+std::vector<PhiInst *> get_phis(BasicBlock *bb) {
+    std::vector<PhiInst *> phis;
+    for (auto &instr : bb->get_instructions()) {
+        if (not instr.is_phi())
+            break;
+        phis.push_back(instr.as<PhiInst>());
+    }
+    return phis;
+}
+} // namespace
+
+void SimplifyCFG::run() {
+    for (auto &func : m_->get_functions()) {
+        if (skips(&func))
+            continue;
+        run_on_func(&func);
+    }
+}
+
+void SimplifyCFG::run_on_func(Function *func) {
+    bool changed;
+    do {
+        changed = fold_branches(func);
+        if (auto erased = func->remove_unreachable_basic_blocks()) {
+            add_stat("blocks erased", erased);
+            changed = true;
+        }
+        changed |= merge_blocks(func);
+        changed |= remove_forwarders(func);
+    } while (changed);
+}
+
+bool SimplifyCFG::fold_branches(Function *func) {
+    bool changed = false;
+    for (auto &bb : func->get_basic_blocks()) {
+        if (not bb.is_terminated() or not bb.get_terminator()->is_br())
+            continue;
+        auto br = bb.get_terminator()->as<BranchInst>();
+        if (not br->is_cond_br())
+            continue;
+        auto true_bb = br->get_operand(1)->as<BasicBlock>();
+        auto false_bb = br->get_operand(2)->as<BasicBlock>();
+        BasicBlock *taken;
+        if (true_bb == false_bb)
+            taken = true_bb;
+        else if (auto cond = br->get_condition()->dyn_cast<ConstantInt>())
+            taken = cond->get_value() ? true_bb : false_bb;
+        else
+            continue;
+        auto not_taken = taken == true_bb ? false_bb : true_bb;
+        if (not_taken != taken)
+            for (auto phi : get_phis(not_taken))
+                phi->remove_incoming(&bb);
+        // the destructor drops both edges, the new branch adds one back
+        bb.erase_instr(br);
+        BranchInst::create_br(taken, &bb);
+        add_stat("branches folded");
+        changed = true;
+    }
+    return changed;
+}
+
+bool SimplifyCFG::merge_blocks(Function *func) {
+    bool changed = false;
+    // only successors are erased, the iterator stays valid
+    for (auto &bb : func->get_basic_blocks())
+        while (try_merge(&bb))
+            changed = true;
+    return changed;
+}
+
+bool SimplifyCFG::try_merge(BasicBlock *bb) {
+    if (bb->get_succ_basic_blocks().size() != 1)
+        return false;
+    auto succ = bb->get_succ_basic_blocks().front();
+    if (succ == bb or succ->get_pre_basic_blocks().size() != 1 or
+        succ == succ->get_parent()->get_entry_block())
+        return false;
+
+    bb->erase_instr(bb->get_terminator());
+    // a single predecessor makes every phi trivial
+    for (auto phi : get_phis(succ)) {
+        phi->replace_all_use_with(phi->get_incoming_value(0));
+        succ->erase_instr(phi);
+    }
+    std::vector<Instruction *> instrs;
+    for (auto &instr : succ->get_instructions())
+        instrs.push_back(&instr);
+    for (auto instr : instrs) {
+        succ->remove_instr(instr);
+        bb->add_instruction(instr);
+        instr->set_parent(bb);
+    }
+    bb->take_succ_basic_blocks(succ);
+    succ->erase_from_parent();
+    delete succ;
+    add_stat("blocks merged");
+    return true;
+}
+
+bool SimplifyCFG::remove_forwarders(Function *func) {
+    bool changed = false;
+    auto &bbs = func->get_basic_blocks();
+    for (auto it = bbs.begin(); it != bbs.end();) {
+        auto bb = &*it++;
+        changed |= try_remove_forwarder(bb);
+    }
+    return changed;
+}
+
+bool SimplifyCFG::try_remove_forwarder(BasicBlock *bb) {
+    if (bb->get_num_of_instr() != 1 or not bb->is_terminated() or
+        bb == bb->get_parent()->get_entry_block())
+        return false;
+    auto br = bb->get_terminator();
+    if (not br->is_br() or br->as<BranchInst>()->is_cond_br())
+        return false;
+    auto target = br->get_operand(0)->as<BasicBlock>();
+    if (target == bb)
+        return false;
+
+    std::vector<BasicBlock *> preds;
+    for (auto pred : bb->get_pre_basic_blocks())
+        if (std::find(preds.begin(), preds.end(), pred) == preds.end())
+            preds.push_back(pred);
+    auto phis = get_phis(target);
+    if (not phis.empty()) {
+        // a predecessor reaching target both ways would need two incomings
+        // for one edge
+        auto &target_preds = target->get_pre_basic_blocks();
+        for (auto pred : preds)
+            if (std::count(target_preds.begin(), target_preds.end(), pred) or
+                std::count(bb->get_pre_basic_blocks().begin(),
+                           bb->get_pre_basic_blocks().end(), pred) > 1)
+                return false;
+    }
+
+    for (auto phi : phis) {
+        auto incoming = phi->get_incoming_value_for(bb);
+        phi->remove_incoming(bb);
+        for (auto pred : preds)
+            phi->add_phi_pair_operand(incoming, pred);
+    }
+    for (auto pred : preds)
+        pred->get_terminator()->as<BranchInst>()->replace_successor(bb,
+                                                                    target);
+    bb->erase_instr(br);
+    bb->erase_from_parent();
+    delete bb;
+    add_stat("forwarders removed");
+    return true;
+}
@@ -0,0 +1,92 @@
+#include "TailRecursionElim.hpp"
+#include "BasicBlock.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "Instruction.hpp"
+
+#include <iterator>
+
+namespace {
+// a pointer the next iteration may get: it must not point into the frame
+// that the allocas of this call share with it
+bool is_outside_frame(Value *ptr) {
+    while (auto gep = ptr->dyn_cast<GetElementPtrInst>())
+        ptr = gep->get_operand(0);
+    return ptr->is<Argument>() or ptr->is<GlobalVariable>();
+}
+} // namespace
+
+void TailRecursionElim::run_on_func(Function *func) {
+    // a branch back to the entry would skip the new phis
+    if (not func->get_entry_block()->get_pre_basic_blocks().empty())
+        return;
+    auto tail_calls = find_tail_calls(func);
+    if (tail_calls.empty())
+        return;
+    auto header = split_entry(func);
+    auto entry = func->get_entry_block();
+
+    std::vector<PhiInst *> phis;
+    for (auto &arg : func->get_args()) {
+        auto phi = PhiInst::create_phi(arg.get_type(), header);
+        arg.replace_all_use_with(phi);
+        phi->add_phi_pair_operand(&arg, entry);
+        phis.push_back(phi);
+    }
+    // phis are not inserted on creation, they come first in header
+    for (auto it = phis.rbegin(); it != phis.rend(); ++it)
+        header->add_instr_begin(*it);
+
+    for (auto [call, ret] : tail_calls) {
+        auto bb = call->get_parent();
+        for (unsigned i = 0; i < phis.size(); i++)
+            phis[i]->add_phi_pair_operand(call->get_operand(i + 1), bb);
+        bb->erase_instr(ret);
+        bb->erase_instr(call);
+        BranchInst::create_br(header, bb);
+    }
+    add_stat("tail calls eliminated", tail_calls.size());
+}
+
+std::vector<std::pair<CallInst *, ReturnInst *>>
+TailRecursionElim::find_tail_calls(Function *func) {
+    std::vector<std::pair<CallInst *, ReturnInst *>> tail_calls;
+    for (auto &bb : func->get_basic_blocks()) {
+        auto &instrs = bb.get_instructions();
+        if (instrs.size() < 2 or not instrs.back().is_ret())
+            continue;
+        auto ret = instrs.back().as<ReturnInst>();
+        auto call = std::prev(instrs.end(), 2)->dyn_cast<CallInst>();
+        if (call == nullptr or call->get_operand(0) != func)
+            continue;
+        if (not ret->is_void_ret() and ret->get_operand(0) != call)
+            continue;
+        bool safe = true;
+        for (unsigned i = 1; i < call->get_num_operand(); i++) {
+            auto arg = call->get_operand(i);
+            if (arg->get_type()->is_pointer_type() and
+                not is_outside_frame(arg))
+                safe = false;
+        }
+        if (safe)
+            tail_calls.emplace_back(call, ret);
+    }
+    return tail_calls;
+}
+
+BasicBlock *TailRecursionElim::split_entry(Function *func) {
+    auto entry = func->get_entry_block();
+    auto header = BasicBlock::create(m_, "", func);
+    std::vector<Instruction *> move_list;
+    for (auto &instr : entry->get_instructions())
+        if (not instr.is_alloca())
+            move_list.push_back(&instr);
+    for (auto instr : move_list) {
+        entry->remove_instr(instr);
+        header->add_instruction(instr);
+        instr->set_parent(header);
+    }
+    header->take_succ_basic_blocks(entry);
+    BranchInst::create_br(header, entry);
+    return header;
+}
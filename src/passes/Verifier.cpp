@@ -0,0 +1,467 @@
+#include "Verifier.hpp"
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "IRprinter.hpp"
+#include "Instruction.hpp"
+
+#include <algorithm>
+#include <llvm/ADT/SmallVector.h>
+
+void Verifier::run() {
+    errors_.clear();
+    num_errors_ = 0;
+    dominators_ = std::make_unique<Dominators>(m_);
+    for (auto &func : m_->get_functions()) {
+        if (not func.is_declaration())
+            verify_function(&func);
+    }
+    func_ = nullptr;
+    tracker_.reset();
+    // the users of globals and functions are checked to be alive only, the
+    // functions have checked their own operands
+    unsigned num_uses = 0;
+    for (auto &global : m_->get_global_variable())
+        verify_uses(&global, nullptr, num_uses);
+    for (auto &func : m_->get_functions())
+        verify_uses(&func, nullptr, num_uses);
+    dominators_.reset();
+}
+
+Verifier::Verifier(Module *m) : Pass(m) {}
+Verifier::~Verifier() = default;
+
+std::string Verifier::get_report() const {
+    std::string report;
+    for (auto &error : errors_)
+        report += error + "\n";
+    if (num_errors_ > errors_.size())
+        report += "... and " + std::to_string(num_errors_ - errors_.size()) +
+                  " more errors\n";
+    return report;
+}
+
+void Verifier::error(const Value *where, const std::string &msg) {
+    if (num_errors_++ >= max_errors)
+        return;
+    std::string text;
+    if (func_)
+        text = "@" + func_->get_name() + ": ";
+    if (auto instr = where->dyn_cast<Instruction>()) {
+        if (instr->get_parent())
+            text += name_of(instr->get_parent()) + ": ";
+        if (not instr->get_type()->is_void_type())
+            text += name_of(instr) + " = ";
+        text += instr->get_instr_op_name() + ": ";
+    } else {
+        text += name_of(where) + ": ";
+    }
+    errors_.push_back(text + msg);
+}
+
+std::string Verifier::name_of(const Value *v) {
+    if (v->is<Function>() or v->is<GlobalVariable>())
+        return "@" + v->get_name();
+    if (v->is<Constant>())
+        return "a constant";
+    if (func_ and not tracker_)
+        tracker_ = std::make_unique<SlotTracker>(func_);
+    auto name = tracker_ ? tracker_->get_name(v) : v->get_name();
+    return "%" + (name.empty() ? std::string("<unnamed>") : name);
+}
+
+void Verifier::verify_function(Function *func) {
+    func_ = func;
+    tracker_.reset();
+    // also numbers the blocks, the vectors below are indexed by that
+    dominators_->run_on_func(func);
+    auto n = func->get_num_basic_blocks();
+    auto in_func = [&](BasicBlock *bb) {
+        return bb != nullptr and bb->get_parent() == func;
+    };
+
+    reachable_.assign(n, 0);
+    std::vector<BasicBlock *> work_list{func->get_entry_block()};
+    reachable_[func->get_entry_block()->get_index()] = 1;
+    while (not work_list.empty()) {
+        auto bb = work_list.back();
+        work_list.pop_back();
+        for (auto succ : bb->get_succ_basic_blocks()) {
+            if (in_func(succ) and not reachable_[succ->get_index()]) {
+                reachable_[succ->get_index()] = 1;
+                work_list.push_back(succ);
+            }
+        }
+    }
+    pred_count_.assign(n, 0);
+    pred_used_.assign(n, 0);
+    pred_stamp_.assign(n, 0);
+
+    verify_cfg(func);
+
+    positions_.clear();
+    for (auto &bb : func->get_basic_blocks()) {
+        unsigned pos = 0;
+        for (auto &instr : bb.get_instructions())
+            positions_[&instr] = pos++;
+    }
+
+    // every operand naming a value of func must be on its use list, which
+    // holds nothing else, so counting both sides is enough
+    unsigned num_uses = 0, num_local_operands = 0;
+    for (auto &arg : func->get_args())
+        verify_uses(&arg, func, num_uses);
+    for (auto &bb : func->get_basic_blocks()) {
+        verify_phis(&bb);
+        bool phis_done = false;
+        for (auto &instr : bb.get_instructions()) {
+            if (instr.get_parent() != &bb)
+                error(&instr, "the parent is another block");
+            if (instr.is_phi() and phis_done)
+                error(&instr, "phi after a non-phi instruction");
+            phis_done |= not instr.is_phi();
+            if (instr.isTerminator() and
+                &instr != &bb.get_instructions().back())
+                error(&instr, "terminator in the middle of the block");
+            verify_instruction(&instr);
+            verify_uses(&instr, func, num_uses);
+            for (auto op : instr.get_operands()) {
+                auto arg = op ? op->dyn_cast<Argument>() : nullptr;
+                auto def = op ? op->dyn_cast<Instruction>() : nullptr;
+                if ((arg and arg->get_parent() == func) or
+                    (def and def->get_parent() and
+                     def->get_parent()->get_parent() == func))
+                    num_local_operands++;
+            }
+        }
+    }
+    if (num_uses != num_local_operands)
+        error(func, "the use lists of the local values hold " +
+                        std::to_string(num_uses) + " uses, the operands " +
+                        std::to_string(num_local_operands));
+}
+
+void Verifier::verify_cfg(Function *func) {
+    auto entry = func->get_entry_block();
+    if (not entry->get_pre_basic_blocks().empty())
+        error(entry, "the entry block has predecessors");
+    edges_.clear();
+    for (auto &bb : func->get_basic_blocks()) {
+        if (bb.get_parent() != func)
+            error(&bb, "the parent is another function");
+        auto &instrs = bb.get_instructions();
+        if (instrs.empty() or not instrs.back().isTerminator()) {
+            error(&bb, "the block does not end with a terminator");
+        } else {
+            // the successors in any order, a cond br may name a block twice
+            llvm::SmallVector<Value *, 2> targets, succs;
+            auto &term = instrs.back();
+            if (term.is_br()) {
+                unsigned first = term.get_num_operand() == 3 ? 1 : 0;
+                for (unsigned i = first; i < term.get_num_operand(); i++)
+                    targets.push_back(term.get_operand(i));
+            }
+            succs.append(bb.get_succ_basic_blocks().begin(),
+                         bb.get_succ_basic_blocks().end());
+            std::sort(targets.begin(), targets.end());
+            std::sort(succs.begin(), succs.end());
+            if (targets != succs)
+                error(&bb, "the successors are not the targets of the "
+                           "terminator");
+        }
+        for (auto succ : bb.get_succ_basic_blocks()) {
+            if (succ->get_parent() != func)
+                error(&bb, "a successor is in another function");
+            else
+                edges_[{&bb, succ}]++;
+        }
+        for (auto pred : bb.get_pre_basic_blocks())
+            edges_[{pred, &bb}]--;
+    }
+    // in block order rather than that of the map, each edge once
+    auto check_edge = [&](const BasicBlock *from, const BasicBlock *to) {
+        auto it = edges_.find({from, to});
+        if (it == edges_.end() or it->second == 0)
+            return;
+        it->second = 0;
+        error(to, "the edge from " + name_of(from) +
+                      " is not in both the predecessors and the successors");
+    };
+    for (auto &bb : func->get_basic_blocks()) {
+        for (auto succ : bb.get_succ_basic_blocks())
+            check_edge(&bb, succ);
+        for (auto pred : bb.get_pre_basic_blocks())
+            check_edge(pred, &bb);
+    }
+}
+
+void Verifier::verify_phis(BasicBlock *bb) {
+    auto &preds = bb->get_pre_basic_blocks();
+    auto in_func = [&](BasicBlock *pred) {
+        return pred != nullptr and pred->get_parent() == func_;
+    };
+    bool counted = false;
+    for (auto &instr : bb->get_instructions()) {
+        auto phi = instr.dyn_cast<PhiInst>();
+        if (not phi)
+            break;
+        if (not counted) {
+            for (auto pred : preds)
+                if (in_func(pred))
+                    pred_count_[pred->get_index()]++;
+            counted = true;
+        }
+        if (phi->get_num_incoming() != preds.size()) {
+            error(phi, std::to_string(phi->get_num_incoming()) +
+                           " incoming values for " +
+                           std::to_string(preds.size()) + " predecessors");
+            continue;
+        }
+        // a fresh stamp resets the used counts of this phi lazily
+        stamp_++;
+        for (unsigned i = 0; i < phi->get_num_incoming(); i++) {
+            auto pre_bb = phi->get_incoming_block(i);
+            if (not in_func(pre_bb)) {
+                error(phi, "an incoming block is not in the function");
+                break;
+            }
+            auto k = pre_bb->get_index();
+            if (pred_stamp_[k] != stamp_) {
+                pred_stamp_[k] = stamp_;
+                pred_used_[k] = 0;
+            }
+            if (++pred_used_[k] > pred_count_[k]) {
+                error(phi, "incoming block " + name_of(pre_bb) +
+                               " is not a predecessor as often");
+                break;
+            }
+        }
+    }
+    if (counted)
+        for (auto pred : preds)
+            if (in_func(pred))
+                pred_count_[pred->get_index()] = 0;
+}
+
+void Verifier::verify_instruction(Instruction *instr) {
+    for (unsigned i = 0; i < instr->get_num_operand(); i++) {
+        if (instr->get_operand(i) == nullptr) {
+            error(instr, "operand " + std::to_string(i) + " is null");
+            return;
+        }
+    }
+    verify_types(instr);
+    verify_dominance(instr);
+}
+
+void Verifier::verify_types(Instruction *instr) {
+    auto ty = instr->get_type();
+    auto num_ops = instr->get_num_operand();
+    auto op_ty = [&](unsigned i) { return instr->get_operand(i)->get_type(); };
+    auto check = [&](bool ok, const std::string &msg) {
+        if (not ok)
+            error(instr, msg);
+        return ok;
+    };
+    auto has_operands = [&](unsigned n) {
+        return check(num_ops == n, std::to_string(num_ops) +
+                                       " operands instead of " +
+                                       std::to_string(n));
+    };
+
+    switch (instr->get_instr_type()) {
+    case Instruction::ret:
+        if (func_->get_return_type()->is_void_type())
+            has_operands(0);
+        else if (has_operands(1))
+            check(op_ty(0) == func_->get_return_type(),
+                  "the value does not have the return type");
+        break;
+    case Instruction::br:
+        if (not check(num_ops == 1 or num_ops == 3,
+                      std::to_string(num_ops) + " operands"))
+            break;
+        if (num_ops == 3)
+            check(op_ty(0)->is_int1_type(), "the condition is not i1");
+        for (unsigned i = num_ops == 3 ? 1 : 0; i < num_ops; i++)
+            check(instr->get_operand(i)->is<BasicBlock>(),
+                  "a target is not a block");
+        break;
+    case Instruction::add:
+    case Instruction::sub:
+    case Instruction::mul:
+    case Instruction::sdiv:
+        if (has_operands(2))
+            check(ty->get_scalar_type()->is_int32_type() and op_ty(0) == ty and
+                      op_ty(1) == ty,
+                  "operands and result are not all i32 or the same i32 "
+                  "vector");
+        break;
+    case Instruction::fadd:
+    case Instruction::fsub:
+    case Instruction::fmul:
+    case Instruction::fdiv:
+        if (has_operands(2))
+            check(ty->get_scalar_type()->is_float_type() and op_ty(0) == ty and
+                      op_ty(1) == ty,
+                  "operands and result are not all float or the same float "
+                  "vector");
+        break;
+    case Instruction::alloca:
+        if (has_operands(0))
+            check(ty->is_pointer_type(), "the result is not a pointer");
+        break;
+    case Instruction::load:
+        if (has_operands(1))
+            check(op_ty(0)->is_pointer_type() and
+                      op_ty(0)->get_pointer_element_type() == ty,
+                  "the address is not a pointer to the result type");
+        break;
+    case Instruction::store:
+        if (has_operands(2))
+            check(op_ty(1)->is_pointer_type() and
+                      op_ty(1)->get_pointer_element_type() == op_ty(0),
+                  "the address is not a pointer to the stored type");
+        break;
+    case Instruction::ge:
+    case Instruction::gt:
+    case Instruction::le:
+    case Instruction::lt:
+    case Instruction::eq:
+    case Instruction::ne:
+        if (has_operands(2))
+            check(ty->is_int1_type() and op_ty(0)->is_integer_type() and
+                      op_ty(0) == op_ty(1),
+                  "not an i1 comparison of integers of the same type");
+        break;
+    case Instruction::fge:
+    case Instruction::fgt:
+    case Instruction::fle:
+    case Instruction::flt:
+    case Instruction::feq:
+    case Instruction::fne:
+        if (has_operands(2))
+            check(ty->is_int1_type() and op_ty(0)->is_float_type() and
+                      op_ty(1)->is_float_type(),
+                  "not an i1 comparison of floats");
+        break;
+    case Instruction::phi:
+        for (unsigned i = 0; i < num_ops; i++)
+            if (not check(op_ty(i) == ty,
+                          "an incoming value does not have the phi type"))
+                break;
+        break;
+    case Instruction::call: {
+        auto callee =
+            num_ops ? instr->get_operand(0)->dyn_cast<Function>() : nullptr;
+        if (not check(callee != nullptr, "the callee is not a function"))
+            break;
+        auto func_ty = callee->get_function_type();
+        if (not check(num_ops - 1 == func_ty->get_num_of_args(),
+                      std::to_string(num_ops - 1) + " arguments for " +
+                          std::to_string(func_ty->get_num_of_args()) +
+                          " parameters"))
+            break;
+        for (unsigned i = 1; i < num_ops; i++)
+            if (not check(op_ty(i) == func_ty->get_param_type(i - 1),
+                          "argument " + std::to_string(i - 1) +
+                              " does not have the parameter type"))
+                break;
+        check(ty == func_ty->get_return_type(),
+              "the result does not have the return type");
+        break;
+    }
+    case Instruction::getelementptr:
+        if (not check(num_ops >= 2, std::to_string(num_ops) + " operands"))
+            break;
+        check(op_ty(0)->is_pointer_type() and ty->is_pointer_type(),
+              "the address or the result is not a pointer");
+        for (unsigned i = 1; i < num_ops; i++)
+            if (not check(op_ty(i)->is_integer_type(),
+                          "an index is not an integer"))
+                break;
+        break;
+    case Instruction::zext:
+        if (has_operands(1))
+            check(op_ty(0)->is_int1_type() and ty->is_int32_type(),
+                  "not an extension of i1 to i32");
+        break;
+    case Instruction::fptosi:
+        if (has_operands(1))
+            check(op_ty(0)->is_float_type() and ty->is_int32_type(),
+                  "not a conversion of float to i32");
+        break;
+    case Instruction::sitofp:
+        if (has_operands(1))
+            check(op_ty(0)->is_integer_type() and ty->is_float_type(),
+                  "not a conversion of an integer to float");
+        break;
+    case Instruction::bitcast:
+        if (has_operands(1))
+            check(op_ty(0)->is_pointer_type() and ty->is_pointer_type(),
+                  "not a cast of a pointer to a pointer");
+        break;
+    }
+}
+
+void Verifier::verify_dominance(Instruction *instr) {
+    auto bb = instr->get_parent();
+    // anything goes in code that never runs
+    if (not reachable_[bb->get_index()])
+        return;
+    auto phi = instr->dyn_cast<PhiInst>();
+    for (unsigned i = 0; i < instr->get_num_operand(); i++) {
+        auto op = instr->get_operand(i);
+        if (auto arg = op->dyn_cast<Argument>()) {
+            if (arg->get_parent() != func_)
+                error(instr, "uses an argument of another function");
+            continue;
+        }
+        auto def = op->dyn_cast<Instruction>();
+        if (def == nullptr)
+            continue;
+        auto def_bb = def->get_parent();
+        if (def_bb == nullptr or def_bb->get_parent() != func_) {
+            error(instr, "uses an instruction that is not in the function");
+            continue;
+        }
+        // an incoming value is used at the end of its block
+        auto use_bb = phi ? phi->get_incoming_block(i) : bb;
+        if (phi and (use_bb == nullptr or use_bb->get_parent() != func_ or
+                     not reachable_[use_bb->get_index()] or
+                     def_bb == use_bb))
+            continue;
+        if (not phi and def_bb == bb) {
+            if (positions_.lookup(def) >= positions_.lookup(instr))
+                error(instr, "uses " + name_of(def) + " before it is defined");
+            continue;
+        }
+        if (not reachable_[def_bb->get_index()] or
+            not dominators_->is_dominate(def_bb, use_bb))
+            error(instr, name_of(def) + " does not dominate this use");
+    }
+}
+
+void Verifier::verify_uses(Value *val, Function *func, unsigned &num_uses) {
+    for (auto &use : val->get_use_list()) {
+        auto user = use.val_;
+        if (use.arg_no_ >= user->get_num_operand() or
+            user->get_operand(use.arg_no_) != val) {
+            error(val, "the use list holds a use that is not an operand");
+            continue;
+        }
+        auto instr = user->dyn_cast<Instruction>();
+        if (func == nullptr) {
+            if (instr and instr->get_parent() == nullptr)
+                error(val, "used by an instruction that is not in a block");
+            continue;
+        }
+        if (instr == nullptr or instr->get_parent() == nullptr or
+            instr->get_parent()->get_parent() != func) {
+            error(val, "used outside of its function");
+            continue;
+        }
+        num_uses++;
+    }
+}
@@ -1,5 +1,6 @@
 #!/usr/bin/env python3
 import subprocess
+import sys
 # 17
 lv0_1 = {
     "return": (3, False),
@@ -109,7 +110,14 @@ suite = [
 ]
 
 
-def eval():
+# --run: interpret each case with cminusfc -run, no clang nor link needed
+def run_case(EXE_PATH, TEST_PATH, input_option):
+    return subprocess.run([EXE_PATH, "-run", TEST_PATH + ".cminus"],
+                          input=input_option, stdout=subprocess.PIPE,
+                          stderr=subprocess.PIPE, timeout=1)
+
+
+def eval(interpret=False):
     f = open("eval_result", 'w')
     EXE_PATH = "../../../build/cminusfc"
     TEST_BASE_PATH = "./testcases/"
@@ -131,6 +139,25 @@ def eval():
 
             COMMAND = [TEST_PATH]
 
+            if interpret:
+                input_option = None
+                if need_input:
+                    with open(ANSWER_PATH + ".in", "rb") as fin:
+                        input_option = fin.read()
+                try:
+                    result = run_case(EXE_PATH, TEST_PATH, input_option)
+                    with open(ANSWER_PATH + ".out", "rb") as fout:
+                        ok = result.stdout == fout.read()
+                except Exception as _:
+                    ok = False
+                if ok:
+                    f.write('\tSuccess\n')
+                    lv_points += score
+                else:
+                    f.write('\tFail\n')
+                    has_bonus = False
+                continue
+
             try:
                 result = subprocess.run([EXE_PATH, "-o", TEST_PATH + ".ll", "-emit-llvm",
                                         TEST_PATH + ".cminus"], stderr=subprocess.PIPE, timeout=1)
@@ -177,4 +204,4 @@ def eval():
 
 
 if __name__ == "__main__":
-    eval()
+    eval("--run" in sys.argv[1:])
@@ -0,0 +1,620 @@
+#include "BasicBlock.hpp"
+#include "Constant.hpp"
+#include "Dominators.hpp"
+#include "Function.hpp"
+#include "GlobalVariable.hpp"
+#include "IRBuilder.hpp"
+#include "Instruction.hpp"
+#include "Mem2Reg.hpp"
+#include "MemoryReport.hpp"
+#include "Module.hpp"
+#include "PassManager.hpp"
+#include "ProgramGenerator.hpp"
+#include "ast.hpp"
+#include "cminusf_builder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/* cminusf_bench: times the compiler on synthetic programs and prints the
+ * results as one JSON document, so that runs of different commits can be
+ * compared phase by phase.
+ *
+ * The macro benchmarks generate a program of a given number of lines in one
+ * of several shapes and time every phase of the cminusfc flow on it: parse,
+ * AST, CminusfBuilder, the pass pipeline and Module::print. The micro
+ * benchmarks time single operations of the ir and the analyses. Every
+ * phase is the best of -repeat runs. The sizes of the ir node classes are
+ * reported too, they decide how much of a big module fits in cache, and so
+ * is the memory of each macro benchmark: the bytes the syntax tree and the
+ * AST took, the ir values created by the builder and by the passes, and
+ * the peak rss of the whole run. */
+
+using std::string;
+using std::operator""s;
+
+namespace {
+
+struct Options {
+    bool macro{true};
+    bool micro{true};
+    std::vector<unsigned> lines{1000, 10000, 100000, 1000000};
+    std::vector<string> shapes{"calls", "nested", "arrays", "random"};
+    // loops nested in every function of the nested shape
+    unsigned depth{6};
+    // of the random shape
+    std::uint32_t seed{1};
+    string pipeline{PassManager::level_pipeline(2)};
+    bool ssa_builder{true};
+    unsigned repeat{3};
+    string output_file;
+};
+
+// identifiers are letters only, n is written in base 26 after the prefix,
+// in capitals so that no keyword comes out
+string ident(const string &prefix, unsigned n) {
+    string digits;
+    do {
+        digits += static_cast<char>('A' + n % 26);
+        n /= 26;
+    } while (n);
+    return prefix + string(digits.rbegin(), digits.rend());
+}
+
+double ms_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+// counts what Module::print writes instead of keeping it
+class NullBuffer : public std::streambuf {
+  public:
+    std::size_t size{0};
+
+  protected:
+    int overflow(int c) override {
+        size++;
+        return c;
+    }
+    std::streamsize xsputn(const char *, std::streamsize n) override {
+        size += n;
+        return n;
+    }
+};
+
+/* The generated programs, each function calls the one before it so that
+ * all of them are reachable from main:
+ *     calls   many small functions with a loop, a branch and array accesses
+ *     nested  loops nested -depth deep around a branch
+ *     arrays  large local arrays, with constant and computed indices
+ * The random shape comes from ProgramGenerator instead. */
+class ProgramWriter {
+  public:
+    ProgramWriter(const string &shape, unsigned depth)
+        : shape_(shape), depth_(depth) {}
+
+    string write(unsigned lines) {
+        line("int g[4096];");
+        line("float gf[64];");
+        num_funcs_ = 0;
+        while (num_lines_ + 8 < lines) {
+            if (shape_ == "calls")
+                write_calls();
+            else if (shape_ == "nested")
+                write_nested();
+            else
+                write_arrays();
+            num_funcs_++;
+        }
+        line("int main(void) {");
+        line("    output(" + ident("f", num_funcs_ - 1) + "(g, 100));");
+        line("    return 0;");
+        line("}");
+        return os_.str();
+    }
+
+    unsigned num_funcs() const { return num_funcs_; }
+
+  private:
+    void line(const string &text) {
+        os_ << text << '\n';
+        num_lines_++;
+    }
+    void indented(unsigned level, const string &text) {
+        line(string(4 * level, ' ') + text);
+    }
+    string name() const { return ident("f", num_funcs_); }
+    // the call of the function before, 0 in the first
+    string call_prev(const string &args) const {
+        if (num_funcs_ == 0)
+            return "0";
+        return ident("f", num_funcs_ - 1) + "(" + args + ")";
+    }
+
+    void write_calls() {
+        line("int " + name() + "(int a[], int n) {");
+        line("    int i;");
+        line("    int s;");
+        line("    i = 0;");
+        line("    s = n;");
+        line("    while (i < n) {");
+        line("        if (a[i] > s) {");
+        line("            s = s + a[i] * 3;");
+        line("        } else {");
+        line("            s = s - i;");
+        line("        }");
+        line("        a[i] = s / 2;");
+        line("        i = i + 1;");
+        line("    }");
+        line("    return s + " + call_prev("a, n - 1") + ";");
+        line("}");
+    }
+
+    void write_nested() {
+        line("int " + name() + "(int a[], int n) {");
+        line("    int s;");
+        for (unsigned d = 0; d < depth_; d++)
+            line("    int " + ident("i", d) + ";");
+        line("    s = n;");
+        for (unsigned d = 0; d < depth_; d++) {
+            auto i = ident("i", d);
+            auto bound = d == 0 ? "n"s : ident("i", d - 1);
+            indented(d + 1, i + " = 0;");
+            indented(d + 1, "while (" + i + " < " + bound + ") {");
+        }
+        auto inner = ident("i", depth_ - 1);
+        indented(depth_ + 1, "if (s > 1000) {");
+        indented(depth_ + 2, "s = s - a[" + inner + "];");
+        indented(depth_ + 1, "} else {");
+        indented(depth_ + 2, "s = s + " + inner + " * 2;");
+        indented(depth_ + 1, "}");
+        for (unsigned d = depth_; d-- > 0;) {
+            auto i = ident("i", d);
+            indented(d + 2, i + " = " + i + " + 1;");
+            indented(d + 1, "}");
+        }
+        line("    return s + " + call_prev("a, n - 1") + ";");
+        line("}");
+    }
+
+    void write_arrays() {
+        line("int " + name() + "(int a[], int n) {");
+        line("    int v[1024];");
+        line("    float w[256];");
+        line("    int i;");
+        line("    i = 0;");
+        line("    while (i < 1024) {");
+        line("        v[i] = a[i] + i;");
+        line("        i = i + 1;");
+        line("    }");
+        for (unsigned k = 0; k < 8; k++) {
+            auto k_str = std::to_string(k);
+            line("    w[" + k_str + "] = v[" + std::to_string(k * 3) +
+                 "] * 1.5 + gf[" + k_str + "];");
+        }
+        line("    v[n] = w[0] + w[7];");
+        line("    return v[n] + " + call_prev("a, n") + ";");
+        line("}");
+    }
+
+    string shape_;
+    unsigned depth_;
+    std::ostringstream os_;
+    unsigned num_lines_{0};
+    unsigned num_funcs_{0};
+};
+
+struct MacroResult {
+    string shape;
+    unsigned lines{0}, functions{0};
+    unsigned instructions{0};
+    std::size_t ir_bytes{0};
+    std::size_t tree_bytes{0}, ast_bytes{0}, build_values{0},
+        build_value_bytes{0}, passes_values{0}, passes_value_bytes{0};
+    double parse_ms{1e300}, ast_ms{1e300}, build_ms{1e300}, passes_ms{1e300},
+        print_ms{1e300};
+};
+
+unsigned count_instrs(Module *m) {
+    unsigned instrs = 0;
+    for (auto &func : m->get_functions()) {
+        for (auto &bb : func.get_basic_blocks())
+            instrs += bb.get_num_of_instr();
+    }
+    return instrs;
+}
+
+std::unique_ptr<Module> build_module(const string &source, bool ssa_builder) {
+    auto text = source + string(2, '\0');
+    parse_context ctx;
+    auto tree = parse_in_place(&ctx, text.data(), source.size());
+    if (tree == nullptr) {
+        std::cerr << "[ERR] generated program: " << ctx.error_message << "\n";
+        std::exit(1);
+    }
+    AST ast(tree);
+    CminusfBuilder builder(ssa_builder);
+    ast.run_visitor(builder);
+    return builder.getModule();
+}
+
+// the two algorithms of Dominators must agree on every idom and frontier,
+// or the timings compare different things
+void check_dominators(Module *m) {
+    Dominators semi_nca(m, Dominators::Algorithm::SemiNCA);
+    Dominators iterative(m, Dominators::Algorithm::Iterative);
+    semi_nca.run();
+    iterative.run();
+    for (auto &func : m->get_functions()) {
+        for (auto &bb : func.get_basic_blocks()) {
+            if (semi_nca.get_idom(&bb) != iterative.get_idom(&bb) or
+                semi_nca.get_dominance_frontier(&bb) !=
+                    iterative.get_dominance_frontier(&bb)) {
+                std::cerr << "[ERR] the dominator algorithms disagree in "
+                          << func.get_name() << "\n";
+                std::exit(1);
+            }
+        }
+    }
+}
+
+MacroResult run_macro(const Options &options, const string &shape,
+                      unsigned lines) {
+    MacroResult result;
+    result.shape = shape;
+    result.lines = lines;
+    string source;
+    if (shape == "random") {
+        ProgramGenerator::Options generator_options;
+        generator_options.seed = options.seed;
+        generator_options.lines = lines;
+        generator_options.calls = ProgramGenerator::CallShape::random;
+        ProgramGenerator generator(generator_options);
+        source = generator.generate();
+        result.functions = generator.num_funcs();
+    } else {
+        ProgramWriter writer(shape, options.depth);
+        source = writer.write(lines);
+        result.functions = writer.num_funcs();
+    }
+    for (unsigned r = 0; r < options.repeat; r++) {
+        auto text = source + string(2, '\0');
+        parse_context ctx;
+        auto start = std::chrono::steady_clock::now();
+        auto tree = parse_in_place(&ctx, text.data(), source.size());
+        result.parse_ms = std::min(result.parse_ms, ms_since(start));
+        if (tree == nullptr) {
+            std::cerr << "[ERR] generated " << shape
+                      << " program: " << ctx.error_message << "\n";
+            std::exit(1);
+        }
+
+        std::size_t tree_nodes;
+        syntax_tree_memory(tree, &result.tree_bytes, &tree_nodes);
+        start = std::chrono::steady_clock::now();
+        AST ast(tree);
+        result.ast_ms = std::min(result.ast_ms, ms_since(start));
+
+        start = std::chrono::steady_clock::now();
+        CminusfBuilder builder(options.ssa_builder,
+                               PassManager::pipeline_has(options.pipeline,
+                                                         "dce"));
+        ast.run_visitor(builder);
+        auto m = builder.getModule();
+        result.build_ms = std::min(result.build_ms, ms_since(start));
+        result.ast_bytes = ast.get_block_bytes();
+        result.build_values = m->get_num_values();
+        result.build_value_bytes = m->get_value_bytes();
+
+        start = std::chrono::steady_clock::now();
+        {
+            PassManager PM(m.get());
+            PM.add_pipeline(options.pipeline);
+            PM.run();
+        }
+        result.passes_ms = std::min(result.passes_ms, ms_since(start));
+        result.passes_values = m->get_num_values() - result.build_values;
+        result.passes_value_bytes =
+            m->get_value_bytes() - result.build_value_bytes;
+
+        NullBuffer buffer;
+        std::ostream null_os(&buffer);
+        start = std::chrono::steady_clock::now();
+        m->print(null_os);
+        result.print_ms = std::min(result.print_ms, ms_since(start));
+        result.instructions = count_instrs(m.get());
+        result.ir_bytes = buffer.size;
+    }
+    return result;
+}
+
+struct MicroResult {
+    string name;
+    unsigned long ops{0};
+    double ns_per_op{1e300};
+};
+
+// the module the analyses are timed on, before any pass
+constexpr unsigned micro_lines = 20000;
+
+template <typename Body>
+MicroResult time_micro(const Options &options, const string &name,
+                       unsigned long ops, Body body) {
+    MicroResult result;
+    result.name = name;
+    result.ops = ops;
+    for (unsigned r = 0; r < options.repeat; r++) {
+        auto ms = body();
+        result.ns_per_op = std::min(result.ns_per_op, ms * 1e6 / ops);
+    }
+    return result;
+}
+
+std::vector<MicroResult> run_micro(const Options &options) {
+    std::vector<MicroResult> results;
+
+    constexpr unsigned long num_gets = 1000000;
+    results.push_back(
+        time_micro(options, "ConstantInt::get", num_gets, [] {
+            Module m;
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned long i = 0; i < num_gets; i++)
+                ConstantInt::get(static_cast<int>(i % 4096), &m);
+            return ms_since(start);
+        }));
+
+    // one value with many uses moved to another and back
+    constexpr unsigned num_uses = 100000, num_moves = 20;
+    results.push_back(time_micro(
+        options, "Value::replace_all_use_with", num_uses * num_moves, [] {
+            Module m;
+            auto *int32 = m.get_int32_type();
+            auto *func = Function::create(
+                FunctionType::get(int32, {int32, int32}), "f", &m);
+            auto *bb = BasicBlock::create(&m, "entry", func);
+            IRBuilder builder(bb, &m);
+            Value *x = &func->get_args().front();
+            Value *y = &func->get_args().back();
+            for (unsigned i = 0; i < num_uses; i++)
+                builder.create_iadd(x, ConstantInt::get(1, &m));
+            builder.create_ret(x);
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned i = 0; i < num_moves; i++) {
+                x->replace_all_use_with(y);
+                std::swap(x, y);
+            }
+            return ms_since(start);
+        }));
+
+    ProgramWriter writer("calls", options.depth);
+    auto source = writer.write(micro_lines);
+
+    auto m = build_module(source, false);
+    unsigned long num_blocks = 0;
+    for (auto &func : m->get_functions())
+        num_blocks += func.get_basic_blocks().size();
+    check_dominators(m.get());
+    // and on the shapes with deeper and less regular control flow
+    ProgramGenerator::Options generator_options;
+    generator_options.seed = options.seed;
+    generator_options.lines = micro_lines;
+    for (auto &other :
+         {ProgramWriter("nested", options.depth).write(micro_lines),
+          ProgramGenerator(generator_options).generate()})
+        check_dominators(build_module(other, false).get());
+    for (auto [algo, name] :
+         {std::pair{Dominators::Algorithm::SemiNCA, "Dominators::run"},
+          std::pair{Dominators::Algorithm::Iterative,
+                    "Dominators::run (iterative)"}}) {
+        results.push_back(time_micro(options, name, num_blocks, [&] {
+            Dominators dominators(m.get(), algo);
+            auto start = std::chrono::steady_clock::now();
+            dominators.run();
+            return ms_since(start);
+        }));
+    }
+
+    auto num_instrs = count_instrs(m.get());
+    results.push_back(time_micro(options, "Mem2Reg::run", num_instrs, [&] {
+        // promoting changes the module, every run gets a fresh one
+        auto fresh = build_module(source, false);
+        Mem2Reg mem2reg(fresh.get());
+        auto start = std::chrono::steady_clock::now();
+        mem2reg.run();
+        return ms_since(start);
+    }));
+
+    results.push_back(time_micro(options, "Module::print", num_instrs, [&] {
+        NullBuffer buffer;
+        std::ostream null_os(&buffer);
+        auto start = std::chrono::steady_clock::now();
+        m->print(null_os);
+        return ms_since(start);
+    }));
+    return results;
+}
+
+struct SizeResult {
+    string name;
+    std::size_t bytes;
+};
+
+#define NODE_SIZE(T) SizeResult{#T, sizeof(T)}
+
+// sizeof of the ir nodes, without the operands that phis, calls and constant
+// arrays move to the heap once they have more than fit inline
+std::vector<SizeResult> node_sizes() {
+    return {NODE_SIZE(Use),           NODE_SIZE(Value),
+            NODE_SIZE(User),          NODE_SIZE(Instruction),
+            NODE_SIZE(IBinaryInst),   NODE_SIZE(ICmpInst),
+            NODE_SIZE(LoadInst),      NODE_SIZE(StoreInst),
+            NODE_SIZE(BranchInst),    NODE_SIZE(GetElementPtrInst),
+            NODE_SIZE(CallInst),      NODE_SIZE(PhiInst),
+            NODE_SIZE(ConstantInt),   NODE_SIZE(Argument),
+            NODE_SIZE(BasicBlock),    NODE_SIZE(Function),
+            NODE_SIZE(GlobalVariable)};
+}
+
+#undef NODE_SIZE
+
+void print_json(std::ostream &os, const Options &options,
+                const std::vector<MacroResult> &macro,
+                const std::vector<MicroResult> &micro) {
+    os << "{\"pipeline\": \"" << options.pipeline
+       << "\", \"ssa_builder\": " << (options.ssa_builder ? "true" : "false")
+       << ", \"repeat\": " << options.repeat
+       << ", \"peak_rss_kb\": " << peak_rss_kb() << ",\n\"macro\": [";
+    for (std::size_t i = 0; i < macro.size(); i++) {
+        auto &r = macro[i];
+        auto total =
+            r.parse_ms + r.ast_ms + r.build_ms + r.passes_ms + r.print_ms;
+        os << (i ? ",\n  " : "\n  ") << "{\"shape\": \"" << r.shape
+           << "\", \"lines\": " << r.lines << ", \"functions\": "
+           << r.functions << ", \"instructions\": " << r.instructions
+           << ", \"ir_bytes\": " << r.ir_bytes
+           << ", \"tree_bytes\": " << r.tree_bytes
+           << ", \"ast_bytes\": " << r.ast_bytes
+           << ", \"build_values\": " << r.build_values
+           << ", \"build_value_bytes\": " << r.build_value_bytes
+           << ", \"passes_values\": " << r.passes_values
+           << ", \"passes_value_bytes\": " << r.passes_value_bytes
+           << ", \"parse_ms\": " << r.parse_ms << ", \"ast_ms\": " << r.ast_ms
+           << ", \"build_ms\": " << r.build_ms
+           << ", \"passes_ms\": " << r.passes_ms
+           << ", \"print_ms\": " << r.print_ms << ", \"total_ms\": " << total
+           << "}";
+    }
+    os << "\n],\n\"micro\": [";
+    for (std::size_t i = 0; i < micro.size(); i++) {
+        auto &r = micro[i];
+        os << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << r.name
+           << "\", \"ops\": " << r.ops << ", \"ns_per_op\": " << r.ns_per_op
+           << "}";
+    }
+    os << "\n],\n\"sizes\": [";
+    auto sizes = node_sizes();
+    for (std::size_t i = 0; i < sizes.size(); i++) {
+        os << (i ? ",\n  " : "\n  ") << "{\"name\": \"" << sizes[i].name
+           << "\", \"bytes\": " << sizes[i].bytes << "}";
+    }
+    os << "\n]}\n";
+}
+
+// the comma separated words of text
+std::vector<string> split(const string &text) {
+    std::vector<string> words;
+    std::istringstream is(text);
+    string word;
+    while (std::getline(is, word, ','))
+        words.push_back(word);
+    return words;
+}
+
+[[noreturn]] void usage(const char *exe_name, const string &msg) {
+    if (not msg.empty())
+        std::cerr << exe_name << ": " << msg << "\n";
+    std::cerr << "Usage: " << exe_name
+              << " [-macro|-micro] [-lines <n>,...]"
+                 " [-shapes calls,nested,arrays,random] [-depth <n>]"
+                 " [-seed <n>] [-O0|-O1|-O2|-passes=<pipeline>]"
+                 " [-repeat <n>] [-o <json-file>]\n";
+    std::exit(msg.empty() ? 0 : 1);
+}
+
+Options parse_options(int argc, char **argv) {
+    Options options;
+    bool ssa_builder_given = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        bool has_value = i + 1 < argc;
+        if (arg == "-h" or arg == "--help") {
+            usage(argv[0], "");
+        } else if (arg == "-macro") {
+            options.micro = false;
+        } else if (arg == "-micro") {
+            options.macro = false;
+        } else if (arg == "-lines" and has_value) {
+            options.lines.clear();
+            for (auto &word : split(argv[++i])) {
+                auto lines = std::atoi(word.c_str());
+                if (lines <= 0)
+                    usage(argv[0], "bad number of lines '" + word + "'");
+                options.lines.push_back(lines);
+            }
+        } else if (arg == "-shapes" and has_value) {
+            options.shapes = split(argv[++i]);
+            for (auto &shape : options.shapes) {
+                if (shape != "calls" and shape != "nested" and
+                    shape != "arrays" and shape != "random")
+                    usage(argv[0], "unknown shape '" + shape + "'");
+            }
+        } else if (arg == "-depth" and has_value) {
+            auto depth = std::atoi(argv[++i]);
+            if (depth <= 0)
+                usage(argv[0], "bad depth");
+            options.depth = depth;
+        } else if (arg == "-seed" and has_value) {
+            options.seed = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "-O0" or arg == "-O1" or arg == "-O2") {
+            options.pipeline = PassManager::level_pipeline(arg[2] - '0');
+            options.ssa_builder = arg != "-O0";
+            ssa_builder_given = true;
+        } else if (arg.rfind("-passes=", 0) == 0) {
+            options.pipeline = arg.substr(8);
+            auto error = PassManager::check_pipeline(options.pipeline);
+            if (not error.empty())
+                usage(argv[0], "bad pipeline: " + error);
+            if (not ssa_builder_given)
+                options.ssa_builder = false;
+        } else if (arg == "-ssa-builder") {
+            options.ssa_builder = true;
+            ssa_builder_given = true;
+        } else if (arg == "-repeat" and has_value) {
+            auto repeat = std::atoi(argv[++i]);
+            if (repeat <= 0)
+                usage(argv[0], "bad repeat count");
+            options.repeat = repeat;
+        } else if (arg == "-o" and has_value) {
+            options.output_file = argv[++i];
+        } else {
+            usage(argv[0], "bad option '" + arg + "'");
+        }
+    }
+    return options;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    auto options = parse_options(argc, argv);
+    std::vector<MacroResult> macro;
+    std::vector<MicroResult> micro;
+    if (options.macro) {
+        for (auto &shape : options.shapes) {
+            for (auto lines : options.lines) {
+                std::cerr << "macro " << shape << " " << lines << " lines\n";
+                macro.push_back(run_macro(options, shape, lines));
+            }
+        }
+    }
+    if (options.micro) {
+        std::cerr << "micro\n";
+        micro = run_micro(options);
+    }
+    if (options.output_file.empty()) {
+        print_json(std::cout, options, macro, micro);
+    } else {
+        std::ofstream output(options.output_file);
+        print_json(output, options, macro, micro);
+    }
+    return 0;
+}
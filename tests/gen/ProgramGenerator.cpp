@@ -0,0 +1,253 @@
+#include "ProgramGenerator.hpp"
+
+namespace {
+
+constexpr unsigned num_vars = 4;
+// size of the global array g, passed to every function as p
+constexpr unsigned global_size = 64;
+
+// identifiers are letters only, n is written in base 26 after the prefix,
+// in capitals so that no keyword comes out
+std::string ident(const std::string &prefix, unsigned n) {
+    std::string digits;
+    do {
+        digits += static_cast<char>('A' + n % 26);
+        n /= 26;
+    } while (n);
+    return prefix + std::string(digits.rbegin(), digits.rend());
+}
+
+} // namespace
+
+bool ProgramGenerator::parse_call_shape(const std::string &name,
+                                        CallShape &shape) {
+    if (name == "none")
+        shape = CallShape::none;
+    else if (name == "chain")
+        shape = CallShape::chain;
+    else if (name == "tree")
+        shape = CallShape::tree;
+    else if (name == "random")
+        shape = CallShape::random;
+    else
+        return false;
+    return true;
+}
+
+std::string ProgramGenerator::generate() {
+    line(0, "int g[" + std::to_string(global_size) + "];");
+    for (unsigned i = 0;; i++) {
+        if (options_.lines ? num_lines_ >= options_.lines
+                           : i >= options_.functions)
+            break;
+        write_function(i);
+        num_funcs_++;
+    }
+    write_main();
+    return os_.str();
+}
+
+void ProgramGenerator::line(unsigned level, const std::string &text) {
+    os_ << std::string(4 * level, ' ') << text << '\n';
+    num_lines_++;
+}
+
+void ProgramGenerator::write_function(unsigned index) {
+    scope_ = Scope();
+    scope_.blocks_left = options_.blocks;
+    for (unsigned i = 0; i < options_.arrays; i++)
+        scope_.array_sizes.push_back(8 + pick(57));
+
+    line(0, "int " + ident("f", index) + "(int p[], int n) {");
+    for (unsigned i = 0; i < num_vars; i++)
+        line(1, "int " + ident("v", i) + ";");
+    // the counters, one for every loop level and at least one to fill the
+    // arrays
+    auto num_counters = options_.loop_depth ? options_.loop_depth : 1;
+    for (unsigned i = 0; i < num_counters; i++)
+        line(1, "int " + ident("k", i) + ";");
+    for (unsigned i = 0; i < options_.arrays; i++)
+        line(1, "int " + ident("a", i) + "[" +
+                    std::to_string(scope_.array_sizes[i]) + "];");
+    if (options_.floats)
+        line(1, "float acc;");
+
+    line(1, "vA = n;");
+    for (unsigned i = 1; i < num_vars; i++)
+        write_assign(1, ident("v", i), "n + " + std::to_string(pick(100)));
+    if (options_.floats)
+        line(1, "acc = 0.5;");
+    for (unsigned i = 0; i < options_.arrays; i++) {
+        auto size = std::to_string(scope_.array_sizes[i]);
+        auto array = ident("a", i);
+        line(1, "kA = 0;");
+        line(1, "while (kA < " + size + ") {");
+        line(2, array + "[kA] = kA;");
+        line(2, "kA = kA + 1;");
+        line(1, "}");
+    }
+
+    // the callee, the argument is in range as required of n
+    int callee = -1;
+    switch (options_.calls) {
+    case CallShape::none:
+        break;
+    case CallShape::chain:
+        callee = static_cast<int>(index) - 1;
+        break;
+    case CallShape::tree:
+        callee = index ? static_cast<int>((index - 1) / 2) : -1;
+        break;
+    case CallShape::random:
+        callee = index ? static_cast<int>(pick(index)) : -1;
+        break;
+    }
+    called_.push_back(false);
+    if (callee >= 0) {
+        called_[callee] = true;
+        auto arg = operand();
+        write_assign(1, var(), ident("f", callee) + "(p, " + arg + ")");
+    }
+
+    // the if and while statements are spread over the body, which has at
+    // least two statements
+    for (unsigned i = 0; i < 2 or scope_.blocks_left > 0; i++)
+        write_stmt(1);
+
+    line(1, "output(vA);");
+    if (options_.floats)
+        line(1, "outputFloat(acc);");
+    line(1, "return " + var() + ";");
+    line(0, "}");
+}
+
+void ProgramGenerator::write_main() {
+    line(0, "int main(void) {");
+    for (unsigned i = 0; i < num_funcs_; i++) {
+        if (not called_[i])
+            line(1, "output(" + ident("f", i) + "(g, " +
+                        std::to_string(pick(1000)) + "));");
+    }
+    line(1, "return 0;");
+    line(0, "}");
+}
+
+void ProgramGenerator::write_block(unsigned level, unsigned num_stmts) {
+    for (unsigned i = 0; i < num_stmts; i++)
+        write_stmt(level);
+}
+
+void ProgramGenerator::write_stmt(unsigned level) {
+    auto choice = pick(10);
+    // statements directly in the function body are control flow more often
+    if (level == 1 and scope_.blocks_left > 0 and pick(2))
+        choice = pick(4);
+
+    if (choice < 2 and scope_.blocks_left > 0) {
+        scope_.blocks_left--;
+        line(level, "if (" + cond() + ") {");
+        write_block(level + 1, 1 + pick(3));
+        if (pick(2)) {
+            line(level, "} else {");
+            write_block(level + 1, 1 + pick(3));
+        }
+        line(level, "}");
+    } else if (choice < 4 and scope_.blocks_left > 0 and
+               scope_.loop_level < options_.loop_depth) {
+        scope_.blocks_left--;
+        auto counter = ident("k", scope_.loop_level);
+        line(level, counter + " = 0;");
+        line(level, "while (" + counter + " < " + std::to_string(2 + pick(4)) +
+                        ") {");
+        scope_.loop_level++;
+        write_block(level + 1, 1 + pick(3));
+        scope_.loop_level--;
+        line(level + 1, counter + " = " + counter + " + 1;");
+        line(level, "}");
+    } else if (choice < 6) {
+        if (not scope_.array_sizes.empty() and pick(2)) {
+            auto i = pick(scope_.array_sizes.size());
+            auto idx = index(scope_.array_sizes[i]);
+            line(level, ident("a", i) + "[" + idx + "] = " + var() + ";");
+        } else {
+            auto idx = index(global_size);
+            line(level, "p[" + idx + "] = " + var() + ";");
+        }
+    } else if (choice == 6) {
+        line(level, "output(" + operand() + ");");
+    } else if (choice == 7 and options_.floats) {
+        line(level, "acc = acc * 0.5 + " + operand() + ";");
+    } else {
+        auto v = var();
+        write_assign(level, v, expr());
+    }
+}
+
+void ProgramGenerator::write_assign(unsigned level, const std::string &var,
+                                    const std::string &expr) {
+    line(level, var + " = " + expr + ";");
+    line(level, "if (" + var + " < 0) {");
+    line(level + 1, var + " = 0 - " + var + ";");
+    line(level, "}");
+    line(level, var + " = " + var + " - " + var + " / 1000 * 1000;");
+}
+
+std::string ProgramGenerator::var() { return ident("v", pick(num_vars)); }
+
+std::string ProgramGenerator::operand() {
+    switch (pick(6)) {
+    case 0:
+        return std::to_string(pick(100));
+    case 1:
+        if (scope_.loop_level > 0)
+            return ident("k", pick(scope_.loop_level));
+        break;
+    case 2:
+        if (not scope_.array_sizes.empty()) {
+            auto i = pick(scope_.array_sizes.size());
+            return ident("a", i) + "[" + index(scope_.array_sizes[i]) + "]";
+        }
+        break;
+    case 3:
+        return "p[" + index(global_size) + "]";
+    }
+    return var();
+}
+
+// the random choices are made one statement after another, the order in
+// which the operands of + are evaluated is unspecified
+std::string ProgramGenerator::expr() {
+    auto form = pick(6);
+    auto lhs = operand();
+    switch (form) {
+    case 0:
+        return lhs;
+    case 1:
+        return lhs + " + " + operand();
+    case 2:
+        return lhs + " - " + operand();
+    case 3:
+        return lhs + " * " + operand();
+    case 4:
+        return lhs + " / " + std::to_string(1 + pick(9));
+    default:
+        auto rhs = operand();
+        return lhs + " * " + rhs + " + " + operand();
+    }
+}
+
+std::string ProgramGenerator::cond() {
+    static const char *const ops[] = {" < ", " <= ", " > ",
+                                      " >= ", " == ", " != "};
+    auto lhs = operand();
+    auto op = ops[pick(6)];
+    return lhs + op + operand();
+}
+
+std::string ProgramGenerator::index(unsigned size) {
+    if (pick(3) == 0)
+        return std::to_string(pick(size));
+    auto v = var();
+    return v + " - " + v + " / " + std::to_string(size) + " * " +
+           std::to_string(size);
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/* Seeded random C-minus-f programs for scaling tests, benchmarks and
+ * fuzzing. The same options and seed give the same program.
+ *
+ * Every program terminates and is well defined: int values stay in
+ * [0, 1000) after each assignment, so nothing overflows, indices are taken
+ * modulo the array size and divisors are nonzero constants. Calls appear
+ * only at the top level of a function and never recursively, loops have
+ * small constant trip counts. What a program prints with output() and
+ * outputFloat() depends on all of that, so the expected output is what any
+ * correct compiler must reproduce. */
+class ProgramGenerator {
+  public:
+    // whom each function calls, always functions defined before it
+    enum class CallShape {
+        none,   // main calls every function
+        chain,  // f_i calls f_{i-1}
+        tree,   // f_i calls f_{(i-1)/2}, a binary tree towards f_0
+        random, // f_i calls one f_j with j < i chosen at random
+    };
+
+    struct Options {
+        std::uint32_t seed{1};
+        unsigned functions{8};
+        // if not 0, functions are added until the program has this many
+        // lines, regardless of functions
+        unsigned lines{0};
+        // if and while statements in every function
+        unsigned blocks{6};
+        unsigned loop_depth{2};
+        // local arrays in every function
+        unsigned arrays{1};
+        CallShape calls{CallShape::chain};
+        bool floats{true};
+    };
+
+    explicit ProgramGenerator(const Options &options)
+        : options_(options), rng_(options.seed) {}
+
+    std::string generate();
+
+    unsigned num_funcs() const { return num_funcs_; }
+
+    // "none", "chain", "tree" or "random", false for any other name
+    static bool parse_call_shape(const std::string &name, CallShape &shape);
+
+  private:
+    // what the statements of the function being written may use
+    struct Scope {
+        std::vector<unsigned> array_sizes;
+        unsigned loop_level{0};
+        unsigned blocks_left{0};
+    };
+
+    unsigned pick(unsigned n) { return rng_() % n; }
+    void line(unsigned level, const std::string &text);
+
+    void write_function(unsigned index);
+    void write_main();
+    void write_block(unsigned level, unsigned num_stmts);
+    void write_stmt(unsigned level);
+    // var = expr and the statements keeping it in [0, 1000)
+    void write_assign(unsigned level, const std::string &var,
+                      const std::string &expr);
+
+    std::string var();
+    // an int value in [0, 1000)
+    std::string operand();
+    // an int value below 1000 * 1000 + 2000
+    std::string expr();
+    std::string cond();
+    std::string index(unsigned size);
+
+    Options options_;
+    std::mt19937 rng_;
+    std::ostringstream os_;
+    unsigned num_lines_{0};
+    unsigned num_funcs_{0};
+    // whether f_i is called by a later function
+    std::vector<char> called_;
+    Scope scope_;
+};
@@ -0,0 +1,115 @@
+#include "Interpreter.hpp"
+#include "ProgramGenerator.hpp"
+#include "ast.hpp"
+#include "cminusf_builder.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/* cminusf_gen: writes a seeded random C-minus-f program, see
+ * ProgramGenerator. With -o <base> it writes <base>.cminus and the output
+ * the program prints to <base>.out, as the reference interpreter (-run
+ * without passes) produces it, in the format of the answers of
+ * tests/2-ir-gen/autogen. Without -o the program goes to stdout. */
+
+using std::string;
+
+namespace {
+
+[[noreturn]] void usage(const char *exe_name, const string &msg) {
+    if (not msg.empty())
+        std::cerr << exe_name << ": " << msg << "\n";
+    std::cerr << "Usage: " << exe_name
+              << " [-seed <n>] [-functions <n>] [-lines <n>] [-blocks <n>]"
+                 " [-depth <n>] [-arrays <n>] [-calls none|chain|tree|random]"
+                 " [-no-floats] [-o <base>]\n";
+    std::exit(msg.empty() ? 0 : 1);
+}
+
+// the value of a numeric option, at least min
+unsigned number(const char *exe_name, const string &option, const char *text,
+                unsigned min) {
+    char *end;
+    auto value = std::strtoul(text, &end, 10);
+    if (*text == '\0' or *end != '\0' or value < min)
+        usage(exe_name, "bad value for " + option);
+    return value;
+}
+
+// what the program prints when interpreted, false after a syntax error
+bool write_expected(string source, const string &file) {
+    auto size = source.size();
+    source.append(2, '\0');
+    parse_context ctx;
+    auto tree = parse_in_place(&ctx, source.data(), size);
+    if (tree == nullptr) {
+        std::cerr << "[ERR] generated program: " << ctx.error_message << "\n";
+        return false;
+    }
+    AST ast(tree);
+    CminusfBuilder builder;
+    ast.run_visitor(builder);
+    auto m = builder.getModule();
+
+    // the interpreter prints through stdio like io.c
+    std::fflush(stdout);
+    if (std::freopen(file.c_str(), "w", stdout) == nullptr) {
+        std::cerr << "[ERR] cannot write " << file << "\n";
+        return false;
+    }
+    Interpreter interpreter(m.get());
+    interpreter.run();
+    std::fclose(stdout);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+    ProgramGenerator::Options options;
+    string output_base;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "-h" or arg == "--help")
+            usage(argv[0], "");
+        if (arg == "-no-floats") {
+            options.floats = false;
+            continue;
+        }
+        if (i + 1 == argc)
+            usage(argv[0], "bad option '" + arg + "'");
+        const char *value = argv[++i];
+        if (arg == "-seed") {
+            options.seed = number(argv[0], arg, value, 0);
+        } else if (arg == "-functions") {
+            options.functions = number(argv[0], arg, value, 1);
+        } else if (arg == "-lines") {
+            options.lines = number(argv[0], arg, value, 1);
+        } else if (arg == "-blocks") {
+            options.blocks = number(argv[0], arg, value, 0);
+        } else if (arg == "-depth") {
+            options.loop_depth = number(argv[0], arg, value, 0);
+        } else if (arg == "-arrays") {
+            options.arrays = number(argv[0], arg, value, 0);
+        } else if (arg == "-calls") {
+            if (not ProgramGenerator::parse_call_shape(value, options.calls))
+                usage(argv[0], "unknown call shape '" + string(value) + "'");
+        } else if (arg == "-o") {
+            output_base = value;
+        } else {
+            usage(argv[0], "bad option '" + arg + "'");
+        }
+    }
+
+    ProgramGenerator generator(options);
+    auto source = generator.generate();
+    if (output_base.empty()) {
+        std::cout << source;
+        return 0;
+    }
+    std::ofstream(output_base + ".cminus", std::ios::binary) << source;
+    return write_expected(source, output_base + ".out") ? 0 : 1;
+}
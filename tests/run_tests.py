@@ -0,0 +1,431 @@
+#!/usr/bin/env python3
+"""Runs the test suites in parallel and incrementally.
+
+The cases of eval_phase1.sh, eval_phase2.sh and eval_lab2.py (and the
+return values of testcases_general) are compiled, linked and run on all
+cores, each step under a timeout. A case that passed before is skipped as
+long as its source, expected output, input, the binaries it runs and the
+flags are unchanged; the results are kept in the cache file. Every case is
+run once per set of --flags, so a sweep over the optimization levels is one
+command:
+
+    ./run_tests.py lab2 general --flags= --flags=-O1 --flags=-O2
+
+The slowest cases are listed at the end with their compile and run times,
+--json writes all of them.
+
+The vectorize cases are compiled with -dce -vectorize instead of the
+flags; each must come out with vector ir and print what it prints at -O0,
+which the interpreter checks as well. As -run takes no vector ir, --run
+runs them with -jit.
+
+The passes suite has a directory per pass in testcases_passes, compiled with
+the options in its "flags" file instead of --flags. A case prints what its
+.out holds, and the ir after the pass must pass the checks in its comments,
+much like FileCheck: the "CHECK: <text>" lines must occur in the ir in
+their order, and the text of a "CHECK-NOT: <text>" line must not occur
+between the matches of the CHECK lines around it. A case without .out,
+one calling functions only clang could link, is checked but not run. The
+ll-parser directory holds .ll cases read back by the .ll parser, in the ";"
+comments of which the checks go; a .ll case without checks must come out
+as it went in, but for comments, blank lines and the source_filename.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import re
+import shlex
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+TESTS_DIR = os.path.dirname(os.path.abspath(__file__))
+sys.path.insert(0, os.path.join(TESTS_DIR, "2-ir-gen", "autogen"))
+from eval_lab2 import suite as lab2_suite  # noqa: E402
+
+
+class Case:
+    def __init__(self, suite, name, source, expected, input_file=None,
+                 flags=None):
+        self.suite = suite
+        self.name = name
+        self.source = source
+        self.expected = expected
+        self.input_file = input_file
+        # the options of the case in place of --flags
+        self.flags = flags
+
+
+CHECK_LINE = re.compile(r"^\s*(?:;\s*)?(CHECK|CHECK-NOT):\s*(.*?)\s*$",
+                        re.M)
+
+
+def check_ir(ir, checks):
+    """the first of checks that ir fails, None if it passes them all"""
+    pos, not_lines = 0, []
+    for kind, text in checks:
+        if kind == "CHECK-NOT":
+            not_lines.append(text)
+            continue
+        found = ir.find(text, pos)
+        if found < 0:
+            return "CHECK: " + text
+        for not_text in not_lines:
+            if not_text in ir[pos:found]:
+                return "CHECK-NOT: " + not_text
+        pos, not_lines = found + len(text), []
+    for not_text in not_lines:
+        if not_text in ir[pos:]:
+            return "CHECK-NOT: " + not_text
+    return None
+
+
+def ir_lines(ir):
+    return [line for line in ir.splitlines()
+            if line.strip() and not line.startswith((";", "source_filename"))]
+
+
+def check_round_trip(source, ir):
+    """the first line of source that ir does not reproduce, None if none"""
+    source_lines, out_lines = ir_lines(source), ir_lines(ir)
+    for line, ir_line in zip(source_lines, out_lines):
+        if line != ir_line:
+            return "round trip: " + line
+    if len(source_lines) != len(out_lines):
+        return "round trip: %d lines in, %d out" % (len(source_lines),
+                                                     len(out_lines))
+    return None
+
+
+def collect(suites):
+    cases = []
+    parser_dir = os.path.join(TESTS_DIR, "1-parser")
+    general_dir = os.path.join(TESTS_DIR, "testcases_general")
+    for suite in suites:
+        if suite in ("phase1", "phase2"):
+            standard, ext = (("output_standard", ".syntax_tree")
+                             if suite == "phase1" else
+                             ("output_standard_ast", ".ast"))
+            for level in ("easy", "normal", "hard", "testcases_general"):
+                source_dir = (general_dir if level == "testcases_general"
+                              else os.path.join(parser_dir, "input", level))
+                for file in sorted(os.listdir(source_dir)):
+                    stem, file_ext = os.path.splitext(file)
+                    # eval_phase2.sh skips the cases with syntax errors
+                    if file_ext != ".cminus" or (suite == "phase2" and
+                                                 stem.startswith("FAIL")):
+                        continue
+                    cases.append(Case(
+                        suite, level + "/" + stem,
+                        os.path.join(source_dir, file),
+                        os.path.join(parser_dir, standard, level, stem + ext)))
+        elif suite == "lab2":
+            autogen = os.path.join(TESTS_DIR, "2-ir-gen", "autogen")
+            for level, level_cases, _ in lab2_suite:
+                for name, (_, need_input) in level_cases.items():
+                    answer = os.path.join(autogen, "answers", level, name)
+                    cases.append(Case(
+                        suite, level + "/" + name,
+                        os.path.join(autogen, "testcases", level,
+                                     name + ".cminus"),
+                        answer + ".out",
+                        answer + ".in" if need_input else None))
+        elif suite in ("general", "vectorize"):
+            source_dir = (general_dir if suite == "general" else
+                          os.path.join(TESTS_DIR, "testcases_vectorize"))
+            for file in sorted(os.listdir(source_dir)):
+                stem, file_ext = os.path.splitext(file)
+                if file_ext == ".cminus":
+                    cases.append(Case(suite, stem,
+                                      os.path.join(source_dir, file),
+                                      os.path.join(source_dir,
+                                                   stem + ".out")))
+        elif suite == "passes":
+            passes_dir = os.path.join(TESTS_DIR, "testcases_passes")
+            for pass_name in sorted(os.listdir(passes_dir)):
+                pass_dir = os.path.join(passes_dir, pass_name)
+                with open(os.path.join(pass_dir, "flags")) as f:
+                    flags = f.read().split()
+                for file in sorted(os.listdir(pass_dir)):
+                    stem, file_ext = os.path.splitext(file)
+                    if file_ext not in (".cminus", ".ll"):
+                        continue
+                    input_file = os.path.join(pass_dir, stem + ".in")
+                    cases.append(Case(
+                        suite, pass_name + "/" + stem,
+                        os.path.join(pass_dir, file),
+                        os.path.join(pass_dir, stem + ".out"),
+                        input_file if os.path.exists(input_file) else None,
+                        flags))
+    return cases
+
+
+def file_hash(path, hasher=None):
+    hasher = hasher or hashlib.sha256()
+    try:
+        with open(path, "rb") as f:
+            for block in iter(lambda: f.read(1 << 20), b""):
+                hasher.update(block)
+    except OSError:
+        hasher.update(b"<missing>")
+    return hasher
+
+
+class Runner:
+    def __init__(self, args):
+        self.build_dir = os.path.abspath(args.build_dir)
+        self.cminusfc = os.path.join(self.build_dir, "cminusfc")
+        self.parser = os.path.join(self.build_dir, "parser")
+        self.timeout = args.timeout
+        self.run_mode = args.run
+        self.clang = args.clang
+        self.io_lib = args.io_lib
+        # the binaries are hashed once, they do not change during a run
+        self.binary_hash = {
+            suite: self.hash_binaries(suite)
+            for suite in ("phase1", "phase2", "lab2", "general", "vectorize",
+                          "passes")
+        }
+
+    def hash_binaries(self, suite):
+        hasher = hashlib.sha256()
+        if suite == "phase1":
+            file_hash(self.parser, hasher)
+        else:
+            file_hash(self.cminusfc, hasher)
+        if (suite in ("lab2", "general", "vectorize", "passes") and
+                not self.run_mode):
+            file_hash(os.path.join(self.build_dir,
+                                   "lib%s.a" % self.io_lib), hasher)
+            hasher.update(str(shutil.which(self.clang)).encode())
+        return hasher.hexdigest()
+
+    def key(self, case, flags):
+        hasher = hashlib.sha256()
+        hasher.update(self.binary_hash[case.suite].encode())
+        hasher.update(json.dumps([case.suite, flags, case.flags,
+                                  self.run_mode, self.timeout,
+                                  self.io_lib]).encode())
+        for path in (case.source, case.expected, case.input_file):
+            if path:
+                file_hash(path, hasher)
+        return hasher.hexdigest()
+
+    def step(self, result, phase, command, **kwargs):
+        """runs command under the timeout, its time goes to result[phase]"""
+        start = time.monotonic()
+        try:
+            proc = subprocess.run(command, stdout=subprocess.PIPE,
+                                  stderr=subprocess.PIPE,
+                                  timeout=self.timeout, **kwargs)
+        except subprocess.TimeoutExpired:
+            proc = None
+        result[phase] = result.get(phase, 0) + (time.monotonic() - start)
+        return proc
+
+    def run(self, case, flags):
+        result = {"suite": case.suite, "case": case.name, "flags": flags}
+        try:
+            with open(case.expected, "rb") as f:
+                expected = f.read()
+        except OSError:
+            if case.suite != "passes":
+                result["status"] = "no expected output"
+                return result
+            expected = None
+        stdin = None
+        if case.input_file:
+            with open(case.input_file, "rb") as f:
+                stdin = f.read()
+        flag_list = (case.flags if case.flags is not None else
+                     shlex.split(flags))
+
+        if case.suite in ("phase1", "phase2"):
+            command = ([self.parser, case.source] if case.suite == "phase1"
+                       else [self.cminusfc, "-emit-ast"] + flag_list +
+                       [case.source])
+            proc = self.step(result, "compile", command)
+            result["status"] = self.compare(proc, expected, False)
+            return result
+
+        if case.suite == "vectorize":
+            # the flags would mix with -dce -vectorize
+            flag_list = ["-dce", "-vectorize"]
+            proc = self.step(result, "run", [self.cminusfc, "-run",
+                                             case.source], input=stdin)
+            if self.compare(proc, expected, False) != "pass":
+                result["status"] = "fail at -O0"
+                return result
+
+        # lab2 compares what the program prints, general its exit status
+        by_status = case.suite == "general"
+        # -run takes no vector ir, the vectorize cases go through the file;
+        # the ir of the passes cases is checked
+        if self.run_mode and case.suite not in ("vectorize", "passes"):
+            proc = self.step(result, "run", [self.cminusfc, "-run"] +
+                             flag_list + [case.source], input=stdin)
+            result["status"] = self.compare(proc, expected, by_status)
+            return result
+
+        work_dir = tempfile.mkdtemp(prefix="cminusf-test-")
+        try:
+            ll_file = os.path.join(work_dir, "case.ll")
+            exe_file = os.path.join(work_dir, "case")
+            proc = self.step(result, "compile",
+                             [self.cminusfc, "-emit-llvm"] + flag_list +
+                             ["-o", ll_file, case.source])
+            if proc is None or proc.returncode != 0:
+                result["status"] = "compile failed"
+                return result
+            if case.suite == "vectorize":
+                with open(ll_file, "rb") as f:
+                    if b"<4 x" not in f.read():
+                        result["status"] = "not vectorized"
+                        return result
+            if case.suite == "passes":
+                with open(case.source) as f:
+                    source = f.read()
+                with open(ll_file) as f:
+                    ir = f.read()
+                checks = CHECK_LINE.findall(source)
+                if checks or not case.source.endswith(".ll"):
+                    failed = check_ir(ir, checks)
+                else:
+                    failed = check_round_trip(source, ir)
+                if failed:
+                    result["status"] = "check failed"
+                    result["detail"] = failed
+                    return result
+                if expected is None:
+                    result["status"] = "pass"
+                    return result
+            if self.run_mode:
+                mode = "-jit" if case.suite == "vectorize" else "-run"
+                proc = self.step(result, "run",
+                                 [self.cminusfc, mode] + flag_list +
+                                 [case.source], input=stdin)
+                result["status"] = self.compare(proc, expected, by_status)
+                return result
+            proc = self.step(result, "link",
+                             [self.clang, "-O0", "-w", "-no-pie", ll_file,
+                              "-o", exe_file, "-L", self.build_dir,
+                              "-l" + self.io_lib])
+            if proc is None or proc.returncode != 0:
+                result["status"] = "link failed"
+                return result
+            proc = self.step(result, "run", [exe_file], input=stdin)
+            result["status"] = self.compare(proc, expected, by_status)
+            return result
+        finally:
+            shutil.rmtree(work_dir, ignore_errors=True)
+
+    @staticmethod
+    def compare(proc, expected, by_status):
+        if proc is None:
+            return "timeout"
+        if by_status:
+            ok = str(proc.returncode) == expected.decode().strip()
+        else:
+            ok = proc.stdout == expected
+        return "pass" if ok else "fail"
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("suites", nargs="*",
+                        choices=["phase1", "phase2", "lab2", "general",
+                                 "vectorize", "passes"],
+                        help="default: all of them")
+    parser.add_argument("--flags", action="append",
+                        help="cminusfc options, repeat for a sweep "
+                             "(default: none)")
+    parser.add_argument("--build-dir",
+                        default=os.path.join(TESTS_DIR, "..", "build"))
+    parser.add_argument("-j", "--jobs", type=int, default=os.cpu_count())
+    parser.add_argument("--timeout", type=float, default=10,
+                        help="seconds for each compile, link and run")
+    parser.add_argument("--run", action="store_true",
+                        help="interpret with cminusfc -run instead of "
+                             "linking with clang")
+    parser.add_argument("--clang", default="clang")
+    parser.add_argument("--io-lib", default="cminus_io",
+                        help="the runtime to link, e.g. cminus_io_fast")
+    parser.add_argument("--cache", help="default: <build-dir>/test_cache.json")
+    parser.add_argument("--force", action="store_true",
+                        help="run the cases that passed before as well")
+    parser.add_argument("--slowest", type=int, default=10,
+                        help="number of cases in the timing summary")
+    parser.add_argument("--json", help="write every result to this file")
+    args = parser.parse_args()
+
+    suites = args.suites or ["phase1", "phase2", "lab2", "general",
+                             "vectorize", "passes"]
+    flag_sets = args.flags or [""]
+    cache_file = args.cache or os.path.join(args.build_dir,
+                                            "test_cache.json")
+    try:
+        with open(cache_file) as f:
+            cache = json.load(f)
+    except (OSError, ValueError):
+        cache = {}
+
+    runner = Runner(args)
+    jobs, results, skipped = [], [], 0
+    for flags in flag_sets:
+        for case in collect(suites):
+            key = runner.key(case, flags)
+            cache_id = "%s %s %s" % (case.suite, case.name, flags)
+            if not args.force and cache.get(cache_id) == key:
+                skipped += 1
+                continue
+            jobs.append((case, flags, key, cache_id))
+
+    start = time.monotonic()
+    with ThreadPoolExecutor(max_workers=max(1, args.jobs)) as pool:
+        futures = [pool.submit(runner.run, case, flags)
+                   for case, flags, _, _ in jobs]
+        for (case, flags, key, cache_id), future in zip(jobs, futures):
+            result = future.result()
+            results.append(result)
+            if result["status"] == "pass":
+                cache[cache_id] = key
+            else:
+                cache.pop(cache_id, None)
+                print("%-6s %-8s %-40s %s" % (result["status"].upper(),
+                                              case.suite, case.name, flags))
+                if "detail" in result:
+                    print("       " + result["detail"])
+    elapsed = time.monotonic() - start
+
+    os.makedirs(os.path.dirname(os.path.abspath(cache_file)), exist_ok=True)
+    with open(cache_file, "w") as f:
+        json.dump(cache, f, indent=0, sort_keys=True)
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(results, f, indent=1)
+
+    def total(result):
+        return sum(result.get(p, 0) for p in ("compile", "link", "run"))
+
+    if results and args.slowest > 0:
+        print("slowest cases:")
+        for result in sorted(results, key=total, reverse=True)[:args.slowest]:
+            print("  %8.1f ms  compile %8.1f  link %8.1f  run %8.1f  %s %s %s"
+                  % (total(result) * 1000, result.get("compile", 0) * 1000,
+                     result.get("link", 0) * 1000,
+                     result.get("run", 0) * 1000, result["suite"],
+                     result["case"], result["flags"]))
+    passed = sum(r["status"] == "pass" for r in results)
+    print("%d passed, %d failed, %d skipped as unchanged, %.1f s" %
+          (passed, len(results) - passed, skipped, elapsed))
+    return 0 if passed == len(results) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
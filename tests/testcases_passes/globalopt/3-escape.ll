@@ -0,0 +1,28 @@
+; a global whose address goes to a declaration may be written through
+; whatever that keeps of it, so it stays a variable read back by main
+; CHECK: @seen = global i32 0
+; CHECK-NOT: @last
+; CHECK: call void @keep(i32* @seen)
+; CHECK: load i32, i32* @seen
+@seen = global i32 0
+@last = global i32 0
+declare i32 @input()
+
+declare void @output(i32)
+
+declare void @keep(i32*)
+
+define i32 @main() {
+label_entry:
+  %op0 = call i32 @input()
+  store i32 %op0, i32* @last
+  %op1 = icmp slt i32 %op0, 0
+  br i1 %op1, label %label2, label %label3
+label2:                                                ; preds = %label_entry
+  call void @keep(i32* @seen)
+  br label %label3
+label3:                                                ; preds = %label_entry, %label2
+  %op4 = load i32, i32* @seen
+  call void @output(i32 %op4)
+  ret i32 0
+}
@@ -0,0 +1,108 @@
+; what cminusfc writes reads back as it was: globals, declarations, a phi
+; that uses a value defined further down, float constants, geps into an
+; array and through a pointer argument, zext, calls and branches
+
+@g = global i32 zeroinitializer
+@h = global [3 x float] zeroinitializer
+declare i32 @input()
+
+declare void @output(i32)
+
+declare void @outputFloat(float)
+
+declare void @neg_idx_except()
+
+define float @scale(float* %a, i32 %n, float %f) {
+label_entry:
+  %op0 = alloca float*
+  %op1 = alloca i32
+  %op2 = alloca float
+  %op3 = alloca i32
+  %op4 = alloca float
+  br label %label5
+label5:                                                ; preds = %label_entry, %label14
+  %op6 = phi float [ 0x0, %label_entry ], [ %op18, %label14 ]
+  %op7 = phi i32 [ 0, %label_entry ], [ %op19, %label14 ]
+  %op8 = icmp slt i32 %op7, %n
+  %op9 = zext i1 %op8 to i32
+  %op10 = icmp ne i32 %op9, 0
+  br i1 %op10, label %label11, label %label13
+label11:                                                ; preds = %label5
+  %op12 = icmp sge i32 %op7, 0
+  br i1 %op12, label %label14, label %label20
+label13:                                                ; preds = %label5
+  ret float %op6
+label14:                                                ; preds = %label11, %label20
+  %op15 = getelementptr float, float* %a, i32 %op7
+  %op16 = load float, float* %op15
+  %op17 = fmul float %op16, %f
+  %op18 = fadd float %op6, %op17
+  %op19 = add i32 %op7, 1
+  br label %label5
+label20:                                                ; preds = %label11
+  call void @neg_idx_except()
+  br label %label14
+}
+define void @fill(i32 %n) {
+label_entry:
+  %op0 = alloca i32
+  %op1 = icmp sge i32 0, 0
+  br i1 %op1, label %label2, label %label8
+label2:                                                ; preds = %label_entry, %label8
+  %op3 = getelementptr [3 x float], [3 x float]* @h, i32 0, i32 0
+  %op4 = sitofp i32 %n to float
+  store float %op4, float* %op3
+  %op5 = sitofp i32 %n to float
+  %op6 = fdiv float %op5, 0x4000000000000000
+  %op7 = icmp sge i32 1, 0
+  br i1 %op7, label %label9, label %label13
+label8:                                                ; preds = %label_entry
+  call void @neg_idx_except()
+  br label %label2
+label9:                                                ; preds = %label2, %label13
+  %op10 = getelementptr [3 x float], [3 x float]* @h, i32 0, i32 1
+  store float %op6, float* %op10
+  %op11 = load i32, i32* @g
+  %op12 = icmp sge i32 2, 0
+  br i1 %op12, label %label14, label %label17
+label13:                                                ; preds = %label2
+  call void @neg_idx_except()
+  br label %label9
+label14:                                                ; preds = %label9, %label17
+  %op15 = getelementptr [3 x float], [3 x float]* @h, i32 0, i32 2
+  %op16 = sitofp i32 %op11 to float
+  store float %op16, float* %op15
+  ret void
+label17:                                                ; preds = %label9
+  call void @neg_idx_except()
+  br label %label14
+}
+define i32 @main() {
+label_entry:
+  %op0 = alloca i32
+  %op1 = call i32 @input()
+  %op2 = mul i32 %op1, 3
+  store i32 %op2, i32* @g
+  call void @fill(i32 %op1)
+  %op3 = getelementptr [3 x float], [3 x float]* @h, i32 0, i32 0
+  %op4 = call float @scale(float* %op3, i32 3, float 0x3fe0000000000000)
+  call void @outputFloat(float %op4)
+  %op5 = icmp sgt i32 %op1, 2
+  %op6 = zext i1 %op5 to i32
+  %op7 = load i32, i32* @g
+  %op8 = icmp slt i32 %op7, 10
+  %op9 = zext i1 %op8 to i32
+  %op10 = icmp eq i32 %op6, %op9
+  %op11 = zext i1 %op10 to i32
+  %op12 = icmp ne i32 %op11, 0
+  br i1 %op12, label %label13, label %label16
+label13:                                                ; preds = %label_entry
+  call void @output(i32 1)
+  br label %label14
+label14:                                                ; preds = %label13, %label16
+  %op15 = load i32, i32* @g
+  ret i32 %op15
+label16:                                                ; preds = %label_entry
+  call void @output(i32 0)
+  br label %label14
+}
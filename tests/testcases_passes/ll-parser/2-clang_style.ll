@@ -0,0 +1,54 @@
+; the parser skips what clang puts around the code: linkage words, nsw,
+; noundef, align, attribute groups, the target and metadata, numbers an
+; unnamed entry block after the arguments and calls a function defined
+; further down
+; CHECK: @k = global i32 0
+; CHECK: define i32 @main() {
+; CHECK-NOT: dso_local
+; CHECK: 0:
+; CHECK: %2 = call i32 @twice(i32 %1)
+; CHECK: %4 = phi i32 [ 0, %0 ], [ %7, %5 ]
+; CHECK: %7 = add i32 %4, %6
+; CHECK: define i32 @twice(i32 %0) {
+; CHECK: 1:
+; CHECK: %2 = mul i32 %0, 2
+; CHECK-NOT: attributes
+target triple = "x86_64-pc-linux-gnu"
+
+@k = dso_local global i32 0, align 4
+
+define dso_local i32 @main() #0 {
+  %1 = call i32 @input()
+  %2 = call i32 @twice(i32 noundef %1)
+  br label %3
+
+3:
+  %4 = phi i32 [ 0, %0 ], [ %7, %5 ]
+  %c = icmp slt i32 %4, %2
+  br i1 %c, label %5, label %8
+
+5:
+  call void @output(i32 %4)
+  %6 = load i32, i32* @k, align 4
+  %7 = add nsw i32 %4, %6
+  br label %3
+
+8:
+  ret i32 0
+}
+
+define internal i32 @twice(i32 %0) #0 {
+  store i32 3, i32* @k, align 4
+  %2 = mul nsw i32 %0, 2
+  ret i32 %2
+}
+
+declare i32 @input() #1
+
+declare void @output(i32) #1
+
+attributes #0 = { noinline nounwind optnone uwtable }
+attributes #1 = { "frame-pointer"="all" }
+
+!llvm.module.flags = !{!0}
+!0 = !{i32 1, !"wchar_size", i32 4}